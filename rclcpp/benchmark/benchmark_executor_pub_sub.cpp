@@ -0,0 +1,147 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how many messages the executors deliver per second, and how long a message takes
+// from publish to the subscription callback, as the numbers of nodes and subscriptions grow.
+// Prints one JSON object per scenario and line.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcl_interfaces/msg/intra_process_message.hpp"
+
+#include "benchmark_utilities.hpp"
+
+using Message = rcl_interfaces::msg::IntraProcessMessage;
+using Clock = std::chrono::steady_clock;
+
+/// Messages published but not yet received by every subscription, to not overrun the queues.
+static const size_t max_messages_in_flight = 10;
+static const size_t queue_depth = 100;
+
+static void
+run_scenario(
+  const std::string & executor_name, size_t number_of_nodes, size_t subscriptions_per_node,
+  const benchmark::BenchmarkOptions & options)
+{
+  static size_t scenario_index = 0;
+  std::string topic = "benchmark_pub_sub_" + std::to_string(scenario_index++);
+  size_t number_of_subscriptions = number_of_nodes * subscriptions_per_node;
+  size_t max_samples = 1000000 / number_of_nodes;
+
+  std::atomic<uint64_t> received(0);
+  std::vector<rclcpp::node::Node::SharedPtr> nodes;
+  std::vector<std::shared_ptr<benchmark::LatencyRecorder>> latencies;
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> subscriptions;
+  for (size_t i = 0; i < number_of_nodes; ++i) {
+    auto node = rclcpp::node::Node::make_shared("benchmark_subscriber_" + std::to_string(i));
+    // The callbacks of a node are mutually exclusive, so each node has its own recorder.
+    auto recorder = std::make_shared<benchmark::LatencyRecorder>(max_samples);
+    for (size_t j = 0; j < subscriptions_per_node; ++j) {
+      subscriptions.push_back(node->create_subscription<Message>(
+          topic, queue_depth,
+          [recorder, &received](const std::shared_ptr<const Message> msg) {
+            auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              Clock::now().time_since_epoch());
+            recorder->record(now - std::chrono::nanoseconds(msg->message_sequence));
+            received.fetch_add(1, std::memory_order_release);
+          }));
+    }
+    nodes.push_back(node);
+    latencies.push_back(recorder);
+  }
+  auto publisher_node = rclcpp::node::Node::make_shared("benchmark_publisher");
+  auto publisher = publisher_node->create_publisher<Message>(topic, queue_depth);
+  if (!publisher_node->wait_for_subscribers(topic, number_of_subscriptions,
+    std::chrono::seconds(10)))
+  {
+    fprintf(stderr, "subscriptions of '%s' not discovered, skipping\n", topic.c_str());
+    return;
+  }
+
+  auto executor = benchmark::make_executor(executor_name);
+  for (auto & node : nodes) {
+    executor->add_node(node);
+  }
+  uint64_t published = 0;
+  Clock::time_point end;
+  auto start = Clock::now();
+  {
+    benchmark::SpinThread spin_thread(executor);
+    Message msg;
+    auto deadline = start + options.duration;
+    while (Clock::now() < deadline && rclcpp::ok()) {
+      uint64_t expected = published * number_of_subscriptions;
+      if (expected - received.load(std::memory_order_acquire) >
+        max_messages_in_flight * number_of_subscriptions)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      msg.message_sequence = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+      publisher->publish(msg);
+      ++published;
+    }
+    // Let the messages in flight arrive, unless some were lost.
+    auto drain_deadline = Clock::now() + std::chrono::seconds(1);
+    while (received.load(std::memory_order_acquire) < published * number_of_subscriptions &&
+      Clock::now() < drain_deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    end = Clock::now();
+  }
+
+  benchmark::LatencyRecorder all_latencies(max_samples * number_of_nodes);
+  for (auto & recorder : latencies) {
+    all_latencies.merge(*recorder);
+  }
+  double seconds = std::chrono::duration<double>(end - start).count();
+  printf(
+    "{\"benchmark\": \"pub_sub\", \"executor\": \"%s\", \"nodes\": %zu, "
+    "\"subscriptions\": %zu, \"published\": %" PRIu64 ", \"received\": %" PRIu64 ", "
+    "\"published_per_second\": %.1f, \"received_per_second\": %.1f",
+    executor_name.c_str(), number_of_nodes, number_of_subscriptions, published,
+    static_cast<uint64_t>(received.load()), published / seconds, received.load() / seconds);
+  benchmark::print_latency_and_end_line("latency", all_latencies);
+}
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto options = benchmark::parse_options(argc, argv);
+
+  for (auto & executor_name : benchmark::executor_names) {
+    if (!options.executor.empty() && options.executor != executor_name) {
+      continue;
+    }
+    for (size_t number_of_nodes : {1, 10, 40}) {
+      for (size_t subscriptions_per_node : {1, 10}) {
+        if (!rclcpp::ok()) {
+          return 0;
+        }
+        run_scenario(executor_name, number_of_nodes, subscriptions_per_node, options);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how late the executors call timers, as the numbers of nodes and timers grow.
+// Prints one JSON object per scenario and line.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "benchmark_utilities.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static const std::chrono::milliseconds timer_period(10);
+
+static void
+run_scenario(
+  const std::string & executor_name, size_t number_of_nodes, size_t timers_per_node,
+  const benchmark::BenchmarkOptions & options)
+{
+  size_t max_samples = 2 * timers_per_node * (options.duration / timer_period + 1);
+
+  std::atomic<uint64_t> calls(0);
+  std::vector<rclcpp::node::Node::SharedPtr> nodes;
+  std::vector<std::shared_ptr<benchmark::LatencyRecorder>> latencies;
+  std::vector<rclcpp::timer::TimerBase::SharedPtr> timers;
+  for (size_t i = 0; i < number_of_nodes; ++i) {
+    auto node = rclcpp::node::Node::make_shared("benchmark_timers_" + std::to_string(i));
+    // The callbacks of a node are mutually exclusive, so each node has its own recorder.
+    auto recorder = std::make_shared<benchmark::LatencyRecorder>(max_samples);
+    for (size_t j = 0; j < timers_per_node; ++j) {
+      timers.push_back(node->create_wall_timer(
+          timer_period,
+          [recorder, &calls](rclcpp::timer::TimerBase & timer) {
+            recorder->record(timer.get_statistics().last_lateness);
+            calls.fetch_add(1, std::memory_order_relaxed);
+          }));
+    }
+    nodes.push_back(node);
+    latencies.push_back(recorder);
+  }
+
+  auto executor = benchmark::make_executor(executor_name);
+  for (auto & node : nodes) {
+    executor->add_node(node);
+  }
+  auto start = Clock::now();
+  {
+    benchmark::SpinThread spin_thread(executor);
+    std::this_thread::sleep_for(options.duration);
+  }
+  auto end = Clock::now();
+
+  uint64_t missed_periods = 0;
+  for (auto & timer : timers) {
+    missed_periods += timer->get_statistics().missed_periods;
+  }
+  benchmark::LatencyRecorder all_latencies(max_samples * number_of_nodes);
+  for (auto & recorder : latencies) {
+    all_latencies.merge(*recorder);
+  }
+  double seconds = std::chrono::duration<double>(end - start).count();
+  uint64_t total_calls = calls.load();
+  printf(
+    "{\"benchmark\": \"timers\", \"executor\": \"%s\", \"nodes\": %zu, \"timers\": %zu, "
+    "\"period_ns\": %" PRId64 ", \"calls\": %" PRIu64 ", \"calls_per_second\": %.1f, "
+    "\"missed_periods\": %" PRIu64,
+    executor_name.c_str(), number_of_nodes, number_of_nodes * timers_per_node,
+    static_cast<int64_t>(std::chrono::nanoseconds(timer_period).count()), total_calls,
+    total_calls / seconds, missed_periods);
+  benchmark::print_latency_and_end_line("lateness", all_latencies);
+}
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto options = benchmark::parse_options(argc, argv);
+
+  for (auto & executor_name : benchmark::executor_names) {
+    if (!options.executor.empty() && options.executor != executor_name) {
+      continue;
+    }
+    for (size_t number_of_nodes : {1, 10, 40}) {
+      for (size_t timers_per_node : {1, 10}) {
+        if (!rclcpp::ok()) {
+          return 0;
+        }
+        run_scenario(executor_name, number_of_nodes, timers_per_node, options);
+      }
+    }
+  }
+  return 0;
+}
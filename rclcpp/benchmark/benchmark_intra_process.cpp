@@ -0,0 +1,326 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares intra process, inter process and mixed subscriptions for message sizes from 64 B to
+// 16 MB, for each callback type and a growing number of subscriptions.
+// Reports the latency from publish to callback, how often rclcpp copied each message and how
+// many allocations each message took. Prints one JSON object per scenario and line.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcl_interfaces/msg/parameter_value.hpp"
+
+#include "allocation_tracking.hpp"
+#include "benchmark_utilities.hpp"
+
+using Message = rcl_interfaces::msg::ParameterValue;
+using Clock = std::chrono::steady_clock;
+
+/// Shared by the copies of a CopyCountingAllocator.
+struct CopyCounters
+{
+  CopyCounters()
+  : copies(0)
+  {}
+
+  std::atomic<uint64_t> copies;
+};
+
+/// Allocator which counts the copy constructions made through it.
+/**
+ * The publisher's ring buffer for intra process messages, the publisher and the subscriptions
+ * copy messages through their allocator, so this counts every copy rclcpp makes.
+ */
+template<typename T>
+class CopyCountingAllocator
+{
+public:
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = CopyCountingAllocator<U>;
+  };
+
+  CopyCountingAllocator()
+  : counters_(std::make_shared<CopyCounters>())
+  {}
+
+  template<typename U>
+  CopyCountingAllocator(const CopyCountingAllocator<U> & other) noexcept
+  : counters_(other.get_counters())
+  {}
+
+  T * allocate(size_t n)
+  {
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T * pointer, size_t n) noexcept
+  {
+    (void)n;
+    ::operator delete(pointer);
+  }
+
+  template<typename U, typename ... Args>
+  void construct(U * pointer, Args && ... args)
+  {
+    ::new(static_cast<void *>(pointer)) U(std::forward<Args>(args) ...);
+  }
+
+  template<typename U>
+  void construct(U * pointer, const U & other)
+  {
+    counters_->copies.fetch_add(1, std::memory_order_relaxed);
+    ::new(static_cast<void *>(pointer)) U(other);
+  }
+
+  template<typename U>
+  void construct(U * pointer, U & other)
+  {
+    construct(pointer, static_cast<const U &>(other));
+  }
+
+  std::shared_ptr<CopyCounters> get_counters() const noexcept
+  {
+    return counters_;
+  }
+
+private:
+  std::shared_ptr<CopyCounters> counters_;
+};
+
+template<typename T, typename U>
+bool operator==(const CopyCountingAllocator<T> & a, const CopyCountingAllocator<U> & b) noexcept
+{
+  return a.get_counters() == b.get_counters();
+}
+
+template<typename T, typename U>
+bool operator!=(const CopyCountingAllocator<T> & a, const CopyCountingAllocator<U> & b) noexcept
+{
+  return !(a == b);
+}
+
+using Alloc = CopyCountingAllocator<void>;
+using Publisher = rclcpp::publisher::Publisher<Message, Alloc>;
+using Subscription = rclcpp::subscription::Subscription<Message, Alloc>;
+
+enum class Transport {Intra, Inter, Mixed};
+enum class CallbackKind {Unique, Shared, ConstShared};
+
+static const char *
+to_string(Transport transport)
+{
+  switch (transport) {
+    case Transport::Intra:
+      return "intra";
+    case Transport::Inter:
+      return "inter";
+    default:
+      return "mixed";
+  }
+}
+
+static const char *
+to_string(CallbackKind kind)
+{
+  switch (kind) {
+    case CallbackKind::Unique:
+      return "unique";
+    case CallbackKind::Shared:
+      return "shared";
+    default:
+      return "const_shared";
+  }
+}
+
+static const size_t queue_depth = 10;
+/// Bytes of messages published but not yet received by every subscription.
+static const size_t max_bytes_in_flight = 64 * 1024 * 1024;
+
+static rclcpp::subscription::SubscriptionBase::SharedPtr
+create_subscription(
+  rclcpp::node::Node::SharedPtr node, const std::string & topic, CallbackKind kind,
+  std::shared_ptr<Alloc> allocator, std::function<void(const Message &)> on_message)
+{
+  switch (kind) {
+    case CallbackKind::Unique:
+      return node->create_subscription<Message>(
+        topic, queue_depth,
+        [on_message](Subscription::MessageUniquePtr msg) {
+          on_message(*msg);
+        }, nullptr, false, nullptr, allocator);
+    case CallbackKind::Shared:
+      return node->create_subscription<Message>(
+        topic, queue_depth,
+        [on_message](const std::shared_ptr<Message> msg) {
+          on_message(*msg);
+        }, nullptr, false, nullptr, allocator);
+    default:
+      return node->create_subscription<Message>(
+        topic, queue_depth,
+        [on_message](const std::shared_ptr<const Message> msg) {
+          on_message(*msg);
+        }, nullptr, false, nullptr, allocator);
+  }
+}
+
+static void
+run_scenario(
+  size_t message_size, Transport transport, CallbackKind kind, size_t number_of_subscriptions,
+  const benchmark::BenchmarkOptions & options)
+{
+  static size_t scenario_index = 0;
+  std::string topic = "benchmark_intra_process_" + std::to_string(scenario_index++);
+  size_t max_messages_in_flight =
+    std::max<size_t>(1, std::min<size_t>(queue_depth / 2, max_bytes_in_flight / message_size));
+  size_t max_samples = 100000;
+
+  auto allocator = std::make_shared<Alloc>();
+  std::atomic<uint64_t> received(0);
+  std::vector<rclcpp::node::Node::SharedPtr> nodes;
+  std::vector<std::shared_ptr<benchmark::LatencyRecorder>> latencies;
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> subscriptions;
+  for (size_t i = 0; i < number_of_subscriptions; ++i) {
+    // Mixed scenarios alternate between intra and inter process subscriptions.
+    bool intra = transport == Transport::Intra || (transport == Transport::Mixed && i % 2 == 0);
+    auto node = rclcpp::node::Node::make_shared(
+      "benchmark_subscriber_" + std::to_string(i), intra);
+    auto recorder = std::make_shared<benchmark::LatencyRecorder>(max_samples);
+    subscriptions.push_back(create_subscription(node, topic, kind, allocator,
+      [recorder, &received](const Message & msg) {
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now().time_since_epoch());
+        recorder->record(now - std::chrono::nanoseconds(msg.integer_value));
+        received.fetch_add(1, std::memory_order_release);
+      }));
+    nodes.push_back(node);
+    latencies.push_back(recorder);
+  }
+  auto publisher_node = rclcpp::node::Node::make_shared(
+    "benchmark_publisher", transport != Transport::Inter);
+  auto publisher = publisher_node->create_publisher<Message>(topic, queue_depth, allocator);
+  if (!publisher_node->wait_for_subscribers(topic, number_of_subscriptions,
+    std::chrono::seconds(10)))
+  {
+    fprintf(stderr, "subscriptions of '%s' not discovered, skipping\n", topic.c_str());
+    return;
+  }
+
+  auto executor = benchmark::make_executor("single_threaded");
+  for (auto & node : nodes) {
+    executor->add_node(node);
+  }
+  auto message_allocator = publisher->get_allocator();
+  uint64_t published = 0;
+  uint64_t copies_before = allocator->get_counters()->copies.load();
+  Clock::time_point end;
+  allocation_tracking::start();
+  auto start = Clock::now();
+  {
+    std::thread spin_thread([executor]() {
+        allocation_tracking::ScopedRegion region("executor");
+        executor->spin();
+      });
+    allocation_tracking::ScopedRegion region("publish");
+    auto deadline = start + options.duration;
+    while (Clock::now() < deadline && rclcpp::ok()) {
+      uint64_t expected = published * number_of_subscriptions;
+      if (expected - received.load(std::memory_order_acquire) >
+        max_messages_in_flight * number_of_subscriptions)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      auto ptr = Publisher::MessageAllocTraits::allocate(*message_allocator, 1);
+      Publisher::MessageAllocTraits::construct(*message_allocator, ptr);
+      Publisher::MessageDeleter deleter;
+      rclcpp::allocator::set_allocator_for_deleter(&deleter, message_allocator.get());
+      Publisher::MessageUniquePtr msg(ptr, deleter);
+      msg->bytes_value.resize(message_size);
+      msg->integer_value = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+      publisher->publish(msg);
+      ++published;
+    }
+    // Let the messages in flight arrive, unless some were lost.
+    auto drain_deadline = Clock::now() + std::chrono::seconds(1);
+    while (received.load(std::memory_order_acquire) < published * number_of_subscriptions &&
+      Clock::now() < drain_deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    end = Clock::now();
+    executor->cancel();
+    spin_thread.join();
+  }
+  allocation_tracking::stop();
+  uint64_t copies = allocator->get_counters()->copies.load() - copies_before;
+
+  benchmark::LatencyRecorder all_latencies(max_samples * number_of_subscriptions);
+  for (auto & recorder : latencies) {
+    all_latencies.merge(*recorder);
+  }
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double per_message = published ? 1.0 / published : 0.0;
+  size_t allocations = allocation_tracking::get_allocation_count("publish") +
+    allocation_tracking::get_allocation_count("executor");
+  size_t allocated_bytes = allocation_tracking::get_allocated_bytes("publish") +
+    allocation_tracking::get_allocated_bytes("executor");
+  printf(
+    "{\"benchmark\": \"intra_process\", \"message_size\": %zu, \"transport\": \"%s\", "
+    "\"callback\": \"%s\", \"subscriptions\": %zu, \"published\": %" PRIu64 ", "
+    "\"received\": %" PRIu64 ", \"received_per_second\": %.1f, \"copies_per_message\": %.2f, "
+    "\"allocations_per_message\": %.2f, \"allocated_bytes_per_message\": %.1f",
+    message_size, to_string(transport), to_string(kind), number_of_subscriptions, published,
+    static_cast<uint64_t>(received.load()), received.load() / seconds, copies * per_message,
+    allocations * per_message, allocated_bytes * per_message);
+  benchmark::print_latency_and_end_line("latency", all_latencies);
+}
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto options = benchmark::parse_options(argc, argv);
+
+  for (size_t message_size : {64, 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024}) {
+    for (auto transport : {Transport::Intra, Transport::Inter, Transport::Mixed}) {
+      for (auto kind : {CallbackKind::Unique, CallbackKind::Shared, CallbackKind::ConstShared}) {
+        for (size_t number_of_subscriptions : {1, 4, 16}) {
+          if (!rclcpp::ok()) {
+            return 0;
+          }
+          if (transport == Transport::Mixed && number_of_subscriptions < 2) {
+            continue;
+          }
+          run_scenario(message_size, transport, kind, number_of_subscriptions, options);
+        }
+      }
+    }
+  }
+  return 0;
+}
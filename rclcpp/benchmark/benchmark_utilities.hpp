@@ -0,0 +1,163 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK_UTILITIES_HPP_
+#define BENCHMARK_UTILITIES_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/executor.hpp"
+#include "rclcpp/executors/multi_threaded_executor.hpp"
+#include "rclcpp/executors/single_threaded_executor.hpp"
+
+namespace benchmark
+{
+
+/// Collects latency samples without allocating once constructed.
+/**
+ * Samples past the capacity are counted but not kept, so the percentiles are those of the
+ * first capacity samples.
+ * A recorder is not thread safe, give each mutually exclusive callback group its own one.
+ */
+class LatencyRecorder
+{
+public:
+  explicit LatencyRecorder(size_t capacity)
+  : dropped_(0)
+  {
+    samples_.reserve(capacity);
+  }
+
+  void
+  record(std::chrono::nanoseconds latency)
+  {
+    if (samples_.size() < samples_.capacity()) {
+      samples_.push_back(latency.count());
+    } else {
+      ++dropped_;
+    }
+  }
+
+  void
+  merge(const LatencyRecorder & other)
+  {
+    samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+    dropped_ += other.dropped_;
+  }
+
+  size_t
+  count() const
+  {
+    return samples_.size() + dropped_;
+  }
+
+  /// Return the latency which the fraction of the samples does not exceed, sorting the samples.
+  int64_t
+  percentile(double fraction)
+  {
+    if (samples_.empty()) {
+      return 0;
+    }
+    std::sort(samples_.begin(), samples_.end());
+    size_t index = static_cast<size_t>(fraction * samples_.size());
+    return samples_[std::min(index, samples_.size() - 1)];
+  }
+
+private:
+  std::vector<int64_t> samples_;
+  size_t dropped_;
+};
+
+/// Executors which the benchmarks compare.
+const std::vector<std::string> executor_names = {"single_threaded", "multi_threaded"};
+
+inline rclcpp::executor::Executor::SharedPtr
+make_executor(const std::string & name)
+{
+  if (name == "single_threaded") {
+    return std::make_shared<rclcpp::executors::single_threaded_executor::SingleThreadedExecutor>();
+  }
+  if (name == "multi_threaded") {
+    return std::make_shared<rclcpp::executors::multi_threaded_executor::MultiThreadedExecutor>();
+  }
+  throw std::invalid_argument("unknown executor '" + name + "'");
+}
+
+/// Spins an executor in a thread until destroyed.
+class SpinThread
+{
+public:
+  explicit SpinThread(rclcpp::executor::Executor::SharedPtr executor)
+  : executor_(executor), thread_([executor]() {executor->spin();})
+  {}
+
+  ~SpinThread()
+  {
+    executor_->cancel();
+    thread_.join();
+  }
+
+private:
+  rclcpp::executor::Executor::SharedPtr executor_;
+  std::thread thread_;
+};
+
+/// Options shared by the benchmarks.
+struct BenchmarkOptions
+{
+  /// How long each scenario runs.
+  std::chrono::milliseconds duration = std::chrono::milliseconds(2000);
+  /// Only run the scenarios of this executor, all executors if empty.
+  std::string executor;
+};
+
+/// Parse --duration-ms <ms> and --executor <name>; the ROS arguments are left to rclcpp::init.
+inline BenchmarkOptions
+parse_options(int argc, char * argv[])
+{
+  BenchmarkOptions options;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (strcmp(argv[i], "--duration-ms") == 0) {
+      options.duration = std::chrono::milliseconds(std::stoll(argv[++i]));
+    } else if (strcmp(argv[i], "--executor") == 0) {
+      options.executor = argv[++i];
+    }
+  }
+  return options;
+}
+
+/// Print the latency percentiles as the end of a JSON object, one scenario per line.
+inline void
+print_latency_and_end_line(const char * prefix, LatencyRecorder & latencies)
+{
+  printf(
+    ", \"%s_p50_ns\": %" PRId64 ", \"%s_p99_ns\": %" PRId64 ", \"%s_p999_ns\": %" PRId64
+    ", \"%s_max_ns\": %" PRId64 "}\n",
+    prefix, latencies.percentile(0.5), prefix, latencies.percentile(0.99),
+    prefix, latencies.percentile(0.999), prefix, latencies.percentile(1.0));
+  fflush(stdout);
+}
+
+}  // namespace benchmark
+
+#endif  // BENCHMARK_UTILITIES_HPP_
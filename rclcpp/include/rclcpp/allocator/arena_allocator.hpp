@@ -0,0 +1,203 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__ALLOCATOR__ARENA_ALLOCATOR_HPP_
+#define RCLCPP__ALLOCATOR__ARENA_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace allocator
+{
+
+/// Options for creating an Arena.
+struct ArenaOptions
+{
+  /// Number of bytes reserved for the arena up front.
+  size_t size = 16 * 1024 * 1024;
+  /// Touch every page of the arena on construction, so that it does not page fault later.
+  bool prefault = true;
+  /// Lock the pages of the arena into RAM, so that they are never swapped out.
+  bool lock_memory = false;
+  /// Lock all current and future pages of the process into RAM, including stacks and the heap.
+  /**
+   * This affects the whole process and is not undone when the arena is destroyed.
+   */
+  bool lock_all_memory = false;
+};
+
+/// Bounded memory arena with constant time allocation and deallocation.
+/**
+ * All memory is reserved when the arena is created.
+ * Blocks are rounded up to a power of two, and freed blocks are kept in one free
+ * list per size, similar to the first level of a TLSF allocator.
+ * An allocation takes a block from the free list of its size, or from the part of
+ * the arena which was never used, or splits the smallest larger free block; all of
+ * these take a number of steps bounded by the number of sizes, and none of them
+ * calls into the system allocator.
+ * Freed blocks are not merged, so the arena should be sized for the largest
+ * amount of memory in use at once, rounded up, plus some headroom.
+ * When the arena is exhausted allocate throws std::bad_alloc.
+ *
+ * The arena is thread-safe; it takes a mutex which is only held for those steps.
+ */
+class Arena
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(Arena);
+
+  /// Constructor.
+  /**
+   * \param[in] options The size of the arena and how it should be kept in RAM.
+   * \throws std::runtime_error if the memory could not be locked.
+   */
+  RCLCPP_PUBLIC
+  explicit Arena(const ArenaOptions & options = ArenaOptions());
+
+  RCLCPP_PUBLIC
+  ~Arena();
+
+  /// Allocate a block of memory.
+  /**
+   * \param[in] size Number of bytes to allocate.
+   * \param[in] alignment Alignment of the block, at most alignof(std::max_align_t).
+   * \return Pointer to the block.
+   * \throws std::bad_alloc if the arena is exhausted or the alignment is not supported.
+   */
+  RCLCPP_PUBLIC
+  void *
+  allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  /// Give a block allocated from this arena back to it.
+  RCLCPP_PUBLIC
+  void
+  deallocate(void * pointer) noexcept;
+
+  /// Return the number of bytes reserved for the arena.
+  RCLCPP_PUBLIC
+  size_t
+  get_size() const;
+
+  /// Return the number of bytes in the blocks which are currently allocated.
+  RCLCPP_PUBLIC
+  size_t
+  get_bytes_in_use() const;
+
+  /// Return the largest number of bytes which were allocated at once.
+  RCLCPP_PUBLIC
+  size_t
+  get_peak_bytes_in_use() const;
+
+private:
+  struct FreeBlock
+  {
+    FreeBlock * next;
+  };
+
+  static const size_t number_of_size_classes = 64;
+
+  void
+  push_free_block(unsigned char * block, size_t size_class);
+
+  unsigned char * buffer_;
+  size_t size_;
+  size_t unused_offset_;
+  FreeBlock * free_lists_[number_of_size_classes];
+  uint64_t free_list_bitmap_;
+  size_t bytes_in_use_;
+  size_t peak_bytes_in_use_;
+  bool memory_locked_;
+  mutable std::mutex mutex_;
+};
+
+/// std::allocator_traits compatible allocator which takes its memory from an Arena.
+/**
+ * Copies and rebound copies share the arena.
+ * This can be passed as the Alloc of publishers, subscriptions and the
+ * AllocatorMemoryStrategy, see rclcpp/allocator/arena_helpers.hpp.
+ * A default constructed allocator has no arena and cannot allocate.
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = ArenaAllocator<U>;
+  };
+
+  ArenaAllocator() noexcept
+  {}
+
+  explicit ArenaAllocator(Arena::SharedPtr arena) noexcept
+  : arena_(arena)
+  {}
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> & other) noexcept
+  : arena_(other.get_arena())
+  {}
+
+  T * allocate(size_t n)
+  {
+    if (!arena_) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T * pointer, size_t n) noexcept
+  {
+    (void)n;
+    if (arena_) {
+      arena_->deallocate(pointer);
+    }
+  }
+
+  Arena::SharedPtr get_arena() const noexcept
+  {
+    return arena_;
+  }
+
+private:
+  Arena::SharedPtr arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) noexcept
+{
+  return a.get_arena() == b.get_arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) noexcept
+{
+  return !(a == b);
+}
+
+}  // namespace allocator
+}  // namespace rclcpp
+
+#endif  // RCLCPP__ALLOCATOR__ARENA_ALLOCATOR_HPP_
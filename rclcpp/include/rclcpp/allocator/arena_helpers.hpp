@@ -0,0 +1,119 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__ALLOCATOR__ARENA_HELPERS_HPP_
+#define RCLCPP__ALLOCATOR__ARENA_HELPERS_HPP_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "rclcpp/allocator/arena_allocator.hpp"
+#include "rclcpp/executor.hpp"
+#include "rclcpp/message_memory_strategy.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/publisher.hpp"
+#include "rclcpp/strategies/allocator_memory_strategy.hpp"
+#include "rclcpp/subscription.hpp"
+
+namespace rclcpp
+{
+namespace allocator
+{
+
+/* Helpers to create an executor and the publishers and subscriptions of a node which all draw
+ * their memory from one Arena, e.g.:
+ *
+ *   auto arena = rclcpp::allocator::create_arena(options);
+ *   auto node = rclcpp::node::Node::make_shared("talker");
+ *   auto publisher = rclcpp::allocator::create_arena_publisher<MessageT>(node, "chatter", arena);
+ *   rclcpp::executors::SingleThreadedExecutor executor(
+ *     rclcpp::allocator::create_arena_executor_arguments(arena));
+ *
+ * The node itself is not placed in the arena, since its callback groups and the rcl handles of
+ * its entities would still be allocated with the default allocator.
+ */
+
+using ArenaVoidAllocator = ArenaAllocator<void>;
+
+/// Create an Arena, reserving and optionally locking all of its memory now.
+static inline Arena::SharedPtr
+create_arena(const ArenaOptions & options = ArenaOptions())
+{
+  return Arena::make_shared(options);
+}
+
+/// Create an executor memory strategy which allocates from the arena.
+static inline std::shared_ptr<
+  memory_strategies::allocator_memory_strategy::AllocatorMemoryStrategy<ArenaVoidAllocator>>
+create_arena_memory_strategy(Arena::SharedPtr arena)
+{
+  using memory_strategies::allocator_memory_strategy::AllocatorMemoryStrategy;
+  return std::allocate_shared<AllocatorMemoryStrategy<ArenaVoidAllocator>>(
+    ArenaAllocator<AllocatorMemoryStrategy<ArenaVoidAllocator>>(arena),
+    std::make_shared<ArenaVoidAllocator>(arena));
+}
+
+/// Create executor arguments with a memory strategy which allocates from the arena.
+static inline executor::ExecutorArgs
+create_arena_executor_arguments(Arena::SharedPtr arena)
+{
+  executor::ExecutorArgs args = executor::create_default_executor_arguments();
+  args.memory_strategy = create_arena_memory_strategy(arena);
+  return args;
+}
+
+/// Create a publisher whose messages are allocated from the arena.
+template<typename MessageT>
+typename publisher::Publisher<MessageT, ArenaVoidAllocator>::SharedPtr
+create_arena_publisher(
+  node::Node::SharedPtr node, const std::string & topic_name, Arena::SharedPtr arena,
+  const rmw_qos_profile_t & qos_profile = rmw_qos_profile_default)
+{
+  return node->create_publisher<MessageT, ArenaVoidAllocator>(
+    topic_name, qos_profile, std::make_shared<ArenaVoidAllocator>(arena));
+}
+
+/// Create a subscription whose messages are allocated from the arena.
+/**
+ * Received messages are borrowed from a MessageMemoryStrategy on the arena,
+ * unless another strategy is given, e.g. one of the message pools in
+ * rclcpp/strategies, which preallocate their messages.
+ */
+template<typename MessageT, typename CallbackT>
+typename subscription::Subscription<MessageT, ArenaVoidAllocator>::SharedPtr
+create_arena_subscription(
+  node::Node::SharedPtr node, const std::string & topic_name, CallbackT && callback,
+  Arena::SharedPtr arena,
+  const rmw_qos_profile_t & qos_profile = rmw_qos_profile_default,
+  callback_group::CallbackGroup::SharedPtr group = nullptr,
+  bool ignore_local_publications = false,
+  typename message_memory_strategy::MessageMemoryStrategy<MessageT, ArenaVoidAllocator>::SharedPtr
+  msg_mem_strat = nullptr)
+{
+  auto allocator = std::make_shared<ArenaVoidAllocator>(arena);
+  if (!msg_mem_strat) {
+    msg_mem_strat =
+      message_memory_strategy::MessageMemoryStrategy<MessageT, ArenaVoidAllocator>::make_shared(
+      allocator);
+  }
+  return node->create_subscription<MessageT, CallbackT, ArenaVoidAllocator>(
+    topic_name, std::forward<CallbackT>(callback), qos_profile, group, ignore_local_publications,
+    msg_mem_strat, allocator);
+}
+
+}  // namespace allocator
+}  // namespace rclcpp
+
+#endif  // RCLCPP__ALLOCATOR__ARENA_HELPERS_HPP_
@@ -17,6 +17,7 @@
 
 #include <memory>
 
+#include "rclcpp/executor_statistics.hpp"
 #include "rclcpp/macros.hpp"
 #include "rclcpp/node.hpp"
 #include "rclcpp/visibility_control.hpp"
@@ -36,15 +37,32 @@ struct AnyExecutable
   RCLCPP_PUBLIC
   virtual ~AnyExecutable();
 
+  /// Reset all members so the object can be reused for the next executable.
+  /**
+   * Like the destructor, this releases the callback group if it was claimed but not executed.
+   */
+  RCLCPP_PUBLIC
+  void
+  clear();
+
+  /// Return true if one of the executable members is set.
+  RCLCPP_PUBLIC
+  bool
+  has_work() const;
+
   // Only one of the following pointers will be set.
   rclcpp::subscription::SubscriptionBase::SharedPtr subscription;
   rclcpp::subscription::SubscriptionBase::SharedPtr subscription_intra_process;
   rclcpp::timer::TimerBase::SharedPtr timer;
   rclcpp::service::ServiceBase::SharedPtr service;
+  rclcpp::service::ServiceBase::SharedPtr service_intra_process;
   rclcpp::client::ClientBase::SharedPtr client;
+  rclcpp::client::ClientBase::SharedPtr client_continuation;
   // These are used to keep the scope on the containing items
   rclcpp::callback_group::CallbackGroup::SharedPtr callback_group;
   rclcpp::node::Node::SharedPtr node;
+  // Statistics of the entity, if the memory strategy resolved them when collecting entities.
+  EntityStatistics::SharedPtr statistics;
 };
 
 }  // namespace executor
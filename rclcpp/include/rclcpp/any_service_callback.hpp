@@ -43,13 +43,19 @@ private:
         const std::shared_ptr<typename ServiceT::Request>,
         std::shared_ptr<typename ServiceT::Response>
       )>;
+  using SharedPtrDeferResponseCallback = std::function<void(
+        const std::shared_ptr<rmw_request_id_t>,
+        const std::shared_ptr<typename ServiceT::Request>
+      )>;
 
   SharedPtrCallback shared_ptr_callback_;
   SharedPtrWithRequestHeaderCallback shared_ptr_with_request_header_callback_;
+  SharedPtrDeferResponseCallback shared_ptr_defer_response_callback_;
 
 public:
   AnyServiceCallback()
-  : shared_ptr_callback_(nullptr), shared_ptr_with_request_header_callback_(nullptr)
+  : shared_ptr_callback_(nullptr), shared_ptr_with_request_header_callback_(nullptr),
+    shared_ptr_defer_response_callback_(nullptr)
   {}
 
   AnyServiceCallback(const AnyServiceCallback &) = default;
@@ -82,6 +88,40 @@ public:
     shared_ptr_with_request_header_callback_ = callback;
   }
 
+  /// Set a callback which does not respond itself.
+  /**
+   * The response is sent later with Service::send_response, given the request header.
+   */
+  template<
+    typename CallbackT,
+    typename std::enable_if<
+      rclcpp::function_traits::same_arguments<
+        CallbackT,
+        SharedPtrDeferResponseCallback
+      >::value
+    >::type * = nullptr
+  >
+  void set(CallbackT callback)
+  {
+    shared_ptr_defer_response_callback_ = callback;
+  }
+
+  /// Return true if the callback responds later rather than filling in a response.
+  bool defers_response() const
+  {
+    return shared_ptr_defer_response_callback_ != nullptr;
+  }
+
+  void dispatch_deferred(
+    std::shared_ptr<rmw_request_id_t> request_header,
+    std::shared_ptr<typename ServiceT::Request> request)
+  {
+    if (shared_ptr_defer_response_callback_ == nullptr) {
+      throw std::runtime_error("unexpected deferred request without a deferring callback set");
+    }
+    shared_ptr_defer_response_callback_(request_header, request);
+  }
+
   void dispatch(
     std::shared_ptr<rmw_request_id_t> request_header,
     std::shared_ptr<typename ServiceT::Request> request,
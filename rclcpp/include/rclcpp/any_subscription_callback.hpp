@@ -21,6 +21,7 @@
 #include <memory>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/function_traits.hpp"
@@ -32,6 +33,23 @@ namespace rclcpp
 namespace any_subscription_callback
 {
 
+/// The signatures a subscription callback can have.
+enum class SubscriptionCallbackKind
+{
+  SharedPtr,
+  SharedPtrWithInfo,
+  ConstSharedPtr,
+  ConstSharedPtrWithInfo,
+  UniquePtr,
+  UniquePtrWithInfo
+};
+
+/// Holds the callback of a subscription and calls it with messages of any ownership.
+/* The signature of the callback is determined with function_traits when it is set.
+ * The callback is then stored as its concrete type, in a holder specialized for
+ * that signature, so dispatching a message takes a single virtual call, rather
+ * than testing a std::function for each signature and calling through it.
+ */
 template<typename MessageT, typename Alloc>
 class AnySubscriptionCallback
 {
@@ -50,23 +68,195 @@ class AnySubscriptionCallback
   using UniquePtrWithInfoCallback =
       std::function<void(MessageUniquePtr, const rmw_message_info_t &)>;
 
-  SharedPtrCallback shared_ptr_callback_;
-  SharedPtrWithInfoCallback shared_ptr_with_info_callback_;
-  ConstSharedPtrCallback const_shared_ptr_callback_;
-  ConstSharedPtrWithInfoCallback const_shared_ptr_with_info_callback_;
-  UniquePtrCallback unique_ptr_callback_;
-  UniquePtrWithInfoCallback unique_ptr_with_info_callback_;
+  template<SubscriptionCallbackKind Kind>
+  using KindTag = std::integral_constant<SubscriptionCallbackKind, Kind>;
+
+  class CallbackHolderBase
+  {
+public:
+    virtual ~CallbackHolderBase() {}
+
+    virtual void dispatch(
+      AnySubscriptionCallback & owner,
+      std::shared_ptr<MessageT> message, const rmw_message_info_t & message_info) = 0;
+
+    virtual void dispatch_intra_process(
+      AnySubscriptionCallback & owner,
+      std::shared_ptr<const MessageT> message, const rmw_message_info_t & message_info) = 0;
+
+    virtual void dispatch_intra_process(
+      MessageUniquePtr & message, const rmw_message_info_t & message_info) = 0;
+
+    virtual bool use_take_shared_method() const = 0;
+  };
+
+  template<typename CallbackT, SubscriptionCallbackKind Kind>
+  class CallbackHolder : public CallbackHolderBase
+  {
+public:
+    explicit CallbackHolder(CallbackT callback)
+    : callback_(std::move(callback))
+    {}
+
+    void dispatch(
+      AnySubscriptionCallback & owner,
+      std::shared_ptr<MessageT> message, const rmw_message_info_t & message_info)
+    {
+      call(KindTag<Kind>(), owner, message, message_info);
+    }
+
+    void dispatch_intra_process(
+      AnySubscriptionCallback & owner,
+      std::shared_ptr<const MessageT> message, const rmw_message_info_t & message_info)
+    {
+      call_intra_process(KindTag<Kind>(), owner, message, message_info);
+    }
+
+    void dispatch_intra_process(
+      MessageUniquePtr & message, const rmw_message_info_t & message_info)
+    {
+      call_intra_process(KindTag<Kind>(), message, message_info);
+    }
+
+    bool use_take_shared_method() const
+    {
+      return Kind == SubscriptionCallbackKind::ConstSharedPtr ||
+             Kind == SubscriptionCallbackKind::ConstSharedPtrWithInfo;
+    }
+
+private:
+    // Messages taken from rmw, which are shared with the message memory strategy.
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::SharedPtr>, AnySubscriptionCallback &,
+      const MessagePtrT & message, const rmw_message_info_t &)
+    {
+      callback_(message);
+    }
+
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::SharedPtrWithInfo>, AnySubscriptionCallback &,
+      const MessagePtrT & message, const rmw_message_info_t & message_info)
+    {
+      callback_(message, message_info);
+    }
+
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtr>, AnySubscriptionCallback &,
+      const MessagePtrT & message, const rmw_message_info_t &)
+    {
+      callback_(message);
+    }
+
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtrWithInfo>, AnySubscriptionCallback &,
+      const MessagePtrT & message, const rmw_message_info_t & message_info)
+    {
+      callback_(message, message_info);
+    }
+
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::UniquePtr>, AnySubscriptionCallback & owner,
+      const MessagePtrT & message, const rmw_message_info_t &)
+    {
+      callback_(owner.copy_message(*message));
+    }
+
+    template<typename MessagePtrT>
+    void call(
+      KindTag<SubscriptionCallbackKind::UniquePtrWithInfo>, AnySubscriptionCallback & owner,
+      const MessagePtrT & message, const rmw_message_info_t & message_info)
+    {
+      callback_(owner.copy_message(*message), message_info);
+    }
+
+    // Shared intra process messages, which only const callbacks can take without a copy.
+    template<SubscriptionCallbackKind OtherKind>
+    void call_intra_process(
+      KindTag<OtherKind>, AnySubscriptionCallback & owner,
+      const std::shared_ptr<const MessageT> & message, const rmw_message_info_t & message_info)
+    {
+      // The callback wants a message it may modify, so it gets its own copy.
+      MessageUniquePtr unique_message = owner.copy_message(*message);
+      call_intra_process(KindTag<OtherKind>(), unique_message, message_info);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtr>, AnySubscriptionCallback &,
+      const std::shared_ptr<const MessageT> & message, const rmw_message_info_t &)
+    {
+      callback_(message);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtrWithInfo>, AnySubscriptionCallback &,
+      const std::shared_ptr<const MessageT> & message, const rmw_message_info_t & message_info)
+    {
+      callback_(message, message_info);
+    }
+
+    // Intra process messages owned by this subscription.
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::SharedPtr>,
+      MessageUniquePtr & message, const rmw_message_info_t &)
+    {
+      typename std::shared_ptr<MessageT> shared_message = std::move(message);
+      callback_(shared_message);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::SharedPtrWithInfo>,
+      MessageUniquePtr & message, const rmw_message_info_t & message_info)
+    {
+      typename std::shared_ptr<MessageT> shared_message = std::move(message);
+      callback_(shared_message, message_info);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtr>,
+      MessageUniquePtr & message, const rmw_message_info_t &)
+    {
+      typename std::shared_ptr<MessageT const> const_shared_message = std::move(message);
+      callback_(const_shared_message);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::ConstSharedPtrWithInfo>,
+      MessageUniquePtr & message, const rmw_message_info_t & message_info)
+    {
+      typename std::shared_ptr<MessageT const> const_shared_message = std::move(message);
+      callback_(const_shared_message, message_info);
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::UniquePtr>,
+      MessageUniquePtr & message, const rmw_message_info_t &)
+    {
+      callback_(std::move(message));
+    }
+
+    void call_intra_process(
+      KindTag<SubscriptionCallbackKind::UniquePtrWithInfo>,
+      MessageUniquePtr & message, const rmw_message_info_t & message_info)
+    {
+      callback_(std::move(message), message_info);
+    }
+
+    CallbackT callback_;
+  };
 
 public:
   explicit AnySubscriptionCallback(std::shared_ptr<Alloc> allocator)
-  : shared_ptr_callback_(nullptr), shared_ptr_with_info_callback_(nullptr),
-    const_shared_ptr_callback_(nullptr), const_shared_ptr_with_info_callback_(nullptr),
-    unique_ptr_callback_(nullptr), unique_ptr_with_info_callback_(nullptr)
   {
     message_allocator_ = std::make_shared<MessageAlloc>(*allocator.get());
     allocator::set_allocator_for_deleter(&message_deleter_, message_allocator_.get());
   }
 
+  /// Copies share the callback.
   AnySubscriptionCallback(const AnySubscriptionCallback &) = default;
 
   template<
@@ -80,7 +270,7 @@ public:
   >
   void set(CallbackT callback)
   {
-    shared_ptr_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::SharedPtr>(std::move(callback));
   }
 
   template<
@@ -94,7 +284,7 @@ public:
   >
   void set(CallbackT callback)
   {
-    shared_ptr_with_info_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::SharedPtrWithInfo>(std::move(callback));
   }
 
   template<
@@ -108,7 +298,7 @@ public:
   >
   void set(CallbackT callback)
   {
-    const_shared_ptr_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::ConstSharedPtr>(std::move(callback));
   }
 
   template<
@@ -122,7 +312,7 @@ public:
   >
   void set(CallbackT callback)
   {
-    const_shared_ptr_with_info_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::ConstSharedPtrWithInfo>(std::move(callback));
   }
 
   template<
@@ -136,7 +326,7 @@ public:
   >
   void set(CallbackT callback)
   {
-    unique_ptr_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::UniquePtr>(std::move(callback));
   }
 
   template<
@@ -150,60 +340,71 @@ public:
   >
   void set(CallbackT callback)
   {
-    unique_ptr_with_info_callback_ = callback;
+    set_holder<SubscriptionCallbackKind::UniquePtrWithInfo>(std::move(callback));
   }
 
+  /// Call the callback with a message taken from rmw.
+  /**
+   * Callbacks taking a unique_ptr get a copy, since the message is shared with the message
+   * memory strategy.
+   */
   void dispatch(
     std::shared_ptr<MessageT> message, const rmw_message_info_t & message_info)
   {
-    (void)message_info;
-    if (shared_ptr_callback_) {
-      shared_ptr_callback_(message);
-    } else if (shared_ptr_with_info_callback_) {
-      shared_ptr_with_info_callback_(message, message_info);
-    } else if (const_shared_ptr_callback_) {
-      const_shared_ptr_callback_(message);
-    } else if (const_shared_ptr_with_info_callback_) {
-      const_shared_ptr_with_info_callback_(message, message_info);
-    } else if (unique_ptr_callback_) {
-      auto ptr = MessageAllocTraits::allocate(*message_allocator_.get(), 1);
-      MessageAllocTraits::construct(*message_allocator_.get(), ptr, *message);
-      unique_ptr_callback_(MessageUniquePtr(ptr, message_deleter_));
-    } else if (unique_ptr_with_info_callback_) {
-      auto ptr = MessageAllocTraits::allocate(*message_allocator_.get(), 1);
-      MessageAllocTraits::construct(*message_allocator_.get(), ptr, *message);
-      unique_ptr_with_info_callback_(MessageUniquePtr(ptr, message_deleter_), message_info);
-    } else {
-      throw std::runtime_error("unexpected message without any callback set");
-    }
+    get_holder().dispatch(*this, message, message_info);
+  }
+
+  /// Return the allocator used for the messages given to the callback.
+  std::shared_ptr<MessageAlloc> get_allocator() const
+  {
+    return message_allocator_;
+  }
+
+  /// Return true if the callback only needs shared, read-only access to intra process messages.
+  /**
+   * Such callbacks can be given an instance shared with other subscriptions, see the
+   * dispatch_intra_process overload taking a shared_ptr to const.
+   */
+  bool use_take_shared_method() const
+  {
+    return callback_ && callback_->use_take_shared_method();
+  }
+
+  void dispatch_intra_process(
+    std::shared_ptr<const MessageT> message, const rmw_message_info_t & message_info)
+  {
+    get_holder().dispatch_intra_process(*this, message, message_info);
   }
 
   void dispatch_intra_process(
     MessageUniquePtr & message, const rmw_message_info_t & message_info)
   {
-    (void)message_info;
-    if (shared_ptr_callback_) {
-      typename std::shared_ptr<MessageT> shared_message = std::move(message);
-      shared_ptr_callback_(shared_message);
-    } else if (shared_ptr_with_info_callback_) {
-      typename std::shared_ptr<MessageT> shared_message = std::move(message);
-      shared_ptr_with_info_callback_(shared_message, message_info);
-    } else if (const_shared_ptr_callback_) {
-      typename std::shared_ptr<MessageT const> const_shared_message = std::move(message);
-      const_shared_ptr_callback_(const_shared_message);
-    } else if (const_shared_ptr_with_info_callback_) {
-      typename std::shared_ptr<MessageT const> const_shared_message = std::move(message);
-      const_shared_ptr_with_info_callback_(const_shared_message, message_info);
-    } else if (unique_ptr_callback_) {
-      unique_ptr_callback_(std::move(message));
-    } else if (unique_ptr_with_info_callback_) {
-      unique_ptr_with_info_callback_(std::move(message), message_info);
-    } else {
+    get_holder().dispatch_intra_process(message, message_info);
+  }
+
+private:
+  template<SubscriptionCallbackKind Kind, typename CallbackT>
+  void set_holder(CallbackT callback)
+  {
+    callback_ = std::make_shared<CallbackHolder<CallbackT, Kind>>(std::move(callback));
+  }
+
+  CallbackHolderBase & get_holder()
+  {
+    if (!callback_) {
       throw std::runtime_error("unexpected message without any callback set");
     }
+    return *callback_;
   }
 
-private:
+  MessageUniquePtr copy_message(const MessageT & message)
+  {
+    auto ptr = MessageAllocTraits::allocate(*message_allocator_.get(), 1);
+    MessageAllocTraits::construct(*message_allocator_.get(), ptr, message);
+    return MessageUniquePtr(ptr, message_deleter_);
+  }
+
+  std::shared_ptr<CallbackHolderBase> callback_;
   std::shared_ptr<MessageAlloc> message_allocator_;
   MessageDeleter message_deleter_;
 };
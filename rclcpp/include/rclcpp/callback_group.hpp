@@ -16,9 +16,11 @@
 #define RCLCPP__CALLBACK_GROUP_HPP_
 
 #include <atomic>
+#include <chrono>
 #include <string>
 #include <vector>
 
+#include "rclcpp/callback_group_generation.hpp"
 #include "rclcpp/client.hpp"
 #include "rclcpp/service.hpp"
 #include "rclcpp/subscription.hpp"
@@ -43,6 +45,15 @@ enum class CallbackGroupType
   Reentrant
 };
 
+/// Keeps a value alone in its cache line, wherever the object holding it was allocated.
+template<typename T>
+struct CacheLinePadded
+{
+  char padding_before[64];
+  T value;
+  char padding_after[64];
+};
+
 class CallbackGroup
 {
   friend class rclcpp::node::Node;
@@ -53,6 +64,9 @@ public:
   RCLCPP_PUBLIC
   explicit CallbackGroup(CallbackGroupType group_type);
 
+  RCLCPP_PUBLIC
+  ~CallbackGroup();
+
   RCLCPP_PUBLIC
   const std::vector<rclcpp::subscription::SubscriptionBase::WeakPtr> &
   get_subscription_ptrs() const;
@@ -69,6 +83,15 @@ public:
   const std::vector<rclcpp::client::ClientBase::WeakPtr> &
   get_client_ptrs() const;
 
+  /// Get the generation of the entities of this group, see GroupGeneration.
+  /**
+   * Comparing it with the value seen when the entities were collected tells whether any were
+   * added or destroyed since, without locking the weak pointers of the entities.
+   */
+  RCLCPP_PUBLIC
+  const GroupGeneration::SharedPtr &
+  get_generation() const;
+
   RCLCPP_PUBLIC
   std::atomic_bool &
   can_be_taken_from();
@@ -77,6 +100,32 @@ public:
   const CallbackGroupType &
   type() const;
 
+  /// Set the scheduling priority of the group; ready work of higher priority groups runs first.
+  /**
+   * The default priority is 0. Priorities and deadlines may be changed while the group is spun,
+   * the memory strategy collects the entities again and uses them from the next wait on.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_priority(int priority);
+
+  RCLCPP_PUBLIC
+  int
+  get_priority() const;
+
+  /// Set a relative deadline for ready work in this group, for earliest deadline first ordering.
+  /**
+   * Work of groups with a deadline is ordered by the time it became ready plus the deadline,
+   * ahead of groups without a deadline. A zero deadline (the default) disables this.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_deadline(std::chrono::nanoseconds deadline);
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  get_deadline() const;
+
 private:
   RCLCPP_DISABLE_COPY(CallbackGroup);
 
@@ -101,7 +150,11 @@ private:
   std::vector<rclcpp::timer::TimerBase::WeakPtr> timer_ptrs_;
   std::vector<rclcpp::service::ServiceBase::SharedPtr> service_ptrs_;
   std::vector<rclcpp::client::ClientBase::WeakPtr> client_ptrs_;
-  std::atomic_bool can_be_taken_from_;
+  GroupGeneration::SharedPtr generation_;
+  std::atomic<int> priority_;
+  std::atomic<int64_t> deadline_ns_;
+  /// Written by every executor thread which claims or releases the group.
+  CacheLinePadded<std::atomic_bool> can_be_taken_from_;
 };
 
 }  // namespace callback_group
@@ -0,0 +1,108 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__CALLBACK_GROUP_GENERATION_HPP_
+#define RCLCPP__CALLBACK_GROUP_GENERATION_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "rclcpp/macros.hpp"
+
+namespace rclcpp
+{
+namespace callback_group
+{
+
+/// Counts the changes to the entities of a callback group.
+/**
+ * It is incremented when an entity is added to the group, when an entity of the group is
+ * destroyed and when the group itself is destroyed. Whoever collected the entities of a group
+ * can compare it with the value seen at that time, instead of checking every entity with
+ * weak_ptr::expired or weak_ptr::lock before each wait.
+ * It is shared with the entities, so it outlives the group.
+ */
+class GroupGeneration
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(GroupGeneration);
+
+  GroupGeneration()
+  : value_(0)
+  {}
+
+  uint64_t
+  get() const
+  {
+    return value_.load(std::memory_order_acquire);
+  }
+
+  void
+  increment()
+  {
+    value_.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(GroupGeneration);
+
+  std::atomic<uint64_t> value_;
+};
+
+/// Held by an entity to increment the generation of its group when the entity is destroyed.
+class GroupMembership
+{
+public:
+  GroupMembership()
+  {}
+
+  ~GroupMembership()
+  {
+    leave();
+  }
+
+  /// Become a member of the group with the given generation.
+  void
+  join(GroupGeneration::SharedPtr generation)
+  {
+    leave();
+    generation_ = std::move(generation);
+  }
+
+  /// Stop being a member, which increments the generation of the group.
+  /**
+   * The most derived class of an entity calls this first thing in its destructor, so the change
+   * is visible before the handles of the entity are finalized. Calling it again does nothing.
+   */
+  void
+  leave()
+  {
+    if (generation_) {
+      generation_->increment();
+      generation_.reset();
+    }
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(GroupMembership);
+
+  GroupGeneration::SharedPtr generation_;
+};
+
+}  // namespace callback_group
+}  // namespace rclcpp
+
+#endif  // RCLCPP__CALLBACK_GROUP_GENERATION_HPP_
@@ -15,19 +15,38 @@
 #ifndef RCLCPP__CLIENT_HPP_
 #define RCLCPP__CLIENT_HPP_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <future>
-#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "rcl/client.h"
 #include "rcl/error_handling.h"
+#include "rcl/guard_condition.h"
 
+#include "rclcpp/callback_group_generation.hpp"
+#include "rclcpp/context.hpp"
+#include "rclcpp/continuable_future.hpp"
 #include "rclcpp/function_traits.hpp"
+#include "rclcpp/inline_function.hpp"
 #include "rclcpp/macros.hpp"
+#include "rclcpp/pending_request_table.hpp"
+#include "rclcpp/scope_exit.hpp"
+#include "rclcpp/service.hpp"
+#include "rclcpp/service_memory_strategy.hpp"
+#include "rclcpp/timer.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/type_support_decl.hpp"
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/visibility_control.hpp"
@@ -37,14 +56,37 @@
 
 namespace rclcpp
 {
+
+// Forward declaration for friend statement
+namespace node
+{
+class Node;
+}  // namespace node
+
 namespace client
 {
 
-class ClientBase
+/// Counters of the requests of a client.
+struct ClientStatistics
+{
+  /// Requests which are waiting for a response.
+  size_t in_flight;
+  /// Requests which were removed because no response came before their deadline.
+  uint64_t expired;
+  /// Responses which did not match a pending request, e.g. because it had expired.
+  uint64_t unmatched_responses;
+};
+
+class ClientBase : public std::enable_shared_from_this<ClientBase>
 {
+  friend rclcpp::node::Node;
+
 public:
   RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(ClientBase);
 
+  using IntraProcessServiceLookupT =
+    std::function<service::ServiceBase::SharedPtr(const std::string &)>;
+
   RCLCPP_PUBLIC
   ClientBase(
     std::shared_ptr<rcl_node_t> node_handle,
@@ -61,18 +103,194 @@ public:
   const rcl_client_t *
   get_client_handle() const;
 
+  /// Get the guard condition which is triggered whenever a response has been handled.
+  /**
+   * An executor waiting on this guard condition wakes up as soon as a pending future of this
+   * client is completed, even if the response was taken by another executor.
+   * It is triggered after the callback of the request returned, so futures completed by the
+   * callback are complete too.
+   */
+  RCLCPP_PUBLIC
+  const rcl_guard_condition_t *
+  get_response_guard_condition() const;
+
+  /// Get the guard condition which is triggered whenever a continuation has been posted.
+  RCLCPP_PUBLIC
+  const rcl_guard_condition_t *
+  get_continuation_guard_condition() const;
+
+  /// Queue a function to be run by an executor in the callback group of this client.
+  /**
+   * This is how the continuations attached to the futures of this client with then() are run.
+   * \param[in] continuation The function to run.
+   */
+  RCLCPP_PUBLIC
+  void
+  post_continuation(std::function<void()> continuation);
+
+  /// Take the oldest posted continuation.
+  /**
+   * \param[out] continuation The taken continuation.
+   * \return true if a continuation was taken, false if none was queued.
+   */
+  RCLCPP_PUBLIC
+  bool
+  take_continuation(std::function<void()> & continuation);
+
+  /// Trigger the continuation guard condition again if continuations are still queued.
+  RCLCPP_PUBLIC
+  void
+  renotify_if_continuations_pending();
+
+  /// Hand requests directly to a service in the same process when there is one.
+  /**
+   * Before a request is sent, lookup is called with the service name. If it returns a service
+   * of the same type which accepts intra process requests, the request is queued in that service
+   * instead of being sent through rmw. The response is still handled by the executor spinning
+   * this client. The client must be owned by a shared pointer.
+   * \param[in] lookup Function returning the service in this process for a service name.
+   */
+  RCLCPP_PUBLIC
+  void
+  setup_intra_process(IntraProcessServiceLookupT lookup);
+
+  /// Block until the service of this client is available, or the timeout passes.
+  /**
+   * The waiting thread sleeps until the graph listener of the context of the node finds the
+   * service, see rclcpp::graph_listener::GraphListener.
+   * The middleware cannot tell which services exist, so only services in the same process
+   * are found, which requires intra process communication to be enabled for the node.
+   * \param[in] timeout How long to wait at most, a negative timeout waits forever.
+   * \return true if the service is available, false on timeout or shutdown.
+   * \throws std::runtime_error if intra process communication is disabled.
+   */
+  RCLCPP_PUBLIC
+  bool
+  wait_for_service(std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
+
+  /// Set how long requests sent from now on wait for a response before they expire.
+  /**
+   * The future of an expired request holds a std::runtime_error and its callback is called.
+   * Expired requests are removed by remove_expired_requests, which is called periodically when
+   * a request timeout is given to Node::create_client.
+   * This includes requests handed directly to a service of the same process, which the service
+   * then drops if it defers its response.
+   * \param[in] timeout How long a request may wait for its response, 0 to wait forever.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_request_timeout(std::chrono::nanoseconds timeout);
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  get_request_timeout() const;
+
+  /// Set how many requests may wait for a response at once.
+  /**
+   * Sending a request when this many are pending throws a std::runtime_error, without the
+   * request being sent.
+   * \param[in] max_pending_requests Maximum number of pending requests, 0 for no limit.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_max_pending_requests(size_t max_pending_requests);
+
+  RCLCPP_PUBLIC
+  size_t
+  get_max_pending_requests() const;
+
+  /// Get the counters of pending, expired and unmatched requests.
+  RCLCPP_PUBLIC
+  ClientStatistics
+  get_statistics() const;
+
+  /// Remove the pending requests whose deadline has passed.
+  /**
+   * The futures of the removed requests are completed with an error, and their callbacks are
+   * called from this thread.
+   * \return The number of removed requests.
+   */
+  virtual size_t remove_expired_requests() = 0;
+
+  /// Return the number of requests which are waiting for a response.
+  virtual size_t get_pending_request_count() const = 0;
+
+  /// Get the membership in the callback group, which the group joins when this is added to it.
+  RCLCPP_PUBLIC
+  callback_group::GroupMembership &
+  get_group_membership();
+
   virtual std::shared_ptr<void> create_response() = 0;
   virtual std::shared_ptr<rmw_request_id_t> create_request_header() = 0;
+  /// Give a response back to the memory strategy once it is no longer used.
+  /**
+   * The default implementation does nothing, the response is freed with its last reference.
+   */
+  virtual void return_response(std::shared_ptr<void> &) {}
+  /// Give a request header back to the memory strategy once it is no longer used.
+  /**
+   * The default implementation does nothing, the header is freed with its last reference.
+   */
+  virtual void return_request_header(std::shared_ptr<rmw_request_id_t> &) {}
   virtual void handle_response(
     std::shared_ptr<rmw_request_id_t> request_header, std::shared_ptr<void> response) = 0;
 
 protected:
   RCLCPP_DISABLE_COPY(ClientBase);
 
+  /// Return the service to hand requests to directly, or nullptr to go through rmw.
+  RCLCPP_PUBLIC
+  service::ServiceBase::SharedPtr
+  get_intra_process_service() const;
+
+  /// Wake up anything waiting on the response guard condition.
+  RCLCPP_PUBLIC
+  void
+  notify_response_handled();
+
+  /// Return the deadline of a request sent now, on the steady clock, in nanoseconds.
+  RCLCPP_PUBLIC
+  int64_t
+  get_request_deadline() const;
+
+  /// Return the function posting the continuations of requests to this client.
+  /**
+   * It is created once and shared by the continuation lists of all requests.
+   * The client must be owned by a shared pointer.
+   */
+  RCLCPP_PUBLIC
+  const std::shared_ptr<const continuable_future::ContinuationList::PostFunction> &
+  get_continuation_post_function();
+
   std::shared_ptr<rcl_node_t> node_handle_;
 
   rcl_client_t client_handle_ = rcl_get_zero_initialized_client();
+  rcl_guard_condition_t response_guard_condition_ = rcl_get_zero_initialized_guard_condition();
+  rcl_guard_condition_t continuation_guard_condition_ =
+    rcl_get_zero_initialized_guard_condition();
   std::string service_name_;
+
+  std::deque<std::function<void()>> continuations_;
+  std::mutex continuations_mutex_;
+  std::shared_ptr<const continuable_future::ContinuationList::PostFunction>
+  continuation_post_function_;
+  std::once_flag continuation_post_function_once_;
+
+  IntraProcessServiceLookupT intra_process_service_lookup_;
+  std::atomic<int64_t> intra_process_sequence_number_;
+
+  std::atomic<int64_t> request_timeout_ns_;
+  std::atomic<size_t> max_pending_requests_;
+  std::atomic<uint64_t> expired_requests_;
+  std::atomic<uint64_t> unmatched_responses_;
+
+  /// Timer removing expired requests, which is owned by the client it calls.
+  rclcpp::timer::TimerBase::SharedPtr expiry_timer_;
+
+  /// Context of the node, whose graph listener wait_for_service uses.
+  rclcpp::context::Context::WeakPtr context_;
+
+  callback_group::GroupMembership group_membership_;
 };
 
 template<typename ServiceT>
@@ -91,16 +309,35 @@ public:
   using SharedFuture = std::shared_future<SharedResponse>;
   using SharedFutureWithRequest = std::shared_future<std::pair<SharedRequest, SharedResponse>>;
 
+  /// The futures returned by async_send_request, which continuations can be attached to.
+  using ContinuableSharedFuture = continuable_future::ContinuableFuture<SharedResponse>;
+  using ContinuableSharedFutureWithRequest =
+    continuable_future::ContinuableFuture<std::pair<SharedRequest, SharedResponse>>;
+
   using CallbackType = std::function<void(SharedFuture)>;
   using CallbackWithRequestType = std::function<void(SharedFutureWithRequest)>;
 
+  /// Callback of a request sent without a future, which is given the response directly.
+  using ResponseCallbackType = std::function<void(SharedResponse)>;
+
+  using SharedResponseBatch = std::vector<SharedResponse>;
+  using SharedFutureBatch = std::shared_future<SharedResponseBatch>;
+
+  /// Called once all requests of a batch are completed.
+  using BatchCallbackType = std::function<void(SharedFutureBatch)>;
+  /// Called for each request of a batch as it is completed, with its index in the batch.
+  using BatchResponseCallbackType = std::function<void(size_t, SharedResponse)>;
+
+  using MemoryStrategy = service_memory_strategy::ServiceMemoryStrategy<ServiceT>;
+
   RCLCPP_SMART_PTR_DEFINITIONS(Client);
 
   Client(
     std::shared_ptr<rcl_node_t> node_handle,
     const std::string & service_name,
-    rcl_client_options_t & client_options)
-  : ClientBase(node_handle, service_name)
+    rcl_client_options_t & client_options,
+    typename MemoryStrategy::SharedPtr memory_strategy = MemoryStrategy::create_default())
+  : ClientBase(node_handle, service_name), memory_strategy_(memory_strategy)
   {
     using rosidl_generator_cpp::get_service_type_support_handle;
     auto service_type_support_handle =
@@ -118,45 +355,126 @@ public:
 
   virtual ~Client()
   {
+    // Leave the group before the handle is finalized, the base class would do it too late.
+    get_group_membership().leave();
     if (rcl_client_fini(&client_handle_, node_handle_.get()) != RCL_RET_OK) {
       fprintf(stderr,
         "Error in destruction of rmw client handle: %s\n", rmw_get_error_string_safe());
     }
   }
 
+  /// Set the strategy providing requests, responses and request headers.
+  /**
+   * Behavior may be undefined if called while the client could be executing.
+   * \param[in] memory_strategy Shared pointer to the memory strategy to set.
+   */
+  void set_memory_strategy(typename MemoryStrategy::SharedPtr memory_strategy)
+  {
+    memory_strategy_ = memory_strategy;
+  }
+
+  /// Borrow a request to send from the memory strategy.
+  /**
+   * The request is released to the memory strategy once the last reference to it is gone,
+   * e.g. after it was sent and the future holding it is destroyed.
+   * \return Shared pointer to the request.
+   */
+  SharedRequest borrow_request()
+  {
+    return memory_strategy_->borrow_request();
+  }
+
   std::shared_ptr<void> create_response()
   {
-    return std::shared_ptr<void>(new typename ServiceT::Response());
+    return memory_strategy_->borrow_response();
   }
 
   std::shared_ptr<rmw_request_id_t> create_request_header()
   {
-    // TODO(wjwwood): This should probably use rmw_request_id's allocator.
-    //                (since it is a C type)
-    return std::shared_ptr<rmw_request_id_t>(new rmw_request_id_t);
+    return memory_strategy_->borrow_request_header();
+  }
+
+  void return_response(std::shared_ptr<void> & response)
+  {
+    auto typed_response = std::static_pointer_cast<typename ServiceT::Response>(response);
+    response.reset();
+    memory_strategy_->return_response(typed_response);
+  }
+
+  void return_request_header(std::shared_ptr<rmw_request_id_t> & request_header)
+  {
+    memory_strategy_->return_request_header(request_header);
   }
 
   void handle_response(std::shared_ptr<rmw_request_id_t> request_header,
     std::shared_ptr<void> response)
   {
-    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
     auto typed_response = std::static_pointer_cast<typename ServiceT::Response>(response);
-    int64_t sequence_number = request_header->sequence_number;
-    // TODO(esteve) this should throw instead since it is not expected to happen in the first place
-    if (this->pending_requests_.count(sequence_number) == 0) {
-      fprintf(stderr, "Received invalid sequence number. Ignoring...\n");
-      return;
+    PendingRequest pending_request;
+    {
+      std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+      if (!pending_requests_.take(request_header->sequence_number, pending_request)) {
+        // The request expired, or the response is not for this client.
+        ++unmatched_responses_;
+        return;
+      }
+    }
+    // Without the lock held, so the callback may send another request.
+    complete_request(pending_request, typed_response, nullptr);
+  }
+
+  size_t remove_expired_requests()
+  {
+    std::vector<PendingRequest> expired_requests;
+    {
+      std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+      int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+      pending_requests_.remove_expired(now, expired_requests);
+      intra_process_pending_requests_.remove_expired(now, expired_requests);
+    }
+    expired_requests_ += expired_requests.size();
+    if (expired_requests.empty()) {
+      return 0;
+    }
+    RCLCPP_SCOPE_EXIT(notify_response_handled());
+    for (auto & pending_request : expired_requests) {
+      if (pending_request.promise) {
+        pending_request.promise->set_exception(std::make_exception_ptr(
+            std::runtime_error("request to service '" + service_name_ + "' timed out")));
+        pending_request.continuations->complete();
+      }
     }
-    auto tuple = this->pending_requests_[sequence_number];
-    auto call_promise = std::get<0>(tuple);
-    auto callback = std::get<1>(tuple);
-    auto future = std::get<2>(tuple);
-    this->pending_requests_.erase(sequence_number);
-    call_promise->set_value(typed_response);
-    callback(future);
+    for (auto & pending_request : expired_requests) {
+      if (pending_request.response_callback) {
+        pending_request.response_callback(nullptr);
+      } else if (pending_request.batch) {
+        pending_request.batch->complete(pending_request.batch_index, nullptr);
+      } else {
+        pending_request.callback(pending_request.future);
+      }
+    }
+    return expired_requests.size();
+  }
+
+  size_t get_pending_request_count() const
+  {
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    return pending_request_count_locked();
   }
 
-  SharedFuture async_send_request(SharedRequest request)
+  /// Send a request.
+  /**
+   * The returned future is a std::shared_future, to which continuations can be attached with
+   * then(). They run as executables of an executor in the callback group of this client once
+   * the response has been handled, so a sequence of requests can be sent from continuations
+   * without blocking a thread on a future or spinning recursively.
+   * Nothing runs the continuations of a client which is not spun by an executor.
+   * \param[in] request The request to send.
+   * \return The future of the response.
+   * \throws std::runtime_error if sending the request failed.
+   */
+  ContinuableSharedFuture async_send_request(SharedRequest request)
   {
     return async_send_request(request, [](SharedFuture) {});
   }
@@ -170,9 +488,34 @@ public:
       >::value
     >::type * = nullptr
   >
-  SharedFuture async_send_request(SharedRequest request, CallbackT && cb)
+  ContinuableSharedFuture async_send_request(SharedRequest request, CallbackT && cb)
   {
+    // The continuation list shares the allocation of the promise.
+    auto state = std::make_shared<continuable_future::PromiseWithContinuations<SharedResponse>>(
+      get_continuation_post_function());
+    PendingRequest pending_request;
+    pending_request.promise = SharedPromise(state, &state->promise);
+    pending_request.callback = std::forward<CallbackT>(cb);
+    pending_request.future = pending_request.promise->get_future();
+    pending_request.continuations =
+      std::shared_ptr<continuable_future::ContinuationList>(state, &state->continuations);
+    ContinuableSharedFuture f(pending_request.future, pending_request.continuations);
+
+    auto intra_process_service = std::dynamic_pointer_cast<service::Service<ServiceT>>(
+      get_intra_process_service());
+    if (intra_process_service) {
+      int64_t sequence_number;
+      {
+        std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+        check_pending_request_limit();
+        sequence_number =
+          insert_intra_process_request(std::move(pending_request), get_request_deadline());
+      }
+      send_intra_process_request(intra_process_service, request, sequence_number);
+      return f;
+    }
     std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    check_pending_request_limit();
     int64_t sequence_number;
     if (RCL_RET_OK != rcl_send_request(get_client_handle(), request.get(), &sequence_number)) {
       // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
@@ -180,14 +523,59 @@ public:
         std::string("failed to send request: ") + rcl_get_error_string_safe());
       // *INDENT-ON*
     }
-
-    SharedPromise call_promise = std::make_shared<Promise>();
-    SharedFuture f(call_promise->get_future());
-    pending_requests_[sequence_number] =
-      std::make_tuple(call_promise, std::forward<CallbackType>(cb), f);
+    pending_requests_.insert(sequence_number, get_request_deadline(), std::move(pending_request));
     return f;
   }
 
+  /// Send a request whose response is only passed to a callback, without a future.
+  /**
+   * Only the callback is stored while the request is pending, within the pending request if
+   * its captures are small, so unlike the overloads returning a future this does not allocate
+   * shared state for a promise.
+   * The callback is called from the thread handling the response, with nullptr if the request
+   * expired.
+   * \param[in] request The request to send.
+   * \param[in] cb The callback taking the response.
+   * \throws std::runtime_error if sending the request failed.
+   */
+  template<
+    typename CallbackT,
+    typename std::enable_if<
+      rclcpp::function_traits::same_arguments<
+        CallbackT,
+        ResponseCallbackType
+      >::value
+    >::type * = nullptr
+  >
+  void async_send_request(SharedRequest request, CallbackT && cb)
+  {
+    PendingRequest pending_request;
+    pending_request.response_callback = std::forward<CallbackT>(cb);
+    auto intra_process_service = std::dynamic_pointer_cast<service::Service<ServiceT>>(
+      get_intra_process_service());
+    if (intra_process_service) {
+      int64_t sequence_number;
+      {
+        std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+        check_pending_request_limit();
+        sequence_number =
+          insert_intra_process_request(std::move(pending_request), get_request_deadline());
+      }
+      send_intra_process_request(intra_process_service, request, sequence_number);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    check_pending_request_limit();
+    int64_t sequence_number;
+    if (RCL_RET_OK != rcl_send_request(get_client_handle(), request.get(), &sequence_number)) {
+      // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+      throw std::runtime_error(
+        std::string("failed to send request: ") + rcl_get_error_string_safe());
+      // *INDENT-ON*
+    }
+    pending_requests_.insert(sequence_number, get_request_deadline(), std::move(pending_request));
+  }
+
   template<
     typename CallbackT,
     typename std::enable_if<
@@ -197,27 +585,334 @@ public:
       >::value
     >::type * = nullptr
   >
-  SharedFutureWithRequest async_send_request(SharedRequest request, CallbackT && cb)
+  ContinuableSharedFutureWithRequest async_send_request(SharedRequest request, CallbackT && cb)
   {
-    SharedPromiseWithRequest promise = std::make_shared<PromiseWithRequest>();
+    auto state = std::make_shared<continuable_future::PromiseWithContinuations<
+          std::pair<SharedRequest, SharedResponse>>>(get_continuation_post_function());
+    SharedPromiseWithRequest promise(state, &state->promise);
     SharedFutureWithRequest future_with_request(promise->get_future());
-
-    auto wrapping_cb = [future_with_request, promise, request, &cb](SharedFuture future) {
-        auto response = future.get();
-        promise->set_value(std::make_pair(request, response));
-        cb(future_with_request);
+    std::shared_ptr<continuable_future::ContinuationList> continuations(
+      state, &state->continuations);
+
+    // The callback is kept by the pending request, it is called after this function returned.
+    CallbackWithRequestType callback = std::forward<CallbackT>(cb);
+    auto wrapping_cb =
+      [future_with_request, promise, request, callback, continuations](SharedFuture future) {
+        try {
+          promise->set_value(std::make_pair(request, future.get()));
+        } catch (...) {
+          // The request expired.
+          promise->set_exception(std::current_exception());
+        }
+        continuations->complete();
+        callback(future_with_request);
       };
 
     async_send_request(request, wrapping_cb);
 
-    return future_with_request;
+    return ContinuableSharedFutureWithRequest(future_with_request, continuations);
+  }
+
+  /// Send a batch of requests, with a single future for all of their responses.
+  /**
+   * All requests are sent while the pending requests are locked once, and they share their
+   * bookkeeping, which is allocated once for the whole batch.
+   * The future holds the responses in the order of the requests, once all of them are
+   * completed. The response of a request which expired, or could not be sent, is nullptr.
+   * \param[in] requests The requests to send.
+   * \param[in] callback Optional function called once all requests are completed.
+   * \param[in] response_callback Optional function called for each completed request.
+   * \return The future of the responses.
+   * \throws std::runtime_error if there is not enough room in the pending requests for the
+   *   batch, in which case nothing is sent, or if sending a request failed, in which case the
+   *   requests which were not sent are completed with nullptr.
+   */
+  SharedFutureBatch async_send_requests(
+    const std::vector<SharedRequest> & requests,
+    BatchCallbackType callback = nullptr,
+    BatchResponseCallbackType response_callback = nullptr)
+  {
+    auto batch = std::make_shared<Batch>(requests.size(), callback, response_callback);
+    SharedFutureBatch future = batch->future;
+    if (requests.empty()) {
+      batch->finish();
+      return future;
+    }
+
+    auto intra_process_service = std::dynamic_pointer_cast<service::Service<ServiceT>>(
+      get_intra_process_service());
+    size_t sent = 0;
+    std::string error;
+    int64_t first_intra_process_sequence_number = 0;
+    {
+      std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+      size_t max_pending_requests = max_pending_requests_.load();
+      size_t pending_request_count = pending_request_count_locked();
+      if (max_pending_requests > 0 &&
+        pending_request_count + requests.size() > max_pending_requests)
+      {
+        throw std::runtime_error(
+                "cannot send " + std::to_string(requests.size()) + " requests, " +
+                std::to_string(pending_request_count) + " of at most " +
+                std::to_string(max_pending_requests) + " requests to service '" +
+                service_name_ + "' are pending already");
+      }
+      int64_t deadline = get_request_deadline();
+      if (intra_process_service) {
+        // The lock keeps other requests from taking sequence numbers in between.
+        intra_process_pending_requests_.reserve(
+          intra_process_pending_requests_.size() + requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+          PendingRequest pending_request;
+          pending_request.batch = batch;
+          pending_request.batch_index = i;
+          int64_t sequence_number =
+            insert_intra_process_request(std::move(pending_request), deadline);
+          if (i == 0) {
+            first_intra_process_sequence_number = sequence_number;
+          }
+        }
+      } else {
+        pending_requests_.reserve(pending_requests_.size() + requests.size());
+        for (; sent < requests.size(); ++sent) {
+          int64_t sequence_number;
+          if (RCL_RET_OK != rcl_send_request(
+              get_client_handle(), requests[sent].get(), &sequence_number))
+          {
+            error = std::string("failed to send request: ") + rcl_get_error_string_safe();
+            break;
+          }
+          PendingRequest pending_request;
+          pending_request.batch = batch;
+          pending_request.batch_index = sent;
+          pending_requests_.insert(sequence_number, deadline, std::move(pending_request));
+        }
+      }
+    }
+    if (intra_process_service) {
+      try {
+        for (; sent < requests.size(); ++sent) {
+          send_intra_process_request(
+            intra_process_service, requests[sent], first_intra_process_sequence_number + sent);
+        }
+      } catch (const std::exception & exception) {
+        // send_intra_process_request removed the request which failed, remove the others.
+        error = exception.what();
+        std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+        for (size_t i = sent + 1; i < requests.size(); ++i) {
+          PendingRequest pending_request;
+          intra_process_pending_requests_.take(
+            first_intra_process_sequence_number + i, pending_request);
+        }
+      }
+    }
+    if (sent < requests.size()) {
+      for (size_t i = sent; i < requests.size(); ++i) {
+        batch->complete(i, nullptr);
+      }
+      throw std::runtime_error(error);
+    }
+    return future;
   }
 
 private:
   RCLCPP_DISABLE_COPY(Client);
 
-  std::map<int64_t, std::tuple<SharedPromise, CallbackType, SharedFuture>> pending_requests_;
-  std::mutex pending_requests_mutex_;
+  /// The shared state of the requests sent with async_send_requests.
+  struct Batch
+  {
+    Batch(
+      size_t size, BatchCallbackType batch_callback,
+      BatchResponseCallbackType batch_response_callback)
+    : responses(size), remaining(size),
+      callback(batch_callback), response_callback(batch_response_callback)
+    {
+      future = promise.get_future();
+    }
+
+    /// Store the response of a request, and complete the batch if it was the last one.
+    void complete(size_t index, SharedResponse response)
+    {
+      responses[index] = response;
+      if (response_callback) {
+        response_callback(index, response);
+      }
+      if (remaining.fetch_sub(1) == 1) {
+        finish();
+      }
+    }
+
+    void finish()
+    {
+      // Every response has been stored, nothing else accesses them anymore.
+      promise.set_value(std::move(responses));
+      if (callback) {
+        callback(future);
+      }
+    }
+
+    SharedResponseBatch responses;
+    std::atomic<size_t> remaining;
+    std::promise<SharedResponseBatch> promise;
+    SharedFutureBatch future;
+    BatchCallbackType callback;
+    BatchResponseCallbackType response_callback;
+  };
+
+  /// A request which is waiting for a response.
+  /**
+   * Requests sent with a response callback only hold it, requests sent with
+   * async_send_requests only refer to their batch, the other members are left empty.
+   */
+  struct PendingRequest
+  {
+    PendingRequest()
+    : batch_index(0)
+    {}
+
+    /// For requests sent without a future.
+    inline_function::InlineFunction<void(SharedResponse)> response_callback;
+    SharedPromise promise;
+    CallbackType callback;
+    SharedFuture future;
+    std::shared_ptr<continuable_future::ContinuationList> continuations;
+    std::shared_ptr<Batch> batch;
+    size_t batch_index;
+  };
+
+  /// Throw if another request would exceed the maximum number of pending requests.
+  /**
+   * pending_requests_mutex_ must be held.
+   */
+  void check_pending_request_limit()
+  {
+    size_t max_pending_requests = max_pending_requests_.load();
+    if (max_pending_requests > 0 && pending_request_count_locked() >= max_pending_requests) {
+      throw std::runtime_error(
+              "cannot send request, " + std::to_string(max_pending_requests) +
+              " requests to service '" + service_name_ + "' are pending already");
+    }
+  }
+
+  size_t pending_request_count_locked() const
+  {
+    return pending_requests_.size() + intra_process_pending_requests_.size();
+  }
+
+  /// Complete a request with its response, or with the exception which prevented it.
+  /**
+   * Called without pending_requests_mutex_ held, so the callbacks may send other requests.
+   * Requests sent without a future are given nullptr instead of the exception.
+   */
+  void complete_request(
+    PendingRequest & pending_request, SharedResponse response, std::exception_ptr error)
+  {
+    RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_client_handle()));
+    // The callbacks may complete what a thread waiting on the guard condition waits for.
+    RCLCPP_SCOPE_EXIT(notify_response_handled());
+    if (pending_request.response_callback) {
+      pending_request.response_callback(error ? nullptr : response);
+      return;
+    }
+    if (pending_request.batch) {
+      pending_request.batch->complete(pending_request.batch_index, error ? nullptr : response);
+      return;
+    }
+    if (error) {
+      pending_request.promise->set_exception(error);
+    } else {
+      pending_request.promise->set_value(response);
+    }
+    pending_request.continuations->complete();
+    pending_request.callback(pending_request.future);
+  }
+
+  /// Add a request for a service of this process to the pending requests.
+  /**
+   * Like requests sent through rmw, it expires after the request timeout.
+   * pending_requests_mutex_ must be held.
+   * \return The sequence number of the request.
+   */
+  int64_t insert_intra_process_request(PendingRequest && pending_request, int64_t deadline)
+  {
+    int64_t sequence_number = ++intra_process_sequence_number_;
+    intra_process_pending_requests_.insert(
+      sequence_number, deadline, std::move(pending_request));
+    return sequence_number;
+  }
+
+  /// Queue a pending request in a service of this process instead of sending it through rmw.
+  /**
+   * The request is not copied, the service callback gets the same object, nor is the
+   * response. The service hands the response, or the exception its callback threw, back to
+   * this client as a continuation, so the request is completed in the callback group of this
+   * client by the executor spinning it, as a response taken from rmw would be.
+   * The pending request is removed again if it cannot be queued.
+   * pending_requests_mutex_ must not be held.
+   */
+  void send_intra_process_request(
+    const typename service::Service<ServiceT>::SharedPtr & intra_process_service,
+    SharedRequest request, int64_t sequence_number)
+  {
+    std::weak_ptr<Client> weak_client = std::static_pointer_cast<Client>(shared_from_this());
+    service::ServiceBase::IntraProcessRequest intra_process_request;
+    intra_process_request.request = request;
+    intra_process_request.sequence_number = sequence_number;
+    // *INDENT-OFF*
+    intra_process_request.respond =
+      [weak_client, sequence_number](std::shared_ptr<void> response, std::exception_ptr error) {
+        auto client = weak_client.lock();
+        if (!client) {
+          return;
+        }
+        auto typed_response = std::static_pointer_cast<typename ServiceT::Response>(response);
+        client->post_continuation([weak_client, sequence_number, typed_response, error]() {
+          auto handling_client = weak_client.lock();
+          if (handling_client) {
+            handling_client->handle_intra_process_response(
+              sequence_number, typed_response, error);
+          }
+        });
+      };
+    intra_process_request.is_pending = [weak_client, sequence_number]() -> bool {
+        auto client = weak_client.lock();
+        if (!client) {
+          return false;
+        }
+        std::lock_guard<std::mutex> lock(client->pending_requests_mutex_);
+        return client->intra_process_pending_requests_.contains(sequence_number);
+      };
+    // *INDENT-ON*
+    try {
+      intra_process_service->add_intra_process_request(std::move(intra_process_request));
+    } catch (...) {
+      PendingRequest pending_request;
+      std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+      intra_process_pending_requests_.take(sequence_number, pending_request);
+      throw;
+    }
+  }
+
+  /// Complete a request handed to a service of this process, unless it expired already.
+  void handle_intra_process_response(
+    int64_t sequence_number, SharedResponse response, std::exception_ptr error)
+  {
+    PendingRequest pending_request;
+    {
+      std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+      if (!intra_process_pending_requests_.take(sequence_number, pending_request)) {
+        ++unmatched_responses_;
+        return;
+      }
+    }
+    complete_request(pending_request, response, error);
+  }
+
+  pending_request_table::PendingRequestTable<PendingRequest> pending_requests_;
+  /// Requests handed to a service of this process, by their intra process sequence number.
+  pending_request_table::PendingRequestTable<PendingRequest> intra_process_pending_requests_;
+  mutable std::mutex pending_requests_mutex_;
+  typename MemoryStrategy::SharedPtr memory_strategy_;
 };
 
 }  // namespace client
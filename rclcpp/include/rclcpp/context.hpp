@@ -15,15 +15,23 @@
 #ifndef RCLCPP__CONTEXT_HPP_
 #define RCLCPP__CONTEXT_HPP_
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <typeindex>
 #include <typeinfo>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "rclcpp/macros.hpp"
 #include "rclcpp/visibility_control.hpp"
+
+#include "rcl/guard_condition.h"
+
 #include "rmw/rmw.h"
 
 namespace rclcpp
@@ -32,14 +40,68 @@ namespace rclcpp
 namespace context
 {
 
+/// State shared by the nodes and executors of an independent part of a process.
+/**
+ * Each context can be shut down on its own: the executors of the context then stop spinning,
+ * without waking up the executors of other contexts.
+ * A SIGINT or rclcpp::utilities::shutdown still shuts down all contexts.
+ */
 class Context
 {
 public:
   RCLCPP_SMART_PTR_DEFINITIONS(Context);
 
+  using ShutdownCallback = std::function<void()>;
+
   RCLCPP_PUBLIC
   Context();
 
+  RCLCPP_PUBLIC
+  virtual ~Context();
+
+  /// Return true if neither this context nor rclcpp as a whole has been shut down.
+  RCLCPP_PUBLIC
+  bool
+  ok() const;
+
+  /// Shut down this context, interrupting the executors which spin its nodes.
+  RCLCPP_PUBLIC
+  void
+  shutdown();
+
+  /// Return the guard condition which is triggered when this context is shut down.
+  /**
+   * It is created on the first call, so contexts which are never waited on cost nothing.
+   */
+  RCLCPP_PUBLIC
+  rcl_guard_condition_t *
+  get_interrupt_guard_condition();
+
+  /// Register a function which is called once when this context is shut down.
+  /**
+   * This lets e.g. an executor cancel its spin and wake up its own wait, instead of checking
+   * ok() on every iteration and waiting on the guard condition of the context as well.
+   * The callback is called from the thread which shuts down the context, while the callbacks
+   * are locked, so it should be quick and must not call into this context.
+   * It is not called if the context is already shut down, check ok() after registering.
+   * \param[in] callback The function to call.
+   * \return An id to pass to remove_shutdown_callback.
+   */
+  RCLCPP_PUBLIC
+  uint64_t
+  add_shutdown_callback(ShutdownCallback callback);
+
+  /// Unregister a shutdown callback; once this returns, the callback is not running anymore.
+  // \return true if the callback was registered.
+  RCLCPP_PUBLIC
+  bool
+  remove_shutdown_callback(uint64_t callback_id);
+
+  /// Shut down all existing contexts, this is done by rclcpp::utilities::shutdown.
+  RCLCPP_PUBLIC
+  static void
+  shutdown_all();
+
   template<typename SubContext, typename ... Args>
   std::shared_ptr<SubContext>
   get_sub_context(Args && ... args)
@@ -71,6 +133,15 @@ private:
 
   std::unordered_map<std::type_index, std::shared_ptr<void>> sub_contexts_;
   std::mutex mutex_;
+
+  std::atomic_bool shutdown_;
+  bool interrupt_guard_condition_initialized_;
+  rcl_guard_condition_t interrupt_guard_condition_ = rcl_get_zero_initialized_guard_condition();
+
+  std::mutex shutdown_callbacks_mutex_;
+  bool shutdown_callbacks_called_;
+  uint64_t next_shutdown_callback_id_;
+  std::vector<std::pair<uint64_t, ShutdownCallback>> shutdown_callbacks_;
 };
 
 }  // namespace context
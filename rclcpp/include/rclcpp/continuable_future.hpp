@@ -0,0 +1,318 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__CONTINUABLE_FUTURE_HPP_
+#define RCLCPP__CONTINUABLE_FUTURE_HPP_
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rclcpp
+{
+namespace continuable_future
+{
+
+/// The functions to run once a future is completed.
+/**
+ * The functions are not called directly but handed to a post function, which e.g. queues them
+ * to be run by an executor. Functions added after the future was completed are posted at once.
+ * This class is thread-safe.
+ */
+class ContinuationList
+{
+public:
+  using Continuation = std::function<void()>;
+  using PostFunction = std::function<void(Continuation)>;
+
+  explicit ContinuationList(PostFunction post)
+  : ContinuationList(std::make_shared<const PostFunction>(std::move(post)))
+  {}
+
+  /// Create a list with a post function shared with other lists, e.g. of the same client.
+  /**
+   * Nothing is allocated until the first function is added.
+   */
+  explicit ContinuationList(std::shared_ptr<const PostFunction> post)
+  : post_(std::move(post)), completed_(false)
+  {
+    if (!post_ || !*post_) {
+      throw std::invalid_argument("a continuation list needs a post function");
+    }
+  }
+
+  /// Add a function to be posted once the future is completed.
+  void
+  add(Continuation continuation)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!completed_) {
+        continuations_.push_back(std::move(continuation));
+        return;
+      }
+    }
+    (*post_)(std::move(continuation));
+  }
+
+  /// Mark the future as completed and post the functions added so far.
+  void
+  complete()
+  {
+    std::vector<Continuation> continuations;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      completed_ = true;
+      continuations.swap(continuations_);
+    }
+    // Without the lock held, so the post function may add continuations.
+    for (auto & continuation : continuations) {
+      (*post_)(std::move(continuation));
+    }
+  }
+
+  bool
+  is_completed() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return completed_;
+  }
+
+  const std::shared_ptr<const PostFunction> &
+  get_post_function() const
+  {
+    return post_;
+  }
+
+private:
+  std::shared_ptr<const PostFunction> post_;
+  mutable std::mutex mutex_;
+  bool completed_;
+  std::vector<Continuation> continuations_;
+};
+
+/// A promise sharing one allocation with the continuation list of its future.
+/**
+ * The list itself allocates nothing until a continuation is attached, so a future which never
+ * gets one costs no more than a plain std::shared_future.
+ */
+template<typename T>
+struct PromiseWithContinuations
+{
+  explicit PromiseWithContinuations(std::shared_ptr<const ContinuationList::PostFunction> post)
+  : continuations(std::move(post))
+  {}
+
+  std::promise<T> promise;
+  ContinuationList continuations;
+};
+
+template<typename T>
+class ContinuableFuture;
+
+namespace detail
+{
+
+/// Completes the future returned by ContinuableFuture::then with the result of a continuation.
+template<typename ResultT>
+struct ContinuationResult
+{
+  using ValueType = ResultT;
+
+  template<typename FunctionT, typename ArgumentT>
+  static void
+  run(
+    FunctionT & function, ArgumentT & argument, std::promise<ValueType> & promise,
+    const std::shared_ptr<ContinuationList> & continuations)
+  {
+    try {
+      promise.set_value(function(argument));
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+    continuations->complete();
+  }
+};
+
+template<>
+struct ContinuationResult<void>
+{
+  using ValueType = void;
+
+  template<typename FunctionT, typename ArgumentT>
+  static void
+  run(
+    FunctionT & function, ArgumentT & argument, std::promise<ValueType> & promise,
+    const std::shared_ptr<ContinuationList> & continuations)
+  {
+    try {
+      function(argument);
+      promise.set_value();
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+    continuations->complete();
+  }
+};
+
+/// A continuation returning a future, e.g. of the next request, completes once that one does.
+template<typename T>
+struct ContinuationResult<ContinuableFuture<T>>
+{
+  using ValueType = T;
+
+  template<typename FunctionT, typename ArgumentT>
+  static void
+  run(
+    FunctionT & function, ArgumentT & argument, std::promise<ValueType> & promise,
+    const std::shared_ptr<ContinuationList> & continuations)
+  {
+    ContinuableFuture<T> inner;
+    try {
+      inner = function(argument);
+      if (!inner.valid() || !inner.get_continuations()) {
+        throw std::invalid_argument("a continuation returned an invalid future");
+      }
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+      continuations->complete();
+      return;
+    }
+    auto shared_promise = std::make_shared<std::promise<ValueType>>(std::move(promise));
+    std::shared_future<T> inner_future = inner;
+    inner.get_continuations()->add(
+      [inner_future, shared_promise, continuations]() {
+        forward_value(inner_future, *shared_promise);
+        continuations->complete();
+      });
+  }
+
+private:
+  template<typename U>
+  static void
+  forward_value(const std::shared_future<U> & future, std::promise<U> & promise)
+  {
+    try {
+      promise.set_value(future.get());
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
+
+  static void
+  forward_value(const std::shared_future<void> & future, std::promise<void> & promise)
+  {
+    try {
+      future.get();
+      promise.set_value();
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
+};
+
+}  // namespace detail
+
+/// A shared future to which continuations can be attached with then().
+/**
+ * It is a std::shared_future, so it can be used wherever one is expected, e.g. with
+ * Executor::spin_until_future_complete. Continuations are posted through the continuation
+ * list of the future once it is completed. For the futures returned by a client that queues
+ * them to be run by an executor in the callback group of the client.
+ */
+template<typename T>
+class ContinuableFuture : public std::shared_future<T>
+{
+public:
+  ContinuableFuture()
+  {}
+
+  ContinuableFuture(
+    std::shared_future<T> future, std::shared_ptr<ContinuationList> continuations)
+  : std::shared_future<T>(std::move(future)), continuations_(std::move(continuations))
+  {}
+
+  /// Run a function once this future is completed, without blocking a thread until then.
+  /**
+   * The function is called with this future, on which get() does not block anymore; it returns
+   * the value or throws the exception the future was completed with.
+   * The returned future is completed with the result of the function, or the exception it
+   * threw. If the function returns a ContinuableFuture itself, e.g. of the next request of a
+   * sequence, the returned future is completed with the result of that one instead, so the
+   * steps of a sequence can be chained without nesting:
+   *
+   *   client_a->async_send_request(request_a)
+   *   .then([client_b](Client<A>::SharedFuture a) {
+   *     return client_b->async_send_request(make_request_b(a.get()));
+   *   })
+   *   .then([](Client<B>::SharedFuture b) {...});
+   *
+   * The continuations of the returned future are posted through the continuation list of this
+   * one, i.e. for a client they run in the callback group of that client as well.
+   * \param[in] function The continuation.
+   * \return The future of the result of the continuation.
+   * \throws std::runtime_error if this future has no continuation list.
+   */
+  template<
+    typename FunctionT,
+    typename ResultT = typename std::decay<
+      typename std::result_of<FunctionT(ContinuableFuture<T>)>::type>::type
+  >
+  ContinuableFuture<typename detail::ContinuationResult<ResultT>::ValueType>
+  then(FunctionT && function) const
+  {
+    using ValueType = typename detail::ContinuationResult<ResultT>::ValueType;
+    if (!continuations_) {
+      throw std::runtime_error("cannot attach a continuation to a future without a source");
+    }
+    auto promise = std::make_shared<std::promise<ValueType>>();
+    auto continuations = std::make_shared<ContinuationList>(continuations_->get_post_function());
+    ContinuableFuture<ValueType> result(promise->get_future().share(), continuations);
+    // The continuation must not refer to the list holding it, else neither is ever destroyed if
+    // this future is never completed, so the function gets a copy with a completed list.
+    std::shared_future<T> future = *this;
+    auto post = continuations_->get_post_function();
+    typename std::decay<FunctionT>::type continuation(std::forward<FunctionT>(function));
+    // *INDENT-OFF*
+    continuations_->add(
+      [future, post, continuation, promise, continuations]() mutable {
+        auto completed = std::make_shared<ContinuationList>(post);
+        completed->complete();
+        ContinuableFuture<T> argument(future, completed);
+        detail::ContinuationResult<ResultT>::run(continuation, argument, *promise, continuations);
+      });
+    // *INDENT-ON*
+    return result;
+  }
+
+  const std::shared_ptr<ContinuationList> &
+  get_continuations() const
+  {
+    return continuations_;
+  }
+
+private:
+  std::shared_ptr<ContinuationList> continuations_;
+};
+
+}  // namespace continuable_future
+}  // namespace rclcpp
+
+#endif  // RCLCPP__CONTINUABLE_FUTURE_HPP_
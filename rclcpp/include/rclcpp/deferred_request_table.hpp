@@ -0,0 +1,150 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__DEFERRED_REQUEST_TABLE_HPP_
+#define RCLCPP__DEFERRED_REQUEST_TABLE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace rclcpp
+{
+namespace deferred_request_table
+{
+
+/// Requests of clients in the same process which wait for a response sent later by a service.
+/**
+ * Each request is kept with the function answering it, by the address of the request header
+ * the service created for it. Keeping the header keeps that address from being reused.
+ * A request whose client stopped waiting, e.g. because the request expired, is dropped the
+ * next time the table has doubled in size since it was last checked, so requests which are
+ * never answered do not accumulate.
+ * This class is thread-safe.
+ */
+template<typename HeaderT, typename RespondT>
+class DeferredRequestTable
+{
+public:
+  /// Returns whether the client of a request still waits for its response.
+  using IsPendingT = std::function<bool()>;
+
+  DeferredRequestTable()
+  : size_(0), check_size_(1)
+  {}
+
+  /// Keep a request until it is answered.
+  /**
+   * \param[in] header The request header, which identifies the request.
+   * \param[in] respond The function answering the request.
+   * \param[in] is_pending Function telling whether the client still waits, or nullptr if it
+   *   always does.
+   */
+  void
+  insert(std::shared_ptr<HeaderT> header, RespondT respond, IsPendingT is_pending)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (requests_.size() >= check_size_) {
+      remove_abandoned_locked();
+      check_size_ = 2 * requests_.size() + 1;
+    }
+    const HeaderT * key = header.get();
+    Entry & entry = requests_[key];
+    entry.header = std::move(header);
+    entry.respond = std::move(respond);
+    entry.is_pending = std::move(is_pending);
+    size_.store(requests_.size());
+  }
+
+  /// Move the function answering a request out of the table.
+  /**
+   * \param[in] header The request header of the request.
+   * \param[out] respond The function answering the request, if it was in the table.
+   * \return true if the request was in the table.
+   */
+  bool
+  take(const HeaderT * header, RespondT & respond)
+  {
+    // Most services never answer a request of this process, so check without the lock first.
+    if (size_.load() == 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = requests_.find(header);
+    if (it == requests_.end()) {
+      return false;
+    }
+    respond = std::move(it->second.respond);
+    requests_.erase(it);
+    size_.store(requests_.size());
+    return true;
+  }
+
+  /// Drop the requests whose client stopped waiting for the response.
+  /**
+   * \return The number of dropped requests.
+   */
+  size_t
+  remove_abandoned()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return remove_abandoned_locked();
+  }
+
+  /// Return the number of requests in the table.
+  size_t
+  size() const
+  {
+    return size_.load();
+  }
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<HeaderT> header;
+    RespondT respond;
+    IsPendingT is_pending;
+  };
+
+  size_t
+  remove_abandoned_locked()
+  {
+    size_t count = 0;
+    for (auto it = requests_.begin(); it != requests_.end(); ) {
+      if (it->second.is_pending && !it->second.is_pending()) {
+        it = requests_.erase(it);
+        ++count;
+      } else {
+        ++it;
+      }
+    }
+    size_.store(requests_.size());
+    return count;
+  }
+
+  std::map<const HeaderT *, Entry> requests_;
+  std::mutex mutex_;
+  std::atomic<size_t> size_;
+  /// Size at which insert checks for abandoned requests next.
+  size_t check_size_;
+};
+
+}  // namespace deferred_request_table
+}  // namespace rclcpp
+
+#endif  // RCLCPP__DEFERRED_REQUEST_TABLE_HPP_
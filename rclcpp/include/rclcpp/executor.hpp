@@ -16,6 +16,7 @@
 #define RCLCPP__EXECUTOR_HPP_
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstdlib>
@@ -29,10 +30,14 @@
 #include "rcl/wait.h"
 
 #include "rclcpp/any_executable.hpp"
+#include "rclcpp/context.hpp"
+#include "rclcpp/contexts/default_context.hpp"
+#include "rclcpp/executor_statistics.hpp"
 #include "rclcpp/macros.hpp"
 #include "rclcpp/memory_strategies.hpp"
 #include "rclcpp/memory_strategy.hpp"
 #include "rclcpp/node.hpp"
+#include "rclcpp/scope_exit.hpp"
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/visibility_control.hpp"
 
@@ -65,6 +70,9 @@ struct ExecutorArgs
 {
   memory_strategy::MemoryStrategy::SharedPtr memory_strategy;
   size_t max_conditions = 0;
+  /// The context of the nodes of the executor, which stops spinning when it is shut down.
+  // If not set, the global default context is used.
+  context::Context::SharedPtr context;
 };
 
 static inline ExecutorArgs create_default_executor_arguments()
@@ -72,6 +80,7 @@ static inline ExecutorArgs create_default_executor_arguments()
   ExecutorArgs args;
   args.memory_strategy = memory_strategies::create_default_strategy();
   args.max_conditions = 0;
+  args.context = contexts::default_context::get_global_default_context();
   return args;
 }
 
@@ -203,7 +212,7 @@ public:
     }
     std::chrono::nanoseconds timeout_left = timeout_ns;
 
-    while (rclcpp::utilities::ok()) {
+    while (context_->ok()) {
       // Do one item of work.
       spin_once(timeout_left);
       // Check if the future is set, return SUCCESS if it is.
@@ -228,12 +237,67 @@ public:
     return FutureReturnCode::INTERRUPTED;
   }
 
+  /// Spin (blocking) until the future of a request sent by the given client is complete.
+  /**
+   * While spinning, the client's response guard condition is part of the waitset, so this
+   * returns as soon as the response has been handled, also when it was taken by another executor
+   * spinning the node of the client.
+   * \param[in] client The client the request was sent with.
+   * \param[in] future The future returned by the client's async_send_request.
+   * \param[in] timeout Optional timeout, as for spin_until_future_complete.
+   * \return The return code, one of SUCCESS, INTERRUPTED, or TIMEOUT.
+   */
+  template<typename ResponseT, typename TimeT = std::milli>
+  FutureReturnCode
+  spin_until_future_complete(
+    rclcpp::client::ClientBase::SharedPtr client,
+    std::shared_future<ResponseT> & future,
+    std::chrono::duration<int64_t, TimeT> timeout = std::chrono::duration<int64_t, TimeT>(-1))
+  {
+    memory_strategy_->add_guard_condition(client->get_response_guard_condition());
+    RCLCPP_SCOPE_EXIT({
+      memory_strategy_->remove_guard_condition(client->get_response_guard_condition());
+    });
+    return spin_until_future_complete(future, timeout);
+  }
+
   /// Cancel any running spin* function, causing it to return.
   /* This function can be called asynchonously from any thread. */
   RCLCPP_PUBLIC
   void
   cancel();
 
+  /// Return how many times executing a callback did not need to interrupt a waiting thread.
+  /**
+   * The interrupt guard condition is only triggered after a callback when a mutually exclusive
+   * callback group was released while another thread was blocked waiting for work.
+   */
+  RCLCPP_PUBLIC
+  uint64_t
+  get_number_of_avoided_wakeups() const;
+
+  /// Return the context of the executor.
+  RCLCPP_PUBLIC
+  context::Context::SharedPtr
+  get_context() const;
+
+  /// Enable or disable the collection of timing statistics, which is off by default.
+  /**
+   * While disabled, the only cost is checking this flag around waiting and executing.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_statistics_enabled(bool enabled);
+
+  RCLCPP_PUBLIC
+  bool
+  get_statistics_enabled() const;
+
+  /// Access the statistics collected while statistics were enabled.
+  RCLCPP_PUBLIC
+  ExecutorStatistics &
+  get_statistics();
+
   /// Support dynamic switching of the memory strategy.
   /**
    * Switching the memory strategy while the executor is spinning in another threading could have
@@ -257,6 +321,11 @@ protected:
   void
   execute_any_executable(AnyExecutable::SharedPtr any_exec);
 
+  /// Execute the work held by any_exec and clear it, so the object can be reused.
+  RCLCPP_PUBLIC
+  void
+  execute_any_executable(AnyExecutable & any_exec);
+
   RCLCPP_PUBLIC
   static void
   execute_subscription(
@@ -275,10 +344,18 @@ protected:
   static void
   execute_service(rclcpp::service::ServiceBase::SharedPtr service);
 
+  RCLCPP_PUBLIC
+  static void
+  execute_intra_process_service(rclcpp::service::ServiceBase::SharedPtr service);
+
   RCLCPP_PUBLIC
   static void
   execute_client(rclcpp::client::ClientBase::SharedPtr client);
 
+  RCLCPP_PUBLIC
+  static void
+  execute_client_continuation(rclcpp::client::ClientBase::SharedPtr client);
+
   RCLCPP_PUBLIC
   void
   wait_for_work(std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
@@ -293,17 +370,35 @@ protected:
 
   RCLCPP_PUBLIC
   void
-  get_next_timer(AnyExecutable::SharedPtr any_exec);
+  get_next_timer(AnyExecutable & any_exec);
 
   RCLCPP_PUBLIC
   AnyExecutable::SharedPtr
   get_next_ready_executable();
 
+  /// Fill the given (empty) executable with ready work, without allocating a new one.
+  // \return true if any_exec holds work afterwards.
+  RCLCPP_PUBLIC
+  bool
+  get_next_ready_executable(AnyExecutable & any_exec);
+
   RCLCPP_PUBLIC
   AnyExecutable::SharedPtr
   get_next_executable(std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
 
+  /// Wait for work if needed and fill the given (empty) executable, without allocating.
+  // \return true if any_exec holds work afterwards.
+  RCLCPP_PUBLIC
+  bool
+  get_next_executable(
+    AnyExecutable & any_exec,
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
+
   /// Spinning state, used to prevent multi threaded calls to spin and to cancel blocking spins.
+  /**
+   * The shutdown of the context sets it to false as well, so after checking the context once
+   * when it starts, a spin loop only needs to check this.
+   */
   std::atomic_bool spinning;
 
   /// Guard condition for signaling the rmw layer to wake up for special events.
@@ -315,10 +410,30 @@ protected:
   /// The memory strategy: an interface for handling user-defined memory allocation strategies.
   memory_strategy::MemoryStrategy::SharedPtr memory_strategy_;
 
+  /// The context of the nodes of this executor, spinning stops when it is shut down.
+  context::Context::SharedPtr context_;
+
+  /// The id of the callback which cancels spinning when the context is shut down.
+  uint64_t shutdown_callback_id_;
+
+  /// Nodes added to this executor.
+  std::vector<std::weak_ptr<rclcpp::node::Node>> weak_nodes_;
+
 private:
   RCLCPP_DISABLE_COPY(Executor);
 
-  std::vector<std::weak_ptr<rclcpp::node::Node>> weak_nodes_;
+  /// Record the execution of any_exec, which started at execution_start, into the statistics.
+  void
+  record_execution(
+    const AnyExecutable & any_exec, ExecutorStatistics::Clock::time_point execution_start);
+
+  std::atomic_bool statistics_enabled_;
+  ExecutorStatistics statistics_;
+
+  /// Number of threads currently inside wait_for_work.
+  std::atomic<size_t> number_of_waiting_threads_;
+  /// Number of executed callbacks which did not trigger the interrupt guard condition.
+  std::atomic<uint64_t> number_of_avoided_wakeups_;
 };
 
 }  // namespace executor
@@ -0,0 +1,245 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__EXECUTOR_STATISTICS_HPP_
+#define RCLCPP__EXECUTOR_STATISTICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace executor
+{
+
+struct HistogramSnapshot;
+
+/// Lock-free histogram of durations with power of two buckets.
+/**
+ * Bucket 0 counts durations below 1ns, bucket i counts durations in [2^(i-1), 2^i) ns and the
+ * last bucket also counts everything longer. Recording is wait-free except for the min/max
+ * updates, which use a compare-and-swap loop.
+ */
+class Histogram
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(Histogram);
+
+  static const size_t number_of_buckets = 40;
+
+  RCLCPP_PUBLIC
+  Histogram();
+
+  RCLCPP_PUBLIC
+  void
+  record(std::chrono::nanoseconds duration);
+
+  RCLCPP_PUBLIC
+  void
+  reset();
+
+  RCLCPP_PUBLIC
+  uint64_t
+  count() const;
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  min() const;
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  max() const;
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  mean() const;
+
+  /// Return an upper bound of the given percentile (0.0 to 1.0) with bucket resolution.
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  percentile(double fraction) const;
+
+  RCLCPP_PUBLIC
+  uint64_t
+  bucket_count(size_t bucket) const;
+
+  /// Copy the bucket counts and the sum, see HistogramSnapshot.
+  RCLCPP_PUBLIC
+  HistogramSnapshot
+  snapshot() const;
+
+  /// Return the exclusive upper bound of the values counted in the given bucket.
+  RCLCPP_PUBLIC
+  static std::chrono::nanoseconds
+  bucket_upper_bound(size_t bucket);
+
+private:
+  RCLCPP_DISABLE_COPY(Histogram);
+
+  std::atomic<uint64_t> buckets_[number_of_buckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_;
+  std::atomic<int64_t> min_;
+  std::atomic<int64_t> max_;
+};
+
+/// The bucket counts and the sum of a Histogram at one point in time.
+/**
+ * The difference of two snapshots of a histogram describes the durations recorded between them,
+ * and the sum of snapshots of several histograms describes all their durations, so statistics
+ * of an interval can be derived without resetting the histograms.
+ */
+struct HistogramSnapshot
+{
+  RCLCPP_PUBLIC
+  HistogramSnapshot();
+
+  RCLCPP_PUBLIC
+  HistogramSnapshot &
+  operator+=(const HistogramSnapshot & other);
+
+  RCLCPP_PUBLIC
+  HistogramSnapshot &
+  operator-=(const HistogramSnapshot & other);
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  mean() const;
+
+  /// Return an upper bound of the given percentile (0.0 to 1.0) with bucket resolution.
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  percentile(double fraction) const;
+
+  uint64_t buckets[Histogram::number_of_buckets];
+  uint64_t count;
+  int64_t sum;
+};
+
+/// Timing of one entity (subscription, timer, service or client) as executed by an executor.
+struct EntityStatistics
+{
+  RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(EntityStatistics);
+
+  /// Time from the end of the wait which reported the entity ready until its execution started.
+  Histogram queue_delay;
+  /// Time spent in execute_*, which includes taking the data and running the user callback.
+  Histogram execution_time;
+  /// Time from the end of the wait until the execution completed.
+  Histogram latency;
+};
+
+/// Statistics collected by an Executor while statistics are enabled.
+class ExecutorStatistics
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(ExecutorStatistics);
+
+  using Clock = std::chrono::steady_clock;
+
+  RCLCPP_PUBLIC
+  ExecutorStatistics();
+
+  /// Time spent in wait_for_work, including the entity collection.
+  Histogram wait_time;
+  /// Time spent looking for the next ready executable.
+  Histogram selection_time;
+
+  /// Get the statistics of the entity with the given rcl handle, creating them if needed.
+  /**
+   * The lookup takes a mutex, so it is done once per entity when the entities are collected
+   * and the result is kept with the entity; recording into the histograms is lock-free.
+   * The statistics of an entity are dropped once it is destroyed, and a new entity reusing the
+   * address of its handle gets new statistics.
+   * \param[in] handle The rcl handle identifying the entity.
+   * \param[in] owner The entity owning the handle, or nullptr to keep the statistics until
+   *   reset() is called.
+   */
+  RCLCPP_PUBLIC
+  EntityStatistics::SharedPtr
+  get_entity_statistics(const void * handle, std::shared_ptr<const void> owner = nullptr);
+
+  /// Find the statistics of the entity with the given rcl handle, or nullptr if there are none.
+  RCLCPP_PUBLIC
+  EntityStatistics::SharedPtr
+  find_entity_statistics(const void * handle) const;
+
+  /// Drop the statistics of entities which have been destroyed.
+  /**
+   * This also happens every time the number of entities has doubled since it was last done.
+   * \return The number of dropped entities.
+   */
+  RCLCPP_PUBLIC
+  size_t
+  remove_destroyed_entities();
+
+  /// Return the handles of all entities with statistics.
+  RCLCPP_PUBLIC
+  std::vector<const void *>
+  get_entity_handles() const;
+
+  /// Remember the end of the last wait, from which queue delays are measured.
+  RCLCPP_PUBLIC
+  void
+  set_last_wait_end(Clock::time_point time);
+
+  RCLCPP_PUBLIC
+  Clock::time_point
+  get_last_wait_end() const;
+
+  /// Clear all histograms and forget all entities which have no owner or have been destroyed.
+  /**
+   * The statistics of the other entities are kept, since executors hold on to them.
+   */
+  RCLCPP_PUBLIC
+  void
+  reset();
+
+private:
+  RCLCPP_DISABLE_COPY(ExecutorStatistics);
+
+  struct Entity
+  {
+    bool has_owner;
+    std::weak_ptr<const void> owner;
+    EntityStatistics::SharedPtr statistics;
+
+    bool
+    is_destroyed() const
+    {
+      return has_owner && owner.expired();
+    }
+  };
+
+  size_t
+  remove_destroyed_entities_locked();
+
+  mutable std::mutex entities_mutex_;
+  std::unordered_map<const void *, Entity> entities_;
+  /// Number of entities at which get_entity_statistics drops destroyed entities next.
+  size_t check_size_;
+  std::atomic<int64_t> last_wait_end_;
+};
+
+}  // namespace executor
+}  // namespace rclcpp
+
+#endif  // RCLCPP__EXECUTOR_STATISTICS_HPP_
@@ -17,8 +17,11 @@
 
 #include <future>
 
+#include "rclcpp/executors/background_executor.hpp"
 #include "rclcpp/executors/multi_threaded_executor.hpp"
 #include "rclcpp/executors/single_threaded_executor.hpp"
+#include "rclcpp/executors/static_single_threaded_executor.hpp"
+#include "rclcpp/executors/thread_per_group_executor.hpp"
 #include "rclcpp/node.hpp"
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/visibility_control.hpp"
@@ -41,8 +44,11 @@ spin(node::Node::SharedPtr node_ptr);
 namespace executors
 {
 
+using rclcpp::executors::background_executor::BackgroundExecutor;
 using rclcpp::executors::multi_threaded_executor::MultiThreadedExecutor;
 using rclcpp::executors::single_threaded_executor::SingleThreadedExecutor;
+using rclcpp::executors::static_single_threaded_executor::StaticSingleThreadedExecutor;
+using rclcpp::executors::thread_per_group_executor::ThreadPerGroupExecutor;
 
 /// Spin (blocking) until the future is complete, it times out waiting, or rclcpp is interrupted.
 /**
@@ -62,7 +68,8 @@ spin_node_until_future_complete(
   std::chrono::duration<int64_t, TimeT> timeout = std::chrono::duration<int64_t, TimeT>(-1))
 {
   // TODO(wjwwood): does not work recursively; can't call spin_node_until_future_complete
-  // inside a callback executed by an executor.
+  // inside a callback executed by an executor. Inside a callback, attach a continuation to the
+  // future of a client with then() instead.
   executor.add_node(node_ptr);
   auto retcode = executor.spin_until_future_complete(future, timeout);
   executor.remove_node(node_ptr);
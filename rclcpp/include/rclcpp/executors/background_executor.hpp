@@ -0,0 +1,98 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__EXECUTORS__BACKGROUND_EXECUTOR_HPP_
+#define RCLCPP__EXECUTORS__BACKGROUND_EXECUTOR_HPP_
+
+#include <memory>
+#include <thread>
+
+#include "rclcpp/executor.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace executors
+{
+namespace background_executor
+{
+
+/// Executor which spins in a thread of its own for as long as it exists.
+/**
+ * Nodes can be added and removed from any thread while it spins: the changes are queued and
+ * made by the spinning thread, which is woken up for them.
+ * This lets code which blocks on a future, e.g. a synchronous service or parameter client,
+ * have its responses delivered without spinning, or adding and removing its node, per call.
+ */
+class BackgroundExecutor
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(BackgroundExecutor);
+
+  /// Start spinning the given executor, or a SingleThreadedExecutor, in a new thread.
+  RCLCPP_PUBLIC
+  explicit BackgroundExecutor(rclcpp::executor::Executor::SharedPtr executor = nullptr);
+
+  /// Stop spinning and remove the nodes which are still added.
+  RCLCPP_PUBLIC
+  virtual ~BackgroundExecutor();
+
+  /// Return the background executor shared within the process, creating it if needed.
+  /**
+   * It is destroyed when the last shared pointer to it is released.
+   */
+  RCLCPP_PUBLIC
+  static SharedPtr
+  get_shared();
+
+  /// Add a node, which is spun from when the spinning thread picks it up.
+  /**
+   * The node counts as having an executor from this call on.
+   * \throws std::runtime_error if the node has an executor already, this one included.
+   */
+  RCLCPP_PUBLIC
+  void
+  add_node(rclcpp::node::Node::SharedPtr node);
+
+  /// Remove a node, blocking until it is no longer spun unless called from a callback.
+  RCLCPP_PUBLIC
+  void
+  remove_node(rclcpp::node::Node::SharedPtr node);
+
+private:
+  RCLCPP_DISABLE_COPY(BackgroundExecutor);
+
+  // Shared with the spinning thread, so it outlives the executor if that is destroyed by one of
+  // its own callbacks and the thread then has to be detached rather than joined.
+  struct State;
+
+  RCLCPP_PUBLIC
+  static void
+  run(std::shared_ptr<State> state);
+
+  RCLCPP_PUBLIC
+  static void
+  apply_pending_changes(State & state);
+
+  std::shared_ptr<State> state_;
+  std::thread thread_;
+};
+
+}  // namespace background_executor
+}  // namespace executors
+}  // namespace rclcpp
+
+#endif  // RCLCPP__EXECUTORS__BACKGROUND_EXECUTOR_HPP_
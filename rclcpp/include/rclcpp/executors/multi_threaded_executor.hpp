@@ -15,11 +15,14 @@
 #ifndef RCLCPP__EXECUTORS__MULTI_THREADED_EXECUTOR_HPP_
 #define RCLCPP__EXECUTORS__MULTI_THREADED_EXECUTOR_HPP_
 
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "rclcpp/executor.hpp"
+#include "rclcpp/executors/worker_pool.hpp"
 #include "rclcpp/macros.hpp"
 #include "rclcpp/memory_strategies.hpp"
 #include "rclcpp/visibility_control.hpp"
@@ -31,14 +34,67 @@ namespace executors
 namespace multi_threaded_executor
 {
 
+/// Scheduling policy applied to the worker threads of a MultiThreadedExecutor.
+using SchedulingPolicy = worker_pool::SchedulingPolicy;
+
+/// Options to be passed to the MultiThreadedExecutor constructor.
+struct MultiThreadedExecutorOptions
+{
+  /// Total number of threads, including the thread calling spin(). 0 means one per core.
+  size_t number_of_threads = 0;
+  /// Use one waiting thread which hands ready executables to the others through a queue.
+  bool use_work_queue = false;
+  /// CPUs each worker thread is pinned to, indexed by worker and reused cyclically if shorter.
+  /**
+   * An empty set (or an empty vector) leaves the affinity untouched. Only supported on Linux.
+   */
+  std::vector<std::vector<size_t>> cpu_sets;
+  /// Real-time scheduling policy for the worker threads; not supported on Windows.
+  SchedulingPolicy scheduling_policy = SchedulingPolicy::Inherit;
+  /// Priority used with SchedulingPolicy::Fifo and SchedulingPolicy::RoundRobin.
+  int scheduling_priority = 0;
+  /// Run the executables on the threads of a pool shared with other executors.
+  /**
+   * If set, spin() only waits for work and submits ready executables to a queue of the pool,
+   * e.g. worker_pool::get_global_worker_pool(), and no threads of the executor are started.
+   * number_of_threads then bounds the executables in flight (0 means the number of threads of
+   * the pool), while use_work_queue, cpu_sets and the scheduling policy are ignored in favor of
+   * the options of the pool.
+   */
+  worker_pool::WorkerPool::SharedPtr worker_pool;
+  /// Priority and share of the queue of this executor in the worker pool.
+  worker_pool::WorkerQueueOptions worker_queue_options;
+};
+
 class MultiThreadedExecutor : public executor::Executor
 {
 public:
   RCLCPP_SMART_PTR_DEFINITIONS(MultiThreadedExecutor);
 
+  /// Constructor.
+  /**
+   * \param[in] args Arguments passed to the base Executor.
+   * \param[in] use_work_queue If true, one thread waits for work and hands ready executables
+   * to the other threads through a queue, instead of all threads taking turns waiting under a
+   * single mutex. Mutually exclusive callback groups are still only run by one thread at a time.
+   */
+  RCLCPP_PUBLIC
+  MultiThreadedExecutor(
+    const executor::ExecutorArgs & args,
+    bool use_work_queue);
+
+  /// Constructor.
+  /**
+   * The worker threads are started by the first call to spin() and are parked between calls,
+   * so they are reused rather than respawned. The thread calling spin() takes part in the work
+   * and its affinity and scheduling policy are left untouched.
+   * \param[in] args Arguments passed to the base Executor.
+   * \param[in] options Threading options, see MultiThreadedExecutorOptions.
+   */
   RCLCPP_PUBLIC
   MultiThreadedExecutor(
-    const executor::ExecutorArgs & args = rclcpp::executor::create_default_executor_arguments());
+    const executor::ExecutorArgs & args = rclcpp::executor::create_default_executor_arguments(),
+    const MultiThreadedExecutorOptions & options = MultiThreadedExecutorOptions());
 
   RCLCPP_PUBLIC
   virtual ~MultiThreadedExecutor();
@@ -56,11 +112,58 @@ protected:
   void
   run(size_t this_thread_number);
 
+  /// Wait for work and push ready executables onto the work queue (work queue mode only).
+  RCLCPP_PUBLIC
+  void
+  run_dispatcher();
+
+  /// Pop executables from the work queue and execute them (work queue mode only).
+  RCLCPP_PUBLIC
+  void
+  run_worker(size_t this_thread_number);
+
+  /// Wait for work and submit ready executables to the worker pool (worker pool mode only).
+  RCLCPP_PUBLIC
+  void
+  run_worker_pool_dispatcher();
+
 private:
+  /// Body of a pool thread: apply the thread options, then take part in every spin() call.
+  void
+  pool_thread_main(size_t this_thread_number);
+
+  void
+  wait_for_pool_threads();
+
+  /// Return queued executables to the pool. Must be called with work_queue_mutex_ held.
+  void
+  discard_queued_executables();
+
   RCLCPP_DISABLE_COPY(MultiThreadedExecutor);
 
   std::mutex wait_mutex_;
   size_t number_of_threads_;
+  MultiThreadedExecutorOptions options_;
+
+  std::vector<std::thread> pool_threads_;
+  std::mutex pool_mutex_;
+  std::condition_variable pool_cv_;
+  size_t spin_generation_;
+  size_t pool_threads_finished_;
+  bool pool_shutdown_;
+
+  bool use_work_queue_;
+  std::mutex work_queue_mutex_;
+  std::condition_variable work_queue_cv_;
+  /// Preallocated executables, handed from the dispatcher to the workers by pointer.
+  std::vector<executor::AnyExecutable> executable_pool_;
+  std::vector<executor::AnyExecutable *> free_executables_;
+  /// Queued executables in FIFO order; it never holds more than one per thread.
+  std::vector<executor::AnyExecutable *> work_queue_;
+  bool dispatcher_done_;
+
+  /// Queue of this executor in options_.worker_pool, if set.
+  worker_pool::WorkerPool::QueueSharedPtr worker_queue_;
 };
 
 }  // namespace multi_threaded_executor
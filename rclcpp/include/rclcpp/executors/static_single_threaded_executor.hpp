@@ -0,0 +1,110 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__EXECUTORS__STATIC_SINGLE_THREADED_EXECUTOR_HPP_
+#define RCLCPP__EXECUTORS__STATIC_SINGLE_THREADED_EXECUTOR_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "rcl/guard_condition.h"
+#include "rcl/wait.h"
+
+#include "rclcpp/executor.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/memory_strategies.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/utilities.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace executors
+{
+namespace static_single_threaded_executor
+{
+
+/// Single-threaded executor for nodes whose entities do not change while spinning.
+/**
+ * When spin() starts, the entities of all added nodes are collected once and the waitset is
+ * sized for them. Each iteration then refills the waitset, waits, and dispatches the ready
+ * entities directly from the waitset arrays, without looking handles up or allocating executables.
+ *
+ * Adding or removing nodes, or creating entities on a node while spinning, triggers a guard
+ * condition which causes an explicit rebuild of the entity list.
+ * spin_some() and spin_once() use the regular Executor implementation.
+ */
+class StaticSingleThreadedExecutor : public executor::Executor
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(StaticSingleThreadedExecutor);
+
+  /// Default constructor. See the default constructor for Executor.
+  RCLCPP_PUBLIC
+  StaticSingleThreadedExecutor(
+    const executor::ExecutorArgs & args = rclcpp::executor::create_default_executor_arguments());
+
+  /// Default destrcutor.
+  RCLCPP_PUBLIC
+  virtual ~StaticSingleThreadedExecutor();
+
+  /// Static single-threaded implementation of spin.
+  // This function will block until work comes in, execute it, and keep blocking.
+  // It will only be interrupt by a CTRL-C (managed by the global signal handler) or cancel().
+  RCLCPP_PUBLIC
+  void
+  spin();
+
+private:
+  RCLCPP_DISABLE_COPY(StaticSingleThreadedExecutor);
+
+  /// Collect the entities of all nodes and resize the waitset for them.
+  void
+  rebuild_entities();
+
+  /// Add the collected entities to the (cleared) waitset.
+  void
+  fill_waitset();
+
+  /// Execute everything the last wait reported ready.
+  /**
+   * \return true if the entities have to be rebuilt before the next wait.
+   */
+  bool
+  execute_ready_entities();
+
+  void
+  clear_waitset();
+
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> subscriptions_;
+  /// For each subscription handle in the waitset, whether it is the intra process one.
+  std::vector<bool> subscription_is_intra_process_;
+  std::vector<rclcpp::timer::TimerBase::SharedPtr> timers_;
+  std::vector<rclcpp::service::ServiceBase::SharedPtr> services_;
+  /// The continuation guard conditions of the clients come last, in the same order.
+  std::vector<rclcpp::client::ClientBase::SharedPtr> clients_;
+  std::vector<const rcl_guard_condition_t *> guard_conditions_;
+  /// Subscriptions with directly delivered intra process messages, in the order of their guard
+  /// conditions, which follow the first number_of_notify_guard_conditions_ guard conditions.
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> intra_process_subscriptions_;
+  /// Services accepting intra process requests, their guard conditions come after those above.
+  std::vector<rclcpp::service::ServiceBase::SharedPtr> intra_process_services_;
+  size_t number_of_notify_guard_conditions_ = 0;
+};
+
+}  // namespace static_single_threaded_executor
+}  // namespace executors
+}  // namespace rclcpp
+
+#endif  // RCLCPP__EXECUTORS__STATIC_SINGLE_THREADED_EXECUTOR_HPP_
@@ -0,0 +1,157 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__EXECUTORS__THREAD_PER_GROUP_EXECUTOR_HPP_
+#define RCLCPP__EXECUTORS__THREAD_PER_GROUP_EXECUTOR_HPP_
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rcl/guard_condition.h"
+#include "rcl/wait.h"
+
+#include "rclcpp/callback_group.hpp"
+#include "rclcpp/executor.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/memory_strategies.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/utilities.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace executors
+{
+namespace thread_per_group_executor
+{
+
+/// Executor which runs every callback group on its own dedicated thread.
+/**
+ * Each callback group of the added nodes gets a worker thread with its own waitset, which only
+ * contains the entities of that group. A group is therefore only ever touched by its own thread
+ * and groups never contend on a shared wait, regardless of their type.
+ *
+ * The thread calling spin() only watches the guard conditions (the executor's interrupt guard
+ * condition, also triggered by ctrl-c, and the notify guard conditions of the nodes). It starts
+ * workers for new groups, and tells the workers to collect their entities again when a node has
+ * changed.
+ * spin_some() and spin_once() use the regular Executor implementation.
+ */
+class ThreadPerGroupExecutor : public executor::Executor
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(ThreadPerGroupExecutor);
+
+  /// Default constructor. See the default constructor for Executor.
+  RCLCPP_PUBLIC
+  ThreadPerGroupExecutor(
+    const executor::ExecutorArgs & args = rclcpp::executor::create_default_executor_arguments());
+
+  /// Default destrcutor.
+  RCLCPP_PUBLIC
+  virtual ~ThreadPerGroupExecutor();
+
+  /// Spin every callback group on its own thread until ctrl-c or cancel().
+  /**
+   * If a worker thread fails, e.g. because a callback threw, spinning is canceled and the
+   * exception is rethrown from here once all workers have been joined.
+   */
+  RCLCPP_PUBLIC
+  void
+  spin();
+
+  /// Return the number of worker threads started by the current or last call to spin().
+  RCLCPP_PUBLIC
+  size_t
+  get_number_of_workers();
+
+private:
+  RCLCPP_DISABLE_COPY(ThreadPerGroupExecutor);
+
+  /// The entities and the waitset of one callback group, owned by the group's thread.
+  struct GroupWorker
+  {
+    std::weak_ptr<rclcpp::callback_group::CallbackGroup> group;
+    rcl_wait_set_t waitset = rcl_get_zero_initialized_wait_set();
+    rcl_guard_condition_t wake_guard_condition = rcl_get_zero_initialized_guard_condition();
+    std::atomic_bool rebuild;
+    std::atomic_bool finished;
+    /// The exception which ended the worker, read once the thread has been joined.
+    std::exception_ptr error;
+    std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> subscriptions;
+    /// For each subscription handle in the waitset, whether it is the intra process one.
+    std::vector<bool> subscription_is_intra_process;
+    std::vector<rclcpp::timer::TimerBase::SharedPtr> timers;
+    std::vector<rclcpp::service::ServiceBase::SharedPtr> services;
+    std::vector<rclcpp::client::ClientBase::SharedPtr> clients;
+    /// Subscriptions with directly delivered intra process messages, their guard conditions
+    /// follow the wake guard condition in the waitset.
+    std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> intra_process_subscriptions;
+    /// Services accepting intra process requests, their guard conditions come after those above.
+    std::vector<rclcpp::service::ServiceBase::SharedPtr> intra_process_services;
+    std::thread thread;
+  };
+
+  /// Start workers for groups which do not have one yet and join workers which are done.
+  void
+  update_workers();
+
+  /// Resize the executor's waitset for the guard conditions watched by the spinning thread.
+  void
+  fill_guard_conditions();
+
+  /// Trigger the wake guard condition of every worker; failures are only reported.
+  void
+  wake_workers(bool rebuild);
+
+  /// Stop and join all workers. This does not throw, so it can be used on scope exit.
+  void
+  join_workers();
+
+  /// Join a finished worker, keeping its error, and destroy its waitset and guard condition.
+  void
+  join_worker(GroupWorker * worker);
+
+  /// Body of a worker thread.
+  void
+  run_worker(GroupWorker * worker);
+
+  static bool
+  collect_group_entities(GroupWorker * worker);
+
+  static void
+  fill_worker_waitset(GroupWorker * worker);
+
+  void
+  execute_worker_entities(GroupWorker * worker);
+
+  static void
+  clear_worker_waitset(GroupWorker * worker);
+
+  std::mutex workers_mutex_;
+  std::vector<std::unique_ptr<GroupWorker>> workers_;
+  std::vector<const rcl_guard_condition_t *> guard_conditions_;
+  /// The first error of a worker joined during the current call to spin().
+  std::exception_ptr worker_error_;
+};
+
+}  // namespace thread_per_group_executor
+}  // namespace executors
+}  // namespace rclcpp
+
+#endif  // RCLCPP__EXECUTORS__THREAD_PER_GROUP_EXECUTOR_HPP_
@@ -0,0 +1,162 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__EXECUTORS__WORKER_POOL_HPP_
+#define RCLCPP__EXECUTORS__WORKER_POOL_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace executors
+{
+namespace worker_pool
+{
+
+/// Scheduling policy applied to executor threads.
+enum class SchedulingPolicy {Inherit, Fifo, RoundRobin};
+
+/// Pin the calling thread to a cpu set and apply a scheduling policy to it.
+/**
+ * Failures are reported on stderr, the thread keeps running with its previous settings.
+ * \param[in] cpu_sets CPUs per thread, indexed by thread number and reused cyclically if
+ *   shorter. An empty set (or an empty vector) leaves the affinity untouched. Only supported
+ *   on Linux.
+ * \param[in] scheduling_policy Real-time scheduling policy; not supported on Windows.
+ * \param[in] scheduling_priority Priority used with SchedulingPolicy::Fifo and
+ *   SchedulingPolicy::RoundRobin.
+ * \param[in] this_thread_number The number of the calling thread, used to pick its cpu set.
+ */
+RCLCPP_PUBLIC
+void
+apply_thread_options(
+  const std::vector<std::vector<size_t>> & cpu_sets,
+  SchedulingPolicy scheduling_policy,
+  int scheduling_priority,
+  size_t this_thread_number);
+
+/// Options to be passed to the WorkerPool constructor.
+struct WorkerPoolOptions
+{
+  /// Number of worker threads. 0 means one per core.
+  size_t number_of_threads = 0;
+  /// CPUs each worker thread is pinned to, see apply_thread_options.
+  std::vector<std::vector<size_t>> cpu_sets;
+  /// Real-time scheduling policy for the worker threads.
+  SchedulingPolicy scheduling_policy = SchedulingPolicy::Inherit;
+  /// Priority used with SchedulingPolicy::Fifo and SchedulingPolicy::RoundRobin.
+  int scheduling_priority = 0;
+};
+
+/// Options of a queue of a WorkerPool, typically one per executor.
+struct WorkerQueueOptions
+{
+  /// The largest share, whose queue still advances when a task is taken from it.
+  static const size_t max_share = 1 << 20;
+
+  /// Work of queues with a higher priority is always run first.
+  int priority = 0;
+  /// Relative share of the threads among the busy queues of the same priority.
+  /// It must be between 1 and max_share.
+  size_t share = 1;
+};
+
+/// A set of threads running the work of several executors.
+/**
+ * Executors which each spin their own threads multiply the number of threads of a process.
+ * Instead, each executor can wait for work on its own and submit the ready executables to a
+ * queue of a shared pool, which runs them on one right-sized set of threads.
+ *
+ * The next task is taken from the busy queue with the highest priority. Among queues of the
+ * same priority, tasks are taken in proportion to their shares (stride scheduling), so a busy
+ * queue cannot starve the others. Tasks of the same queue are run in the order submitted, but
+ * several of them can run at once on different threads.
+ */
+class WorkerPool
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(WorkerPool);
+
+  class Queue;
+  using QueueSharedPtr = std::shared_ptr<Queue>;
+
+  /// Constructor, which starts the threads.
+  RCLCPP_PUBLIC
+  explicit WorkerPool(const WorkerPoolOptions & options = WorkerPoolOptions());
+
+  /// Destructor, which drops the tasks which have not started and joins the threads.
+  RCLCPP_PUBLIC
+  virtual ~WorkerPool();
+
+  /// Create a queue to submit tasks to.
+  /**
+   * Tasks which are still queued when the last reference to the queue is released are dropped.
+   * \throws std::invalid_argument if the share is 0 or above WorkerQueueOptions::max_share.
+   */
+  RCLCPP_PUBLIC
+  QueueSharedPtr
+  create_queue(const WorkerQueueOptions & options = WorkerQueueOptions());
+
+  /// Run the task on one of the threads.
+  /**
+   * \throws std::invalid_argument if the queue was not created by this pool.
+   */
+  RCLCPP_PUBLIC
+  void
+  submit(const QueueSharedPtr & queue, std::function<void()> task);
+
+  RCLCPP_PUBLIC
+  size_t
+  get_number_of_threads() const;
+
+private:
+  RCLCPP_DISABLE_COPY(WorkerPool);
+
+  void
+  run(size_t this_thread_number);
+
+  /// Take the next task according to priorities and shares. mutex_ must be held.
+  bool
+  take_next_task(std::function<void()> & task);
+
+  WorkerPoolOptions options_;
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<std::weak_ptr<Queue>> queues_;
+  /// The pass of the last queue a task was taken from, where idle queues resume.
+  uint64_t current_pass_;
+  bool shutdown_;
+};
+
+/// Get the worker pool of the process, created on first use with one thread per core.
+RCLCPP_PUBLIC
+WorkerPool::SharedPtr
+get_global_worker_pool();
+
+}  // namespace worker_pool
+}  // namespace executors
+}  // namespace rclcpp
+
+#endif  // RCLCPP__EXECUTORS__WORKER_POOL_HPP_
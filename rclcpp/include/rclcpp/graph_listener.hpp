@@ -0,0 +1,119 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__GRAPH_LISTENER_HPP_
+#define RCLCPP__GRAPH_LISTENER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "rclcpp/context.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace graph_listener
+{
+
+/// Waits for changes of the ROS graph on behalf of all threads of a context.
+/**
+ * The middleware does not notify about changes of the graph, so it has to be queried.
+ * Rather than each waiting thread sleeping and querying on its own, the waiting threads block
+ * on a condition variable, while a single thread of the listener checks all their conditions
+ * each poll period and wakes up exactly the threads whose condition holds.
+ * Changes made in this process, like creating a publisher or a service, notify the listener,
+ * so waiting for them takes no poll period at all.
+ *
+ * The thread is started by the first wait and sleeps without waking up while nothing waits.
+ * The listener is a sub context, use Context::get_sub_context to get the one of a context.
+ */
+class GraphListener
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(GraphListener);
+
+  RCLCPP_PUBLIC
+  GraphListener();
+
+  RCLCPP_PUBLIC
+  virtual ~GraphListener();
+
+  /// Block until the condition holds, the timeout passes or the context is shut down.
+  /**
+   * The condition is checked right away, then by the thread of the listener, so it must only
+   * refer to things which are kept alive by the caller.
+   * The listener does not call it anymore once this returns.
+   * \param[in] context The context which interrupts the wait when it is shut down.
+   * \param[in] condition Function returning true once the graph is as expected.
+   * \param[in] timeout How long to wait at most, a negative timeout waits forever.
+   * \return true if the condition holds.
+   */
+  RCLCPP_PUBLIC
+  bool
+  wait_for(
+    rclcpp::context::Context & context,
+    std::function<bool()> condition,
+    std::chrono::nanoseconds timeout);
+
+  /// Check the conditions of all waiting threads now, because the graph has changed.
+  RCLCPP_PUBLIC
+  void
+  notify();
+
+  /// Set how often the conditions are checked while waiting, 100ms by default.
+  RCLCPP_PUBLIC
+  void
+  set_poll_period(std::chrono::nanoseconds poll_period);
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  get_poll_period() const;
+
+private:
+  RCLCPP_DISABLE_COPY(GraphListener);
+
+  struct Wait
+  {
+    rclcpp::context::Context * context;
+    std::function<bool()> condition;
+    bool done;
+    bool result;
+    bool checking;
+  };
+
+  void
+  run();
+
+  mutable std::mutex mutex_;
+  /// Wakes up the thread of the listener.
+  std::condition_variable wake_listener_;
+  /// Wakes up the waiting threads.
+  std::condition_variable wake_waiters_;
+  std::list<std::shared_ptr<Wait>> waits_;
+  std::chrono::nanoseconds poll_period_;
+  bool notified_;
+  bool stopped_;
+  std::thread thread_;
+};
+
+}  // namespace graph_listener
+}  // namespace rclcpp
+
+#endif  // RCLCPP__GRAPH_LISTENER_HPP_
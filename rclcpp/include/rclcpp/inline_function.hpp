@@ -0,0 +1,229 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__INLINE_FUNCTION_HPP_
+#define RCLCPP__INLINE_FUNCTION_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rclcpp
+{
+namespace inline_function
+{
+
+template<typename SignatureT, size_t Capacity = 48>
+class InlineFunction;
+
+/// Move-only function wrapper which stores small callables within itself.
+/**
+ * Callables of up to Capacity bytes which can be moved without throwing are stored in the
+ * InlineFunction, so wrapping e.g. a lambda capturing a few pointers or shared_ptrs does not
+ * allocate, unlike std::function, which only stores very small callables inline.
+ * Larger callables are allocated on the heap.
+ */
+template<typename ReturnT, typename ... ArgsT, size_t Capacity>
+class InlineFunction<ReturnT(ArgsT ...), Capacity>
+{
+public:
+  InlineFunction()
+  : ops_(nullptr)
+  {}
+
+  InlineFunction(std::nullptr_t)  // NOLINT(runtime/explicit): like std::function
+  : ops_(nullptr)
+  {}
+
+  template<
+    typename FunctorT,
+    typename std::enable_if<
+      !std::is_same<typename std::decay<FunctorT>::type, InlineFunction>::value
+    >::type * = nullptr
+  >
+  InlineFunction(FunctorT && functor)  // NOLINT(runtime/explicit): like std::function
+  : ops_(nullptr)
+  {
+    emplace(std::forward<FunctorT>(functor));
+  }
+
+  InlineFunction(InlineFunction && other) noexcept
+  : ops_(nullptr)
+  {
+    move_from(other);
+  }
+
+  InlineFunction &
+  operator=(InlineFunction && other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      move_from(other);
+    }
+    return *this;
+  }
+
+  InlineFunction &
+  operator=(std::nullptr_t)
+  {
+    reset();
+    return *this;
+  }
+
+  ~InlineFunction()
+  {
+    reset();
+  }
+
+  explicit operator bool() const
+  {
+    return ops_ != nullptr;
+  }
+
+  /// Return true if the callable is stored within this object rather than on the heap.
+  bool
+  is_inline() const
+  {
+    return ops_ && ops_->is_inline;
+  }
+
+  ReturnT
+  operator()(ArgsT ... args)
+  {
+    if (!ops_) {
+      throw std::bad_function_call();
+    }
+    return ops_->invoke(&storage_, std::forward<ArgsT>(args) ...);
+  }
+
+private:
+  InlineFunction(const InlineFunction &) = delete;
+  InlineFunction & operator=(const InlineFunction &) = delete;
+
+  struct Ops
+  {
+    ReturnT (* invoke)(void *, ArgsT && ...);
+    void (* move)(void * from, void * to);
+    void (* destroy)(void *);
+    bool is_inline;
+  };
+
+  using Storage = typename std::aligned_storage<Capacity>::type;
+
+  template<typename FunctorT>
+  struct InlineOps
+  {
+    static ReturnT invoke(void * storage, ArgsT && ... args)
+    {
+      return (*static_cast<FunctorT *>(storage))(std::forward<ArgsT>(args) ...);
+    }
+
+    static void move(void * from, void * to)
+    {
+      new (to) FunctorT(std::move(*static_cast<FunctorT *>(from)));
+      static_cast<FunctorT *>(from)->~FunctorT();
+    }
+
+    static void destroy(void * storage)
+    {
+      static_cast<FunctorT *>(storage)->~FunctorT();
+    }
+
+    static const Ops * get()
+    {
+      static const Ops ops = {&invoke, &move, &destroy, true};
+      return &ops;
+    }
+  };
+
+  template<typename FunctorT>
+  struct HeapOps
+  {
+    static ReturnT invoke(void * storage, ArgsT && ... args)
+    {
+      return (**static_cast<FunctorT **>(storage))(std::forward<ArgsT>(args) ...);
+    }
+
+    static void move(void * from, void * to)
+    {
+      *static_cast<FunctorT **>(to) = *static_cast<FunctorT **>(from);
+    }
+
+    static void destroy(void * storage)
+    {
+      delete *static_cast<FunctorT **>(storage);
+    }
+
+    static const Ops * get()
+    {
+      static const Ops ops = {&invoke, &move, &destroy, false};
+      return &ops;
+    }
+  };
+
+  template<typename FunctorT>
+  struct fits_inline
+    : std::integral_constant<bool,
+      sizeof(FunctorT) <= Capacity &&
+      std::alignment_of<Storage>::value % std::alignment_of<FunctorT>::value == 0 &&
+      std::is_nothrow_move_constructible<FunctorT>::value>
+  {};
+
+  template<typename FunctorT>
+  typename std::enable_if<fits_inline<typename std::decay<FunctorT>::type>::value>::type
+  emplace(FunctorT && functor)
+  {
+    using DecayedT = typename std::decay<FunctorT>::type;
+    new (&storage_) DecayedT(std::forward<FunctorT>(functor));
+    ops_ = InlineOps<DecayedT>::get();
+  }
+
+  template<typename FunctorT>
+  typename std::enable_if<!fits_inline<typename std::decay<FunctorT>::type>::value>::type
+  emplace(FunctorT && functor)
+  {
+    using DecayedT = typename std::decay<FunctorT>::type;
+    *reinterpret_cast<DecayedT **>(&storage_) = new DecayedT(std::forward<FunctorT>(functor));
+    ops_ = HeapOps<DecayedT>::get();
+  }
+
+  void
+  move_from(InlineFunction & other) noexcept
+  {
+    if (other.ops_) {
+      other.ops_->move(&other.storage_, &storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  void
+  reset()
+  {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops * ops_;
+};
+
+}  // namespace inline_function
+}  // namespace rclcpp
+
+#endif  // RCLCPP__INLINE_FUNCTION_HPP_
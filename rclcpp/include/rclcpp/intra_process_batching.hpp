@@ -0,0 +1,172 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__INTRA_PROCESS_BATCHING_HPP_
+#define RCLCPP__INTRA_PROCESS_BATCHING_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace rclcpp
+{
+namespace intra_process_batching
+{
+
+/// Gathers the sequence numbers of published intra process messages into batches.
+/**
+ * A batch is announced with a single notification carrying the sequence number of its last
+ * message, see SequenceTracker for how subscriptions find the other messages of the batch.
+ * A batch is complete when it holds max_messages messages, or when a message is added after
+ * max_delay has passed since its first one.
+ *
+ * This class is not thread-safe, the publisher serializes the access to it.
+ */
+class NotificationBatcher
+{
+public:
+  NotificationBatcher()
+  : max_messages_(1), max_delay_(0), pending_(0), last_sequence_(0)
+  {}
+
+  /// Set the bounds of a batch.
+  /**
+   * \param[in] max_messages Maximum number of messages per batch, 1 to notify every message.
+   * \param[in] max_delay Maximum age of the first message of a batch when another one is added.
+   * \throws std::invalid_argument if max_messages is 0.
+   */
+  void
+  set_limits(size_t max_messages, std::chrono::nanoseconds max_delay)
+  {
+    if (max_messages == 0) {
+      throw std::invalid_argument("a batch must hold at least one message");
+    }
+    max_messages_ = max_messages;
+    max_delay_ = max_delay;
+  }
+
+  size_t
+  get_max_messages() const
+  {
+    return max_messages_;
+  }
+
+  /// Add the sequence number of a published message to the pending batch.
+  /**
+   * \param[in] sequence The sequence number of the message.
+   * \param[in] now The current time.
+   * \param[out] notify_sequence The sequence number to notify, if the batch is complete.
+   * \return true if the batch is complete and has to be notified.
+   */
+  bool
+  add(uint64_t sequence, std::chrono::steady_clock::time_point now, uint64_t & notify_sequence)
+  {
+    if (pending_ == 0 || sequence > last_sequence_) {
+      // Concurrent publishers may add their sequence numbers out of order.
+      last_sequence_ = sequence;
+    }
+    if (pending_ == 0) {
+      first_time_ = now;
+    }
+    ++pending_;
+    if (pending_ < max_messages_ && now - first_time_ < max_delay_) {
+      return false;
+    }
+    return flush(notify_sequence);
+  }
+
+  /// Take the pending batch, even if it is not complete.
+  /**
+   * \param[out] notify_sequence The sequence number to notify, if a batch was pending.
+   * \return true if a batch was pending and has to be notified.
+   */
+  bool
+  flush(uint64_t & notify_sequence)
+  {
+    if (pending_ == 0) {
+      return false;
+    }
+    pending_ = 0;
+    notify_sequence = last_sequence_;
+    return true;
+  }
+
+private:
+  size_t max_messages_;
+  std::chrono::nanoseconds max_delay_;
+  size_t pending_;
+  uint64_t last_sequence_;
+  std::chrono::steady_clock::time_point first_time_;
+};
+
+/// Tracks the next expected intra process sequence number of each publisher.
+/**
+ * A notification announces all messages of a publisher since its previous notification, so a
+ * subscription takes the messages from the one after the last it was notified of, up to the
+ * notified one. Without batching that is just the notified message.
+ *
+ * The first notification of a publisher only announces the notified message, like a
+ * subscription which joins late, since the beginning of its batch is unknown.
+ * A notification which is older than the previous one, e.g. because of concurrent publishers,
+ * also only announces the notified message.
+ *
+ * This class is not thread-safe, the subscription serializes the access to it.
+ */
+class SequenceTracker
+{
+public:
+  /// Return the first sequence number announced by a notification.
+  /**
+   * \param[in] publisher_id The intra process id of the publisher.
+   * \param[in] last_sequence The notified sequence number, which is the last one announced.
+   * \param[in] max_messages Maximum number of messages announced, older ones are skipped,
+   *   0 for no limit.
+   * \return The first announced sequence number, not larger than last_sequence.
+   */
+  uint64_t
+  begin(uint64_t publisher_id, uint64_t last_sequence, size_t max_messages)
+  {
+    auto it = next_sequences_.find(publisher_id);
+    if (it == next_sequences_.end()) {
+      next_sequences_.emplace(publisher_id, last_sequence + 1);
+      return last_sequence;
+    }
+    uint64_t first = it->second;
+    if (last_sequence < first) {
+      return last_sequence;
+    }
+    if (max_messages > 0 && last_sequence - first >= max_messages) {
+      first = last_sequence + 1 - max_messages;
+    }
+    it->second = last_sequence + 1;
+    return first;
+  }
+
+  /// Forget a publisher, e.g. because it was destroyed.
+  void
+  erase(uint64_t publisher_id)
+  {
+    next_sequences_.erase(publisher_id);
+  }
+
+private:
+  std::unordered_map<uint64_t, uint64_t> next_sequences_;
+};
+
+}  // namespace intra_process_batching
+}  // namespace rclcpp
+
+#endif  // RCLCPP__INTRA_PROCESS_BATCHING_HPP_
@@ -19,19 +19,25 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <unordered_map>
 #include <set>
+#include <string>
 
 #include "rclcpp/allocator/allocator_deleter.hpp"
 #include "rclcpp/intra_process_manager_impl.hpp"
+#include "rclcpp/shared_entry_mapped_ring_buffer.hpp"
 #include "rclcpp/mapped_ring_buffer.hpp"
 #include "rclcpp/macros.hpp"
 #include "rclcpp/publisher.hpp"
+#include "rclcpp/service.hpp"
 #include "rclcpp/subscription.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/visibility_control.hpp"
 
 namespace rclcpp
@@ -112,6 +118,24 @@ namespace intra_process_manager
  * Because of this the size of the internal storage should be carefully
  * considered.
  *
+ * Alternatively the manager can deliver directly, see set_direct_delivery.
+ * In that case no intra process topics are created at all.
+ * Instead, store_intra_process_message queues the publisher id, message sequence
+ * pair in each destined subscription and triggers that subscription's intra
+ * process guard condition, which wakes up the executor spinning it.
+ * The subscription then calls take_intra_process_message as before.
+ * This avoids the middleware round trip, and therefore serialization of the
+ * notification and the dependency on discovery, for every intra process message.
+ * Each subscription bounds its queue, see
+ * SubscriptionBase::set_intra_process_queue_policy, either dropping the oldest
+ * notification or blocking the publisher for a bounded time when it is full.
+ *
+ * Services are registered by name with add_service.
+ * A client in the same process looks its service up with get_service before
+ * each request and, if found, queues the request in the service directly.
+ * The service's executor handles it like a request taken from rmw, and the
+ * response is handed back to the client without being serialized either.
+ *
  * /TODO(wjwwood): update to include information about handling latching.
  * /TODO(wjwwood): consider thread safety of the class.
  *
@@ -132,6 +156,25 @@ public:
   RCLCPP_PUBLIC
   virtual ~IntraProcessManager();
 
+  /// Choose between delivery through intra process topics and direct delivery.
+  /* With direct delivery, publishers and subscriptions use no intra process
+   * topics and subscriptions are notified in process by store_intra_process_message.
+   * The default is to deliver through the intra process topics.
+   *
+   * All publishers and subscriptions of a manager must agree on this, so it
+   * can only be changed before the first one is registered.
+   *
+   * \param direct_delivery true to deliver directly.
+   * \throws std::runtime_error if publishers or subscriptions were already added.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_direct_delivery(bool direct_delivery);
+
+  RCLCPP_PUBLIC
+  bool
+  get_direct_delivery() const;
+
   /// Register a subscription with the manager, returns subscriptions unique id.
   /* In addition to generating a unique intra process id for the subscription,
    * this method also stores the topic name of the subscription.
@@ -173,22 +216,44 @@ public:
    * This method is templated on the publisher's message type so that internal
    * storage of the same type can be allocated.
    *
+   * The buffer_type selects how the storage is synchronized.
+   * With the default, MappedRingBufferType::Locked, storing a message waits for
+   * any subscription which is copying a message out of the same storage.
+   * MappedRingBufferType::SharedEntry avoids that, at the cost of an allocation
+   * per stored message, see SharedEntryMappedRingBuffer.
+   *
    * This method will allocate memory.
    *
    * \param publisher publisher to be registered with the manager.
    * \param buffer_size if 0 (default) a size is calculated based on the QoS.
+   * \param buffer_type the kind of ring buffer used to store the messages.
    * \return an unsigned 64-bit integer which is the publisher's unique id.
    */
   template<typename MessageT, typename Alloc>
   uint64_t
   add_publisher(typename publisher::Publisher<MessageT, Alloc>::SharedPtr publisher,
-    size_t buffer_size = 0)
+    size_t buffer_size = 0,
+    mapped_ring_buffer::MappedRingBufferType buffer_type =
+    mapped_ring_buffer::MappedRingBufferType::Locked)
   {
+    using MessageAlloc = typename publisher::Publisher<MessageT, Alloc>::MessageAlloc;
+    has_entities_.store(true);
     auto id = IntraProcessManager::get_next_unique_id();
     size_t size = buffer_size > 0 ? buffer_size : publisher->get_queue_size();
-    auto mrb = mapped_ring_buffer::MappedRingBuffer<MessageT,
-      typename publisher::Publisher<MessageT, Alloc>::MessageAlloc>::make_shared(
-      size, publisher->get_allocator());
+    // Messages are keyed by the publisher's sequence numbers, so they can be looked up directly.
+    auto key_mode = mapped_ring_buffer::MappedRingBufferKeyMode::Sequential;
+    mapped_ring_buffer::MappedRingBufferBase::SharedPtr mrb;
+    switch (buffer_type) {
+      case mapped_ring_buffer::MappedRingBufferType::SharedEntry:
+        mrb = mapped_ring_buffer::SharedEntryMappedRingBuffer<MessageT, MessageAlloc>::make_shared(
+          size, publisher->get_allocator(), key_mode);
+        break;
+      case mapped_ring_buffer::MappedRingBufferType::Locked:
+      default:
+        mrb = mapped_ring_buffer::MappedRingBuffer<MessageT, MessageAlloc>::make_shared(
+          size, publisher->get_allocator(), key_mode);
+        break;
+    }
     impl_->add_publisher(id, publisher, mrb, size);
     return id;
   }
@@ -240,7 +305,10 @@ public:
     std::unique_ptr<MessageT, Deleter> & message)
   {
     using MRBMessageAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MessageT>;
-    using TypedMRB = typename mapped_ring_buffer::MappedRingBuffer<MessageT, MRBMessageAlloc>;
+    using TypedMRB = mapped_ring_buffer::TypedMappedRingBufferBase<MessageT, MRBMessageAlloc>;
+    if (direct_delivery_.load()) {
+      impl_->wait_for_subscription_capacity(intra_process_publisher_id);
+    }
     uint64_t message_seq = 0;
     mapped_ring_buffer::MappedRingBufferBase::SharedPtr buffer = impl_->get_publisher_info_for_id(
       intra_process_publisher_id, message_seq);
@@ -250,16 +318,61 @@ public:
     }
 
     // Insert the message into the ring buffer using the message_seq to identify it.
+    // A displaced message which was not taken by all of its subscriptions is counted as
+    // overwritten for the remaining ones by the impl.
     bool did_replace = typed_buffer->push_and_replace(message_seq, message);
-    // TODO(wjwwood): do something when a message was displaced. log debug?
     (void)did_replace;  // Avoid unused variable warning.
 
     impl_->store_intra_process_message(intra_process_publisher_id, message_seq);
+    RCLCPP_TRACEPOINT(intra_process_store, intra_process_publisher_id, message_seq);
+    if (direct_delivery_.load()) {
+      impl_->deliver_intra_process_message(intra_process_publisher_id, message_seq);
+    }
 
     // Return the message sequence which is sent to the subscription.
     return message_seq;
   }
 
+  /// Store a shared, immutable message in the manager, and return the message sequence number.
+  /* Like the unique_ptr version, except that the manager shares the message
+   * rather than taking ownership of it.
+   * Subscriptions taking it as a shared_ptr to const get this very instance,
+   * only subscriptions which need ownership get a copy.
+   *
+   * \param intra_process_publisher_id the id of the publisher of this message.
+   * \param message the message that is being stored.
+   * \return the message sequence number.
+   */
+  template<typename MessageT, typename Alloc = std::allocator<void>>
+  uint64_t
+  store_intra_process_message(
+    uint64_t intra_process_publisher_id,
+    const std::shared_ptr<const MessageT> & message)
+  {
+    using MRBMessageAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MessageT>;
+    using TypedMRB = mapped_ring_buffer::TypedMappedRingBufferBase<MessageT, MRBMessageAlloc>;
+    if (direct_delivery_.load()) {
+      impl_->wait_for_subscription_capacity(intra_process_publisher_id);
+    }
+    uint64_t message_seq = 0;
+    mapped_ring_buffer::MappedRingBufferBase::SharedPtr buffer = impl_->get_publisher_info_for_id(
+      intra_process_publisher_id, message_seq);
+    typename TypedMRB::SharedPtr typed_buffer = std::static_pointer_cast<TypedMRB>(buffer);
+    if (!typed_buffer) {
+      throw std::runtime_error("Typecast failed due to incorrect message type");
+    }
+
+    bool did_replace = typed_buffer->push_and_replace(message_seq, message);
+    (void)did_replace;  // Avoid unused variable warning.
+
+    impl_->store_intra_process_message(intra_process_publisher_id, message_seq);
+    RCLCPP_TRACEPOINT(intra_process_store, intra_process_publisher_id, message_seq);
+    if (direct_delivery_.load()) {
+      impl_->deliver_intra_process_message(intra_process_publisher_id, message_seq);
+    }
+    return message_seq;
+  }
+
   /// Take an intra process message.
   /* The intra_process_publisher_id and message_sequence_number parameters
    * uniquely identify a message instance, which should be taken.
@@ -289,10 +402,15 @@ public:
    *
    * This method may allocate memory to copy the stored message.
    *
+   * If a filter is given, it is applied to the stored message first, and if it
+   * returns false the message is taken without being copied and message is set
+   * to nullptr as well.
+   *
    * \param intra_process_publisher_id the id of the message's publisher.
    * \param message_sequence_number the sequence number of the message.
    * \param requesting_subscriptions_intra_process_id the subscription's id.
    * \param message the message typed unique_ptr used to return the message.
+   * \param filter optional predicate the message has to satisfy to be returned.
    */
   template<typename MessageT, typename Alloc = std::allocator<void>,
   typename Deleter = std::default_delete<MessageT>>
@@ -301,10 +419,11 @@ public:
     uint64_t intra_process_publisher_id,
     uint64_t message_sequence_number,
     uint64_t requesting_subscriptions_intra_process_id,
-    std::unique_ptr<MessageT, Deleter> & message)
+    std::unique_ptr<MessageT, Deleter> & message,
+    const std::function<bool(const MessageT &)> & filter = nullptr)
   {
     using MRBMessageAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MessageT>;
-    using TypedMRB = mapped_ring_buffer::MappedRingBuffer<MessageT, MRBMessageAlloc>;
+    using TypedMRB = mapped_ring_buffer::TypedMappedRingBufferBase<MessageT, MRBMessageAlloc>;
     message = nullptr;
 
     size_t target_subs_size = 0;
@@ -318,6 +437,14 @@ public:
     if (!typed_buffer) {
       return;
     }
+    if (filter && !typed_buffer->test_at_key(message_sequence_number, filter)) {
+      if (!target_subs_size) {
+        // Nobody else wants the message, release it without handing it out.
+        std::shared_ptr<const MessageT> discarded;
+        typed_buffer->pop_shared_at_key(message_sequence_number, discarded);
+      }
+      return;
+    }
     // Return a copy or the unique_ptr (ownership) depending on how many subscriptions are left.
     if (target_subs_size) {
       // There are more subscriptions to serve, return a copy.
@@ -326,19 +453,167 @@ public:
       // This is the last one to be returned, transfer ownership.
       typed_buffer->pop_at_key(message_sequence_number, message);
     }
+    RCLCPP_TRACEPOINT(intra_process_take, intra_process_publisher_id, message_sequence_number,
+      requesting_subscriptions_intra_process_id, static_cast<const void *>(message.get()));
   }
 
+  /// Take an intra process message for a subscription which discards it, without looking at it.
+  /* The bookkeeping is the same as for take_intra_process_message, but the message is neither
+   * copied nor handed out. If this was the last subscription to take it, it is released.
+   *
+   * \param intra_process_publisher_id the id of the message's publisher.
+   * \param message_sequence_number the sequence number of the message.
+   * \param requesting_subscriptions_intra_process_id the subscription's id.
+   */
+  template<typename MessageT, typename Alloc = std::allocator<void>>
+  void
+  skip_intra_process_message(
+    uint64_t intra_process_publisher_id,
+    uint64_t message_sequence_number,
+    uint64_t requesting_subscriptions_intra_process_id)
+  {
+    using MRBMessageAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MessageT>;
+    using TypedMRB = mapped_ring_buffer::TypedMappedRingBufferBase<MessageT, MRBMessageAlloc>;
+
+    size_t target_subs_size = 0;
+    mapped_ring_buffer::MappedRingBufferBase::SharedPtr buffer = impl_->take_intra_process_message(
+      intra_process_publisher_id,
+      message_sequence_number,
+      requesting_subscriptions_intra_process_id,
+      target_subs_size
+      );
+    typename TypedMRB::SharedPtr typed_buffer = std::static_pointer_cast<TypedMRB>(buffer);
+    if (!typed_buffer || target_subs_size) {
+      return;
+    }
+    // Nobody else wants the message, release it.
+    std::shared_ptr<const MessageT> discarded;
+    typed_buffer->pop_shared_at_key(message_sequence_number, discarded);
+  }
+
+  /// Take an intra process message as a shared, immutable instance.
+  /* Like the unique_ptr version, but no copy is made: all subscriptions taking
+   * the message this way share the same instance, which is the stored one.
+   * A copy is only made if a later subscription takes it with the unique_ptr
+   * version, since that one needs ownership.
+   *
+   * \param intra_process_publisher_id the id of the message's publisher.
+   * \param message_sequence_number the sequence number of the message.
+   * \param requesting_subscriptions_intra_process_id the subscription's id.
+   * \param message the shared_ptr used to return the message.
+   */
+  template<typename MessageT, typename Alloc = std::allocator<void>>
+  void
+  take_intra_process_message(
+    uint64_t intra_process_publisher_id,
+    uint64_t message_sequence_number,
+    uint64_t requesting_subscriptions_intra_process_id,
+    std::shared_ptr<const MessageT> & message)
+  {
+    using MRBMessageAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MessageT>;
+    using TypedMRB = mapped_ring_buffer::TypedMappedRingBufferBase<MessageT, MRBMessageAlloc>;
+    message = nullptr;
+
+    size_t target_subs_size = 0;
+    mapped_ring_buffer::MappedRingBufferBase::SharedPtr buffer = impl_->take_intra_process_message(
+      intra_process_publisher_id,
+      message_sequence_number,
+      requesting_subscriptions_intra_process_id,
+      target_subs_size
+      );
+    typename TypedMRB::SharedPtr typed_buffer = std::static_pointer_cast<TypedMRB>(buffer);
+    if (!typed_buffer) {
+      return;
+    }
+    if (target_subs_size) {
+      typed_buffer->get_shared_at_key(message_sequence_number, message);
+    } else {
+      // This is the last one, the manager does not need to keep its reference any longer.
+      typed_buffer->pop_shared_at_key(message_sequence_number, message);
+    }
+    RCLCPP_TRACEPOINT(intra_process_take, intra_process_publisher_id, message_sequence_number,
+      requesting_subscriptions_intra_process_id, static_cast<const void *>(message.get()));
+  }
+
+  /// Release the messages of a publisher which were not taken within the given lifespan.
+  /* Stored messages are normally kept until all of their subscriptions took them, or until
+   * they are displaced from the publisher's ring buffer, so messages which a lagging
+   * subscription never takes hold on to their memory for as long as the queue depth allows.
+   * With a lifespan, expired messages are released eagerly whenever the publisher stores a
+   * message, and skipped by subscriptions trying to take them.
+   * Call evict_expired_messages, e.g. from a timer, to also release them while nothing is
+   * published.
+   * Messages are counted as evicted, see get_evicted_count.
+   *
+   * Independently of the lifespan, a message is released as soon as the last subscription
+   * which was still to take it is removed.
+   *
+   * \param intra_process_publisher_id the id of the publisher.
+   * \param lifespan how long messages are kept, zero (the default) to keep them until displaced.
+   * \throws std::invalid_argument if the lifespan is negative.
+   * \throws std::runtime_error if the publisher id is not found.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_lifespan(uint64_t intra_process_publisher_id, std::chrono::nanoseconds lifespan);
+
+  /// Return the number of messages of a publisher which were released before being taken.
+  /* These are the messages which expired, see set_lifespan, and the messages which were
+   * still to be taken by subscriptions which were removed.
+   *
+   * \param intra_process_publisher_id the id of the publisher.
+   * \return the number of evicted messages, or 0 if the publisher id is not found.
+   */
+  RCLCPP_PUBLIC
+  uint64_t
+  get_evicted_count(uint64_t intra_process_publisher_id) const;
+
+  /// Release the expired messages of all publishers which have a lifespan.
+  RCLCPP_PUBLIC
+  void
+  evict_expired_messages();
+
   /// Return true if the given rmw_gid_t matches any stored Publishers.
   RCLCPP_PUBLIC
   bool
   matches_any_publishers(const rmw_gid_t * id) const;
 
+  /// Return the number of subscriptions on the topic of the given publisher.
+  /* These are the subscriptions receiving the publisher's messages through this manager.
+   *
+   * \param intra_process_publisher_id the id of the publisher.
+   * \return the number of subscriptions, or 0 if the publisher id is not found.
+   */
+  RCLCPP_PUBLIC
+  size_t
+  get_subscription_count(uint64_t intra_process_publisher_id) const;
+
+  /// Register a service, so clients in the same process can hand requests to it directly.
+  /* Only a weak reference to the service is kept.
+   * If another service with the same name was registered before, it is replaced.
+   *
+   * \param service the Service to be registered.
+   */
+  RCLCPP_PUBLIC
+  void
+  add_service(service::ServiceBase::SharedPtr service);
+
+  /// Look up the service registered for the given name.
+  /* \param service_name name of the service.
+   * \return the service, or nullptr if none is registered or it was destroyed.
+   */
+  RCLCPP_PUBLIC
+  service::ServiceBase::SharedPtr
+  get_service(const std::string & service_name) const;
+
 private:
   RCLCPP_PUBLIC
   static uint64_t
   get_next_unique_id();
 
   IntraProcessManagerImplBase::SharedPtr impl_;
+  std::atomic_bool direct_delivery_;
+  std::atomic_bool has_entities_;
 };
 
 }  // namespace intra_process_manager
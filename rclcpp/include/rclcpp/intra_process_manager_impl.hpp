@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <map>
@@ -26,10 +27,12 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "rclcpp/macros.hpp"
 #include "rclcpp/mapped_ring_buffer.hpp"
 #include "rclcpp/publisher.hpp"
+#include "rclcpp/service.hpp"
 #include "rclcpp/subscription.hpp"
 #include "rclcpp/visibility_control.hpp"
 
@@ -65,50 +68,100 @@ public:
     uint64_t intra_process_publisher_id,
     uint64_t & message_seq) = 0;
 
+  virtual void
+  wait_for_subscription_capacity(uint64_t intra_process_publisher_id) = 0;
+
   virtual void
   store_intra_process_message(uint64_t intra_process_publisher_id, uint64_t message_seq) = 0;
 
+  virtual void
+  deliver_intra_process_message(uint64_t intra_process_publisher_id, uint64_t message_seq) = 0;
+
   virtual mapped_ring_buffer::MappedRingBufferBase::SharedPtr
   take_intra_process_message(uint64_t intra_process_publisher_id,
     uint64_t message_sequence_number,
     uint64_t requesting_subscriptions_intra_process_id,
     size_t & size) = 0;
 
+  virtual void
+  set_lifespan(uint64_t intra_process_publisher_id, std::chrono::nanoseconds lifespan) = 0;
+
+  virtual uint64_t
+  get_evicted_count(uint64_t intra_process_publisher_id) const = 0;
+
+  virtual void
+  evict_expired_messages() = 0;
+
   virtual bool
   matches_any_publishers(const rmw_gid_t * id) const = 0;
 
+  virtual size_t
+  get_subscription_count(uint64_t intra_process_publisher_id) const = 0;
+
+  virtual void
+  add_service(service::ServiceBase::SharedPtr service) = 0;
+
+  virtual service::ServiceBase::SharedPtr
+  get_service(const std::string & service_name) const = 0;
+
 private:
   RCLCPP_DISABLE_COPY(IntraProcessManagerImplBase);
 };
 
+/// Default implementation of the intra process manager.
+/* The registry of publishers and subscriptions is read-mostly: it is only
+ * changed when an entity is added or removed, but read for every message.
+ * So it is kept as an immutable snapshot, which is replaced as a whole by the
+ * (rare) writers and which readers access without taking a lock.
+ * The state for the in-flight messages of each publisher has its own mutex,
+ * so publishers on independent topics do not contend with each other.
+ */
 template<typename Allocator = std::allocator<void>>
 class IntraProcessManagerImpl : public IntraProcessManagerImplBase
 {
 public:
-  IntraProcessManagerImpl() = default;
+  IntraProcessManagerImpl()
+  : registry_(std::allocate_shared<Registry>(RebindAlloc<Registry>()))
+  {}
+
   ~IntraProcessManagerImpl() = default;
 
   void
   add_subscription(uint64_t id, subscription::SubscriptionBase::SharedPtr subscription)
   {
-    subscriptions_[id] = subscription;
-    subscription_ids_by_topic_[subscription->get_topic_name()].insert(id);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto registry = copy_registry();
+    registry->subscriptions[id] = subscription;
+    registry->subscription_ids_by_topic[subscription->get_topic_name()].insert(id);
+    // Publish the registry first, so the subscription can be found once it is targeted.
+    publish_registry(registry);
+    // Make room for the new subscription in the publishers' slots now, so publishing doesn't.
+    for (auto & publisher_pair : registry->publishers) {
+      PublisherInfo & info = *publisher_pair.second;
+      if (info.topic_name == subscription->get_topic_name()) {
+        std::lock_guard<std::mutex> info_lock(info.mutex);
+        info.add_topic_subscription(id, subscription);
+      }
+    }
   }
 
   void
   remove_subscription(uint64_t intra_process_subscription_id)
   {
-    subscriptions_.erase(intra_process_subscription_id);
-    for (auto & pair : subscription_ids_by_topic_) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto registry = copy_registry();
+    registry->subscriptions.erase(intra_process_subscription_id);
+    for (auto & pair : registry->subscription_ids_by_topic) {
       pair.second.erase(intra_process_subscription_id);
     }
     // Iterate over all publisher infos and all stored subscription id's and
     // remove references to this subscription's id.
-    for (auto & publisher_pair : publishers_) {
-      for (auto & sub_pair : publisher_pair.second.target_subscriptions_by_message_sequence) {
-        sub_pair.second.erase(intra_process_subscription_id);
-      }
+    for (auto & publisher_pair : registry->publishers) {
+      PublisherInfo & info = *publisher_pair.second;
+      std::lock_guard<std::mutex> info_lock(info.mutex);
+      info.erase_subscription(intra_process_subscription_id);
     }
+    publish_registry(registry);
   }
 
   void add_publisher(uint64_t id,
@@ -116,21 +169,44 @@ public:
     mapped_ring_buffer::MappedRingBufferBase::SharedPtr mrb,
     size_t size)
   {
-    publishers_[id].publisher = publisher;
     // As long as the size of the ring buffer is less than the max sequence number, we're safe.
     if (size > std::numeric_limits<uint64_t>::max()) {
       throw std::invalid_argument("the calculated buffer size is too large");
     }
-    publishers_[id].sequence_number.store(0);
-
-    publishers_[id].buffer = mrb;
-    publishers_[id].target_subscriptions_by_message_sequence.reserve(size);
+    if (size == 0) {
+      throw std::invalid_argument("the buffer size must be positive");
+    }
+    auto publisher_ptr = publisher.lock();
+    if (!publisher_ptr) {
+      throw std::invalid_argument("add_publisher called with an expired publisher");
+    }
+    auto info = std::allocate_shared<PublisherInfo>(RebindAlloc<PublisherInfo>());
+    info->publisher = publisher;
+    info->topic_name = publisher_ptr->get_topic_name();
+    info->sequence_number.store(0);
+    info->evicted_count.store(0);
+
+    info->buffer = mrb;
+    // One slot per ring buffer slot, each with room for all of the topic's subscriptions.
+    info->target_subscriptions.assign(size, TargetSubscriptions(uint64_allocator));
+
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto registry = copy_registry();
+    // Resolve the subscriptions the publisher will publish to once, publishing only uses this.
+    for (auto subscription_id : registry->subscription_ids_by_topic[info->topic_name]) {
+      info->add_topic_subscription(subscription_id, registry->subscriptions[subscription_id]);
+    }
+    registry->publishers[id] = info;
+    publish_registry(registry);
   }
 
   void
   remove_publisher(uint64_t intra_process_publisher_id)
   {
-    publishers_.erase(intra_process_publisher_id);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto registry = copy_registry();
+    registry->publishers.erase(intra_process_publisher_id);
+    publish_registry(registry);
   }
 
   // return message_seq and mrb
@@ -139,50 +215,98 @@ public:
     uint64_t intra_process_publisher_id,
     uint64_t & message_seq)
   {
-    std::lock_guard<std::mutex> lock(runtime_mutex_);
-    auto it = publishers_.find(intra_process_publisher_id);
-    if (it == publishers_.end()) {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
       throw std::runtime_error("get_publisher_info_for_id called with invalid publisher id");
     }
-    PublisherInfo & info = it->second;
     // Calculate the next message sequence number.
-    message_seq = info.sequence_number.fetch_add(1);
+    message_seq = info->sequence_number.fetch_add(1);
 
-    return info.buffer;
+    return info->buffer;
+  }
+
+  void
+  wait_for_subscription_capacity(uint64_t intra_process_publisher_id)
+  {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
+      return;
+    }
+    // Each subscription waits until its max_block_time after this, not after the previous wait,
+    // so a publish is blocked for the longest of these times at most.
+    auto publish_start = std::chrono::steady_clock::now();
+    // Use the registry rather than the publisher's list of subscriptions, so no lock is held
+    // while waiting; a subscription which blocks must still be able to take messages.
+    auto registry = std::atomic_load(&registry_);
+    auto topic_it = registry->subscription_ids_by_topic.find(info->topic_name);
+    if (topic_it == registry->subscription_ids_by_topic.end()) {
+      return;
+    }
+    for (auto subscription_id : topic_it->second) {
+      auto subscription_it = registry->subscriptions.find(subscription_id);
+      if (subscription_it == registry->subscriptions.end()) {
+        continue;
+      }
+      auto subscription = subscription_it->second.lock();
+      if (subscription) {
+        subscription->wait_for_intra_process_capacity(publish_start);
+      }
+    }
   }
 
   void
   store_intra_process_message(uint64_t intra_process_publisher_id, uint64_t message_seq)
   {
-    std::lock_guard<std::mutex> lock(runtime_mutex_);
-    auto it = publishers_.find(intra_process_publisher_id);
-    if (it == publishers_.end()) {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
       throw std::runtime_error("store_intra_process_message called with invalid publisher id");
     }
-    PublisherInfo & info = it->second;
-    auto publisher = info.publisher.lock();
-    if (!publisher) {
+    if (info->publisher.expired()) {
       throw std::runtime_error("publisher has unexpectedly gone out of scope");
     }
 
-    // Figure out what subscriptions should receive the message.
-    auto & destined_subscriptions = subscription_ids_by_topic_[publisher->get_topic_name()];
-    // Store the list for later comparison.
-    if (info.target_subscriptions_by_message_sequence.count(message_seq) == 0) {
-      info.target_subscriptions_by_message_sequence.emplace(
-        message_seq, AllocSet(std::less<uint64_t>(), uint64_allocator));
-    } else {
-      info.target_subscriptions_by_message_sequence[message_seq].clear();
-    }
-    std::copy(
-      destined_subscriptions.begin(), destined_subscriptions.end(),
-      // Memory allocation occurs in info.target_subscriptions_by_message_sequence[message_seq]
-      std::inserter(
-        info.target_subscriptions_by_message_sequence[message_seq],
-        // This ends up only being a hint to std::set, could also be .begin().
-        info.target_subscriptions_by_message_sequence[message_seq].end()
-      )
-    );
+    std::lock_guard<std::mutex> lock(info->mutex);
+    // Store the list of subscriptions which should receive the message for later comparison,
+    // replacing the targets of the message displaced from the same ring buffer slot.
+    // This does not allocate, since the slots were reserved when the subscriptions were added.
+    TargetSubscriptions & targets = info->get_targets(message_seq);
+    if (targets.in_use) {
+      // The subscriptions which did not take the displaced message yet have lost it.
+      for (auto subscription_id : targets.subscription_ids) {
+        auto subscription = info->get_topic_subscription(subscription_id).lock();
+        if (subscription) {
+          subscription->on_intra_process_message_overwritten();
+        }
+      }
+    }
+    targets.message_seq = message_seq;
+    targets.in_use = true;
+    targets.subscription_ids.assign(
+      info->topic_subscription_ids.begin(), info->topic_subscription_ids.end());
+    if (info->lifespan > std::chrono::nanoseconds::zero()) {
+      targets.stored_at = std::chrono::steady_clock::now();
+      evict_expired(*info, targets.stored_at);
+    }
+  }
+
+  void
+  deliver_intra_process_message(uint64_t intra_process_publisher_id, uint64_t message_seq)
+  {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
+      throw std::runtime_error("deliver_intra_process_message called with invalid publisher id");
+    }
+    std::lock_guard<std::mutex> lock(info->mutex);
+    TargetSubscriptions & targets = info->get_targets(message_seq);
+    if (!targets.matches(message_seq)) {
+      return;
+    }
+    for (auto subscription_id : targets.subscription_ids) {
+      auto subscription = info->get_topic_subscription(subscription_id).lock();
+      if (subscription) {
+        subscription->deliver_intra_process_message(intra_process_publisher_id, message_seq);
+      }
+    }
   }
 
   mapped_ring_buffer::MappedRingBufferBase::SharedPtr
@@ -192,45 +316,82 @@ public:
     size_t & size
   )
   {
-    std::lock_guard<std::mutex> lock(runtime_mutex_);
-    PublisherInfo * info;
-    {
-      auto it = publishers_.find(intra_process_publisher_id);
-      if (it == publishers_.end()) {
-        // Publisher is either invalid or no longer exists.
-        return 0;
-      }
-      info = &it->second;
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
+      // Publisher is either invalid or no longer exists.
+      return 0;
     }
+    std::lock_guard<std::mutex> lock(info->mutex);
     // Figure out how many subscriptions are left.
-    AllocSet * target_subs;
+    TargetSubscriptions & targets = info->get_targets(message_sequence_number);
+    if (!targets.matches(message_sequence_number)) {
+      // Message is no longer being stored by this publisher.
+      return 0;
+    }
+    if (info->lifespan > std::chrono::nanoseconds::zero() &&
+      !targets.subscription_ids.empty() &&
+      std::chrono::steady_clock::now() - targets.stored_at >= info->lifespan)
     {
-      auto it = info->target_subscriptions_by_message_sequence.find(message_sequence_number);
-      if (it == info->target_subscriptions_by_message_sequence.end()) {
-        // Message is no longer being stored by this publisher.
-        return 0;
+      // Too old for any subscription, skip it and release it for all of them.
+      info->evict(targets);
+      return 0;
+    }
+    if (!targets.erase(requesting_subscriptions_intra_process_id)) {
+      // This publisher id/message seq pair was not intended for this subscription.
+      return 0;
+    }
+    size = targets.subscription_ids.size();
+    return info->buffer;
+  }
+
+  void
+  set_lifespan(uint64_t intra_process_publisher_id, std::chrono::nanoseconds lifespan)
+  {
+    if (lifespan < std::chrono::nanoseconds::zero()) {
+      throw std::invalid_argument("the lifespan must not be negative");
+    }
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
+      throw std::runtime_error("set_lifespan called with invalid publisher id");
+    }
+    std::lock_guard<std::mutex> lock(info->mutex);
+    if (info->lifespan == std::chrono::nanoseconds::zero()) {
+      // The messages stored so far were not stamped, their lifespan starts now.
+      auto now = std::chrono::steady_clock::now();
+      for (auto & targets : info->target_subscriptions) {
+        targets.stored_at = now;
       }
-      target_subs = &it->second;
     }
-    {
-      auto it = std::find(
-        target_subs->begin(), target_subs->end(),
-        requesting_subscriptions_intra_process_id);
-      if (it == target_subs->end()) {
-        // This publisher id/message seq pair was not intended for this subscription.
-        return 0;
+    info->lifespan = lifespan;
+  }
+
+  uint64_t
+  get_evicted_count(uint64_t intra_process_publisher_id) const
+  {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    return info ? info->evicted_count.load(std::memory_order_relaxed) : 0;
+  }
+
+  void
+  evict_expired_messages()
+  {
+    auto registry = std::atomic_load(&registry_);
+    auto now = std::chrono::steady_clock::now();
+    for (auto & publisher_pair : registry->publishers) {
+      PublisherInfo & info = *publisher_pair.second;
+      std::lock_guard<std::mutex> lock(info.mutex);
+      if (info.lifespan > std::chrono::nanoseconds::zero()) {
+        evict_expired(info, now);
       }
-      target_subs->erase(it);
     }
-    size = target_subs->size();
-    return info->buffer;
   }
 
   bool
   matches_any_publishers(const rmw_gid_t * id) const
   {
-    for (auto & publisher_pair : publishers_) {
-      auto publisher = publisher_pair.second.publisher.lock();
+    auto registry = std::atomic_load(&registry_);
+    for (auto & publisher_pair : registry->publishers) {
+      auto publisher = publisher_pair.second->publisher.lock();
       if (!publisher) {
         continue;
       }
@@ -241,6 +402,38 @@ public:
     return false;
   }
 
+  size_t
+  get_subscription_count(uint64_t intra_process_publisher_id) const
+  {
+    auto info = get_publisher_info(intra_process_publisher_id);
+    if (!info) {
+      return 0;
+    }
+    std::lock_guard<std::mutex> lock(info->mutex);
+    return info->topic_subscription_ids.size();
+  }
+
+  void
+  add_service(service::ServiceBase::SharedPtr service)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto registry = copy_registry();
+    // A later service with the same name takes over, like the most recent server would in rmw.
+    registry->services[service->get_service_name()] = service;
+    publish_registry(registry);
+  }
+
+  service::ServiceBase::SharedPtr
+  get_service(const std::string & service_name) const
+  {
+    auto registry = std::atomic_load(&registry_);
+    auto it = registry->services.find(service_name);
+    if (it == registry->services.end()) {
+      return nullptr;
+    }
+    return it->second.lock();
+  }
+
 private:
   RCLCPP_DISABLE_COPY(IntraProcessManagerImpl);
 
@@ -250,39 +443,231 @@ private:
   RebindAlloc<uint64_t> uint64_allocator;
 
   using AllocSet = std::set<uint64_t, std::less<uint64_t>, RebindAlloc<uint64_t>>;
+  using AllocVector = std::vector<uint64_t, RebindAlloc<uint64_t>>;
   using SubscriptionMap = std::unordered_map<uint64_t, subscription::SubscriptionBase::WeakPtr,
       std::hash<uint64_t>, std::equal_to<uint64_t>,
       RebindAlloc<std::pair<const uint64_t, subscription::SubscriptionBase::WeakPtr>>>;
   using IDTopicMap = std::map<std::string, AllocSet,
       std::less<std::string>, RebindAlloc<std::pair<std::string, AllocSet>>>;
+  using ServiceMap = std::map<std::string, service::ServiceBase::WeakPtr,
+      std::less<std::string>,
+      RebindAlloc<std::pair<const std::string, service::ServiceBase::WeakPtr>>>;
+
+  /// The subscriptions which have yet to take a stored message.
+  struct TargetSubscriptions
+  {
+    explicit TargetSubscriptions(const RebindAlloc<uint64_t> & allocator)
+    : message_seq(0), in_use(false), subscription_ids(allocator)
+    {}
 
-  SubscriptionMap subscriptions_;
+    bool
+    matches(uint64_t seq) const
+    {
+      return in_use && message_seq == seq;
+    }
 
-  IDTopicMap subscription_ids_by_topic_;
+    /// Remove the subscription id, returns false if it was not a target.
+    bool
+    erase(uint64_t subscription_id)
+    {
+      auto it = std::find(subscription_ids.begin(), subscription_ids.end(), subscription_id);
+      if (it == subscription_ids.end()) {
+        return false;
+      }
+      subscription_ids.erase(it);
+      return true;
+    }
+
+    uint64_t message_seq;
+    bool in_use;
+    AllocVector subscription_ids;
+    /// When the message was stored, only set while the publisher has a lifespan.
+    std::chrono::steady_clock::time_point stored_at;
+  };
+
+  using TargetSubscriptionsVector =
+    std::vector<TargetSubscriptions, RebindAlloc<TargetSubscriptions>>;
 
   struct PublisherInfo
   {
     RCLCPP_DISABLE_COPY(PublisherInfo);
 
-    PublisherInfo() = default;
+    PublisherInfo()
+    : lifespan(std::chrono::nanoseconds::zero()), oldest_seq(0)
+    {}
+
+    /// Return the slot for the sequence number, the same one used by the ring buffer.
+    TargetSubscriptions &
+    get_targets(uint64_t seq)
+    {
+      return target_subscriptions[seq % target_subscriptions.size()];
+    }
+
+    /// Add a subscription on the topic and make room for it in each slot.
+    void
+    add_topic_subscription(
+      uint64_t subscription_id, subscription::SubscriptionBase::WeakPtr subscription)
+    {
+      auto it = std::lower_bound(
+        topic_subscription_ids.begin(), topic_subscription_ids.end(), subscription_id);
+      auto index = it - topic_subscription_ids.begin();
+      if (it != topic_subscription_ids.end() && *it == subscription_id) {
+        topic_subscriptions[index] = subscription;
+        return;
+      }
+      topic_subscription_ids.insert(it, subscription_id);
+      topic_subscriptions.insert(topic_subscriptions.begin() + index, subscription);
+      for (auto & targets : target_subscriptions) {
+        targets.subscription_ids.reserve(topic_subscription_ids.size());
+      }
+    }
+
+    /// Return the subscription on the topic with the given id, or an empty pointer.
+    subscription::SubscriptionBase::WeakPtr
+    get_topic_subscription(uint64_t subscription_id) const
+    {
+      auto it = std::lower_bound(
+        topic_subscription_ids.begin(), topic_subscription_ids.end(), subscription_id);
+      if (it == topic_subscription_ids.end() || *it != subscription_id) {
+        return subscription::SubscriptionBase::WeakPtr();
+      }
+      return topic_subscriptions[it - topic_subscription_ids.begin()];
+    }
+
+    void
+    erase_subscription(uint64_t subscription_id)
+    {
+      auto it = std::lower_bound(
+        topic_subscription_ids.begin(), topic_subscription_ids.end(), subscription_id);
+      if (it == topic_subscription_ids.end() || *it != subscription_id) {
+        // Not on this topic, so it cannot be the target of any stored message either.
+        return;
+      }
+      auto index = it - topic_subscription_ids.begin();
+      topic_subscription_ids.erase(it);
+      topic_subscriptions.erase(topic_subscriptions.begin() + index);
+      for (auto & targets : target_subscriptions) {
+        if (targets.in_use && targets.erase(subscription_id) && targets.subscription_ids.empty()) {
+          // Nobody is left to take the message, so it does not have to wait to be displaced.
+          evict(targets);
+        }
+      }
+    }
 
+    /// Release a stored message which will not be taken anymore, mutex must be held.
+    void
+    evict(TargetSubscriptions & targets)
+    {
+      buffer->remove_at_key(targets.message_seq);
+      targets.in_use = false;
+      targets.subscription_ids.clear();
+      evicted_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // These are set once, before the info is added to the registry.
     publisher::PublisherBase::WeakPtr publisher;
-    std::atomic<uint64_t> sequence_number;
+    std::string topic_name;
     mapped_ring_buffer::MappedRingBufferBase::SharedPtr buffer;
 
-    using TargetSubscriptionsMap = std::unordered_map<uint64_t, AllocSet,
-        std::hash<uint64_t>, std::equal_to<uint64_t>,
-        RebindAlloc<std::pair<const uint64_t, AllocSet>>>;
-    TargetSubscriptionsMap target_subscriptions_by_message_sequence;
+    std::atomic<uint64_t> sequence_number;
+    /// Messages released before they were taken by all of their subscriptions or displaced.
+    std::atomic<uint64_t> evicted_count;
+
+    /// Protects the members below, which are only used for this publisher's messages.
+    std::mutex mutex;
+    /// The ids of the subscriptions on the publisher's topic, sorted.
+    AllocVector topic_subscription_ids;
+    /// The subscriptions on the publisher's topic, in the same order as their ids.
+    std::vector<subscription::SubscriptionBase::WeakPtr,
+      RebindAlloc<subscription::SubscriptionBase::WeakPtr>> topic_subscriptions;
+    /// Targets of the stored messages, indexed by message sequence modulo the buffer size.
+    TargetSubscriptionsVector target_subscriptions;
+    /// How long messages are kept for the subscriptions, zero to keep them until displaced.
+    std::chrono::nanoseconds lifespan;
+    /// The sequence number of the oldest message which may have to be evicted.
+    uint64_t oldest_seq;
   };
 
-  using PublisherMap = std::unordered_map<uint64_t, PublisherInfo,
+  using PublisherInfoSharedPtr = std::shared_ptr<PublisherInfo>;
+  using PublisherMap = std::unordered_map<uint64_t, PublisherInfoSharedPtr,
       std::hash<uint64_t>, std::equal_to<uint64_t>,
-      RebindAlloc<std::pair<const uint64_t, PublisherInfo>>>;
+      RebindAlloc<std::pair<const uint64_t, PublisherInfoSharedPtr>>>;
+
+  /// Snapshot of the registered entities, it is not modified once published.
+  struct Registry
+  {
+    PublisherMap publishers;
+    SubscriptionMap subscriptions;
+    IDTopicMap subscription_ids_by_topic;
+    ServiceMap services;
+  };
+
+  using RegistrySharedPtr = std::shared_ptr<Registry>;
+
+  PublisherInfoSharedPtr
+  get_publisher_info(uint64_t intra_process_publisher_id) const
+  {
+    auto registry = std::atomic_load(&registry_);
+    auto it = registry->publishers.find(intra_process_publisher_id);
+    if (it == registry->publishers.end()) {
+      return nullptr;
+    }
+    return it->second;
+  }
 
-  PublisherMap publishers_;
+  /// Evict the oldest messages of the publisher for as long as they are expired.
+  /* Messages are stored in sequence, so the scan stops at the first one which is still alive,
+   * and over time it looks at each message once. info.mutex must be held.
+   */
+  static void
+  evict_expired(PublisherInfo & info, std::chrono::steady_clock::time_point now)
+  {
+    uint64_t next_seq = info.sequence_number.load();
+    uint64_t size = info.target_subscriptions.size();
+    if (next_seq > size) {
+      // Anything older has been displaced from the ring buffer already.
+      info.oldest_seq = std::max(info.oldest_seq, next_seq - size);
+    }
+    for (; info.oldest_seq < next_seq; ++info.oldest_seq) {
+      uint64_t seq = info.oldest_seq;
+      TargetSubscriptions & targets = info.get_targets(seq);
+      if (!targets.matches(seq)) {
+        if (targets.message_seq < seq) {
+          // A concurrent publish has yet to store it, look again next time.
+          break;
+        }
+        // Evicted or displaced already.
+        continue;
+      }
+      if (targets.subscription_ids.empty()) {
+        // Taken by all of its subscriptions, the last one released it.
+        continue;
+      }
+      if (now - targets.stored_at < info.lifespan) {
+        break;
+      }
+      info.evict(targets);
+    }
+  }
+
+  /// Return a modifiable copy of the current registry, registry_mutex_ must be held.
+  RegistrySharedPtr
+  copy_registry()
+  {
+    return std::allocate_shared<Registry>(RebindAlloc<Registry>(), *registry_);
+  }
+
+  /// Replace the current registry with the given one, registry_mutex_ must be held.
+  void
+  publish_registry(const RegistrySharedPtr & registry)
+  {
+    std::atomic_store(&registry_, std::shared_ptr<const Registry>(registry));
+  }
 
-  std::mutex runtime_mutex_;
+  /// The current registry, only accessed with the atomic shared_ptr operations.
+  std::shared_ptr<const Registry> registry_;
+  /// Serializes the modifications of the registry.
+  std::mutex registry_mutex_;
 };
 
 RCLCPP_PUBLIC
@@ -0,0 +1,170 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__LOANED_MESSAGE_HPP_
+#define RCLCPP__LOANED_MESSAGE_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/allocator/allocator_common.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace loaned_message
+{
+
+/// A message borrowed from a LoanedMessagePool.
+/**
+ * It is a move-only handle on one of the pool's messages.
+ * The message goes back to the pool once this and any other references to it,
+ * e.g. the ones given to intra process subscriptions when it was published, are gone.
+ */
+template<typename MessageT>
+class LoanedMessage
+{
+public:
+  LoanedMessage() = default;
+
+  explicit LoanedMessage(std::shared_ptr<MessageT> message)
+  : message_(std::move(message))
+  {}
+
+  LoanedMessage(LoanedMessage && other) = default;
+
+  LoanedMessage &
+  operator=(LoanedMessage && other) = default;
+
+  MessageT &
+  operator*() const
+  {
+    return *message_;
+  }
+
+  MessageT *
+  operator->() const
+  {
+    return message_.get();
+  }
+
+  MessageT *
+  get() const
+  {
+    return message_.get();
+  }
+
+  explicit operator bool() const
+  {
+    return message_ != nullptr;
+  }
+
+  /// Give up the loan, the returned reference can only be used to read the message.
+  std::shared_ptr<const MessageT>
+  release()
+  {
+    return std::move(message_);
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(LoanedMessage);
+
+  std::shared_ptr<MessageT> message_;
+};
+
+/// Pool of preallocated messages which can be borrowed and are recycled when no longer used.
+/**
+ * All messages are allocated with the given allocator when the pool is created.
+ * A message is free again once only the pool references it, so no bookkeeping is needed
+ * when a message is given back and borrowing or returning a message does not allocate.
+ * If all messages are in use the pool grows by one message, so after the highest number
+ * of concurrently used messages has been reached the pool does not allocate anymore.
+ *
+ * Messages are not reset when they are borrowed again, they keep the contents of
+ * their previous use, which allows their storage (e.g. of sequences) to be reused.
+ */
+template<typename MessageT, typename Alloc = std::allocator<void>>
+class LoanedMessagePool
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS_NOT_COPYABLE(LoanedMessagePool<MessageT, Alloc>);
+
+  using MessageAllocTraits = allocator::AllocRebind<MessageT, Alloc>;
+  using MessageAlloc = typename MessageAllocTraits::allocator_type;
+
+  /// Constructor.
+  /**
+   * \param[in] size Number of messages to preallocate, must be positive.
+   * \param[in] allocator Allocator used for the messages.
+   */
+  explicit LoanedMessagePool(size_t size, std::shared_ptr<Alloc> allocator = nullptr)
+  {
+    if (size == 0) {
+      throw std::invalid_argument("size must be a positive, non-zero value");
+    }
+    if (!allocator) {
+      message_allocator_ = std::make_shared<MessageAlloc>();
+    } else {
+      message_allocator_ = std::make_shared<MessageAlloc>(*allocator.get());
+    }
+    messages_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      messages_.push_back(std::allocate_shared<MessageT>(*message_allocator_.get()));
+    }
+  }
+
+  /// Borrow a message which is not used anymore, growing the pool if there is none.
+  LoanedMessage<MessageT>
+  borrow_message()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < messages_.size(); ++i) {
+      auto & message = messages_[(next_index_ + i) % messages_.size()];
+      // Only the pool can hand out new references, so a count of one cannot increase
+      // concurrently.
+      if (message.use_count() == 1) {
+        // Synchronize with the last user releasing the message before it is modified.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next_index_ = (next_index_ + i + 1) % messages_.size();
+        return LoanedMessage<MessageT>(message);
+      }
+    }
+    messages_.push_back(std::allocate_shared<MessageT>(*message_allocator_.get()));
+    return LoanedMessage<MessageT>(messages_.back());
+  }
+
+  /// Return the number of messages in the pool, used or not.
+  size_t
+  size()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return messages_.size();
+  }
+
+private:
+  std::shared_ptr<MessageAlloc> message_allocator_;
+  std::vector<std::shared_ptr<MessageT>> messages_;
+  size_t next_index_ = 0;
+  std::mutex mutex_;
+};
+
+}  // namespace loaned_message
+}  // namespace rclcpp
+
+#endif  // RCLCPP__LOANED_MESSAGE_HPP_
@@ -0,0 +1,85 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__MAILBOX_HPP_
+#define RCLCPP__MAILBOX_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "rclcpp/macros.hpp"
+
+namespace rclcpp
+{
+namespace mailbox
+{
+
+/// Holds the latest message of a topic, e.g. of a pose or joint state, for any thread to read.
+/**
+ * A new message replaces the previous one with std::atomic_store, and reading it is a
+ * std::atomic_load, so neither runs a callback or copies a message. This is not lock-free: the
+ * standard library implements these with a pool of mutexes, which are only held for the pointer
+ * swap. Older messages are dropped instead of queued. Messages are shared, not copied: a reader
+ * keeps the message it got alive for as long as it holds it, so it never changes under the
+ * reader.
+ */
+template<typename MessageT>
+class Mailbox
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(Mailbox);
+
+  Mailbox()
+  : count_(0)
+  {}
+
+  /// Replace the message.
+  void
+  put(std::shared_ptr<const MessageT> message)
+  {
+    std::atomic_store(&message_, std::move(message));
+    count_.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Get the latest message, nullptr if there has been none yet.
+  std::shared_ptr<const MessageT>
+  get() const
+  {
+    return std::atomic_load(&message_);
+  }
+
+  /// Get the number of messages put so far, to tell whether a new one arrived since the last get.
+  /**
+   * The count is incremented after the message is swapped in, so a message got after reading
+   * the count is at least as new as that count.
+   */
+  uint64_t
+  get_count() const
+  {
+    return count_.load(std::memory_order_acquire);
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(Mailbox);
+
+  std::shared_ptr<const MessageT> message_;
+  std::atomic<uint64_t> count_;
+};
+
+}  // namespace mailbox
+}  // namespace rclcpp
+
+#endif  // RCLCPP__MAILBOX_HPP_
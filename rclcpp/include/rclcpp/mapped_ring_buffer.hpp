@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -35,6 +36,94 @@ class RCLCPP_PUBLIC MappedRingBufferBase
 {
 public:
   RCLCPP_SMART_PTR_DEFINITIONS(MappedRingBufferBase);
+
+  virtual ~MappedRingBufferBase() {}
+
+  /// Release the value stored at the given key without returning it.
+  /* This does not need the type of the values, so the intra process manager can
+   * evict messages which will not be taken anymore.
+   * Readers which already got a shared reference to the value keep it.
+   *
+   * \param key the key associated with the stored value
+   * \return true if the key was found
+   */
+  virtual bool
+  remove_at_key(uint64_t key) = 0;
+};
+
+/// Kinds of ring buffer which can be used to store in-flight intra process messages.
+enum class MappedRingBufferType
+{
+  /// MappedRingBuffer, every operation is serialized by a single mutex.
+  Locked,
+  /// SharedEntryMappedRingBuffer, writers never wait for readers making copies.
+  SharedEntry,
+};
+
+/// How the keys of a ring buffer are mapped to its slots.
+enum class MappedRingBufferKeyMode
+{
+  /// Any key can be used, looking up a key is linear in the size of the buffer.
+  Arbitrary,
+  /// Keys are increasing sequence numbers, the key is stored in slot key % size.
+  /* Looking up a key is constant time.
+   * Consecutive keys displace the oldest key, like in the arbitrary mode, but
+   * a gap in the sequence may displace a more recent one.
+   */
+  Sequential,
+};
+
+/// Interface for ring buffers of T which can be accessed by a key.
+/* See MappedRingBuffer for a description of the semantics of each method.
+ * This allows users of a ring buffer to be agnostic of how it is synchronized.
+ */
+template<typename T, typename Alloc = std::allocator<void>>
+class TypedMappedRingBufferBase : public MappedRingBufferBase
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(TypedMappedRingBufferBase<T, Alloc>);
+  using ElemAllocTraits = allocator::AllocRebind<T, Alloc>;
+  using ElemAlloc = typename ElemAllocTraits::allocator_type;
+  using ElemDeleter = allocator::Deleter<ElemAlloc, T>;
+
+  using ElemUniquePtr = std::unique_ptr<T, ElemDeleter>;
+  using ElemSharedPtr = std::shared_ptr<const T>;
+
+  virtual ~TypedMappedRingBufferBase() {}
+
+  virtual void
+  get_copy_at_key(uint64_t key, ElemUniquePtr & value) = 0;
+
+  virtual void
+  get_ownership_at_key(uint64_t key, ElemUniquePtr & value) = 0;
+
+  virtual void
+  pop_at_key(uint64_t key, ElemUniquePtr & value) = 0;
+
+  virtual void
+  get_shared_at_key(uint64_t key, ElemSharedPtr & value) = 0;
+
+  virtual void
+  pop_shared_at_key(uint64_t key, ElemSharedPtr & value) = 0;
+
+  virtual bool
+  test_at_key(uint64_t key, const std::function<bool(const T &)> & predicate) = 0;
+
+  virtual bool
+  push_and_replace(uint64_t key, ElemUniquePtr & value) = 0;
+
+  virtual bool
+  push_and_replace(uint64_t key, const ElemSharedPtr & value) = 0;
+
+  bool
+  push_and_replace(uint64_t key, ElemUniquePtr && value)
+  {
+    ElemUniquePtr temp = std::move(value);
+    return push_and_replace(key, temp);
+  }
+
+  virtual bool
+  has_key(uint64_t key) = 0;
 };
 
 /// Ring buffer container of unique_ptr's of T, which can be accessed by a key.
@@ -52,25 +141,39 @@ public:
  * But iteration does not begin with the ring buffer's head, and therefore
  * there is no guarantee on which value is returned if a key is used multiple
  * times.
+ *
+ * If the keys are sequence numbers, MappedRingBufferKeyMode::Sequential can
+ * be passed to the constructor, which makes the key lookups constant time.
+ *
+ * A stored value can also be shared, either because it was pushed as a
+ * shared_ptr to const or because get_shared_at_key was called for it.
+ * A shared value is immutable: it is handed out without copying to shared
+ * readers, and copies are only made for readers which need ownership.
  */
 template<typename T, typename Alloc = std::allocator<void>>
-class MappedRingBuffer : public MappedRingBufferBase
+class MappedRingBuffer : public TypedMappedRingBufferBase<T, Alloc>
 {
 public:
   RCLCPP_SMART_PTR_DEFINITIONS(MappedRingBuffer<T, Alloc>);
-  using ElemAllocTraits = allocator::AllocRebind<T, Alloc>;
-  using ElemAlloc = typename ElemAllocTraits::allocator_type;
-  using ElemDeleter = allocator::Deleter<ElemAlloc, T>;
+  using Base = TypedMappedRingBufferBase<T, Alloc>;
+  using ElemAllocTraits = typename Base::ElemAllocTraits;
+  using ElemAlloc = typename Base::ElemAlloc;
+  using ElemDeleter = typename Base::ElemDeleter;
 
-  using ElemUniquePtr = std::unique_ptr<T, ElemDeleter>;
+  using ElemUniquePtr = typename Base::ElemUniquePtr;
+  using ElemSharedPtr = typename Base::ElemSharedPtr;
+  using Base::push_and_replace;
 
   /// Constructor.
   /* The constructor will allocate memory while reserving space.
    *
    * \param size size of the ring buffer; must be positive and non-zero.
+   * \param allocator allocator used for copies of the stored values.
+   * \param key_mode how keys are mapped to slots.
    */
-  explicit MappedRingBuffer(size_t size, std::shared_ptr<Alloc> allocator = nullptr)
-  : elements_(size), head_(0)
+  explicit MappedRingBuffer(size_t size, std::shared_ptr<Alloc> allocator = nullptr,
+    MappedRingBufferKeyMode key_mode = MappedRingBufferKeyMode::Arbitrary)
+  : elements_(size), head_(0), key_mode_(key_mode)
   {
     if (size == 0) {
       throw std::invalid_argument("size must be a positive, non-zero value");
@@ -95,16 +198,14 @@ public:
    * \param key the key associated with the stored value
    * \param value if the key is found, the value is stored in this parameter
    */
-  void
+  virtual void
   get_copy_at_key(uint64_t key, ElemUniquePtr & value)
   {
     std::lock_guard<std::mutex> lock(data_mutex_);
     auto it = get_iterator_of_key(key);
     value = nullptr;
     if (it != elements_.end() && it->in_use) {
-      auto ptr = ElemAllocTraits::allocate(*allocator_.get(), 1);
-      ElemAllocTraits::construct(*allocator_.get(), ptr, *it->value);
-      value = ElemUniquePtr(ptr);
+      value = copy_of(*it);
     }
   }
 
@@ -127,7 +228,7 @@ public:
    * \param key the key associated with the stored value
    * \param value if the key is found, the value is stored in this parameter
    */
-  void
+  virtual void
   get_ownership_at_key(uint64_t key, ElemUniquePtr & value)
   {
     std::lock_guard<std::mutex> lock(data_mutex_);
@@ -135,9 +236,12 @@ public:
     value = nullptr;
     if (it != elements_.end() && it->in_use) {
       // Make a copy.
-      auto ptr = ElemAllocTraits::allocate(*allocator_.get(), 1);
-      ElemAllocTraits::construct(*allocator_.get(), ptr, *it->value);
-      auto copy = ElemUniquePtr(ptr);
+      auto copy = copy_of(*it);
+      if (it->shared_value) {
+        // A shared value cannot be given away, return the copy instead.
+        value.swap(copy);
+        return;
+      }
       // Return the original.
       value.swap(it->value);
       // Store the copy.
@@ -155,18 +259,82 @@ public:
    * \param key the key associated with the stored value
    * \param value if the key is found, the value is stored in this parameter
    */
-  void
+  virtual void
   pop_at_key(uint64_t key, ElemUniquePtr & value)
   {
     std::lock_guard<std::mutex> lock(data_mutex_);
     auto it = get_iterator_of_key(key);
     value = nullptr;
     if (it != elements_.end() && it->in_use) {
-      value.swap(it->value);
+      if (it->shared_value) {
+        // Others may still hold the shared value, so ownership of a copy is returned.
+        value = copy_of(*it);
+        it->shared_value.reset();
+      } else {
+        value.swap(it->value);
+      }
       it->in_use = false;
     }
   }
 
+  /// Return a shared, immutable reference to the value stored at the given key.
+  /* The key is matched if an element in the ring buffer has a matching key.
+   * A uniquely owned value is converted into a shared one on the first call, later
+   * calls return the same instance, so this never copies the value.
+   *
+   * The contents of value before the method is called are discarded.
+   *
+   * \param key the key associated with the stored value
+   * \param value if the key is found, the value is stored in this parameter
+   */
+  virtual void
+  get_shared_at_key(uint64_t key, ElemSharedPtr & value)
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    auto it = get_iterator_of_key(key);
+    value = nullptr;
+    if (it != elements_.end() && it->in_use) {
+      value = share(*it);
+    }
+  }
+
+  /// Return a shared reference to the value stored at the given key and remove it.
+  /* Like get_shared_at_key, but the element is removed from the ring buffer.
+   *
+   * \param key the key associated with the stored value
+   * \param value if the key is found, the value is stored in this parameter
+   */
+  virtual void
+  pop_shared_at_key(uint64_t key, ElemSharedPtr & value)
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    auto it = get_iterator_of_key(key);
+    value = nullptr;
+    if (it != elements_.end() && it->in_use) {
+      value = share(*it);
+      it->shared_value.reset();
+      it->in_use = false;
+    }
+  }
+
+  /// Apply a predicate to the value stored at the given key, without copying or taking it.
+  /* The predicate is called while the ring buffer is locked, so it should be quick.
+   *
+   * \param key the key associated with the stored value
+   * \param predicate called with the stored value if the key is found
+   * \return the result of the predicate, or false if the key is not found
+   */
+  virtual bool
+  test_at_key(uint64_t key, const std::function<bool(const T &)> & predicate)
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    auto it = get_iterator_of_key(key);
+    if (it == elements_.end() || !it->in_use) {
+      return false;
+    }
+    return predicate(it->shared_value ? *it->shared_value : *it->value);
+  }
+
   /// Insert a key-value pair, displacing an existing pair if necessary.
   /* The key's uniqueness is not checked on insertion.
    * It is up to the user to ensure the key is unique.
@@ -178,27 +346,56 @@ public:
    * \param key the key associated with the value to be stored
    * \param value the value to store, and optionally the value displaced
    */
-  bool
+  virtual bool
   push_and_replace(uint64_t key, ElemUniquePtr & value)
   {
     std::lock_guard<std::mutex> lock(data_mutex_);
-    bool did_replace = elements_[head_].in_use;
-    elements_[head_].key = key;
-    elements_[head_].value.swap(value);
-    elements_[head_].in_use = true;
-    head_ = (head_ + 1) % elements_.size();
+    element & e = elements_[get_index_for_push(key)];
+    bool did_replace = e.in_use;
+    e.key = key;
+    e.value.swap(value);
+    e.shared_value.reset();
+    e.in_use = true;
     return did_replace;
   }
 
-  bool
-  push_and_replace(uint64_t key, ElemUniquePtr && value)
+  /// Insert a key and shared value pair, displacing an existing pair if necessary.
+  /* Like push_and_replace for unique values, but the stored value is shared and will be
+   * handed out without copying by get_shared_at_key.
+   *
+   * \param key the key associated with the value to be stored
+   * \param value the shared value to store
+   * \return true if a pair was displaced
+   */
+  virtual bool
+  push_and_replace(uint64_t key, const ElemSharedPtr & value)
   {
-    ElemUniquePtr temp = std::move(value);
-    return push_and_replace(key, temp);
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    element & e = elements_[get_index_for_push(key)];
+    bool did_replace = e.in_use;
+    e.key = key;
+    e.value.reset();
+    e.shared_value = value;
+    e.in_use = true;
+    return did_replace;
+  }
+
+  virtual bool
+  remove_at_key(uint64_t key)
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    auto it = get_iterator_of_key(key);
+    if (it == elements_.end() || !it->in_use) {
+      return false;
+    }
+    it->value.reset();
+    it->shared_value.reset();
+    it->in_use = false;
+    return true;
   }
 
   /// Return true if the key is found in the ring buffer, otherwise false.
-  bool
+  virtual bool
   has_key(uint64_t key)
   {
     std::lock_guard<std::mutex> lock(data_mutex_);
@@ -211,15 +408,54 @@ private:
   struct element
   {
     uint64_t key;
+    /// The value, if it is uniquely owned, otherwise nullptr.
     ElemUniquePtr value;
+    /// The value, if it is shared, otherwise nullptr.
+    ElemSharedPtr shared_value;
     bool in_use;
   };
 
+  ElemUniquePtr
+  copy_of(const element & e)
+  {
+    const T & source = e.shared_value ? *e.shared_value : *e.value;
+    auto ptr = ElemAllocTraits::allocate(*allocator_.get(), 1);
+    ElemAllocTraits::construct(*allocator_.get(), ptr, source);
+    // The copy has to be released with the allocator it came from.
+    ElemDeleter deleter;
+    allocator::set_allocator_for_deleter(&deleter, allocator_.get());
+    return ElemUniquePtr(ptr, deleter);
+  }
+
+  static ElemSharedPtr
+  share(element & e)
+  {
+    if (!e.shared_value) {
+      e.shared_value = ElemSharedPtr(std::move(e.value));
+    }
+    return e.shared_value;
+  }
+
   using VectorAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<element>;
 
+  size_t
+  get_index_for_push(uint64_t key)
+  {
+    if (key_mode_ == MappedRingBufferKeyMode::Sequential) {
+      return key % elements_.size();
+    }
+    size_t index = head_;
+    head_ = (head_ + 1) % elements_.size();
+    return index;
+  }
+
   typename std::vector<element, VectorAlloc>::iterator
   get_iterator_of_key(uint64_t key)
   {
+    if (key_mode_ == MappedRingBufferKeyMode::Sequential) {
+      auto it = elements_.begin() + key % elements_.size();
+      return (it->in_use && it->key == key) ? it : elements_.end();
+    }
     // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
     auto it = std::find_if(elements_.begin(), elements_.end(), [key](element & e) -> bool {
       return e.key == key && e.in_use;
@@ -230,6 +466,7 @@ private:
 
   std::vector<element, VectorAlloc> elements_;
   size_t head_;
+  MappedRingBufferKeyMode key_mode_;
   std::shared_ptr<ElemAlloc> allocator_;
   std::mutex data_mutex_;
 };
@@ -15,6 +15,7 @@
 #ifndef RCLCPP__MEMORY_STRATEGY_HPP_
 #define RCLCPP__MEMORY_STRATEGY_HPP_
 
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -45,12 +46,30 @@ public:
 
   virtual bool collect_entities(const WeakNodeVector & weak_nodes) = 0;
 
+  /// Set the statistics into which the executor records, or nullptr while they are disabled.
+  /**
+   * The executor calls this before collecting the entities. A strategy may resolve the
+   * statistics of each entity when collecting it and set AnyExecutable::statistics, so the
+   * executor does not have to look them up for every execution.
+   * The default implementation does nothing.
+   */
+  virtual void
+  set_executor_statistics(rclcpp::executor::ExecutorStatistics * statistics);
+
   virtual size_t number_of_ready_subscriptions() const = 0;
   virtual size_t number_of_ready_services() const = 0;
   virtual size_t number_of_ready_clients() const = 0;
   virtual size_t number_of_ready_timers() const = 0;
   virtual size_t number_of_guard_conditions() const = 0;
 
+  /// Return how long a wait may block before a timer kept by the strategy expires.
+  /**
+   * Timers which are added to the waitset are accounted for by rcl_wait itself.
+   * \return The time until the next expiry, or a negative duration if there is nothing to wait
+   * for.
+   */
+  virtual std::chrono::nanoseconds time_until_next_timer() const = 0;
+
   virtual bool add_handles_to_waitset(rcl_wait_set_t * wait_set) = 0;
   virtual void clear_handles() = 0;
   virtual void remove_null_handles(rcl_wait_set_t * wait_set) = 0;
@@ -64,17 +83,33 @@ public:
   virtual void remove_guard_condition(const rcl_guard_condition_t * guard_condition) = 0;
 
   virtual void
-  get_next_subscription(rclcpp::executor::AnyExecutable::SharedPtr any_exec,
+  get_next_subscription(rclcpp::executor::AnyExecutable & any_exec,
     const WeakNodeVector & weak_nodes) = 0;
 
   virtual void
-  get_next_service(rclcpp::executor::AnyExecutable::SharedPtr any_exec,
+  get_next_service(rclcpp::executor::AnyExecutable & any_exec,
     const WeakNodeVector & weak_nodes) = 0;
 
   virtual void
-  get_next_client(rclcpp::executor::AnyExecutable::SharedPtr any_exec,
+  get_next_client(rclcpp::executor::AnyExecutable & any_exec,
     const WeakNodeVector & weak_nodes) = 0;
 
+  /// Fill any_exec with the next ready timer.
+  /**
+   * The default implementation checks every timer of the given nodes.
+   */
+  virtual void
+  get_next_timer(rclcpp::executor::AnyExecutable & any_exec,
+    const WeakNodeVector & weak_nodes);
+
+  /// Fill any_exec with the next ready executable of any type.
+  /**
+   * The default implementation checks timers, then subscriptions, then services, then clients.
+   */
+  virtual void
+  get_next_ready_executable(rclcpp::executor::AnyExecutable & any_exec,
+    const WeakNodeVector & weak_nodes);
+
   virtual rcl_allocator_t
   get_allocator() = 0;
 
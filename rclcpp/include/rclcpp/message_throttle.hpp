@@ -0,0 +1,101 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__MESSAGE_THROTTLE_HPP_
+#define RCLCPP__MESSAGE_THROTTLE_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace rclcpp
+{
+namespace message_throttle
+{
+
+/// Decides which of the received messages of a subscription are kept.
+/**
+ * Only every keep_every-th message is kept, and of those only the ones received at least
+ * min_period after the previous kept one. The decision does not depend on the contents of a
+ * message, so it can be made before the message is taken.
+ *
+ * This class is not thread-safe, the subscription serializes the access to it.
+ */
+class MessageThrottle
+{
+public:
+  MessageThrottle()
+  : min_period_(0), keep_every_(1), received_(0), has_kept_(false)
+  {}
+
+  /// Set the limits, and start over as if no message had been received.
+  /**
+   * \param[in] min_period Minimum time between two kept messages, 0 for no limit.
+   * \param[in] keep_every Keep one of every keep_every messages, 1 to keep all.
+   * \throws std::invalid_argument if min_period is negative or keep_every is 0.
+   */
+  void
+  set_limits(std::chrono::nanoseconds min_period, size_t keep_every)
+  {
+    if (min_period < std::chrono::nanoseconds::zero()) {
+      throw std::invalid_argument("the minimum period between messages must not be negative");
+    }
+    if (keep_every == 0) {
+      throw std::invalid_argument("at least every message must be kept, not every 0th");
+    }
+    min_period_ = min_period;
+    keep_every_ = keep_every;
+    received_ = 0;
+    has_kept_ = false;
+  }
+
+  /// Return whether any message can be discarded.
+  bool
+  is_enabled() const
+  {
+    return min_period_ > std::chrono::nanoseconds::zero() || keep_every_ > 1;
+  }
+
+  /// Decide whether a message received now is kept.
+  /**
+   * \param[in] now The current time.
+   * \return true if the message is kept, false if it is discarded.
+   */
+  bool
+  accept(std::chrono::steady_clock::time_point now)
+  {
+    if (received_++ % keep_every_ != 0) {
+      return false;
+    }
+    if (has_kept_ && now - last_kept_ < min_period_) {
+      return false;
+    }
+    has_kept_ = true;
+    last_kept_ = now;
+    return true;
+  }
+
+private:
+  std::chrono::nanoseconds min_period_;
+  size_t keep_every_;
+  uint64_t received_;
+  bool has_kept_;
+  std::chrono::steady_clock::time_point last_kept_;
+};
+
+}  // namespace message_throttle
+}  // namespace rclcpp
+
+#endif  // RCLCPP__MESSAGE_THROTTLE_HPP_
@@ -15,11 +15,14 @@
 #ifndef RCLCPP__NODE_HPP_
 #define RCLCPP__NODE_HPP_
 
+#include <chrono>
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "rcl/error_handling.h"
@@ -34,10 +37,14 @@
 #include "rclcpp/client.hpp"
 #include "rclcpp/context.hpp"
 #include "rclcpp/macros.hpp"
+#include "rclcpp/mailbox.hpp"
 #include "rclcpp/message_memory_strategy.hpp"
 #include "rclcpp/parameter.hpp"
+#include "rclcpp/parameter_event_coalescer.hpp"
+#include "rclcpp/parameter_snapshot.hpp"
 #include "rclcpp/publisher.hpp"
 #include "rclcpp/service.hpp"
+#include "rclcpp/service_memory_strategy.hpp"
 #include "rclcpp/subscription.hpp"
 #include "rclcpp/timer.hpp"
 #include "rclcpp/visibility_control.hpp"
@@ -73,12 +80,48 @@ public:
    * \param[in] context The context for the node (usually represents the state of a process).
    * \param[in] use_intra_process_comms True to use the optimized intra-process communication
    * pipeline to pass messages between nodes in the same process using shared memory.
+   * \param[in] lightweight True to not give the node a parameter events publisher of its own.
+   * Its parameter events are then published by a publisher shared by the lightweight nodes of
+   * the context, which is created for the first event, so composing many nodes into a process
+   * does not create one publisher for each of them. The shared publisher belongs to an internal
+   * node, so it does not depend on any of the lightweight nodes.
    */
   RCLCPP_PUBLIC
   Node(
     const std::string & node_name, rclcpp::context::Context::SharedPtr context,
+    bool use_intra_process_comms = false, bool lightweight = false);
+
+  /// Create a node which starts with the given parameters.
+  /**
+   * The parameters are stored at once and announced with a single event, which is much faster
+   * than setting them one by one for nodes with many parameters.
+   * If a name is given more than once, the last value is kept; unset parameters are ignored.
+   * \param[in] node_name Name of the node.
+   * \param[in] initial_parameters The parameters of the node.
+   * \param[in] use_intra_process_comms True to use the optimized intra-process communication
+   * pipeline to pass messages between nodes in the same process using shared memory.
+   */
+  RCLCPP_PUBLIC
+  Node(
+    const std::string & node_name,
+    const std::vector<rclcpp::parameter::ParameterVariant> & initial_parameters,
     bool use_intra_process_comms = false);
 
+  /// Create a node with a context which starts with the given parameters.
+  /**
+   * \param[in] node_name Name of the node.
+   * \param[in] context The context for the node (usually represents the state of a process).
+   * \param[in] initial_parameters The parameters of the node, see above.
+   * \param[in] use_intra_process_comms True to use the optimized intra-process communication
+   * pipeline to pass messages between nodes in the same process using shared memory.
+   * \param[in] lightweight True to share the parameter events publisher, see above.
+   */
+  RCLCPP_PUBLIC
+  Node(
+    const std::string & node_name, rclcpp::context::Context::SharedPtr context,
+    const std::vector<rclcpp::parameter::ParameterVariant> & initial_parameters,
+    bool use_intra_process_comms = false, bool lightweight = false);
+
   RCLCPP_PUBLIC
   virtual ~Node();
 
@@ -88,6 +131,11 @@ public:
   const std::string &
   get_name() const;
 
+  /// Get the context of the node.
+  RCLCPP_PUBLIC
+  rclcpp::context::Context::SharedPtr
+  get_context() const;
+
   /// Create and return a callback group.
   RCLCPP_PUBLIC
   rclcpp::callback_group::CallbackGroup::SharedPtr
@@ -170,18 +218,44 @@ public:
     msg_mem_strat = nullptr,
     std::shared_ptr<Alloc> allocator = nullptr);
 
+  /// Create a Subscription which keeps only the latest message of the topic in a mailbox.
+  /**
+   * This is meant for state-style topics, e.g. poses or joint states, which are read less often
+   * than they are published. The history of the subscription is reduced to the last message, so
+   * stale messages are dropped rather than queued, and each message the executor takes or the
+   * intra-process manager delivers is swapped into the mailbox, without copying it.
+   * Any thread can then read the latest message from the mailbox, see mailbox::Mailbox.
+   * \param[in] topic_name The topic to subscribe on.
+   * \param[in] mailbox The mailbox which receives the messages.
+   * \param[in] qos_profile The quality of service profile, of which the history is replaced.
+   * \param[in] group The callback group for this subscription. NULL for no callback group.
+   * \param[in] ignore_local_publications True to ignore local publications.
+   * \return Shared pointer to the created subscription, which must be kept to keep receiving.
+   */
+  template<typename MessageT, typename Alloc = std::allocator<void>>
+  typename rclcpp::subscription::Subscription<MessageT, Alloc>::SharedPtr
+  create_mailbox_subscription(
+    const std::string & topic_name,
+    typename rclcpp::mailbox::Mailbox<MessageT>::SharedPtr mailbox,
+    const rmw_qos_profile_t & qos_profile = rmw_qos_profile_default,
+    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr,
+    bool ignore_local_publications = false);
+
   /// Create a timer.
   /**
    * \param[in] period Time interval between triggers of the callback.
    * \param[in] callback User-defined callback function.
    * \param[in] group Callback group to execute this timer's callback in.
+   * \param[in] slack How late the callback may be triggered, so that the executor can wake up
+   *   once for several timers, see TimerBase::set_slack.
    */
   template<typename CallbackType>
   typename rclcpp::timer::WallTimer<CallbackType>::SharedPtr
   create_wall_timer(
     std::chrono::nanoseconds period,
     CallbackType callback,
-    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr);
+    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr,
+    std::chrono::nanoseconds slack = std::chrono::nanoseconds::zero());
 
   /// Create a timer.
   /**
@@ -200,22 +274,36 @@ public:
   using CallbackGroupWeakPtr = std::weak_ptr<CallbackGroup>;
   using CallbackGroupWeakPtrList = std::list<CallbackGroupWeakPtr>;
 
-  /* Create and return a Client. */
+  /* Create and return a Client.
+   * The responses and request headers it takes are borrowed from mem_strat, or allocated on
+   * demand if it is nullptr.
+   * If request_timeout is not 0, requests which did not get a response within it expire, see
+   * ClientBase::set_request_timeout. They are removed by a timer in the group of the client,
+   * at most half a timeout after their deadline.
+   */
   template<typename ServiceT>
   typename rclcpp::client::Client<ServiceT>::SharedPtr
   create_client(
     const std::string & service_name,
     const rmw_qos_profile_t & qos_profile = rmw_qos_profile_services_default,
-    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr);
+    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr,
+    typename rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::SharedPtr
+    mem_strat = nullptr,
+    std::chrono::nanoseconds request_timeout = std::chrono::nanoseconds::zero());
 
-  /* Create and return a Service. */
+  /* Create and return a Service.
+   * The requests, responses and request headers it uses are borrowed from mem_strat, or
+   * allocated on demand if it is nullptr.
+   */
   template<typename ServiceT, typename CallbackT>
   typename rclcpp::service::Service<ServiceT>::SharedPtr
   create_service(
     const std::string & service_name,
     CallbackT && callback,
     const rmw_qos_profile_t & qos_profile = rmw_qos_profile_services_default,
-    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr);
+    rclcpp::callback_group::CallbackGroup::SharedPtr group = nullptr,
+    typename rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::SharedPtr
+    mem_strat = nullptr);
 
   RCLCPP_PUBLIC
   std::vector<rcl_interfaces::msg::SetParametersResult>
@@ -225,10 +313,48 @@ public:
   rcl_interfaces::msg::SetParametersResult
   set_parameters_atomically(const std::vector<rclcpp::parameter::ParameterVariant> & parameters);
 
+  /// Coalesce the parameter events of this node into one per window.
+  /**
+   * By default, each call setting parameters publishes an event right away.
+   * With a window, the changes are merged, keeping only the final state of each parameter, and
+   * published once per window by a timer of the node, which must be spun for that.
+   * With a window of std::chrono::nanoseconds::max(), there is no timer and the merged changes
+   * are only published by flush_parameter_events, e.g. at the end of a bulk reconfiguration.
+   * Setting a window of zero publishes the pending changes and restores the default.
+   * This must not be called concurrently with itself.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_parameter_event_window(std::chrono::nanoseconds window);
+
+  /// Publish the parameter changes which are pending because of a window, if there are any.
+  RCLCPP_PUBLIC
+  void
+  flush_parameter_events();
+
+  /// Get the parameters with the given names which exist, without taking the lock of the node.
   RCLCPP_PUBLIC
   std::vector<rclcpp::parameter::ParameterVariant>
   get_parameters(const std::vector<std::string> & names) const;
 
+  /// Get all parameters as they were after the last change, without taking the lock of the node.
+  /**
+   * Reading several parameters from one snapshot gives values which were all set at once.
+   */
+  RCLCPP_PUBLIC
+  rclcpp::parameter_snapshot::ParameterSnapshot
+  get_parameters_snapshot() const;
+
+  /// Get a handle which reads a bool, int64_t or double parameter with a single atomic load.
+  /**
+   * This is meant for callbacks on a hot path, e.g. a gain read by a control loop.
+   * The parameter need not exist yet; the handle follows all later changes to it.
+   * \param[in] name The name of the parameter.
+   */
+  template<typename T>
+  rclcpp::parameter_snapshot::ParameterHandle<T>
+  get_parameter_handle(const std::string & name);
+
   RCLCPP_PUBLIC
   std::vector<rcl_interfaces::msg::ParameterDescriptor>
   describe_parameters(const std::vector<std::string> & names) const;
@@ -237,6 +363,7 @@ public:
   std::vector<uint8_t>
   get_parameter_types(const std::vector<std::string> & names) const;
 
+  /// List the parameters below the given prefixes, or all parameters if there are none.
   RCLCPP_PUBLIC
   rcl_interfaces::msg::ListParametersResult
   list_parameters(const std::vector<std::string> & prefixes, uint64_t depth) const;
@@ -253,6 +380,30 @@ public:
   size_t
   count_subscribers(const std::string & topic_name) const;
 
+  /// Block until a topic has at least count publishers, or the timeout passes.
+  /**
+   * The waiting thread sleeps until the graph listener of the context finds the publishers,
+   * see rclcpp::graph_listener::GraphListener.
+   * \param[in] timeout How long to wait at most, a negative timeout waits forever.
+   * \return true if there are enough publishers, false on timeout or shutdown.
+   */
+  RCLCPP_PUBLIC
+  bool
+  wait_for_publishers(
+    const std::string & topic_name, size_t count = 1,
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1)) const;
+
+  /// Block until a topic has at least count subscribers, or the timeout passes.
+  /**
+   * \param[in] timeout How long to wait at most, a negative timeout waits forever.
+   * \return true if there are enough subscribers, false on timeout or shutdown.
+   */
+  RCLCPP_PUBLIC
+  bool
+  wait_for_subscribers(
+    const std::string & topic_name, size_t count = 1,
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1)) const;
+
   RCLCPP_PUBLIC
   const CallbackGroupWeakPtrList &
   get_callback_groups() const;
@@ -269,6 +420,58 @@ private:
   bool
   group_in_node(callback_group::CallbackGroup::SharedPtr group);
 
+  /// Set parameters in place and add them to the event.
+  /**
+   * If setting a parameter throws, all parameters of the range are restored, the event is
+   * left as it was and the exception is rethrown.
+   * mutex_ must be held.
+   */
+  RCLCPP_PUBLIC
+  void
+  apply_parameters(
+    std::vector<rclcpp::parameter::ParameterVariant>::const_iterator first,
+    std::vector<rclcpp::parameter::ParameterVariant>::const_iterator last,
+    rcl_interfaces::msg::ParameterEvent & parameter_event);
+
+  /// Store the initial parameters of the node and publish them in one event.
+  RCLCPP_PUBLIC
+  void
+  load_initial_parameters(const std::vector<rclcpp::parameter::ParameterVariant> & parameters);
+
+  /// The parameter events publisher shared by the lightweight nodes of a context.
+  struct SharedParameterEventsPublisher
+  {
+    /// Serializes the publishing of the lightweight nodes, and protects node.
+    std::mutex mutex;
+    /// Internal node whose own events publisher is shared, it is created for the first event.
+    /**
+     * It has a context of its own, since a node keeps its context alive and the context keeps
+     * this alive.
+     */
+    std::shared_ptr<Node> node;
+  };
+
+  /// Publish a parameter event, with the shared publisher if this node is lightweight.
+  /**
+   * mutex_ must be held.
+   */
+  RCLCPP_PUBLIC
+  void
+  publish_events(std::shared_ptr<rcl_interfaces::msg::ParameterEvent> parameter_event);
+
+  /// Publish the event of a parameter change, or merge it into the pending one.
+  /**
+   * mutex_ must be held.
+   */
+  RCLCPP_PUBLIC
+  void
+  publish_parameter_event(std::shared_ptr<rcl_interfaces::msg::ParameterEvent> parameter_event);
+
+  /// Let the threads waiting for the graph know that an entity was created in this process.
+  RCLCPP_PUBLIC
+  void
+  notify_graph_change();
+
   std::string name_;
 
   std::shared_ptr<rcl_node_t> node_handle_;
@@ -284,15 +487,24 @@ private:
   size_t number_of_clients_;
 
   bool use_intra_process_comms_;
+  bool lightweight_;
 
   mutable std::mutex mutex_;
 
   /// Guard condition for notifying the Executor of changes to this node.
   rcl_guard_condition_t notify_guard_condition_ = rcl_get_zero_initialized_guard_condition();
 
-  std::map<std::string, rclcpp::parameter::ParameterVariant> parameters_;
+  std::unordered_map<std::string, rclcpp::parameter::ParameterVariant> parameters_;
+  /// The names of parameters_, sorted so that the names below a prefix can be listed directly.
+  std::set<std::string> parameter_names_;
+  /// What readers which do not take mutex_ see of parameters_, published after each change.
+  rclcpp::parameter_snapshot::ParameterReadCache parameter_read_cache_;
 
   publisher::Publisher<rcl_interfaces::msg::ParameterEvent>::SharedPtr events_publisher_;
+  std::shared_ptr<SharedParameterEventsPublisher> shared_events_publisher_;
+  std::chrono::nanoseconds parameter_event_window_;
+  rclcpp::timer::TimerBase::SharedPtr parameter_event_timer_;
+  parameter_event_coalescer::ParameterEventCoalescer pending_parameter_event_;
 };
 
 }  // namespace node
@@ -102,6 +102,32 @@ Node::create_publisher(
         throw std::runtime_error(
           "intra process publish called after destruction of intra process manager");
       }
+      using MessageUniquePtr = typename publisher::Publisher<MessageT, Alloc>::MessageUniquePtr;
+      auto & message_type_info = typeid(MessageUniquePtr);
+      if (message_type_info != type_info) {
+        throw std::runtime_error(
+          std::string("published type '") + type_info.name() +
+          "' is incompatible from the publisher type '" + message_type_info.name() + "'");
+      }
+      auto unique_msg_ptr = static_cast<MessageUniquePtr *>(msg);
+      if (!unique_msg_ptr || !*unique_msg_ptr) {
+        throw std::runtime_error("cannot publisher msg which is a null pointer");
+      }
+      // Take over the message along with its deleter.
+      MessageUniquePtr unique_msg = std::move(*unique_msg_ptr);
+      uint64_t message_seq =
+        ipm->store_intra_process_message<MessageT, Alloc>(publisher_id, unique_msg);
+      return message_seq;
+    };
+    auto shared_const_publish_callback =
+      [weak_ipm](uint64_t publisher_id, const std::shared_ptr<const void> & msg,
+        const std::type_info & type_info) -> uint64_t
+    {
+      auto ipm = weak_ipm.lock();
+      if (!ipm) {
+        throw std::runtime_error(
+          "intra process publish called after destruction of intra process manager");
+      }
       if (!msg) {
         throw std::runtime_error("cannot publisher msg which is a null pointer");
       }
@@ -111,24 +137,46 @@ Node::create_publisher(
           std::string("published type '") + type_info.name() +
           "' is incompatible from the publisher type '" + message_type_info.name() + "'");
       }
-      MessageT * typed_message_ptr = static_cast<MessageT *>(msg);
-      using MessageDeleter = typename publisher::Publisher<MessageT, Alloc>::MessageDeleter;
-      std::unique_ptr<MessageT, MessageDeleter> unique_msg(typed_message_ptr);
-      uint64_t message_seq =
-        ipm->store_intra_process_message<MessageT, Alloc>(publisher_id, unique_msg);
-      return message_seq;
+      return ipm->store_intra_process_message<MessageT, Alloc>(
+        publisher_id, std::static_pointer_cast<const MessageT>(msg));
+    };
+    auto count_callback = [weak_ipm](uint64_t publisher_id) -> size_t
+    {
+      auto ipm = weak_ipm.lock();
+      // Without the manager assume there are no intra process subscriptions.
+      return ipm ? ipm->get_subscription_count(publisher_id) : 0;
+    };
+    auto lifespan_callback = [weak_ipm](uint64_t publisher_id, std::chrono::nanoseconds lifespan)
+    {
+      auto ipm = weak_ipm.lock();
+      if (!ipm) {
+        throw std::runtime_error(
+          "intra process lifespan set after destruction of intra process manager");
+      }
+      ipm->set_lifespan(publisher_id, lifespan);
+    };
+    auto evicted_callback = [weak_ipm](uint64_t publisher_id) -> uint64_t
+    {
+      auto ipm = weak_ipm.lock();
+      return ipm ? ipm->get_evicted_count(publisher_id) : 0;
     };
     // *INDENT-ON*
     publisher->setup_intra_process(
       intra_process_publisher_id,
       shared_publish_callback,
-      publisher_options);
+      shared_const_publish_callback,
+      count_callback,
+      publisher_options,
+      intra_process_manager->get_direct_delivery(),
+      lifespan_callback,
+      evicted_callback);
   }
   if (rcl_trigger_guard_condition(&notify_guard_condition_) != RCL_RET_OK) {
     throw std::runtime_error(
             std::string(
               "Failed to notify waitset on publisher creation: ") + rmw_get_error_string());
   }
+  notify_graph_change();
   return publisher;
 }
 
@@ -156,8 +204,9 @@ Node::create_subscription(
     msg_mem_strat =
       rclcpp::message_memory_strategy::MessageMemoryStrategy<MessageT, Alloc>::create_default();
   }
-  auto message_alloc =
-    std::make_shared<typename subscription::Subscription<MessageT, Alloc>::MessageAlloc>();
+  // The rcl subscriptions keep a pointer to this allocator, and it lives as long as the copy of
+  // the callback held by the subscription.
+  auto message_alloc = any_subscription_callback.get_allocator();
 
   auto subscription_options = rcl_subscription_get_default_options();
   subscription_options.qos = qos_profile;
@@ -195,7 +244,8 @@ Node::create_subscription(
         uint64_t publisher_id,
         uint64_t message_sequence,
         uint64_t subscription_id,
-        typename Subscription<MessageT, Alloc>::MessageUniquePtr & message)
+        typename Subscription<MessageT, Alloc>::MessageUniquePtr & message,
+        const typename Subscription<MessageT, Alloc>::MessageFilter & filter)
       {
         auto ipm = weak_ipm.lock();
         if (!ipm) {
@@ -203,9 +253,32 @@ Node::create_subscription(
           throw std::runtime_error(
             "intra process take called after destruction of intra process manager");
         }
+        ipm->take_intra_process_message<MessageT, Alloc>(
+          publisher_id, message_sequence, subscription_id, message, filter);
+      },
+      [weak_ipm](
+        uint64_t publisher_id,
+        uint64_t message_sequence,
+        uint64_t subscription_id,
+        std::shared_ptr<const MessageT> & message)
+      {
+        auto ipm = weak_ipm.lock();
+        if (!ipm) {
+          throw std::runtime_error(
+            "intra process take called after destruction of intra process manager");
+        }
         ipm->take_intra_process_message<MessageT, Alloc>(
           publisher_id, message_sequence, subscription_id, message);
       },
+      [weak_ipm](uint64_t publisher_id, uint64_t message_sequence, uint64_t subscription_id) {
+        auto ipm = weak_ipm.lock();
+        if (!ipm) {
+          throw std::runtime_error(
+            "intra process skip called after destruction of intra process manager");
+        }
+        ipm->skip_intra_process_message<MessageT, Alloc>(
+          publisher_id, message_sequence, subscription_id);
+      },
       [weak_ipm](const rmw_gid_t * sender_gid) -> bool {
         auto ipm = weak_ipm.lock();
         if (!ipm) {
@@ -214,7 +287,8 @@ Node::create_subscription(
         }
         return ipm->matches_any_publishers(sender_gid);
       },
-      intra_process_options
+      intra_process_options,
+      intra_process_manager->get_direct_delivery()
     );
     // *INDENT-ON*
   }
@@ -234,6 +308,7 @@ Node::create_subscription(
             std::string(
               "Failed to notify waitset on subscription creation: ") + rmw_get_error_string());
   }
+  notify_graph_change();
   return sub;
 }
 
@@ -261,15 +336,44 @@ Node::create_subscription(
     allocator);
 }
 
+template<typename MessageT, typename Alloc>
+typename rclcpp::subscription::Subscription<MessageT, Alloc>::SharedPtr
+Node::create_mailbox_subscription(
+  const std::string & topic_name,
+  typename rclcpp::mailbox::Mailbox<MessageT>::SharedPtr mailbox,
+  const rmw_qos_profile_t & qos_profile,
+  rclcpp::callback_group::CallbackGroup::SharedPtr group,
+  bool ignore_local_publications)
+{
+  if (!mailbox) {
+    throw std::invalid_argument("Cannot create mailbox subscription, mailbox is null.");
+  }
+  rmw_qos_profile_t qos = qos_profile;
+  qos.history = RMW_QOS_POLICY_KEEP_LAST_HISTORY;
+  qos.depth = 1;
+  // A callback taking a shared_ptr to const shares the intra-process message instead of copying.
+  auto callback = [mailbox](const std::shared_ptr<const MessageT> message) {
+      mailbox->put(message);
+    };
+  return this->create_subscription<MessageT, decltype(callback), Alloc>(
+    topic_name,
+    std::move(callback),
+    qos,
+    group,
+    ignore_local_publications);
+}
+
 template<typename CallbackType>
 typename rclcpp::timer::WallTimer<CallbackType>::SharedPtr
 Node::create_wall_timer(
   std::chrono::nanoseconds period,
   CallbackType callback,
-  rclcpp::callback_group::CallbackGroup::SharedPtr group)
+  rclcpp::callback_group::CallbackGroup::SharedPtr group,
+  std::chrono::nanoseconds slack)
 {
   auto timer = rclcpp::timer::WallTimer<CallbackType>::make_shared(
     period, std::move(callback));
+  timer->set_slack(slack);
   if (group) {
     if (!group_in_node(group)) {
       // TODO(jacquelinekay): use custom exception
@@ -293,7 +397,10 @@ typename client::Client<ServiceT>::SharedPtr
 Node::create_client(
   const std::string & service_name,
   const rmw_qos_profile_t & qos_profile,
-  rclcpp::callback_group::CallbackGroup::SharedPtr group)
+  rclcpp::callback_group::CallbackGroup::SharedPtr group,
+  typename rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::SharedPtr
+  mem_strat,
+  std::chrono::nanoseconds request_timeout)
 {
   rcl_client_options_t options = rcl_client_get_default_options();
   options.qos = qos_profile;
@@ -301,12 +408,34 @@ Node::create_client(
   using rclcpp::client::Client;
   using rclcpp::client::ClientBase;
 
+  if (!mem_strat) {
+    mem_strat = rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::create_default();
+  }
   auto cli = Client<ServiceT>::make_shared(
     node_handle_,
     service_name,
-    options);
+    options,
+    mem_strat);
 
   auto cli_base_ptr = std::dynamic_pointer_cast<ClientBase>(cli);
+  cli_base_ptr->context_ = context_;
+  // Setup intra process.
+  if (use_intra_process_comms_) {
+    auto intra_process_manager =
+      context_->get_sub_context<rclcpp::intra_process_manager::IntraProcessManager>();
+    rclcpp::intra_process_manager::IntraProcessManager::WeakPtr weak_ipm = intra_process_manager;
+    // *INDENT-OFF*
+    cli->setup_intra_process(
+      [weak_ipm](const std::string & name) -> rclcpp::service::ServiceBase::SharedPtr {
+        auto ipm = weak_ipm.lock();
+        if (!ipm) {
+          // Fall back to rmw, which is still there.
+          return nullptr;
+        }
+        return ipm->get_service(name);
+      });
+    // *INDENT-ON*
+  }
   if (group) {
     if (!group_in_node(group)) {
       // TODO(esteve): use custom exception
@@ -317,6 +446,22 @@ Node::create_client(
     default_callback_group_->add_client(cli_base_ptr);
   }
   number_of_clients_++;
+  if (request_timeout > std::chrono::nanoseconds::zero()) {
+    cli->set_request_timeout(request_timeout);
+    std::weak_ptr<Client<ServiceT>> weak_cli = cli;
+    // The client owns the timer, so it stops with the client.
+    // *INDENT-OFF*
+    cli_base_ptr->expiry_timer_ = create_wall_timer(
+      std::max<std::chrono::nanoseconds>(request_timeout / 2, std::chrono::milliseconds(1)),
+      [weak_cli]() {
+        auto client = weak_cli.lock();
+        if (client) {
+          client->remove_expired_requests();
+        }
+      },
+      group);
+    // *INDENT-ON*
+  }
 
   if (rcl_trigger_guard_condition(&notify_guard_condition_) != RCL_RET_OK) {
     throw std::runtime_error(
@@ -332,7 +477,9 @@ Node::create_service(
   const std::string & service_name,
   CallbackT && callback,
   const rmw_qos_profile_t & qos_profile,
-  rclcpp::callback_group::CallbackGroup::SharedPtr group)
+  rclcpp::callback_group::CallbackGroup::SharedPtr group,
+  typename rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::SharedPtr
+  mem_strat)
 {
   rclcpp::service::AnyServiceCallback<ServiceT> any_service_callback;
   any_service_callback.set(std::forward<CallbackT>(callback));
@@ -340,10 +487,20 @@ Node::create_service(
   rcl_service_options_t service_options = rcl_service_get_default_options();
   service_options.qos = qos_profile;
 
+  if (!mem_strat) {
+    mem_strat = rclcpp::service_memory_strategy::ServiceMemoryStrategy<ServiceT>::create_default();
+  }
   auto serv = service::Service<ServiceT>::make_shared(
     node_handle_,
-    service_name, any_service_callback, service_options);
+    service_name, any_service_callback, service_options, mem_strat);
   auto serv_base_ptr = std::dynamic_pointer_cast<service::ServiceBase>(serv);
+  // Setup intra process.
+  if (use_intra_process_comms_) {
+    auto intra_process_manager =
+      context_->get_sub_context<rclcpp::intra_process_manager::IntraProcessManager>();
+    serv->setup_intra_process();
+    intra_process_manager->add_service(serv_base_ptr);
+  }
   if (group) {
     if (!group_in_node(group)) {
       // TODO(jacquelinekay): use custom exception
@@ -359,9 +516,18 @@ Node::create_service(
             std::string(
               "Failed to notify waitset on service creation: ") + rmw_get_error_string());
   }
+  notify_graph_change();
   return serv;
 }
 
+template<typename T>
+rclcpp::parameter_snapshot::ParameterHandle<T>
+Node::get_parameter_handle(const std::string & name)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return parameter_read_cache_.template get_handle<T>(name, parameters_);
+}
+
 }  // namespace node
 }  // namespace rclcpp
 
@@ -15,7 +15,13 @@
 #ifndef RCLCPP__PARAMETER_CLIENT_HPP_
 #define RCLCPP__PARAMETER_CLIENT_HPP_
 
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "rcl_interfaces/msg/parameter.hpp"
@@ -40,6 +46,9 @@ namespace rclcpp
 namespace parameter_client
 {
 
+// Forward declaration for friend statement
+class SyncParametersClient;
+
 class AsyncParametersClient
 {
 public:
@@ -99,7 +108,74 @@ public:
       "parameter_events", std::forward<CallbackT>(callback), rmw_qos_profile_parameter_events);
   }
 
+  /// Mirror the parameters of the remote node locally.
+  /**
+   * The cache is seeded with a single list_parameters and get_parameters call, after which the
+   * parameter events keep it up to date, so get_cached_parameters is answered locally, without
+   * any service call or spinning.
+   * The node of this client must be spun for the cache to be seeded and updated.
+   * Parameter events do not name the node they come from, so the cache applies all events it
+   * receives; it only mirrors the remote node exactly if no other node on the parameter events
+   * topic sets parameters with the same names.
+   * Enabling and disabling the cache must not be done concurrently with reading from it.
+   * \return A future which is complete once the cache has been seeded, or which holds the
+   *   exception of a failed seed request, e.g. one which timed out.
+   *   To retry after a failure, disable the cache and enable it again.
+   */
+  RCLCPP_PUBLIC
+  std::shared_future<void>
+  enable_parameter_cache();
+
+  /// Stop mirroring the parameters of the remote node and drop the cached values.
+  RCLCPP_PUBLIC
+  void
+  disable_parameter_cache();
+
+  /// Return true if the cache is enabled and has been seeded.
+  RCLCPP_PUBLIC
+  bool
+  is_parameter_cache_ready() const;
+
+  /// Return the cached value of each of the given parameters which is set.
+  /**
+   * \throws std::runtime_error if the cache is not enabled.
+   */
+  RCLCPP_PUBLIC
+  std::vector<rclcpp::parameter::ParameterVariant>
+  get_cached_parameters(const std::vector<std::string> & names) const;
+
+  /// Get the cached value of a parameter.
+  /**
+   * \return true if the parameter is set.
+   * \throws std::runtime_error if the cache is not enabled.
+   */
+  RCLCPP_PUBLIC
+  bool
+  get_cached_parameter(
+    const std::string & name, rclcpp::parameter::ParameterVariant & parameter) const;
+
 private:
+  friend class SyncParametersClient;
+
+  /// Parameters of the remote node, shared with the callbacks which update them.
+  struct ParameterCache
+  {
+    std::mutex mutex;
+    std::unordered_map<std::string, rclcpp::parameter::ParameterVariant> parameters;
+    // Parameters updated by events before the seed arrived, which the seed must not overwrite.
+    std::unordered_set<std::string> updated_while_seeding;
+    bool ready = false;
+    std::promise<void> seeded;
+    std::shared_future<void> seeded_future;
+  };
+
+  RCLCPP_PUBLIC
+  static void
+  seed_parameter_cache(
+    std::shared_ptr<ParameterCache> cache,
+    rclcpp::client::Client<rcl_interfaces::srv::ListParameters>::SharedPtr list_client,
+    rclcpp::client::Client<rcl_interfaces::srv::GetParameters>::SharedPtr get_client);
+
   const rclcpp::node::Node::SharedPtr node_;
   rclcpp::client::Client<rcl_interfaces::srv::GetParameters>::SharedPtr get_parameters_client_;
   rclcpp::client::Client<rcl_interfaces::srv::GetParameterTypes>::SharedPtr
@@ -111,8 +187,20 @@ private:
   rclcpp::client::Client<rcl_interfaces::srv::DescribeParameters>::SharedPtr
     describe_parameters_client_;
   std::string remote_node_name_;
+  std::shared_ptr<ParameterCache> parameter_cache_;
+  rclcpp::subscription::Subscription<rcl_interfaces::msg::ParameterEvent>::SharedPtr
+    parameter_cache_subscription_;
 };
 
+/// Blocking parameter client.
+/**
+ * If the node is not spun by any other executor, it is added to the client's executor for the
+ * duration of each call. If the node is already spun elsewhere, the client's executor only waits
+ * for the response guard condition of the service client, so a call returns as soon as that
+ * other executor delivered the response.
+ * Constructed with a BackgroundExecutor, the node is added to it right away and the calls only
+ * wait for the background thread to deliver the response.
+ */
 class SyncParametersClient
 {
 public:
@@ -127,6 +215,18 @@ public:
     rclcpp::executor::Executor::SharedPtr executor,
     rclcpp::node::Node::SharedPtr node);
 
+  /// Use a background executor, e.g. BackgroundExecutor::get_shared(), to spin the node.
+  /**
+   * \throws std::runtime_error if the node has an executor already.
+   */
+  RCLCPP_PUBLIC
+  SyncParametersClient(
+    rclcpp::executors::BackgroundExecutor::SharedPtr background_executor,
+    rclcpp::node::Node::SharedPtr node);
+
+  RCLCPP_PUBLIC
+  virtual ~SyncParametersClient();
+
   RCLCPP_PUBLIC
   std::vector<rclcpp::parameter::ParameterVariant>
   get_parameters(const std::vector<std::string> & parameter_names);
@@ -157,7 +257,26 @@ public:
   }
 
 private:
+  /// Block until the future of a request of the given client is complete, or rclcpp shut down.
+  // \return true if the future is complete.
+  template<typename FutureT>
+  bool
+  wait_for_future(
+    rclcpp::client::ClientBase::SharedPtr client, std::shared_future<FutureT> & future)
+  {
+    if (background_executor_ || node_->has_executor.load()) {
+      // Another executor spins the node and completes the future.
+      return executor_->spin_until_future_complete(client, future) ==
+             rclcpp::executor::FutureReturnCode::SUCCESS;
+    }
+    executor_->add_node(node_, false);
+    RCLCPP_SCOPE_EXIT(executor_->remove_node(node_, false));
+    return executor_->spin_until_future_complete(future) ==
+           rclcpp::executor::FutureReturnCode::SUCCESS;
+  }
+
   rclcpp::executor::Executor::SharedPtr executor_;
+  rclcpp::executors::BackgroundExecutor::SharedPtr background_executor_;
   rclcpp::node::Node::SharedPtr node_;
   AsyncParametersClient::SharedPtr async_parameters_client_;
 };
@@ -0,0 +1,117 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__PARAMETER_EVENT_COALESCER_HPP_
+#define RCLCPP__PARAMETER_EVENT_COALESCER_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter.hpp"
+#include "rcl_interfaces/msg/parameter_event.hpp"
+
+namespace rclcpp
+{
+namespace parameter_event_coalescer
+{
+
+/// Merge consecutive parameter events into one with the same final state.
+/**
+ * For each parameter, the merged event only reports the difference between before the first
+ * and after the last of the added events: a parameter which was new and then changed is new
+ * with its last value, one which was new and then deleted is not reported at all, and so on.
+ * Parameters are reported in the order they first appeared in.
+ *
+ * This class is not thread-safe.
+ */
+class ParameterEventCoalescer
+{
+public:
+  ParameterEventCoalescer()
+  {}
+
+  /// Merge an event into the pending one.
+  void
+  add(const rcl_interfaces::msg::ParameterEvent & event)
+  {
+    for (auto & parameter : event.new_parameters) {
+      add(parameter, false, true);
+    }
+    for (auto & parameter : event.changed_parameters) {
+      add(parameter, true, true);
+    }
+    for (auto & parameter : event.deleted_parameters) {
+      add(parameter, true, false);
+    }
+  }
+
+  /// Return true if no parameter is pending.
+  bool
+  empty() const
+  {
+    return pending_.empty();
+  }
+
+  /// Move the merged event out, leaving nothing pending.
+  /**
+   * \param[out] event The merged changes are appended to this event.
+   */
+  void
+  take(rcl_interfaces::msg::ParameterEvent & event)
+  {
+    for (auto & pending : pending_) {
+      if (!pending.existed_before && pending.exists_after) {
+        event.new_parameters.push_back(std::move(pending.parameter));
+      } else if (pending.existed_before && pending.exists_after) {
+        event.changed_parameters.push_back(std::move(pending.parameter));
+      } else if (pending.existed_before) {
+        event.deleted_parameters.push_back(std::move(pending.parameter));
+      }
+    }
+    pending_.clear();
+    indices_.clear();
+  }
+
+private:
+  struct PendingParameter
+  {
+    rcl_interfaces::msg::Parameter parameter;
+    bool existed_before;
+    bool exists_after;
+  };
+
+  void
+  add(const rcl_interfaces::msg::Parameter & parameter, bool existed_before, bool exists_after)
+  {
+    auto inserted = indices_.emplace(parameter.name, pending_.size());
+    if (inserted.second) {
+      pending_.push_back(PendingParameter {parameter, existed_before, exists_after});
+    } else {
+      // Whether it existed before is known from the first event of the parameter.
+      PendingParameter & pending = pending_[inserted.first->second];
+      pending.parameter = parameter;
+      pending.exists_after = exists_after;
+    }
+  }
+
+  std::vector<PendingParameter> pending_;
+  std::unordered_map<std::string, size_t> indices_;
+};
+
+}  // namespace parameter_event_coalescer
+}  // namespace rclcpp
+
+#endif  // RCLCPP__PARAMETER_EVENT_COALESCER_HPP_
@@ -0,0 +1,274 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__PARAMETER_SNAPSHOT_HPP_
+#define RCLCPP__PARAMETER_SNAPSHOT_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/parameter.hpp"
+
+namespace rclcpp
+{
+namespace parameter_snapshot
+{
+
+using ParameterMap = std::unordered_map<std::string, parameter::ParameterVariant>;
+
+/// An immutable view of all parameters of a node at one point in time.
+/**
+ * Taking a snapshot does not lock the node, and the snapshot does not change when parameters
+ * are set afterwards, so several parameters read from it are always consistent with each other.
+ */
+class ParameterSnapshot
+{
+public:
+  explicit ParameterSnapshot(std::shared_ptr<const ParameterMap> parameters)
+  : parameters_(std::move(parameters))
+  {}
+
+  /// Get a parameter by name.
+  /**
+   * \param[in] name The name of the parameter.
+   * \param[out] parameter The parameter, if it exists.
+   * \return true if the parameter exists.
+   */
+  bool
+  get_parameter(const std::string & name, parameter::ParameterVariant & parameter) const
+  {
+    auto it = parameters_->find(name);
+    if (it == parameters_->end()) {
+      return false;
+    }
+    parameter = it->second;
+    return true;
+  }
+
+  bool
+  has_parameter(const std::string & name) const
+  {
+    return parameters_->find(name) != parameters_->end();
+  }
+
+  const ParameterMap &
+  get_parameters() const
+  {
+    return *parameters_;
+  }
+
+private:
+  std::shared_ptr<const ParameterMap> parameters_;
+};
+
+/// The parameter type which holds values of type T.
+template<typename T>
+struct ParameterTypeOf;
+
+template<>
+struct ParameterTypeOf<bool>
+{
+  static const parameter::ParameterType value = parameter::ParameterType::PARAMETER_BOOL;
+  static bool get(const parameter::ParameterVariant & parameter) {return parameter.as_bool();}
+};
+
+template<>
+struct ParameterTypeOf<int64_t>
+{
+  static const parameter::ParameterType value = parameter::ParameterType::PARAMETER_INTEGER;
+  static int64_t get(const parameter::ParameterVariant & parameter) {return parameter.as_int();}
+};
+
+template<>
+struct ParameterTypeOf<double>
+{
+  static const parameter::ParameterType value = parameter::ParameterType::PARAMETER_DOUBLE;
+  static double get(const parameter::ParameterVariant & parameter) {return parameter.as_double();}
+};
+
+/// Holds the value of one parameter for readers which must not lock, see ParameterHandle.
+class ParameterCellBase
+{
+public:
+  virtual ~ParameterCellBase()
+  {}
+
+  /// Store the new state of the parameter, nullptr if it does not exist.
+  virtual void
+  update(const parameter::ParameterVariant * parameter) = 0;
+};
+
+template<typename T>
+class ParameterCell : public ParameterCellBase
+{
+public:
+  ParameterCell()
+  : is_set_(false), value_(T())
+  {}
+
+  void
+  update(const parameter::ParameterVariant * parameter)
+  {
+    if (!parameter || parameter->get_type() != ParameterTypeOf<T>::value) {
+      is_set_.store(false, std::memory_order_release);
+      return;
+    }
+    value_.store(ParameterTypeOf<T>::get(*parameter), std::memory_order_relaxed);
+    is_set_.store(true, std::memory_order_release);
+  }
+
+  bool
+  load(T & value) const
+  {
+    if (!is_set_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = value_.load(std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  std::atomic<bool> is_set_;
+  std::atomic<T> value_;
+};
+
+/// Reads one bool, integer or double parameter with an atomic load, e.g. from a control loop.
+/**
+ * The value is updated by the node whenever the parameter is set.
+ */
+template<typename T>
+class ParameterHandle
+{
+  static_assert(
+    std::is_same<T, bool>::value || std::is_same<T, int64_t>::value ||
+    std::is_same<T, double>::value,
+    "parameter handles hold bool, int64_t or double values");
+
+public:
+  ParameterHandle()
+  {}
+
+  explicit ParameterHandle(std::shared_ptr<const ParameterCell<T>> cell)
+  : cell_(std::move(cell))
+  {}
+
+  /// Get the current value.
+  /**
+   * \param[out] value The value, if the parameter is set and of type T.
+   * \return true if the parameter is set and of type T.
+   */
+  bool
+  get(T & value) const
+  {
+    return cell_ && cell_->load(value);
+  }
+
+  /// Get the current value, or the given one if the parameter is not set or of another type.
+  T
+  get_or(T default_value) const
+  {
+    T value;
+    return get(value) ? value : default_value;
+  }
+
+private:
+  std::shared_ptr<const ParameterCell<T>> cell_;
+};
+
+/// What lock-free readers of the parameters of a node see.
+/**
+ * The node updates it after every change, while holding its lock, and readers get snapshots
+ * and handles from it without taking that lock. Every change copies the parameters once, so
+ * this favors nodes whose parameters are read much more often than they are set.
+ * Publishing and creating handles must be serialized by the caller.
+ */
+class ParameterReadCache
+{
+public:
+  ParameterReadCache()
+  : current_(std::make_shared<const ParameterMap>())
+  {}
+
+  /// Get the parameters as of the last publish.
+  ParameterSnapshot
+  get_snapshot() const
+  {
+    return ParameterSnapshot(std::atomic_load(&current_));
+  }
+
+  /// Make the current parameters visible to readers.
+  /**
+   * \param[in] parameters All parameters.
+   * \param[in] changed_names The names of the parameters which may have changed.
+   */
+  void
+  publish(const ParameterMap & parameters, const std::vector<std::string> & changed_names)
+  {
+    std::shared_ptr<const ParameterMap> next = std::make_shared<const ParameterMap>(parameters);
+    std::atomic_store(&current_, next);
+    if (cells_.empty()) {
+      return;
+    }
+    for (auto & name : changed_names) {
+      auto cells = cells_.find(name);
+      if (cells == cells_.end()) {
+        continue;
+      }
+      auto it = parameters.find(name);
+      const parameter::ParameterVariant * parameter =
+        it != parameters.end() ? &it->second : nullptr;
+      for (auto & cell : cells->second) {
+        cell->update(parameter);
+      }
+    }
+  }
+
+  /// Get a handle to a parameter, which need not exist yet.
+  /**
+   * \param[in] name The name of the parameter.
+   * \param[in] parameters All current parameters, to initialize the handle.
+   */
+  template<typename T>
+  ParameterHandle<T>
+  get_handle(const std::string & name, const ParameterMap & parameters)
+  {
+    auto & cells = cells_[name];
+    for (auto & cell : cells) {
+      auto typed_cell = std::dynamic_pointer_cast<ParameterCell<T>>(cell);
+      if (typed_cell) {
+        return ParameterHandle<T>(typed_cell);
+      }
+    }
+    auto typed_cell = std::make_shared<ParameterCell<T>>();
+    auto it = parameters.find(name);
+    typed_cell->update(it != parameters.end() ? &it->second : nullptr);
+    cells.push_back(typed_cell);
+    return ParameterHandle<T>(typed_cell);
+  }
+
+private:
+  std::shared_ptr<const ParameterMap> current_;
+  std::unordered_map<std::string, std::vector<std::shared_ptr<ParameterCellBase>>> cells_;
+};
+
+}  // namespace parameter_snapshot
+}  // namespace rclcpp
+
+#endif  // RCLCPP__PARAMETER_SNAPSHOT_HPP_
@@ -0,0 +1,281 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__PENDING_REQUEST_TABLE_HPP_
+#define RCLCPP__PENDING_REQUEST_TABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rclcpp
+{
+namespace pending_request_table
+{
+
+/// Table of the requests of a client which are waiting for a response, by sequence number.
+/**
+ * Sequence numbers are assigned in increasing order, so the entries are kept in a ring of
+ * slots indexed by the sequence number modulo the capacity, which is a power of two.
+ * Adding and taking an entry is then a single slot access.
+ * When a new sequence number lands on the slot of an older entry, the ring doubles if at
+ * least half of its slots are used. Otherwise the older entry, e.g. of a request whose
+ * response was lost, is moved to an overflow map, so a few stragglers cannot make the ring
+ * grow without bound: the capacity stays below twice the largest number of entries held at
+ * once, or the initial capacity.
+ * Entries are moved in and out of the table, they are never copied.
+ *
+ * Each entry has a deadline, after which remove_expired moves it out.
+ * Deadlines are in nanoseconds on any clock, as long as the same clock is used throughout.
+ *
+ * This class is not thread-safe, the client serializes the access to it.
+ */
+template<typename T>
+class PendingRequestTable
+{
+public:
+  /// Deadline of an entry which never expires.
+  static const int64_t no_deadline = std::numeric_limits<int64_t>::max();
+
+  /// Constructor.
+  /**
+   * \param[in] initial_capacity Number of slots to start with, rounded up to a power of two.
+   */
+  explicit PendingRequestTable(size_t initial_capacity = 16)
+  : size_(0), next_deadline_(no_deadline)
+  {
+    size_t capacity = 1;
+    while (capacity < initial_capacity) {
+      capacity *= 2;
+    }
+    slots_.resize(capacity);
+  }
+
+  /// Add an entry for a sequence number.
+  /**
+   * \param[in] sequence_number The sequence number of the request.
+   * \param[in] deadline Time after which the entry expires, or no_deadline.
+   * \param[in] value The entry, which is moved into the table.
+   * \throws std::invalid_argument if there is an entry for the sequence number already.
+   */
+  void
+  insert(int64_t sequence_number, int64_t deadline, T && value)
+  {
+    if (!overflow_.empty() && overflow_.count(sequence_number) != 0) {
+      throw std::invalid_argument("sequence number is pending already");
+    }
+    while (slot_for(sequence_number).used) {
+      Slot & used_slot = slot_for(sequence_number);
+      if (used_slot.sequence_number == sequence_number) {
+        throw std::invalid_argument("sequence number is pending already");
+      }
+      if (2 * size_ >= slots_.size()) {
+        grow(2 * slots_.size());
+      } else {
+        // Keep the older entry aside rather than growing for it.
+        overflow_[used_slot.sequence_number] = std::move(used_slot);
+        used_slot.used = false;
+        used_slot.value = T();
+      }
+    }
+    Slot & slot = slot_for(sequence_number);
+    slot.used = true;
+    slot.sequence_number = sequence_number;
+    slot.deadline = deadline;
+    slot.value = std::move(value);
+    ++size_;
+    if (deadline < next_deadline_) {
+      next_deadline_ = deadline;
+    }
+  }
+
+  /// Move the entry of a sequence number out of the table.
+  /**
+   * \param[in] sequence_number The sequence number of the response.
+   * \param[out] value The entry, if there was one.
+   * \return true if there was an entry for the sequence number.
+   */
+  bool
+  take(int64_t sequence_number, T & value)
+  {
+    Slot & slot = slot_for(sequence_number);
+    if (slot.used && slot.sequence_number == sequence_number) {
+      value = std::move(slot.value);
+      release(slot);
+      return true;
+    }
+    if (overflow_.empty()) {
+      return false;
+    }
+    auto it = overflow_.find(sequence_number);
+    if (it == overflow_.end()) {
+      return false;
+    }
+    value = std::move(it->second.value);
+    overflow_.erase(it);
+    --size_;
+    return true;
+  }
+
+  /// Return whether there is an entry for a sequence number.
+  bool
+  contains(int64_t sequence_number) const
+  {
+    const Slot & slot =
+      slots_[static_cast<uint64_t>(sequence_number) & (slots_.size() - 1)];
+    if (slot.used && slot.sequence_number == sequence_number) {
+      return true;
+    }
+    return !overflow_.empty() && overflow_.count(sequence_number) != 0;
+  }
+
+  /// Move all entries whose deadline has passed out of the table.
+  /**
+   * This scans the slots and the overflow map, but only once the earliest deadline passed.
+   * \param[in] now The current time, on the clock of the deadlines.
+   * \param[out] expired The expired entries are appended to this.
+   * \return The number of expired entries.
+   */
+  size_t
+  remove_expired(int64_t now, std::vector<T> & expired)
+  {
+    if (now < next_deadline_) {
+      return 0;
+    }
+    size_t count = 0;
+    int64_t next_deadline = no_deadline;
+    for (auto & slot : slots_) {
+      if (!slot.used) {
+        continue;
+      }
+      if (slot.deadline <= now) {
+        expired.push_back(std::move(slot.value));
+        release(slot);
+        ++count;
+      } else if (slot.deadline < next_deadline) {
+        next_deadline = slot.deadline;
+      }
+    }
+    for (auto it = overflow_.begin(); it != overflow_.end(); ) {
+      if (it->second.deadline <= now) {
+        expired.push_back(std::move(it->second.value));
+        it = overflow_.erase(it);
+        --size_;
+        ++count;
+      } else {
+        if (it->second.deadline < next_deadline) {
+          next_deadline = it->second.deadline;
+        }
+        ++it;
+      }
+    }
+    next_deadline_ = next_deadline;
+    return count;
+  }
+
+  /// Grow the table to at least the given number of slots.
+  /**
+   * Sequence numbers are only guaranteed a free slot while they are consecutive, so this
+   * avoids most, but not all, growth while the entries are fewer than half the slots.
+   * \param[in] capacity The number of slots, rounded up to a power of two.
+   */
+  void
+  reserve(size_t capacity)
+  {
+    if (capacity > slots_.size()) {
+      grow(capacity);
+    }
+  }
+
+  /// Return the number of entries in the table.
+  size_t
+  size() const
+  {
+    return size_;
+  }
+
+  /// Return the number of slots of the table.
+  size_t
+  capacity() const
+  {
+    return slots_.size();
+  }
+
+private:
+  struct Slot
+  {
+    Slot()
+    : used(false), sequence_number(0), deadline(no_deadline)
+    {}
+
+    bool used;
+    int64_t sequence_number;
+    int64_t deadline;
+    T value;
+  };
+
+  Slot &
+  slot_for(int64_t sequence_number)
+  {
+    return slots_[static_cast<uint64_t>(sequence_number) & (slots_.size() - 1)];
+  }
+
+  void
+  release(Slot & slot)
+  {
+    slot.used = false;
+    // Release what the entry holds now rather than when the slot is reused.
+    slot.value = T();
+    --size_;
+  }
+
+  /// Double the capacity until there are at least the given number of slots.
+  /**
+   * Entries in distinct slots stay in distinct slots when the capacity doubles.
+   * \param[in] min_capacity The number of slots to reach.
+   */
+  void
+  grow(size_t min_capacity)
+  {
+    size_t capacity = slots_.size();
+    while (capacity < min_capacity) {
+      capacity *= 2;
+    }
+    std::vector<Slot> slots(capacity);
+    for (auto & slot : slots_) {
+      if (slot.used) {
+        slots[static_cast<uint64_t>(slot.sequence_number) & (capacity - 1)] = std::move(slot);
+      }
+    }
+    slots_.swap(slots);
+  }
+
+  std::vector<Slot> slots_;
+  /// Entries moved out of the ring by a newer sequence number, see insert.
+  std::unordered_map<int64_t, Slot> overflow_;
+  size_t size_;
+  int64_t next_deadline_;
+};
+
+template<typename T>
+const int64_t PendingRequestTable<T>::no_deadline;
+
+}  // namespace pending_request_table
+}  // namespace rclcpp
+
+#endif  // RCLCPP__PENDING_REQUEST_TABLE_HPP_
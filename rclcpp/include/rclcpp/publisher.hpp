@@ -18,11 +18,17 @@
 #include <rmw/error_handling.h>
 #include <rmw/rmw.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 #include "rcl/error_handling.h"
 #include "rcl/publisher.h"
@@ -32,7 +38,10 @@
 
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/allocator/allocator_deleter.hpp"
+#include "rclcpp/intra_process_batching.hpp"
+#include "rclcpp/loaned_message.hpp"
 #include "rclcpp/macros.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/type_support_decl.hpp"
 #include "rclcpp/visibility_control.hpp"
 
@@ -113,15 +122,134 @@ public:
   bool
   operator==(const rmw_gid_t * gid) const;
 
+  /// Stores a published message, given as a pointer to the std::unique_ptr owning the message.
+  /* The void * is a std::unique_ptr<MessageT, MessageDeleter> * and the type_info is the one of
+   * that std::unique_ptr type. The callback moves the message out of it together with its
+   * deleter, so that it can be given back the same way it was allocated.
+   * This used to be the raw message pointer, released from its unique_ptr; callbacks which
+   * cast it to a message need to be changed to take it from the unique_ptr instead.
+   */
   typedef std::function<uint64_t(uint64_t, void *, const std::type_info &)> StoreMessageCallbackT;
+  typedef std::function<
+      uint64_t(uint64_t, const std::shared_ptr<const void> &, const std::type_info &)
+    > StoreSharedMessageCallbackT;
+  /// Returns the number of intra process subscriptions for the given intra process publisher id.
+  typedef std::function<size_t(uint64_t)> CountSubscriptionsCallbackT;
+  /// Sets the lifespan of the intra process messages of the given intra process publisher id.
+  typedef std::function<void(uint64_t, std::chrono::nanoseconds)> SetLifespanCallbackT;
+  /// Returns the number of evicted intra process messages of the given intra process publisher id.
+  typedef std::function<uint64_t(uint64_t)> CountEvictedCallbackT;
+
+  /// Set whether messages are only published inter process if there are other subscriptions.
+  /**
+   * When intra process communication is used, subscriptions of the same process receive the
+   * messages through the intra process manager and ignore the inter process copy.
+   * If enabled, publishing inter process is skipped unless the middleware knows of more
+   * subscriptions on the topic than there are intra process subscriptions.
+   * This is disabled by default and only meant for topics which are known to be local: a
+   * remote subscription misses the messages published until the middleware discovered it, and
+   * since the result is reused for the given period, for up to that period afterwards.
+   * \param[in] enabled If true, the inter process publish may be skipped as described.
+   * \param[in] check_period How long the number of subscriptions is cached.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_skip_inter_process_publish(
+    bool enabled,
+    std::chrono::nanoseconds check_period = std::chrono::milliseconds(100));
+
+  /// Return true if published messages have to be sent inter process, see above.
+  RCLCPP_PUBLIC
+  bool
+  needs_inter_process_publish();
+
+  /// Announce published messages to intra process subscriptions in batches.
+  /**
+   * Unless intra process messages are delivered directly (see
+   * IntraProcessManager::set_direct_delivery), every published message is announced to the
+   * intra process subscriptions by a notification on the intra process topic, which costs a
+   * middleware write per message.
+   * With batching, a single notification announces all messages published since the previous
+   * one, and the subscriptions take all of them in one execution. The notification is
+   * published once max_messages messages are pending, or by the first publish after max_delay
+   * has passed since the oldest pending message was published.
+   * Since the delay is only checked when publishing, call flush_intra_process_notifications,
+   * e.g. from a timer, to bound the latency of the last messages of a burst.
+   *
+   * Messages to inter process subscriptions are not batched, each is published on its own.
+   * \param[in] max_messages Maximum number of messages per notification, 1 disables batching.
+   * \param[in] max_delay Maximum time a message waits for its notification, see above.
+   * \throws std::invalid_argument if max_messages is 0, or larger than the queue size, since
+   *   the publisher only keeps that many messages for the intra process subscriptions.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_intra_process_notification_batching(
+    size_t max_messages,
+    std::chrono::nanoseconds max_delay = std::chrono::milliseconds(10));
+
+  /// Get the maximum number of messages per intra process notification, 1 without batching.
+  RCLCPP_PUBLIC
+  size_t
+  get_intra_process_notification_batch_size() const;
+
+  /// Publish the notification of the pending intra process messages, if there are any.
+  RCLCPP_PUBLIC
+  void
+  flush_intra_process_notifications();
+
+  /// Release the intra process messages of this publisher which are not taken within lifespan.
+  /**
+   * Messages are otherwise kept for the intra process subscriptions until all of them took
+   * them or they are displaced by newer ones, which for large messages and deep queues can
+   * pin a lot of memory. Expired messages are skipped by the subscriptions.
+   * See IntraProcessManager::set_lifespan for when they are released.
+   * \param[in] lifespan How long messages are kept, zero to keep them until they are displaced.
+   * \throws std::invalid_argument if lifespan is negative.
+   * \throws std::runtime_error if the publisher does not use intra process communication.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_intra_process_lifespan(std::chrono::nanoseconds lifespan);
+
+  /// Get the number of intra process messages which were released before they were taken.
+  RCLCPP_PUBLIC
+  uint64_t
+  get_intra_process_evicted_count() const;
 
 protected:
+  /// Set up intra process publishing.
+  /**
+   * \param[in] intra_process_publisher_id The id assigned by the intra process manager.
+   * \param[in] callback Function storing a published message in the intra process manager.
+   * \param[in] shared_callback Function storing a shared, immutable published message.
+   * \param[in] count_callback Function counting the intra process subscriptions.
+   * \param[in] intra_process_options Options for the intra process notification publisher.
+   * \param[in] direct_delivery If true, the intra process manager notifies the subscriptions
+   *   itself and no notification is published on the intra process topic.
+   * \param[in] lifespan_callback Function setting the lifespan of the stored messages.
+   * \param[in] evicted_callback Function counting the evicted messages.
+   */
   RCLCPP_PUBLIC
   void
   setup_intra_process(
     uint64_t intra_process_publisher_id,
     StoreMessageCallbackT callback,
-    const rcl_publisher_options_t & intra_process_options);
+    StoreSharedMessageCallbackT shared_callback,
+    CountSubscriptionsCallbackT count_callback,
+    const rcl_publisher_options_t & intra_process_options,
+    bool direct_delivery = false,
+    SetLifespanCallbackT lifespan_callback = nullptr,
+    CountEvictedCallbackT evicted_callback = nullptr);
+
+  /// Publish the notification for a stored message on the intra process topic, if one is used.
+  /**
+   * With batching, the notification may be deferred, see
+   * set_intra_process_notification_batching.
+   */
+  RCLCPP_PUBLIC
+  void
+  publish_intra_process_notification(uint64_t message_seq);
 
   std::shared_ptr<rcl_node_t> node_handle_;
 
@@ -134,9 +262,28 @@ protected:
 
   uint64_t intra_process_publisher_id_;
   StoreMessageCallbackT store_intra_process_message_;
+  StoreSharedMessageCallbackT store_shared_intra_process_message_;
+  CountSubscriptionsCallbackT count_intra_process_subscriptions_;
+  SetLifespanCallbackT set_intra_process_lifespan_;
+  CountEvictedCallbackT count_intra_process_evicted_;
+  bool intra_process_direct_delivery_;
 
   rmw_gid_t rmw_gid_;
   rmw_gid_t intra_process_rmw_gid_;
+
+  std::atomic_bool skip_inter_process_publish_;
+  std::atomic<int64_t> inter_process_check_period_ns_;
+  /// Time of the last check of the inter process subscriptions, 0 if there was none.
+  std::atomic<int64_t> last_inter_process_check_ns_;
+  std::atomic_bool has_inter_process_subscriptions_;
+
+  std::atomic_bool batch_intra_process_notifications_;
+  mutable std::mutex notification_batcher_mutex_;
+  intra_process_batching::NotificationBatcher notification_batcher_;
+
+private:
+  void
+  do_publish_intra_process_notification(uint64_t message_seq);
 };
 
 /// A publisher publishes messages of any type to a topic.
@@ -150,6 +297,8 @@ public:
   using MessageAlloc = typename MessageAllocTraits::allocator_type;
   using MessageDeleter = allocator::Deleter<MessageAlloc, MessageT>;
   using MessageUniquePtr = std::unique_ptr<MessageT, MessageDeleter>;
+  using LoanedMessage = loaned_message::LoanedMessage<MessageT>;
+  using LoanedMessagePool = loaned_message::LoanedMessagePool<MessageT, MessageAlloc>;
 
   RCLCPP_SMART_PTR_DEFINITIONS(Publisher<MessageT, Alloc>);
 
@@ -215,33 +364,39 @@ public:
   {
     this->do_inter_process_publish(msg.get());
     if (store_intra_process_message_) {
-      // Take the pointer from the unique_msg, release it and pass as a void *
-      // to the ipm. The ipm should then capture it again as a unique_ptr of
-      // the correct type.
-      // TODO(wjwwood):
-      //   investigate how to transfer the custom deleter (if there is one)
-      //   from the incoming unique_ptr through to the ipm's unique_ptr.
-      //   See: http://stackoverflow.com/questions/11002641/dynamic-casting-for-unique-ptr
-      MessageT * msg_ptr = msg.get();
-      msg.release();
-      uint64_t message_seq =
-        store_intra_process_message_(intra_process_publisher_id_, msg_ptr, typeid(MessageT));
-      rcl_interfaces::msg::IntraProcessMessage ipm;
-      ipm.publisher_id = intra_process_publisher_id_;
-      ipm.message_sequence = message_seq;
-      auto status = rcl_publish(&intra_process_publisher_handle_, &ipm);
-      if (status != RCL_RET_OK) {
-        // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
-        throw std::runtime_error(
-          std::string("failed to publish intra process message: ") + rcl_get_error_string_safe());
-        // *INDENT-ON*
-      }
+      // Pass the unique_ptr itself as a void * to the ipm, which moves the message
+      // out of it, along with its deleter, into a unique_ptr of the same type.
+      uint64_t message_seq = store_intra_process_message_(
+        intra_process_publisher_id_, &msg, typeid(MessageUniquePtr));
+      this->publish_intra_process_notification(message_seq);
     } else {
       // Always destroy the message, even if we don't consume it, for consistency.
       msg.reset();
     }
   }
 
+  /// Send a message which is released through a custom deleter to the topic for this publisher.
+  /**
+   * This can be used to publish messages which are e.g. taken from a pool, without copying
+   * them for intra process subscriptions.
+   * The message is shared with intra process subscriptions which take it as a shared_ptr to
+   * const, the other ones get a copy.
+   * It is released through its deleter once the last intra process user of it is done.
+   * \param[in] msg A unique pointer to the message to send.
+   */
+  template<typename Deleter>
+  typename std::enable_if<!std::is_same<Deleter, MessageDeleter>::value>::type
+  publish(std::unique_ptr<MessageT, Deleter> & msg)
+  {
+    if (!store_intra_process_message_) {
+      this->do_inter_process_publish(msg.get());
+      msg.reset();
+      return;
+    }
+    // The shared_ptr keeps the deleter, the message can't be stored in the ring buffer as is.
+    this->publish(std::shared_ptr<const MessageT>(std::move(msg)));
+  }
+
   void
   publish(const std::shared_ptr<MessageT> & msg)
   {
@@ -264,20 +419,16 @@ public:
   void
   publish(std::shared_ptr<const MessageT> msg)
   {
-    // Avoid allocating when not using intra process.
+    this->do_inter_process_publish(msg.get());
     if (!store_intra_process_message_) {
       // In this case we're not using intra process.
-      return this->do_inter_process_publish(msg.get());
+      return;
     }
-    // Otherwise we have to allocate memory in a unique_ptr and pass it along.
-    // TODO(wjwwood):
-    //   The intra process manager should probably also be able to store
-    //   shared_ptr's and do the "smart" thing based on other intra process
-    //   subscriptions. For now call the other publish().
-    auto ptr = MessageAllocTraits::allocate(*message_allocator_.get(), 1);
-    MessageAllocTraits::construct(*message_allocator_.get(), ptr, *msg.get());
-    MessageUniquePtr unique_msg(ptr, message_deleter_);
-    return this->publish(unique_msg);
+    // The message cannot change anymore, so the intra process manager can share it with the
+    // subscriptions instead of storing a copy.
+    uint64_t message_seq = store_shared_intra_process_message_(
+      intra_process_publisher_id_, msg, typeid(MessageT));
+    this->publish_intra_process_notification(message_seq);
   }
 
   void
@@ -295,6 +446,46 @@ public:
     return this->publish(unique_msg);
   }
 
+  /// Borrow a message from this publisher's pool, to be published with publish(LoanedMessage &).
+  /**
+   * The pool is created on the first call, with one message more than the queue size,
+   * since that many messages can be stored for intra process subscriptions while the next
+   * one is being filled.
+   * It grows if more messages are in use, e.g. because subscriptions keep them.
+   * The message keeps the contents it had when it was last published.
+   * \return The borrowed message.
+   */
+  LoanedMessage
+  borrow_loaned_message()
+  {
+    // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+    std::call_once(loaned_message_pool_once_, [this]() {
+      loaned_message_pool_ = LoanedMessagePool::make_shared(queue_size_ + 1, message_allocator_);
+    });
+    // *INDENT-ON*
+    return loaned_message_pool_->borrow_message();
+  }
+
+  /// Send a message borrowed from this publisher to the topic.
+  /**
+   * The message is not copied for intra process subscriptions which take it as a shared_ptr
+   * to const, and it goes back to the pool once it is not used anymore.
+   * Recycling the message does not allocate memory, and neither does storing it for intra
+   * process subscriptions in the default mapped ring buffer. Publishing may still allocate:
+   * the rmw implementation may do so when it publishes the message and the intra process
+   * notification, subscriptions which need ownership of the message get a copy, and a
+   * MappedRingBufferType::SharedEntry buffer allocates an entry for every stored message.
+   * \param[in] msg The borrowed message, which is empty afterwards.
+   */
+  void
+  publish(LoanedMessage & msg)
+  {
+    if (!msg) {
+      throw std::runtime_error("cannot publish an empty loaned message");
+    }
+    this->publish(msg.release());
+  }
+
   std::shared_ptr<MessageAlloc> get_allocator() const
   {
     return message_allocator_;
@@ -304,6 +495,11 @@ protected:
   void
   do_inter_process_publish(const MessageT * msg)
   {
+    RCLCPP_TRACEPOINT(publish, static_cast<const void *>(&publisher_handle_),
+      static_cast<const void *>(msg));
+    if (!this->needs_inter_process_publish()) {
+      return;
+    }
     auto status = rcl_publish(&publisher_handle_, msg);
     if (status != RCL_RET_OK) {
       // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
@@ -316,6 +512,9 @@ protected:
   std::shared_ptr<MessageAlloc> message_allocator_;
 
   MessageDeleter message_deleter_;
+
+  std::once_flag loaned_message_pool_once_;
+  typename LoanedMessagePool::SharedPtr loaned_message_pool_;
 };
 
 }  // namespace publisher
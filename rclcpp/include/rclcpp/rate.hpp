@@ -16,6 +16,7 @@
 #define RCLCPP__RATE_HPP_
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <thread>
 
@@ -42,6 +43,37 @@ using std::chrono::duration;
 using std::chrono::duration_cast;
 using std::chrono::nanoseconds;
 
+/// How late the sleeps of a rate ended, since its creation or the last reset_statistics.
+struct RateStatistics
+{
+  RateStatistics()
+  : cycles(0), missed_cycles(0),
+    min_overshoot(nanoseconds::max()), max_overshoot(nanoseconds::zero()),
+    total_overshoot(nanoseconds::zero())
+  {}
+
+  /// Return the mean overshoot of the cycles which were not missed.
+  nanoseconds
+  mean_overshoot() const
+  {
+    uint64_t slept = cycles - missed_cycles;
+    if (slept == 0) {
+      return nanoseconds::zero();
+    }
+    return total_overshoot / static_cast<nanoseconds::rep>(slept);
+  }
+
+  /// Number of calls to sleep.
+  uint64_t cycles;
+  /// Number of calls to sleep which came after the end of the cycle, so did not sleep.
+  uint64_t missed_cycles;
+  /// Time from the end of the cycle to the end of the sleep, for the cycles which slept.
+  // min_overshoot is nanoseconds::max() until a cycle has slept.
+  nanoseconds min_overshoot;
+  nanoseconds max_overshoot;
+  nanoseconds total_overshoot;
+};
+
 template<class Clock = std::chrono::high_resolution_clock>
 class GenericRate : public RateBase
 {
@@ -53,7 +85,7 @@ public:
       duration_cast<nanoseconds>(duration<double>(1.0 / rate)))
   {}
   explicit GenericRate(std::chrono::nanoseconds period)
-  : period_(period), last_interval_(Clock::now())
+  : period_(period), precision_margin_(nanoseconds::zero()), last_interval_(Clock::now())
   {}
 
   virtual bool
@@ -72,8 +104,10 @@ public:
     auto time_to_sleep = next_interval - now;
     // Update the interval
     last_interval_ += period_;
+    ++statistics_.cycles;
     // If the time_to_sleep is negative or zero, don't sleep
     if (time_to_sleep <= std::chrono::seconds(0)) {
+      ++statistics_.missed_cycles;
       // If an entire cycle was missed then reset next interval.
       // This might happen if the loop took more than a cycle.
       // Or if time jumps forward.
@@ -84,10 +118,55 @@ public:
       return false;
     }
     // Sleep (will get interrupted by ctrl-c, may not sleep full time)
-    rclcpp::utilities::sleep_for(time_to_sleep);
+    if (precision_margin_ <= nanoseconds::zero()) {
+      rclcpp::utilities::sleep_for(time_to_sleep);
+    } else {
+      // Waking up from a sleep takes longer than the margin at most, spin for the rest of it.
+      if (time_to_sleep > precision_margin_) {
+        rclcpp::utilities::sleep_for(time_to_sleep - precision_margin_);
+      }
+      while (Clock::now() < next_interval && rclcpp::utilities::ok()) {
+      }
+    }
+    record_overshoot(Clock::now() - next_interval);
     return true;
   }
 
+  /// Sleep until a margin before the end of the cycle, then busy wait until its end.
+  /**
+   * Waking up from a sleep can take a lot longer than the deadline, more than the period of
+   * fast loops, while busy waiting ends right at the deadline, at the cost of a core.
+   * The margin is the longest a sleep may take to end, e.g. 100 microseconds on a stock kernel.
+   * The default margin of zero only sleeps.
+   */
+  void
+  set_precision_margin(std::chrono::nanoseconds margin)
+  {
+    precision_margin_ = margin;
+  }
+
+  std::chrono::nanoseconds
+  get_precision_margin() const
+  {
+    return precision_margin_;
+  }
+
+  /// Return how late the sleeps have ended.
+  /**
+   * Like sleep, this must not be called concurrently with the other functions of the rate.
+   */
+  const RateStatistics &
+  get_statistics() const
+  {
+    return statistics_;
+  }
+
+  void
+  reset_statistics()
+  {
+    statistics_ = RateStatistics();
+  }
+
   virtual bool
   is_steady() const
   {
@@ -108,7 +187,25 @@ public:
 private:
   RCLCPP_DISABLE_COPY(GenericRate);
 
+  void
+  record_overshoot(nanoseconds overshoot)
+  {
+    // A sleep interrupted by ctrl-c ends early, which is not an overshoot.
+    if (overshoot < nanoseconds::zero()) {
+      overshoot = nanoseconds::zero();
+    }
+    if (overshoot < statistics_.min_overshoot) {
+      statistics_.min_overshoot = overshoot;
+    }
+    if (overshoot > statistics_.max_overshoot) {
+      statistics_.max_overshoot = overshoot;
+    }
+    statistics_.total_overshoot += overshoot;
+  }
+
   std::chrono::nanoseconds period_;
+  std::chrono::nanoseconds precision_margin_;
+  RateStatistics statistics_;
   using ClockDurationNano = std::chrono::duration<typename Clock::rep, std::nano>;
   std::chrono::time_point<Clock, ClockDurationNano> last_interval_;
 };
@@ -19,13 +19,16 @@
 #include <memory>
 
 #include "rclcpp/executors.hpp"
+#include "rclcpp/graph_listener.hpp"
 #include "rclcpp/node.hpp"
 #include "rclcpp/parameter.hpp"
 #include "rclcpp/parameter_client.hpp"
 #include "rclcpp/parameter_service.hpp"
 #include "rclcpp/rate.hpp"
+#include "rclcpp/statistics_publisher.hpp"
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/visibility_control.hpp"
+#include "rclcpp/wait_set.hpp"
 
 // NOLINTNEXTLINE(runtime/int)
 inline const std::chrono::seconds operator"" _s(unsigned long long s)
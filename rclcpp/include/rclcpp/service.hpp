@@ -15,17 +15,25 @@
 #ifndef RCLCPP__SERVICE_HPP_
 #define RCLCPP__SERVICE_HPP_
 
+#include <deque>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #include "rcl/error_handling.h"
+#include "rcl/guard_condition.h"
 #include "rcl/service.h"
 
 #include "rclcpp/any_service_callback.hpp"
+#include "rclcpp/deferred_request_table.hpp"
 #include "rclcpp/macros.hpp"
+#include "rclcpp/service_memory_strategy.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/type_support_decl.hpp"
 #include "rclcpp/visibility_control.hpp"
 #include "rmw/error_handling.h"
@@ -57,11 +65,79 @@ public:
   const rcl_service_t *
   get_service_handle();
 
+  /// A request handed over by a client in the same process, without going through rmw.
+  struct IntraProcessRequest
+  {
+    /// The request, shared with the client rather than copied.
+    std::shared_ptr<void> request;
+    /// Sequence number passed to the callback in the request header.
+    int64_t sequence_number;
+    /// Called with the response once the request has been handled, or with the exception the
+    /// callback of the service threw instead. Called from the thread handling the request, it
+    /// is up to the client to hand the response over to its own executor.
+    std::function<void(std::shared_ptr<void>, std::exception_ptr)> respond;
+    /// Returns false once the client stopped waiting for the response, e.g. because the request
+    /// expired, so that a service deferring its response can drop the request.
+    std::function<bool()> is_pending;
+  };
+
+  /// Get the guard condition signaling queued intra process requests.
+  /**
+   * Executors wait on this guard condition next to the service handle, see
+   * add_intra_process_request.
+   * \return The guard condition, or nullptr if intra process requests are not enabled.
+   */
+  RCLCPP_PUBLIC
+  const rcl_guard_condition_t *
+  get_intra_process_guard_condition() const;
+
+  /// Queue a request from a client in the same process and wake up the executor.
+  /**
+   * The request is handled in the executor which spins this service, like a request received
+   * through rmw, but without being serialized. The respond function of the request is called
+   * from that executor thread too, also when the callback of the service throws.
+   * \param[in] request The request and the function receiving the response.
+   * \throws std::runtime_error if intra process requests are not enabled for this service.
+   */
+  RCLCPP_PUBLIC
+  void
+  add_intra_process_request(IntraProcessRequest request);
+
+  /// Take the oldest queued intra process request.
+  /**
+   * \param[out] request The request taken.
+   * \return true if a request was taken, false if the queue was empty.
+   */
+  RCLCPP_PUBLIC
+  bool
+  take_intra_process_request(IntraProcessRequest & request);
+
+  /// Trigger the intra process guard condition again if requests are still queued.
+  RCLCPP_PUBLIC
+  void
+  renotify_if_intra_process_pending();
+
+  /// Enable intra process requests for this service.
+  RCLCPP_PUBLIC
+  void
+  setup_intra_process();
+
   virtual std::shared_ptr<void> create_request() = 0;
   virtual std::shared_ptr<rmw_request_id_t> create_request_header() = 0;
+  /// Give a request back to the memory strategy once it is no longer used.
+  /**
+   * The default implementation does nothing, the request is freed with its last reference.
+   */
+  virtual void return_request(std::shared_ptr<void> &) {}
+  /// Give a request header back to the memory strategy once it is no longer used.
+  /**
+   * The default implementation does nothing, the header is freed with its last reference.
+   */
+  virtual void return_request_header(std::shared_ptr<rmw_request_id_t> &) {}
   virtual void handle_request(
     std::shared_ptr<rmw_request_id_t> request_header,
     std::shared_ptr<void> request) = 0;
+  virtual void handle_intra_process_request(IntraProcessRequest & request) = 0;
 
 protected:
   RCLCPP_DISABLE_COPY(ServiceBase);
@@ -70,6 +146,13 @@ protected:
 
   rcl_service_t service_handle_ = rcl_get_zero_initialized_service();
   std::string service_name_;
+
+private:
+  bool uses_intra_process_;
+  rcl_guard_condition_t intra_process_guard_condition_ =
+    rcl_get_zero_initialized_guard_condition();
+  std::deque<IntraProcessRequest> intra_process_requests_;
+  std::mutex intra_process_requests_mutex_;
 };
 
 using any_service_callback::AnyServiceCallback;
@@ -88,14 +171,24 @@ public:
         const std::shared_ptr<rmw_request_id_t>,
         const std::shared_ptr<typename ServiceT::Request>,
         std::shared_ptr<typename ServiceT::Response>)>;
+
+  /// Callback which returns without a response, which is sent later with send_response.
+  using DeferResponseCallbackType = std::function<
+      void(
+        const std::shared_ptr<rmw_request_id_t>,
+        const std::shared_ptr<typename ServiceT::Request>)>;
   RCLCPP_SMART_PTR_DEFINITIONS(Service);
 
+  using MemoryStrategy = service_memory_strategy::ServiceMemoryStrategy<ServiceT>;
+
   Service(
     std::shared_ptr<rcl_node_t> node_handle,
     const std::string & service_name,
     AnyServiceCallback<ServiceT> any_callback,
-    rcl_service_options_t & service_options)
-  : ServiceBase(node_handle, service_name), any_callback_(any_callback)
+    rcl_service_options_t & service_options,
+    typename MemoryStrategy::SharedPtr memory_strategy = MemoryStrategy::create_default())
+  : ServiceBase(node_handle, service_name), any_callback_(any_callback),
+    memory_strategy_(memory_strategy)
   {
     using rosidl_generator_cpp::get_service_type_support_handle;
     auto service_type_support_handle = get_service_type_support_handle<ServiceT>();
@@ -122,31 +215,138 @@ public:
     }
   }
 
+  /// Set the strategy providing requests, responses and request headers.
+  /**
+   * Behavior may be undefined if called while the service could be executing.
+   * \param[in] memory_strategy Shared pointer to the memory strategy to set.
+   */
+  void set_memory_strategy(typename MemoryStrategy::SharedPtr memory_strategy)
+  {
+    memory_strategy_ = memory_strategy;
+  }
+
+  /// Borrow a response from the memory strategy, e.g. to send with send_response.
+  /**
+   * The response is released to the memory strategy once the last reference to it is gone.
+   * \return Shared pointer to the response.
+   */
+  std::shared_ptr<typename ServiceT::Response> borrow_response()
+  {
+    return memory_strategy_->borrow_response();
+  }
+
   std::shared_ptr<void> create_request()
   {
-    return std::shared_ptr<void>(new typename ServiceT::Request());
+    return memory_strategy_->borrow_request();
   }
 
   std::shared_ptr<rmw_request_id_t> create_request_header()
   {
-    // TODO(wjwwood): This should probably use rmw_request_id's allocator.
-    //                (since it is a C type)
-    return std::shared_ptr<rmw_request_id_t>(new rmw_request_id_t);
+    return memory_strategy_->borrow_request_header();
+  }
+
+  void return_request(std::shared_ptr<void> & request)
+  {
+    auto typed_request = std::static_pointer_cast<typename ServiceT::Request>(request);
+    request.reset();
+    memory_strategy_->return_request(typed_request);
+  }
+
+  void return_request_header(std::shared_ptr<rmw_request_id_t> & request_header)
+  {
+    memory_strategy_->return_request_header(request_header);
   }
 
   void handle_request(std::shared_ptr<rmw_request_id_t> request_header,
     std::shared_ptr<void> request)
   {
     auto typed_request = std::static_pointer_cast<typename ServiceT::Request>(request);
-    auto response = std::shared_ptr<typename ServiceT::Response>(new typename ServiceT::Response);
-    any_callback_.dispatch(request_header, typed_request, response);
-    send_response(request_header, response);
+    if (any_callback_.defers_response()) {
+      RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_service_handle()));
+      any_callback_.dispatch_deferred(request_header, typed_request);
+      return;
+    }
+    auto response = memory_strategy_->borrow_response();
+    {
+      RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_service_handle()));
+      any_callback_.dispatch(request_header, typed_request, response);
+    }
+    send_rmw_response(request_header, response);
+    memory_strategy_->return_response(response);
   }
 
+  void handle_intra_process_request(IntraProcessRequest & request)
+  {
+    auto typed_request = std::static_pointer_cast<typename ServiceT::Request>(request.request);
+    auto request_header = create_request_header();
+    *request_header = rmw_request_id_t();
+    request_header->sequence_number = request.sequence_number;
+    if (any_callback_.defers_response()) {
+      deferred_intra_process_requests_.insert(
+        request_header, std::move(request.respond), std::move(request.is_pending));
+      try {
+        RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_service_handle()));
+        any_callback_.dispatch_deferred(request_header, typed_request);
+      } catch (...) {
+        IntraProcessRespondT respond;
+        if (deferred_intra_process_requests_.take(request_header.get(), respond)) {
+          respond(nullptr, std::current_exception());
+        }
+        throw;
+      }
+      return;
+    }
+    // The response is handed to the client, which releases it.
+    auto response = memory_strategy_->borrow_response();
+    try {
+      RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_service_handle()));
+      any_callback_.dispatch(request_header, typed_request, response);
+    } catch (...) {
+      // The client gets the exception rather than waiting for a response forever; it is still
+      // raised in this executor, like for a request received through rmw.
+      memory_strategy_->return_request_header(request_header);
+      request.respond(nullptr, std::current_exception());
+      throw;
+    }
+    request.respond(response, nullptr);
+    memory_strategy_->return_request_header(request_header);
+  }
+
+  /// Send the response to a request.
+  /**
+   * Callbacks which defer the response call this later with the request header they were
+   * given, from any thread, so that slow requests do not block the executor.
+   * The header identifies the client, and a request handed over by a client of this process
+   * is answered without going through rmw, by handing the response to the client's executor.
+   * Such requests are kept until they are answered, or until their client stops waiting, e.g.
+   * because the request expired.
+   * \param[in] req_id The request header the callback was given.
+   * \param[in] response The response, which is not modified.
+   * \throws std::runtime_error if sending the response failed.
+   */
   void send_response(
     std::shared_ptr<rmw_request_id_t> req_id,
     std::shared_ptr<typename ServiceT::Response> response)
   {
+    IntraProcessRespondT respond;
+    if (deferred_intra_process_requests_.take(req_id.get(), respond)) {
+      respond(response, nullptr);
+      return;
+    }
+    send_rmw_response(req_id, response);
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(Service);
+
+  using IntraProcessRespondT = std::function<void(std::shared_ptr<void>, std::exception_ptr)>;
+
+  void send_rmw_response(
+    std::shared_ptr<rmw_request_id_t> req_id,
+    std::shared_ptr<typename ServiceT::Response> response)
+  {
+    // Deferred responses may be sent from several threads at once.
+    std::lock_guard<std::mutex> lock(send_response_mutex_);
     rcl_ret_t status = rcl_send_response(get_service_handle(), req_id.get(), response.get());
 
     if (status != RCL_RET_OK) {
@@ -157,10 +357,13 @@ public:
     }
   }
 
-private:
-  RCLCPP_DISABLE_COPY(Service);
-
   AnyServiceCallback<ServiceT> any_callback_;
+  typename MemoryStrategy::SharedPtr memory_strategy_;
+
+  std::mutex send_response_mutex_;
+  /// Intra process requests which wait for a deferred response, by their request header.
+  deferred_request_table::DeferredRequestTable<rmw_request_id_t, IntraProcessRespondT>
+  deferred_intra_process_requests_;
 };
 
 }  // namespace service
@@ -0,0 +1,135 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__SERVICE_MEMORY_STRATEGY_HPP_
+#define RCLCPP__SERVICE_MEMORY_STRATEGY_HPP_
+
+#include <memory>
+
+#include "rclcpp/allocator/allocator_common.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+#include "rmw/types.h"
+
+namespace rclcpp
+{
+namespace service_memory_strategy
+{
+
+/// Default allocation strategy for the requests, responses and request headers of services.
+/**
+ * Services and clients borrow from it what they take from rmw, and what a
+ * service passes to its callback as the response, and return it once handled.
+ * Like MessageMemoryStrategy for subscriptions, derived strategies can hand out
+ * preallocated objects, see rclcpp/strategies/service_pool_memory_strategy.hpp.
+ * Borrowed objects may be kept by user code, e.g. in the future of a client.
+ */
+template<typename ServiceT>
+class ServiceMemoryStrategy
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(ServiceMemoryStrategy);
+
+  using Request = typename ServiceT::Request;
+  using Response = typename ServiceT::Response;
+
+  virtual ~ServiceMemoryStrategy() {}
+
+  /// Default factory method
+  static SharedPtr create_default()
+  {
+    return std::make_shared<ServiceMemoryStrategy<ServiceT>>();
+  }
+
+  /// By default, dynamically allocate a new request.
+  virtual std::shared_ptr<Request> borrow_request()
+  {
+    return std::make_shared<Request>();
+  }
+
+  /// By default, dynamically allocate a new response.
+  virtual std::shared_ptr<Response> borrow_response()
+  {
+    return std::make_shared<Response>();
+  }
+
+  /// By default, dynamically allocate a new request header.
+  virtual std::shared_ptr<rmw_request_id_t> borrow_request_header()
+  {
+    return std::make_shared<rmw_request_id_t>();
+  }
+
+  /// Release ownership of the request, which will deallocate it if it has no more owners.
+  virtual void return_request(std::shared_ptr<Request> & request)
+  {
+    request.reset();
+  }
+
+  /// Release ownership of the response, which will deallocate it if it has no more owners.
+  virtual void return_response(std::shared_ptr<Response> & response)
+  {
+    response.reset();
+  }
+
+  /// Release ownership of the request header, which will deallocate it if it has no more owners.
+  virtual void return_request_header(std::shared_ptr<rmw_request_id_t> & request_header)
+  {
+    request_header.reset();
+  }
+};
+
+/// Allocation strategy which allocates requests, responses and request headers with an allocator.
+template<typename ServiceT, typename Alloc = std::allocator<void>>
+class AllocatorServiceMemoryStrategy : public ServiceMemoryStrategy<ServiceT>
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(AllocatorServiceMemoryStrategy);
+
+  using Request = typename ServiceT::Request;
+  using Response = typename ServiceT::Response;
+  using RequestAlloc = typename allocator::AllocRebind<Request, Alloc>::allocator_type;
+  using ResponseAlloc = typename allocator::AllocRebind<Response, Alloc>::allocator_type;
+  using HeaderAlloc = typename allocator::AllocRebind<rmw_request_id_t, Alloc>::allocator_type;
+
+  explicit AllocatorServiceMemoryStrategy(std::shared_ptr<Alloc> allocator)
+  : request_allocator_(*allocator.get()), response_allocator_(*allocator.get()),
+    header_allocator_(*allocator.get())
+  {}
+
+  std::shared_ptr<Request> borrow_request()
+  {
+    return std::allocate_shared<Request>(request_allocator_);
+  }
+
+  std::shared_ptr<Response> borrow_response()
+  {
+    return std::allocate_shared<Response>(response_allocator_);
+  }
+
+  std::shared_ptr<rmw_request_id_t> borrow_request_header()
+  {
+    return std::allocate_shared<rmw_request_id_t>(header_allocator_);
+  }
+
+private:
+  RequestAlloc request_allocator_;
+  ResponseAlloc response_allocator_;
+  HeaderAlloc header_allocator_;
+};
+
+}  // namespace service_memory_strategy
+}  // namespace rclcpp
+
+#endif  // RCLCPP__SERVICE_MEMORY_STRATEGY_HPP_
@@ -0,0 +1,296 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__SHARED_ENTRY_MAPPED_RING_BUFFER_HPP_
+#define RCLCPP__SHARED_ENTRY_MAPPED_RING_BUFFER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/allocator/allocator_common.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/mapped_ring_buffer.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace mapped_ring_buffer
+{
+
+/// Ring buffer of T's which can be accessed by a key, without a buffer wide lock.
+/* This has the same semantics as MappedRingBuffer, see its documentation,
+ * with the following differences:
+ *
+ * Each slot holds a shared_ptr to an immutable entry, i.e. the key and the
+ * value, and slots are only accessed with the atomic shared_ptr operations.
+ * Readers take a reference to the entry and make their copies afterwards, so
+ * they never hold up writers, and writers never wait on a copy in progress.
+ * A value is only moved out of an entry once it has been removed from its slot
+ * and no reader holds a reference to it anymore, otherwise a copy is returned.
+ *
+ * This is not lock-free: the standard library implements the atomic shared_ptr
+ * operations with a pool of mutexes, which are only held while a slot is read
+ * or replaced. Accesses to different slots may also contend on the same mutex.
+ *
+ * Because of this get_ownership_at_key always returns a copy, and
+ * push_and_replace allocates memory for the new entry.
+ *
+ * Like MappedRingBuffer, it supports MappedRingBufferKeyMode::Sequential.
+ */
+template<typename T, typename Alloc = std::allocator<void>>
+class SharedEntryMappedRingBuffer : public TypedMappedRingBufferBase<T, Alloc>
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(SharedEntryMappedRingBuffer<T, Alloc>);
+  using Base = TypedMappedRingBufferBase<T, Alloc>;
+  using ElemAllocTraits = typename Base::ElemAllocTraits;
+  using ElemAlloc = typename Base::ElemAlloc;
+  using ElemDeleter = typename Base::ElemDeleter;
+
+  using ElemUniquePtr = typename Base::ElemUniquePtr;
+  using ElemSharedPtr = typename Base::ElemSharedPtr;
+  using Base::push_and_replace;
+
+  /// Constructor.
+  /* The constructor will allocate memory while reserving space.
+   *
+   * \param size size of the ring buffer; must be positive and non-zero.
+   * \param allocator allocator used for the entries and copies of the stored values.
+   * \param key_mode how keys are mapped to slots.
+   */
+  explicit SharedEntryMappedRingBuffer(size_t size, std::shared_ptr<Alloc> allocator = nullptr,
+    MappedRingBufferKeyMode key_mode = MappedRingBufferKeyMode::Arbitrary)
+  : slots_(size), head_(0), key_mode_(key_mode)
+  {
+    if (size == 0) {
+      throw std::invalid_argument("size must be a positive, non-zero value");
+    }
+    if (!allocator) {
+      allocator_ = std::make_shared<ElemAlloc>();
+    } else {
+      allocator_ = std::make_shared<ElemAlloc>(*allocator.get());
+    }
+  }
+
+  virtual ~SharedEntryMappedRingBuffer() {}
+
+  virtual void
+  get_copy_at_key(uint64_t key, ElemUniquePtr & value)
+  {
+    value = nullptr;
+    auto e = find_entry(key);
+    if (e) {
+      value = copy_of(*e);
+    }
+  }
+
+  virtual void
+  get_ownership_at_key(uint64_t key, ElemUniquePtr & value)
+  {
+    // Other readers may be using the stored value at any time, so it is never given away.
+    get_copy_at_key(key, value);
+  }
+
+  virtual void
+  pop_at_key(uint64_t key, ElemUniquePtr & value)
+  {
+    value = nullptr;
+    auto e = remove_entry(key);
+    if (e) {
+      value = take_or_copy(e);
+    }
+  }
+
+  virtual void
+  get_shared_at_key(uint64_t key, ElemSharedPtr & value)
+  {
+    value = nullptr;
+    auto e = find_entry(key);
+    if (e) {
+      value = share(e);
+    }
+  }
+
+  virtual void
+  pop_shared_at_key(uint64_t key, ElemSharedPtr & value)
+  {
+    value = nullptr;
+    auto e = remove_entry(key);
+    if (e) {
+      value = share(e);
+    }
+  }
+
+  virtual bool
+  test_at_key(uint64_t key, const std::function<bool(const T &)> & predicate)
+  {
+    // The reference to the entry keeps the value alive while the predicate runs.
+    auto e = find_entry(key);
+    if (!e) {
+      return false;
+    }
+    return predicate(e->shared_value ? *e->shared_value : *e->value);
+  }
+
+  virtual bool
+  push_and_replace(uint64_t key, ElemUniquePtr & value)
+  {
+    auto e = std::allocate_shared<entry>(
+      EntryAlloc(*allocator_.get()), key, std::move(value), ElemSharedPtr());
+    auto displaced = store_entry(e);
+    if (displaced) {
+      value = take_or_copy(displaced);
+    }
+    return displaced != nullptr;
+  }
+
+  virtual bool
+  push_and_replace(uint64_t key, const ElemSharedPtr & value)
+  {
+    auto e = std::allocate_shared<entry>(
+      EntryAlloc(*allocator_.get()), key, ElemUniquePtr(), value);
+    return store_entry(e) != nullptr;
+  }
+
+  virtual bool
+  remove_at_key(uint64_t key)
+  {
+    // The entry, and so the value, is freed once the last reader holding it lets go.
+    return remove_entry(key) != nullptr;
+  }
+
+  virtual bool
+  has_key(uint64_t key)
+  {
+    return find_entry(key) != nullptr;
+  }
+
+private:
+  RCLCPP_DISABLE_COPY(SharedEntryMappedRingBuffer<T, Alloc>);
+
+  struct entry
+  {
+    entry(uint64_t key, ElemUniquePtr && value, const ElemSharedPtr & shared_value)
+    : key(key), value(std::move(value)), shared_value(shared_value)
+    {}
+
+    const uint64_t key;
+    /// The value, if it was pushed uniquely owned, otherwise nullptr.
+    ElemUniquePtr value;
+    /// The value, if it was pushed shared, otherwise nullptr.
+    const ElemSharedPtr shared_value;
+  };
+
+  using EntrySharedPtr = std::shared_ptr<entry>;
+  using EntryAlloc = typename std::allocator_traits<ElemAlloc>::template rebind_alloc<entry>;
+  using VectorAlloc =
+    typename std::allocator_traits<Alloc>::template rebind_alloc<EntrySharedPtr>;
+
+  EntrySharedPtr
+  store_entry(const EntrySharedPtr & e)
+  {
+    size_t index = key_mode_ == MappedRingBufferKeyMode::Sequential ?
+      e->key % slots_.size() : head_.fetch_add(1) % slots_.size();
+    return std::atomic_exchange(&slots_[index], e);
+  }
+
+  EntrySharedPtr
+  find_entry(uint64_t key, size_t * index = nullptr)
+  {
+    size_t begin = 0;
+    size_t end = slots_.size();
+    if (key_mode_ == MappedRingBufferKeyMode::Sequential) {
+      begin = key % slots_.size();
+      end = begin + 1;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      auto e = std::atomic_load(&slots_[i]);
+      if (e && e->key == key) {
+        if (index) {
+          *index = i;
+        }
+        return e;
+      }
+    }
+    return nullptr;
+  }
+
+  EntrySharedPtr
+  remove_entry(uint64_t key)
+  {
+    size_t index = 0;
+    EntrySharedPtr e;
+    while ((e = find_entry(key, &index))) {
+      EntrySharedPtr expected = e;
+      if (std::atomic_compare_exchange_strong(&slots_[index], &expected, EntrySharedPtr())) {
+        return e;
+      }
+      // The slot was changed concurrently, look again.
+    }
+    return nullptr;
+  }
+
+  /// Return the value of an entry which is no longer in a slot, copying it if still in use.
+  ElemUniquePtr
+  take_or_copy(EntrySharedPtr & e)
+  {
+    // The entry cannot be found anymore, so a count of one means no reader is left.
+    if (e->value && e.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return std::move(e->value);
+    }
+    if (!e->value && !e->shared_value) {
+      return nullptr;
+    }
+    return copy_of(*e);
+  }
+
+  static ElemSharedPtr
+  share(const EntrySharedPtr & e)
+  {
+    if (e->shared_value) {
+      return e->shared_value;
+    }
+    // Keep the whole entry alive for as long as the value is shared.
+    return ElemSharedPtr(e, e->value.get());
+  }
+
+  ElemUniquePtr
+  copy_of(const entry & e)
+  {
+    const T & source = e.shared_value ? *e.shared_value : *e.value;
+    auto ptr = ElemAllocTraits::allocate(*allocator_.get(), 1);
+    ElemAllocTraits::construct(*allocator_.get(), ptr, source);
+    // The copy has to be released with the allocator it came from.
+    ElemDeleter deleter;
+    allocator::set_allocator_for_deleter(&deleter, allocator_.get());
+    return ElemUniquePtr(ptr, deleter);
+  }
+
+  std::vector<EntrySharedPtr, VectorAlloc> slots_;
+  std::atomic<size_t> head_;
+  MappedRingBufferKeyMode key_mode_;
+  std::shared_ptr<ElemAlloc> allocator_;
+};
+
+}  // namespace mapped_ring_buffer
+}  // namespace rclcpp
+
+#endif  // RCLCPP__SHARED_ENTRY_MAPPED_RING_BUFFER_HPP_
@@ -0,0 +1,133 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__STATISTICS_PUBLISHER_HPP_
+#define RCLCPP__STATISTICS_PUBLISHER_HPP_
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rclcpp/executor.hpp"
+#include "rclcpp/executor_statistics.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/publisher.hpp"
+#include "rclcpp/timer.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace statistics_publisher
+{
+
+/// Periodically publishes statistics of a node and of the executor spinning it.
+/**
+ * The statistics are published on the topic "<node name>__statistics", as named values in the
+ * new_parameters of a rcl_interfaces ParameterEvent, since rclcpp depends on no diagnostics
+ * messages. All values but the first two cover the last period:
+ *
+ * - node: the name of the node
+ * - period_ns: the length of the period
+ * - executor.idle_ratio: the time spent in wait_for_work over the length of the period,
+ *   summed over the threads of the executor
+ * - topic.<topic>.messages_per_second: the messages passed to the subscriptions of the topic
+ * - topic.<topic>.intra_process_dropped: intra process messages dropped from the queues of
+ *   the subscriptions or overwritten before they were taken
+ * - topic.<topic>.take_latency_p50_ns, _p99_ns: the time from the end of the wait which
+ *   reported a subscription ready until its execution started
+ * - topic.<topic>.callback_duration_p50_ns, _p99_ns, _p999_ns: the time spent executing a
+ *   subscription, which includes taking the message
+ *
+ * Latencies and durations are upper bounds with the power of two resolution of Histogram.
+ * The constructor enables the statistics of the executor, which then records the durations of
+ * each execution, see ExecutorStatistics for what that costs. The subscriptions always count
+ * the taken messages with relaxed atomic increments.
+ * The timer is in a callback group of its own, so it never delays the other callbacks of the
+ * node in a multi threaded executor, and it has a slack of a tenth of the period, so it usually
+ * fires together with other timers rather than waking up the executor itself.
+ */
+class StatisticsPublisher
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(StatisticsPublisher);
+
+  /// Start publishing the statistics.
+  /**
+   * \param[in] node The node whose subscriptions are reported and which publishes.
+   * \param[in] executor The executor which spins the node.
+   * \param[in] period How often the statistics are published.
+   */
+  RCLCPP_PUBLIC
+  StatisticsPublisher(
+    rclcpp::node::Node::SharedPtr node,
+    rclcpp::executor::Executor::SharedPtr executor,
+    std::chrono::nanoseconds period = std::chrono::seconds(1));
+
+  RCLCPP_PUBLIC
+  virtual ~StatisticsPublisher();
+
+  /// Collect the statistics since the previous call, as they are published.
+  RCLCPP_PUBLIC
+  std::shared_ptr<rcl_interfaces::msg::ParameterEvent>
+  collect();
+
+private:
+  RCLCPP_DISABLE_COPY(StatisticsPublisher);
+
+  /// Counters of all subscriptions of a topic at one point in time.
+  struct TopicSnapshot
+  {
+    TopicSnapshot()
+    : taken(0), dropped(0)
+    {}
+
+    uint64_t taken;
+    uint64_t dropped;
+    rclcpp::executor::HistogramSnapshot queue_delay;
+    rclcpp::executor::HistogramSnapshot execution_time;
+  };
+
+  /// Lets the timer callback reach the statistics publisher only while it exists.
+  struct TimerTarget
+  {
+    std::mutex mutex;
+    StatisticsPublisher * statistics_publisher;
+  };
+
+  std::map<std::string, TopicSnapshot>
+  take_topic_snapshots(
+    rclcpp::node::Node & node, rclcpp::executor::ExecutorStatistics & executor_statistics);
+
+  std::weak_ptr<rclcpp::node::Node> node_;
+  std::weak_ptr<rclcpp::executor::Executor> executor_;
+  std::string node_name_;
+  rclcpp::callback_group::CallbackGroup::SharedPtr callback_group_;
+  rclcpp::publisher::Publisher<rcl_interfaces::msg::ParameterEvent>::SharedPtr publisher_;
+  rclcpp::timer::TimerBase::SharedPtr timer_;
+  std::shared_ptr<TimerTarget> timer_target_;
+
+  std::mutex mutex_;
+  std::chrono::steady_clock::time_point previous_time_;
+  rclcpp::executor::HistogramSnapshot previous_wait_time_;
+  std::map<std::string, TopicSnapshot> previous_topics_;
+};
+
+}  // namespace statistics_publisher
+}  // namespace rclcpp
+
+#endif  // RCLCPP__STATISTICS_PUBLISHER_HPP_
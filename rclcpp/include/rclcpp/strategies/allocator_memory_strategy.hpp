@@ -15,7 +15,12 @@
 #ifndef RCLCPP__STRATEGIES__ALLOCATOR_MEMORY_STRATEGY_HPP_
 #define RCLCPP__STRATEGIES__ALLOCATOR_MEMORY_STRATEGY_HPP_
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "rcl/allocator.h"
@@ -23,6 +28,7 @@
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/memory_strategy.hpp"
 #include "rclcpp/node.hpp"
+#include "rclcpp/timer_queue.hpp"
 #include "rclcpp/visibility_control.hpp"
 
 #include "rmw/types.h"
@@ -39,6 +45,18 @@ namespace allocator_memory_strategy
  * By default, the memory strategy dynamically allocates memory for structures that come in from
  * the rmw implementation after the executor waits for work, based on the number of entities that
  * come through.
+ *
+ * Timers are kept in a queue ordered by expiry rather than in the waitset, which provides both
+ * the ready timers and the timeout for the wait.
+ *
+ * The handles gathered by collect_entities are cached between waits. The cache is only rebuilt
+ * when one of the guard conditions (the executor's interrupt guard condition, which the shutdown
+ * of the context triggers as well, or a node's notify guard condition) was triggered, when the
+ * set of guard conditions changes, or when one of the cached entities has been destroyed.
+ *
+ * Subscriptions which get their intra process messages delivered directly contribute their
+ * intra process guard condition, which is added to the waitset after the other guard conditions.
+ * Services which accept intra process requests do the same, after those of the subscriptions.
  */
 template<typename Alloc = std::allocator<void>>
 class AllocatorMemoryStrategy : public memory_strategy::MemoryStrategy
@@ -74,6 +92,7 @@ public:
       }
     }
     guard_conditions_.push_back(guard_condition);
+    entities_dirty_ = true;
   }
 
   void remove_guard_condition(const rcl_guard_condition_t * guard_condition)
@@ -81,6 +100,7 @@ public:
     for (auto it = guard_conditions_.begin(); it != guard_conditions_.end(); ++it) {
       if (*it == guard_condition) {
         guard_conditions_.erase(it);
+        entities_dirty_ = true;
         break;
       }
     }
@@ -89,8 +109,11 @@ public:
   void clear_handles()
   {
     subscription_handles_.clear();
+    intra_process_guard_conditions_.clear();
     service_handles_.clear();
+    intra_process_service_guard_conditions_.clear();
     client_handles_.clear();
+    client_continuation_guard_conditions_.clear();
     timer_handles_.clear();
   }
 
@@ -116,71 +139,233 @@ public:
         timer_handles_[i] = nullptr;
       }
     }
+    // A triggered guard condition may mean that entities were added to a node, that nodes were
+    // added to the executor, or that a mutually exclusive group became available again.
+    size_t number_of_guard_conditions =
+      std::min(guard_conditions_.size(), wait_set->size_of_guard_conditions);
+    for (size_t i = 0; i < number_of_guard_conditions; ++i) {
+      if (wait_set->guard_conditions[i]) {
+        entities_dirty_ = true;
+        break;
+      }
+    }
+    // The intra process guard conditions follow, each one signals a ready subscription.
+    for (size_t i = 0; i < intra_process_guard_conditions_.size(); ++i) {
+      size_t index = guard_conditions_.size() + i;
+      if (index >= wait_set->size_of_guard_conditions || !wait_set->guard_conditions[index]) {
+        intra_process_guard_conditions_[i] = nullptr;
+      }
+    }
+    // Then those of the services, each one signals queued intra process requests.
+    size_t intra_process_service_offset =
+      guard_conditions_.size() + intra_process_guard_conditions_.size();
+    for (size_t i = 0; i < intra_process_service_guard_conditions_.size(); ++i) {
+      size_t index = intra_process_service_offset + i;
+      if (index >= wait_set->size_of_guard_conditions || !wait_set->guard_conditions[index]) {
+        intra_process_service_guard_conditions_[i] = nullptr;
+      }
+    }
+    // Then those of the clients, each one signals posted continuations.
+    size_t client_continuation_offset =
+      intra_process_service_offset + intra_process_service_guard_conditions_.size();
+    for (size_t i = 0; i < client_continuation_guard_conditions_.size(); ++i) {
+      size_t index = client_continuation_offset + i;
+      if (index >= wait_set->size_of_guard_conditions || !wait_set->guard_conditions[index]) {
+        client_continuation_guard_conditions_[i] = nullptr;
+      }
+    }
 
     subscription_handles_.erase(
       std::remove(subscription_handles_.begin(), subscription_handles_.end(), nullptr),
       subscription_handles_.end()
     );
 
+    intra_process_guard_conditions_.erase(
+      std::remove(
+        intra_process_guard_conditions_.begin(), intra_process_guard_conditions_.end(), nullptr),
+      intra_process_guard_conditions_.end()
+    );
+
     service_handles_.erase(
       std::remove(service_handles_.begin(), service_handles_.end(), nullptr),
       service_handles_.end()
     );
 
+    intra_process_service_guard_conditions_.erase(
+      std::remove(
+        intra_process_service_guard_conditions_.begin(),
+        intra_process_service_guard_conditions_.end(), nullptr),
+      intra_process_service_guard_conditions_.end()
+    );
+
     client_handles_.erase(
       std::remove(client_handles_.begin(), client_handles_.end(), nullptr),
       client_handles_.end()
     );
 
+    client_continuation_guard_conditions_.erase(
+      std::remove(
+        client_continuation_guard_conditions_.begin(),
+        client_continuation_guard_conditions_.end(), nullptr),
+      client_continuation_guard_conditions_.end()
+    );
+
     timer_handles_.erase(
       std::remove(timer_handles_.begin(), timer_handles_.end(), nullptr),
       timer_handles_.end()
     );
+
+    // Timers are not waited on through the waitset, the ready ones come from the timer queue.
+    timer_queue_.pop_ready(timer_handles_);
+  }
+
+  void set_executor_statistics(executor::ExecutorStatistics * statistics)
+  {
+    if (statistics != executor_statistics_) {
+      // Rebuild the index, so the statistics of the entities are resolved (or released).
+      executor_statistics_ = statistics;
+      entities_dirty_ = true;
+    }
   }
 
   bool collect_entities(const WeakNodeVector & weak_nodes)
   {
+    if (!entities_dirty_ && cached_entities_are_valid(weak_nodes)) {
+      restore_cached_handles();
+      timer_queue_.requeue();
+      return false;
+    }
+
+    cached_subscription_handles_.clear();
+    cached_intra_process_guard_conditions_.clear();
+    cached_service_handles_.clear();
+    cached_intra_process_service_guard_conditions_.clear();
+    cached_client_handles_.clear();
+    cached_client_continuation_guard_conditions_.clear();
+    timer_queue_.clear();
+    subscription_index_.clear();
+    intra_process_index_.clear();
+    service_index_.clear();
+    intra_process_service_index_.clear();
+    client_index_.clear();
+    client_continuation_index_.clear();
+    timer_index_.clear();
+
+    for (auto & pair : group_schedules_) {
+      pair.second.collected = false;
+    }
+    use_group_priorities_ = false;
+
     bool has_invalid_weak_nodes = false;
+    bool has_busy_groups = false;
     for (auto & weak_node : weak_nodes) {
       auto node = weak_node.lock();
       if (!node) {
-        has_invalid_weak_nodes = false;
+        has_invalid_weak_nodes = true;
         continue;
       }
       for (auto & weak_group : node->get_callback_groups()) {
         auto group = weak_group.lock();
-        if (!group || !group->can_be_taken_from().load()) {
+        if (!group) {
+          continue;
+        }
+        if (!group->can_be_taken_from().load()) {
+          // The entities of this group are left out until it is released, which is signaled
+          // through the interrupt guard condition, so the cache cannot be reused as-is.
+          has_busy_groups = true;
           continue;
         }
+        GroupSchedule * schedule = &group_schedules_[group.get()];
+        if (schedule->group.owner_before(group) || group.owner_before(schedule->group)) {
+          // A new group allocated at the address of a destroyed one starts with a new schedule.
+          *schedule = GroupSchedule();
+          schedule->group = group;
+        }
+        schedule->collected = true;
+        // Read before the entities, so changes made while collecting are noticed next time.
+        schedule->generation = group->get_generation();
+        schedule->collected_generation = schedule->generation->get();
+        if (group->get_priority() != 0 ||
+          group->get_deadline() > std::chrono::nanoseconds::zero())
+        {
+          use_group_priorities_ = true;
+        }
         for (auto & weak_subscription : group->get_subscription_ptrs()) {
           auto subscription = weak_subscription.lock();
           if (subscription) {
-            subscription_handles_.push_back(subscription->get_subscription_handle());
-            if (subscription->get_intra_process_subscription_handle()) {
-              subscription_handles_.push_back(
-                subscription->get_intra_process_subscription_handle());
+            auto handle = subscription->get_subscription_handle();
+            auto statistics = resolve_statistics(handle, subscription);
+            subscription_index_[handle] =
+            {subscription, group, node, schedule, cached_subscription_handles_.size(), statistics};
+            cached_subscription_handles_.push_back(handle);
+            auto intra_process_handle = subscription->get_intra_process_subscription_handle();
+            if (intra_process_handle) {
+              // Executed as the subscription, so recorded with it.
+              subscription_index_[intra_process_handle] = {subscription, group, node, schedule,
+                cached_subscription_handles_.size(), statistics};
+              cached_subscription_handles_.push_back(intra_process_handle);
+            }
+            auto intra_process_guard_condition = subscription->get_intra_process_guard_condition();
+            if (intra_process_guard_condition) {
+              intra_process_index_[intra_process_guard_condition] = {subscription, group, node,
+                schedule, cached_intra_process_guard_conditions_.size(),
+                resolve_statistics(intra_process_handle, subscription)};
+              cached_intra_process_guard_conditions_.push_back(intra_process_guard_condition);
             }
           }
         }
         for (auto & service : group->get_service_ptrs()) {
           if (service) {
-            service_handles_.push_back(service->get_service_handle());
+            auto handle = service->get_service_handle();
+            service_index_[handle] = {service, group, node, schedule,
+              cached_service_handles_.size(), resolve_statistics(handle, service)};
+            cached_service_handles_.push_back(handle);
+            auto intra_process_guard_condition = service->get_intra_process_guard_condition();
+            if (intra_process_guard_condition) {
+              intra_process_service_index_[intra_process_guard_condition] = {service, group, node,
+                schedule, cached_intra_process_service_guard_conditions_.size(),
+                resolve_statistics(intra_process_guard_condition, service)};
+              cached_intra_process_service_guard_conditions_.push_back(
+                intra_process_guard_condition);
+            }
           }
         }
         for (auto & weak_client : group->get_client_ptrs()) {
           auto client = weak_client.lock();
           if (client) {
-            client_handles_.push_back(client->get_client_handle());
+            auto handle = client->get_client_handle();
+            client_index_[handle] = {client, group, node, schedule,
+              cached_client_handles_.size(), resolve_statistics(handle, client)};
+            cached_client_handles_.push_back(handle);
+            auto continuation_guard_condition = client->get_continuation_guard_condition();
+            client_continuation_index_[continuation_guard_condition] = {client, group, node,
+              schedule, cached_client_continuation_guard_conditions_.size(),
+              resolve_statistics(continuation_guard_condition, client)};
+            cached_client_continuation_guard_conditions_.push_back(continuation_guard_condition);
           }
         }
         for (auto & weak_timer : group->get_timer_ptrs()) {
           auto timer = weak_timer.lock();
           if (timer) {
-            timer_handles_.push_back(timer->get_timer_handle());
+            auto handle = timer->get_timer_handle();
+            timer_index_[handle] =
+            {timer, group, node, schedule, timer_queue_.size(), resolve_statistics(handle, timer)};
+            timer_queue_.push(timer);
           }
         }
       }
     }
+    // Forget the scheduling state of groups which are gone (busy groups are kept).
+    for (auto it = group_schedules_.begin(); it != group_schedules_.end(); ) {
+      if (!it->second.collected && (!has_busy_groups || it->second.group.expired())) {
+        it = group_schedules_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // If invalid nodes were found the executor prunes them, so rebuild once more afterwards.
+    entities_dirty_ = has_invalid_weak_nodes || has_busy_groups;
+    restore_cached_handles();
     return has_invalid_weak_nodes;
   }
 
@@ -221,6 +406,30 @@ public:
         return false;
       }
     }
+
+    for (auto guard_condition : intra_process_guard_conditions_) {
+      if (rcl_wait_set_add_guard_condition(wait_set, guard_condition) != RCL_RET_OK) {
+        fprintf(stderr, "Couldn't add intra process guard_condition to waitset: %s\n",
+          rcl_get_error_string_safe());
+        return false;
+      }
+    }
+
+    for (auto guard_condition : intra_process_service_guard_conditions_) {
+      if (rcl_wait_set_add_guard_condition(wait_set, guard_condition) != RCL_RET_OK) {
+        fprintf(stderr, "Couldn't add intra process service guard_condition to waitset: %s\n",
+          rcl_get_error_string_safe());
+        return false;
+      }
+    }
+
+    for (auto guard_condition : client_continuation_guard_conditions_) {
+      if (rcl_wait_set_add_guard_condition(wait_set, guard_condition) != RCL_RET_OK) {
+        fprintf(stderr, "Couldn't add client continuation guard_condition to waitset: %s\n",
+          rcl_get_error_string_safe());
+        return false;
+      }
+    }
     return true;
   }
 
@@ -232,113 +441,198 @@ public:
   }
 
   virtual void
-  get_next_subscription(executor::AnyExecutable::SharedPtr any_exec,
-    const WeakNodeVector & weak_nodes)
+  get_next_subscription(executor::AnyExecutable & any_exec, const WeakNodeVector &)
   {
     auto it = subscription_handles_.begin();
     while (it != subscription_handles_.end()) {
-      auto subscription = get_subscription_by_handle(*it, weak_nodes);
+      subscription::SubscriptionBase::SharedPtr subscription;
+      if (!resolve_handle(subscription_index_, *it, subscription, any_exec)) {
+        ++it;
+        continue;
+      }
       if (subscription) {
         // Figure out if this is for intra-process or not.
-        bool is_intra_process = false;
-        if (subscription->get_intra_process_subscription_handle()) {
-          is_intra_process = subscription->get_intra_process_subscription_handle() == *it;
-        }
-        // Find the group for this handle and see if it can be serviced
-        auto group = get_group_by_subscription(subscription, weak_nodes);
-        if (!group) {
-          // Group was not found, meaning the subscription is not valid...
-          // Remove it from the ready list and continue looking
-          subscription_handles_.erase(it);
-          continue;
-        }
-        if (!group->can_be_taken_from().load()) {
-          // Group is mutually exclusive and is being used, so skip it for now
-          // Leave it to be checked next time, but continue searching
-          ++it;
-          continue;
-        }
-        // Otherwise it is safe to set and return the any_exec
-        if (is_intra_process) {
-          any_exec->subscription_intra_process = subscription;
+        if (subscription->get_intra_process_subscription_handle() == *it) {
+          any_exec.subscription_intra_process = subscription;
         } else {
-          any_exec->subscription = subscription;
+          any_exec.subscription = subscription;
         }
-        any_exec->callback_group = group;
-        any_exec->node = get_node_by_group(group, weak_nodes);
+        advance_cursor(subscription_index_, *it, next_subscription_order_);
         subscription_handles_.erase(it);
         return;
       }
       // Else, the subscription is no longer valid, remove it and continue
-      subscription_handles_.erase(it);
+      it = subscription_handles_.erase(it);
     }
+    get_next_intra_process_subscription(any_exec);
   }
 
   virtual void
-  get_next_service(executor::AnyExecutable::SharedPtr any_exec,
-    const WeakNodeVector & weak_nodes)
+  get_next_service(executor::AnyExecutable & any_exec, const WeakNodeVector &)
   {
     auto it = service_handles_.begin();
     while (it != service_handles_.end()) {
-      auto service = get_service_by_handle(*it, weak_nodes);
+      service::ServiceBase::SharedPtr service;
+      if (!resolve_handle(service_index_, *it, service, any_exec)) {
+        ++it;
+        continue;
+      }
       if (service) {
-        // Find the group for this handle and see if it can be serviced
-        auto group = get_group_by_service(service, weak_nodes);
-        if (!group) {
-          // Group was not found, meaning the service is not valid...
-          // Remove it from the ready list and continue looking
-          service_handles_.erase(it);
-          continue;
-        }
-        if (!group->can_be_taken_from().load()) {
-          // Group is mutually exclusive and is being used, so skip it for now
-          // Leave it to be checked next time, but continue searching
-          ++it;
-          continue;
-        }
-        // Otherwise it is safe to set and return the any_exec
-        any_exec->service = service;
-        any_exec->callback_group = group;
-        any_exec->node = get_node_by_group(group, weak_nodes);
+        any_exec.service = service;
+        advance_cursor(service_index_, *it, next_service_order_);
         service_handles_.erase(it);
         return;
       }
       // Else, the service is no longer valid, remove it and continue
-      service_handles_.erase(it);
+      it = service_handles_.erase(it);
     }
+    get_next_intra_process_service(any_exec);
   }
 
   virtual void
-  get_next_client(executor::AnyExecutable::SharedPtr any_exec, const WeakNodeVector & weak_nodes)
+  get_next_client(executor::AnyExecutable & any_exec, const WeakNodeVector &)
   {
     auto it = client_handles_.begin();
     while (it != client_handles_.end()) {
-      auto client = get_client_by_handle(*it, weak_nodes);
+      client::ClientBase::SharedPtr client;
+      if (!resolve_handle(client_index_, *it, client, any_exec)) {
+        ++it;
+        continue;
+      }
       if (client) {
-        // Find the group for this handle and see if it can be serviced
-        auto group = get_group_by_client(client, weak_nodes);
-        if (!group) {
-          // Group was not found, meaning the service is not valid...
-          // Remove it from the ready list and continue looking
-          client_handles_.erase(it);
-          continue;
-        }
-        if (!group->can_be_taken_from().load()) {
-          // Group is mutually exclusive and is being used, so skip it for now
-          // Leave it to be checked next time, but continue searching
-          ++it;
-          continue;
-        }
-        // Otherwise it is safe to set and return the any_exec
-        any_exec->client = client;
-        any_exec->callback_group = group;
-        any_exec->node = get_node_by_group(group, weak_nodes);
+        any_exec.client = client;
+        advance_cursor(client_index_, *it, next_client_order_);
         client_handles_.erase(it);
         return;
       }
-      // Else, the service is no longer valid, remove it and continue
-      client_handles_.erase(it);
+      // Else, the client is no longer valid, remove it and continue
+      it = client_handles_.erase(it);
     }
+    get_next_client_continuation(any_exec);
+  }
+
+  virtual void
+  get_next_timer(executor::AnyExecutable & any_exec, const WeakNodeVector &)
+  {
+    auto it = timer_handles_.begin();
+    while (it != timer_handles_.end()) {
+      timer::TimerBase::SharedPtr timer;
+      if (!resolve_handle(timer_index_, *it, timer, any_exec)) {
+        ++it;
+        continue;
+      }
+      if (timer && timer->is_ready()) {
+        any_exec.timer = timer;
+        advance_cursor(timer_index_, *it, next_timer_order_);
+        timer_handles_.erase(it);
+        return;
+      }
+      // Else, the timer is no longer valid or not ready anymore, remove it and continue
+      any_exec.callback_group.reset();
+      any_exec.node.reset();
+      it = timer_handles_.erase(it);
+    }
+  }
+
+  /// Pick the ready executable of the most urgent callback group.
+  /**
+   * If no collected group has a priority or a deadline, this is the default type ordered
+   * selection. Otherwise ready work is ordered by deadline (earliest first, for groups which
+   * have one), then by priority. A group which has been passed over starvation_limit times in a
+   * row while it had ready work is run next regardless.
+   */
+  virtual void
+  get_next_ready_executable(executor::AnyExecutable & any_exec,
+    const WeakNodeVector & weak_nodes)
+  {
+    if (!use_group_priorities_) {
+      if (fair_scheduling_) {
+        get_next_fair_executable(any_exec, weak_nodes);
+      } else {
+        memory_strategy::MemoryStrategy::get_next_ready_executable(any_exec, weak_nodes);
+      }
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (auto & pair : group_schedules_) {
+      pair.second.ready = false;
+    }
+    Candidate best;
+    consider_ready_handles(0, timer_handles_, timer_index_, now, best);
+    consider_ready_handles(1, subscription_handles_, subscription_index_, now, best);
+    consider_ready_handles(
+      4, intra_process_guard_conditions_, intra_process_index_, now, best);
+    consider_ready_handles(2, service_handles_, service_index_, now, best);
+    consider_ready_handles(
+      5, intra_process_service_guard_conditions_, intra_process_service_index_, now, best);
+    consider_ready_handles(3, client_handles_, client_index_, now, best);
+    consider_ready_handles(
+      6, client_continuation_guard_conditions_, client_continuation_index_, now, best);
+    for (auto & pair : group_schedules_) {
+      GroupSchedule & schedule = pair.second;
+      if (&schedule == best.schedule || !schedule.ready) {
+        schedule.pending = false;
+        schedule.times_passed_over = 0;
+      } else {
+        ++schedule.times_passed_over;
+      }
+    }
+    // Move the chosen handle to the front of its list and let the regular lookup claim it.
+    switch (best.list) {
+      case 0:
+        move_to_front(timer_handles_, best.position);
+        get_next_timer(any_exec, weak_nodes);
+        break;
+      case 1:
+        move_to_front(subscription_handles_, best.position);
+        get_next_subscription(any_exec, weak_nodes);
+        break;
+      case 2:
+        move_to_front(service_handles_, best.position);
+        get_next_service(any_exec, weak_nodes);
+        break;
+      case 3:
+        move_to_front(client_handles_, best.position);
+        get_next_client(any_exec, weak_nodes);
+        break;
+      case 4:
+        move_to_front(intra_process_guard_conditions_, best.position);
+        get_next_intra_process_subscription(any_exec);
+        break;
+      case 5:
+        move_to_front(intra_process_service_guard_conditions_, best.position);
+        get_next_intra_process_service(any_exec);
+        break;
+      case 6:
+        move_to_front(client_continuation_guard_conditions_, best.position);
+        get_next_client_continuation(any_exec);
+        break;
+      default:
+        break;
+    }
+    if (!any_exec.has_work()) {
+      // Nothing could be claimed, fall back to the default order which also drops stale handles.
+      memory_strategy::MemoryStrategy::get_next_ready_executable(any_exec, weak_nodes);
+    }
+  }
+
+  /// Enable or disable round-robin selection of ready work.
+  /**
+   * By default ready work is served in collection order, timers first, which under saturation
+   * favours the entities of the nodes and groups that were added first. With fair scheduling the
+   * starting point rotates: within each kind the search starts after the last served entity, and
+   * the kind that is looked at first rotates through timers, subscriptions, services and clients.
+   * Callback group priorities and deadlines, if any are set, take precedence.
+   */
+  void set_fair_scheduling(bool fair_scheduling)
+  {
+    fair_scheduling_ = fair_scheduling;
+  }
+
+  /// Set how often a group with ready work may be passed over before it is run regardless.
+  void set_starvation_limit(size_t starvation_limit)
+  {
+    starvation_limit_ = starvation_limit;
   }
 
   virtual rcl_allocator_t get_allocator()
@@ -363,7 +657,14 @@ public:
 
   size_t number_of_guard_conditions() const
   {
-    return guard_conditions_.size();
+    return guard_conditions_.size() + intra_process_guard_conditions_.size() +
+           intra_process_service_guard_conditions_.size() +
+           client_continuation_guard_conditions_.size();
+  }
+
+  std::chrono::nanoseconds time_until_next_timer() const
+  {
+    return timer_queue_.time_until_next();
   }
 
   size_t number_of_ready_timers() const
@@ -376,13 +677,407 @@ private:
   using VectorRebind =
       std::vector<T, typename std::allocator_traits<Alloc>::template rebind_alloc<T>>;
 
+  /// Scheduling bookkeeping kept per callback group across waits.
+  /**
+   * The schedules are looked up by the address of their group, so each one also keeps a weak
+   * reference to its group, to tell it from a later group at the same address.
+   */
+  struct GroupSchedule
+  {
+    std::weak_ptr<callback_group::CallbackGroup> group;
+    bool collected = false;
+    bool ready = false;
+    bool pending = false;
+    std::chrono::steady_clock::time_point ready_since;
+    size_t times_passed_over = 0;
+    /// The generation of the group and its value when the entities were collected.
+    callback_group::GroupGeneration::SharedPtr generation;
+    uint64_t collected_generation = 0;
+  };
+
+  /// Entity, group and node resolved for a handle when the entities were collected.
+  /**
+   * Only weak references are kept, so the index does not extend the lifetime of anything.
+   */
+  template<typename EntityT>
+  struct EntityRecord
+  {
+    std::weak_ptr<EntityT> entity;
+    std::weak_ptr<callback_group::CallbackGroup> group;
+    std::weak_ptr<node::Node> node;
+    GroupSchedule * schedule;
+    /// Position of the handle in collection order, used by fair scheduling.
+    size_t order;
+    /// Statistics of the entity, if the executor records statistics.
+    executor::EntityStatistics::SharedPtr statistics;
+  };
+
+  template<typename HandleT, typename EntityT>
+  using HandleIndexRebind = std::unordered_map<
+      const HandleT *, EntityRecord<EntityT>, std::hash<const HandleT *>,
+      std::equal_to<const HandleT *>,
+      typename std::allocator_traits<Alloc>::template rebind_alloc<
+        std::pair<const HandleT * const, EntityRecord<EntityT>>>>;
+
+  /// A ready handle considered by the priority based selection.
+  struct Candidate
+  {
+    int list = -1;
+    size_t position = 0;
+    GroupSchedule * schedule = nullptr;
+    int priority = 0;
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  bool is_better_candidate(const Candidate & a, const Candidate & b) const
+  {
+    if (b.list < 0) {
+      return true;
+    }
+    bool a_starved = a.schedule->times_passed_over >= starvation_limit_;
+    bool b_starved = b.schedule->times_passed_over >= starvation_limit_;
+    if (a_starved != b_starved) {
+      return a_starved;
+    }
+    if (a_starved) {
+      return a.schedule->times_passed_over > b.schedule->times_passed_over;
+    }
+    if (a.has_deadline != b.has_deadline) {
+      return a.has_deadline;
+    }
+    if (a.has_deadline && a.deadline != b.deadline) {
+      return a.deadline < b.deadline;
+    }
+    return a.priority > b.priority;
+  }
+
+  template<typename HandleT, typename EntityT>
+  void
+  consider_ready_handles(
+    int list,
+    const VectorRebind<const HandleT *> & handles,
+    const HandleIndexRebind<HandleT, EntityT> & index,
+    std::chrono::steady_clock::time_point now,
+    Candidate & best)
+  {
+    for (size_t i = 0; i < handles.size(); ++i) {
+      auto it = index.find(handles[i]);
+      if (it == index.end()) {
+        continue;
+      }
+      auto group = it->second.group.lock();
+      if (!group || !group->can_be_taken_from().load()) {
+        continue;
+      }
+      GroupSchedule * schedule = it->second.schedule;
+      schedule->ready = true;
+      if (!schedule->pending) {
+        schedule->pending = true;
+        schedule->ready_since = now;
+      }
+      Candidate candidate;
+      candidate.list = list;
+      candidate.position = i;
+      candidate.schedule = schedule;
+      candidate.priority = group->get_priority();
+      candidate.has_deadline = group->get_deadline() > std::chrono::nanoseconds::zero();
+      if (candidate.has_deadline) {
+        candidate.deadline = schedule->ready_since + group->get_deadline();
+      }
+      if (is_better_candidate(candidate, best)) {
+        best = candidate;
+      }
+    }
+  }
+
+  /// Claim the subscription of the first ready intra process guard condition.
+  void get_next_intra_process_subscription(executor::AnyExecutable & any_exec)
+  {
+    auto it = intra_process_guard_conditions_.begin();
+    while (it != intra_process_guard_conditions_.end()) {
+      subscription::SubscriptionBase::SharedPtr subscription;
+      if (!resolve_handle(intra_process_index_, *it, subscription, any_exec)) {
+        ++it;
+        continue;
+      }
+      if (subscription) {
+        any_exec.subscription_intra_process = subscription;
+        advance_cursor(intra_process_index_, *it, next_intra_process_order_);
+        intra_process_guard_conditions_.erase(it);
+        return;
+      }
+      // Else, the subscription is no longer valid, remove it and continue
+      it = intra_process_guard_conditions_.erase(it);
+    }
+  }
+
+  /// Claim the service of the first ready intra process service guard condition.
+  void get_next_intra_process_service(executor::AnyExecutable & any_exec)
+  {
+    auto it = intra_process_service_guard_conditions_.begin();
+    while (it != intra_process_service_guard_conditions_.end()) {
+      service::ServiceBase::SharedPtr service;
+      if (!resolve_handle(intra_process_service_index_, *it, service, any_exec)) {
+        ++it;
+        continue;
+      }
+      if (service) {
+        any_exec.service_intra_process = service;
+        advance_cursor(
+          intra_process_service_index_, *it, next_intra_process_service_order_);
+        intra_process_service_guard_conditions_.erase(it);
+        return;
+      }
+      // Else, the service is no longer valid, remove it and continue
+      it = intra_process_service_guard_conditions_.erase(it);
+    }
+  }
+
+  /// Claim the client of the first ready continuation guard condition.
+  void get_next_client_continuation(executor::AnyExecutable & any_exec)
+  {
+    auto it = client_continuation_guard_conditions_.begin();
+    while (it != client_continuation_guard_conditions_.end()) {
+      client::ClientBase::SharedPtr client;
+      if (!resolve_handle(client_continuation_index_, *it, client, any_exec)) {
+        ++it;
+        continue;
+      }
+      if (client) {
+        any_exec.client_continuation = client;
+        advance_cursor(
+          client_continuation_index_, *it, next_client_continuation_order_);
+        client_continuation_guard_conditions_.erase(it);
+        return;
+      }
+      // Else, the client is no longer valid, remove it and continue
+      it = client_continuation_guard_conditions_.erase(it);
+    }
+  }
+
+  /// Claim the next ready executable, rotating the starting point as described in
+  /// set_fair_scheduling.
+  void get_next_fair_executable(executor::AnyExecutable & any_exec,
+    const WeakNodeVector & weak_nodes)
+  {
+    rotate_to_cursor(timer_handles_, timer_index_, next_timer_order_);
+    rotate_to_cursor(subscription_handles_, subscription_index_, next_subscription_order_);
+    rotate_to_cursor(
+      intra_process_guard_conditions_, intra_process_index_, next_intra_process_order_);
+    rotate_to_cursor(service_handles_, service_index_, next_service_order_);
+    rotate_to_cursor(
+      intra_process_service_guard_conditions_, intra_process_service_index_,
+      next_intra_process_service_order_);
+    rotate_to_cursor(client_handles_, client_index_, next_client_order_);
+    rotate_to_cursor(
+      client_continuation_guard_conditions_, client_continuation_index_,
+      next_client_continuation_order_);
+    for (size_t i = 0; i < 4; ++i) {
+      size_t kind = (next_kind_ + i) % 4;
+      switch (kind) {
+        case 0:
+          get_next_timer(any_exec, weak_nodes);
+          break;
+        case 1:
+          get_next_subscription(any_exec, weak_nodes);
+          break;
+        case 2:
+          get_next_service(any_exec, weak_nodes);
+          break;
+        default:
+          get_next_client(any_exec, weak_nodes);
+          break;
+      }
+      if (any_exec.has_work()) {
+        next_kind_ = (kind + 1) % 4;
+        return;
+      }
+    }
+  }
+
+  /// Move the ready handle which comes first at or after cursor in collection order, wrapping
+  /// around, to the front of handles.
+  template<typename HandleT, typename EntityT>
+  static void
+  rotate_to_cursor(
+    VectorRebind<const HandleT *> & handles,
+    const HandleIndexRebind<HandleT, EntityT> & index,
+    size_t cursor)
+  {
+    size_t best_position = 0;
+    size_t best_distance = std::numeric_limits<size_t>::max();
+    for (size_t i = 0; i < handles.size(); ++i) {
+      auto it = index.find(handles[i]);
+      if (it == index.end()) {
+        continue;
+      }
+      // Distance from the cursor going forward; orders before the cursor come after the wrap.
+      size_t order = it->second.order;
+      size_t distance = order >= cursor ?
+        order - cursor : std::numeric_limits<size_t>::max() / 2 + order;
+      if (distance < best_distance) {
+        best_distance = distance;
+        best_position = i;
+      }
+    }
+    if (best_position != 0) {
+      move_to_front(handles, best_position);
+    }
+  }
+
+  /// Remember the collection order position following handle as the next place to start from.
+  template<typename HandleT, typename EntityT>
+  void
+  advance_cursor(
+    const HandleIndexRebind<HandleT, EntityT> & index,
+    const HandleT * handle,
+    size_t & cursor) const
+  {
+    if (!fair_scheduling_) {
+      return;
+    }
+    auto it = index.find(handle);
+    if (it != index.end()) {
+      cursor = it->second.order + 1;
+    }
+  }
+
+  template<typename HandleT>
+  static void
+  move_to_front(VectorRebind<const HandleT *> & handles, size_t position)
+  {
+    std::rotate(handles.begin(), handles.begin() + position, handles.begin() + position + 1);
+  }
+
+  /// Resolve a ready handle through the index and claim it if its group can be taken from.
+  /**
+   * \return true if the handle is done with (claimed or no longer valid) and should be removed
+   * from the ready list, false if it must be left for a later pass.
+   */
+  template<typename HandleT, typename EntityT>
+  static bool
+  resolve_handle(
+    const HandleIndexRebind<HandleT, EntityT> & index,
+    const HandleT * handle,
+    std::shared_ptr<EntityT> & entity,
+    executor::AnyExecutable & any_exec)
+  {
+    auto it = index.find(handle);
+    if (it == index.end()) {
+      return true;
+    }
+    entity = it->second.entity.lock();
+    if (!entity) {
+      return true;
+    }
+    auto group = it->second.group.lock();
+    if (!group) {
+      // Group was not found, meaning the entity is not valid...
+      entity.reset();
+      return true;
+    }
+    if (!group->can_be_taken_from().load()) {
+      // Group is mutually exclusive and is being used, so skip it for now
+      // Leave it to be checked next time, but continue searching
+      entity.reset();
+      return false;
+    }
+    // Otherwise it is safe to set the any_exec
+    any_exec.callback_group = group;
+    any_exec.node = it->second.node.lock();
+    any_exec.statistics = it->second.statistics;
+    return true;
+  }
+
+  executor::EntityStatistics::SharedPtr
+  resolve_statistics(const void * handle, std::shared_ptr<const void> entity)
+  {
+    if (!executor_statistics_ || !handle) {
+      return nullptr;
+    }
+    return executor_statistics_->get_entity_statistics(handle, std::move(entity));
+  }
+
+  /// Check that nothing referenced by the cached handles has been destroyed since collection.
+  /**
+   * Entities tell their group when they are destroyed, so this compares one generation per
+   * group rather than checking the weak pointer of every entity.
+   */
+  bool cached_entities_are_valid(const WeakNodeVector & weak_nodes) const
+  {
+    for (auto & weak_node : weak_nodes) {
+      if (weak_node.expired()) {
+        return false;
+      }
+    }
+    for (auto & pair : group_schedules_) {
+      const GroupSchedule & schedule = pair.second;
+      if (schedule.collected && schedule.generation->get() != schedule.collected_generation) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Refill the ready handles from the cache; this reuses the capacity of the ready vectors.
+  void restore_cached_handles()
+  {
+    subscription_handles_ = cached_subscription_handles_;
+    intra_process_guard_conditions_ = cached_intra_process_guard_conditions_;
+    service_handles_ = cached_service_handles_;
+    intra_process_service_guard_conditions_ = cached_intra_process_service_guard_conditions_;
+    client_handles_ = cached_client_handles_;
+    client_continuation_guard_conditions_ = cached_client_continuation_guard_conditions_;
+  }
+
   VectorRebind<const rcl_guard_condition_t *> guard_conditions_;
 
   VectorRebind<const rcl_subscription_t *> subscription_handles_;
+  VectorRebind<const rcl_guard_condition_t *> intra_process_guard_conditions_;
   VectorRebind<const rcl_service_t *> service_handles_;
+  VectorRebind<const rcl_guard_condition_t *> intra_process_service_guard_conditions_;
   VectorRebind<const rcl_client_t *> client_handles_;
+  VectorRebind<const rcl_guard_condition_t *> client_continuation_guard_conditions_;
   VectorRebind<const rcl_timer_t *> timer_handles_;
 
+  bool entities_dirty_ = true;
+  executor::ExecutorStatistics * executor_statistics_ = nullptr;
+  VectorRebind<const rcl_subscription_t *> cached_subscription_handles_;
+  VectorRebind<const rcl_guard_condition_t *> cached_intra_process_guard_conditions_;
+  VectorRebind<const rcl_service_t *> cached_service_handles_;
+  VectorRebind<const rcl_guard_condition_t *> cached_intra_process_service_guard_conditions_;
+  VectorRebind<const rcl_client_t *> cached_client_handles_;
+  VectorRebind<const rcl_guard_condition_t *> cached_client_continuation_guard_conditions_;
+  timer::TimerQueue<Alloc> timer_queue_;
+
+  HandleIndexRebind<rcl_subscription_t, subscription::SubscriptionBase> subscription_index_;
+  HandleIndexRebind<rcl_guard_condition_t, subscription::SubscriptionBase> intra_process_index_;
+  HandleIndexRebind<rcl_service_t, service::ServiceBase> service_index_;
+  HandleIndexRebind<rcl_guard_condition_t, service::ServiceBase> intra_process_service_index_;
+  HandleIndexRebind<rcl_client_t, client::ClientBase> client_index_;
+  HandleIndexRebind<rcl_guard_condition_t, client::ClientBase> client_continuation_index_;
+  HandleIndexRebind<rcl_timer_t, timer::TimerBase> timer_index_;
+
+  std::unordered_map<
+    const callback_group::CallbackGroup *, GroupSchedule,
+    std::hash<const callback_group::CallbackGroup *>,
+    std::equal_to<const callback_group::CallbackGroup *>,
+    typename std::allocator_traits<Alloc>::template rebind_alloc<
+      std::pair<const callback_group::CallbackGroup * const, GroupSchedule>>> group_schedules_;
+  bool use_group_priorities_ = false;
+  size_t starvation_limit_ = 16;
+
+  bool fair_scheduling_ = false;
+  size_t next_kind_ = 0;
+  size_t next_timer_order_ = 0;
+  size_t next_subscription_order_ = 0;
+  size_t next_intra_process_order_ = 0;
+  size_t next_service_order_ = 0;
+  size_t next_intra_process_service_order_ = 0;
+  size_t next_client_order_ = 0;
+  size_t next_client_continuation_order_ = 0;
+
   std::shared_ptr<ExecAlloc> executable_allocator_;
   std::shared_ptr<VoidAlloc> allocator_;
 };
@@ -0,0 +1,378 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__STRATEGIES__LOCK_FREE_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
+#define RCLCPP__STRATEGIES__LOCK_FREE_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/message_memory_strategy.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace strategies
+{
+namespace message_pool_memory_strategy
+{
+
+/// What borrow_message does when all messages of the pool are in use.
+enum class PoolExhaustedPolicy
+{
+  /// Add as many messages as the pool has to it, and hand out one of them.
+  Grow,
+  /// Wait until a message is released.
+  Block
+};
+
+/// Message pool which can be shared by threads, without locks in the common case.
+/**
+ * Like MessagePoolMemoryStrategy, this hands out preallocated messages, but it
+ * can be used by several threads at once, e.g. by a MultiThreadedExecutor
+ * running a subscription of a reentrant callback group.
+ *
+ * The free messages are kept in a lock-free stack of slot indices. A borrowed
+ * message is owned by a shared_ptr whose control block is placed in the
+ * message's slot and knows the slot index, so when the last reference to the
+ * message goes away, whether in return_message or later in user code which kept
+ * it, the slot is pushed back in constant time and without allocating.
+ *
+ * When all messages are in use, the pool either grows or blocks, see
+ * PoolExhaustedPolicy; growing and blocking take a mutex.
+ * Each borrowed message is default constructed, and it is destroyed once released.
+ */
+template<
+  typename MessageT,
+  size_t Size,
+  typename std::enable_if<
+    rosidl_generator_traits::has_fixed_size<MessageT>::value
+  >::type * = nullptr
+>
+class LockFreeMessagePoolMemoryStrategy
+  : public message_memory_strategy::MessageMemoryStrategy<MessageT>
+{
+  static_assert(Size > 0, "the message pool must not be empty");
+
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(LockFreeMessagePoolMemoryStrategy);
+
+  /// Constructor.
+  /**
+   * \param[in] policy What to do when all messages are in use.
+   */
+  explicit LockFreeMessagePoolMemoryStrategy(
+    PoolExhaustedPolicy policy = PoolExhaustedPolicy::Grow)
+  : pool_(std::make_shared<Pool>(policy))
+  {}
+
+  /// Borrow a free message from the pool.
+  /**
+   * \return Shared pointer to the borrowed message.
+   */
+  std::shared_ptr<MessageT> borrow_message()
+  {
+    uint32_t index = pool_->acquire();
+    Slot & slot = pool_->get_slot(index);
+    MessageT * message;
+    try {
+      message = new (&slot.message) MessageT();
+    } catch (...) {
+      pool_->release(index);
+      throw;
+    }
+    // If the control block does not fit into the slot, the shared_ptr constructor destroys the
+    // message and rethrows, with the allocator never having been used to deallocate.
+    try {
+      return std::shared_ptr<MessageT>(message, Destroyer(), SlotAllocator<MessageT>(pool_, index));
+    } catch (...) {
+      pool_->release(index);
+      throw;
+    }
+  }
+
+  /// Return a message to the message pool.
+  /**
+   * The message goes back to the pool once the last reference to it is gone.
+   * \param[in] msg Shared pointer to the message to return.
+   */
+  void return_message(std::shared_ptr<MessageT> & msg)
+  {
+    msg.reset();
+  }
+
+  /// Return the number of messages in the pool, in use or not.
+  size_t get_capacity() const
+  {
+    return pool_->get_capacity();
+  }
+
+private:
+  /// Space for the shared_ptr control block in a slot, which holds the deleter and allocator.
+  static const size_t control_block_capacity = 128;
+  /// The pool doubles when it grows, so this gives room for Size * (2^max_chunks - 1) messages.
+  static const size_t max_chunks = 24;
+  static const uint32_t no_index = std::numeric_limits<uint32_t>::max();
+
+  struct Slot
+  {
+    typename std::aligned_storage<sizeof(MessageT), alignof(MessageT)>::type message;
+    typename std::aligned_storage<control_block_capacity>::type control_block;
+    std::atomic<uint32_t> next;
+  };
+
+  class Pool
+  {
+  public:
+    explicit Pool(PoolExhaustedPolicy policy)
+    : policy_(policy), head_(make_head(0, no_index)), number_of_chunks_(0), waiters_(0)
+    {
+      for (auto & chunk : chunks_) {
+        chunk.store(nullptr);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      add_chunk();
+    }
+
+    ~Pool()
+    {
+      for (size_t i = 0; i < number_of_chunks_.load(); ++i) {
+        delete[] chunks_[i].load();
+      }
+    }
+
+    /// Pop a free slot, growing or blocking if there is none.
+    uint32_t
+    acquire()
+    {
+      uint32_t index = pop();
+      if (index != no_index) {
+        return index;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (policy_ == PoolExhaustedPolicy::Grow) {
+        // Another thread may have grown the pool meanwhile.
+        index = pop();
+        return index != no_index ? index : add_chunk();
+      }
+      // The releasing thread checks waiters_ after pushing, so either it notifies or pop finds
+      // the released slot.
+      ++waiters_;
+      while ((index = pop()) == no_index) {
+        condition_.wait(lock);
+      }
+      --waiters_;
+      return index;
+    }
+
+    /// Push a slot back, this is called once its control block is gone.
+    void
+    release(uint32_t index)
+    {
+      push(index);
+      if (waiters_.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        condition_.notify_one();
+      }
+    }
+
+    Slot &
+    get_slot(uint32_t index) const
+    {
+      // Chunk k holds the indices [Size * (2^k - 1), Size * (2^(k + 1) - 1)).
+      size_t chunk = 0;
+      size_t quotient = index / Size + 1;
+      while (quotient >>= 1) {
+        ++chunk;
+      }
+      size_t offset = index - Size * ((static_cast<size_t>(1) << chunk) - 1);
+      return chunks_[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    size_t
+    get_capacity() const
+    {
+      return Size * ((static_cast<size_t>(1) << number_of_chunks_.load()) - 1);
+    }
+
+  private:
+    /// The head of the free list, tagged with a counter against the ABA problem.
+    static uint64_t
+    make_head(uint32_t tag, uint32_t index)
+    {
+      return (static_cast<uint64_t>(tag) << 32) | index;
+    }
+
+    uint32_t
+    pop()
+    {
+      uint64_t head = head_.load();
+      while (true) {
+        uint32_t index = static_cast<uint32_t>(head);
+        if (index == no_index) {
+          return no_index;
+        }
+        uint32_t next = get_slot(index).next.load();
+        uint64_t new_head = make_head(static_cast<uint32_t>(head >> 32) + 1, next);
+        if (head_.compare_exchange_weak(head, new_head)) {
+          return index;
+        }
+      }
+    }
+
+    void
+    push(uint32_t index)
+    {
+      Slot & slot = get_slot(index);
+      uint64_t head = head_.load();
+      while (true) {
+        slot.next.store(static_cast<uint32_t>(head));
+        uint64_t new_head = make_head(static_cast<uint32_t>(head >> 32) + 1, index);
+        if (head_.compare_exchange_weak(head, new_head)) {
+          return;
+        }
+      }
+    }
+
+    /// Add the next chunk, push all but its first slot and return that one; mutex_ must be held.
+    uint32_t
+    add_chunk()
+    {
+      size_t chunk = number_of_chunks_.load();
+      size_t first = get_capacity();
+      size_t count = Size << chunk;
+      if (chunk >= max_chunks || first + count >= no_index) {
+        throw std::bad_alloc();
+      }
+      chunks_[chunk].store(new Slot[count], std::memory_order_release);
+      number_of_chunks_.store(chunk + 1);
+      for (size_t i = count - 1; i > 0; --i) {
+        push(static_cast<uint32_t>(first + i));
+      }
+      if (chunk == 0) {
+        // The first chunk is filled up completely when the pool is constructed.
+        push(static_cast<uint32_t>(first));
+        return no_index;
+      }
+      return static_cast<uint32_t>(first);
+    }
+
+    PoolExhaustedPolicy policy_;
+    std::atomic<uint64_t> head_;
+    std::array<std::atomic<Slot *>, max_chunks> chunks_;
+    std::atomic<size_t> number_of_chunks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::atomic<size_t> waiters_;
+  };
+
+  /// Deleter of borrowed messages, the slot itself is released with the control block.
+  struct Destroyer
+  {
+    void operator()(MessageT * message) const
+    {
+      message->~MessageT();
+    }
+  };
+
+  /// Allocator placing the control block of a borrowed message into the message's slot.
+  /* Releasing the slot in deallocate, rather than in the deleter, guarantees that the slot is
+   * not handed out again while the control block is still being destroyed.
+   * It keeps the pool alive as long as messages are in use.
+   */
+  template<typename T>
+  struct SlotAllocator
+  {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+      using other = SlotAllocator<U>;
+    };
+
+    SlotAllocator(std::shared_ptr<Pool> pool, uint32_t index)
+    : pool_(pool), index_(index)
+    {}
+
+    template<typename U>
+    SlotAllocator(const SlotAllocator<U> & other)  // NOLINT(runtime/explicit)
+    : pool_(other.pool_), index_(other.index_)
+    {}
+
+    T *
+    allocate(size_t n)
+    {
+      static_assert(alignof(T) <= alignof(decltype(Slot::control_block)),
+        "control block alignment is not supported");
+      if (n * sizeof(T) > control_block_capacity) {
+        throw std::bad_alloc();
+      }
+      return reinterpret_cast<T *>(&pool_->get_slot(index_).control_block);
+    }
+
+    void
+    deallocate(T *, size_t)
+    {
+      pool_->release(index_);
+    }
+
+    template<typename U>
+    bool
+    operator==(const SlotAllocator<U> & other) const
+    {
+      return pool_ == other.pool_ && index_ == other.index_;
+    }
+
+    template<typename U>
+    bool
+    operator!=(const SlotAllocator<U> & other) const
+    {
+      return !(*this == other);
+    }
+
+    std::shared_ptr<Pool> pool_;
+    uint32_t index_;
+  };
+
+  std::shared_ptr<Pool> pool_;
+};
+
+template<typename MessageT, size_t Size,
+  typename std::enable_if<rosidl_generator_traits::has_fixed_size<MessageT>::value>::type * E>
+const size_t LockFreeMessagePoolMemoryStrategy<MessageT, Size, E>::control_block_capacity;
+
+template<typename MessageT, size_t Size,
+  typename std::enable_if<rosidl_generator_traits::has_fixed_size<MessageT>::value>::type * E>
+const size_t LockFreeMessagePoolMemoryStrategy<MessageT, Size, E>::max_chunks;
+
+template<typename MessageT, size_t Size,
+  typename std::enable_if<rosidl_generator_traits::has_fixed_size<MessageT>::value>::type * E>
+const uint32_t LockFreeMessagePoolMemoryStrategy<MessageT, Size, E>::no_index;
+
+}  // namespace message_pool_memory_strategy
+}  // namespace strategies
+}  // namespace rclcpp
+
+#endif  // RCLCPP__STRATEGIES__LOCK_FREE_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
@@ -0,0 +1,335 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__STRATEGIES__RETAINING_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
+#define RCLCPP__STRATEGIES__RETAINING_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/message_memory_strategy.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace strategies
+{
+namespace message_pool_memory_strategy
+{
+
+/// Message pool which keeps the storage of its messages across reuse.
+/**
+ * Unlike MessagePoolMemoryStrategy, this works with any message type, including
+ * messages with unbounded strings and sequences.
+ * Messages are constructed once and are never destroyed while they are in the
+ * pool, so strings and sequences keep the capacity they grew to.
+ * After warm-up rcl_take deserializes into storage which is already allocated,
+ * since resizing a sequence or assigning a string within its capacity does not
+ * allocate.
+ *
+ * A reset function may be given to clear a message before it is reused, e.g.
+ * to call clear() on its sequences, which resets their size but keeps their
+ * capacity.
+ * By default messages are handed out as they were returned, since rcl_take
+ * overwrites every field.
+ *
+ * The pool starts with Size messages.
+ * When all of them are in use, a new message is allocated, and it is kept in
+ * the pool once it is released, so the pool grows to the largest number of
+ * messages in use at once.
+ * The control block of the shared_ptr handing out a message is placed next to
+ * the message, so once the pool has grown, borrowing does not allocate.
+ * A message goes back to the pool once the last reference to it is gone, so
+ * callbacks may keep the messages they were given.
+ * Borrowing and returning messages is thread-safe.
+ */
+template<typename MessageT, size_t Size>
+class RetainingMessagePoolMemoryStrategy
+  : public message_memory_strategy::MessageMemoryStrategy<MessageT>
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(RetainingMessagePoolMemoryStrategy);
+
+  using ResetFunction = std::function<void(MessageT &)>;
+
+  /// Constructor.
+  /**
+   * If the reset function throws, the message is replaced by a new one.
+   * \param[in] reset Optional function called on each message before it is reused.
+   */
+  explicit RetainingMessagePoolMemoryStrategy(ResetFunction reset = nullptr)
+  : pool_(std::make_shared<Pool>(reset))
+  {}
+
+  /// Borrow a free message from the pool, or a new message if none is free.
+  /**
+   * \return Shared pointer to the borrowed message.
+   */
+  std::shared_ptr<MessageT> borrow_message()
+  {
+    Entry * entry = pool_->acquire();
+    // If the control block does not fit into the entry, the shared_ptr constructor calls the
+    // resetter and rethrows, with the allocator never having been used to deallocate.
+    try {
+      return std::shared_ptr<MessageT>(
+        &entry->message(), Resetter(pool_.get(), entry), EntryAllocator<MessageT>(pool_, entry));
+    } catch (...) {
+      pool_->release(entry);
+      throw;
+    }
+  }
+
+  /// Return a message to the message pool.
+  /**
+   * The message goes back to the pool once the last reference to it is gone.
+   * \param[in] msg Shared pointer to the message to return.
+   */
+  void return_message(std::shared_ptr<MessageT> & msg)
+  {
+    msg.reset();
+  }
+
+  /// Return the number of messages in the pool, in use or not.
+  size_t get_capacity() const
+  {
+    return pool_->get_capacity();
+  }
+
+private:
+  /// Space for the shared_ptr control block in an entry, which holds the deleter and allocator.
+  static const size_t control_block_capacity = 128;
+
+  /// A pooled message, with room for the control block of the shared_ptr handing it out.
+  /* Placing the control block here means that borrowing a message does not allocate.
+   */
+  struct Entry
+  {
+    Entry()
+    : constructed(false)
+    {
+      construct();
+    }
+
+    ~Entry()
+    {
+      if (constructed) {
+        message().~MessageT();
+      }
+    }
+
+    MessageT &
+    message()
+    {
+      return *reinterpret_cast<MessageT *>(&message_storage);
+    }
+
+    void
+    construct()
+    {
+      new (&message_storage) MessageT();
+      constructed = true;
+    }
+
+    typename std::aligned_storage<sizeof(MessageT), alignof(MessageT)>::type message_storage;
+    /// False if the message was destroyed and constructing its replacement failed.
+    bool constructed;
+    typename std::aligned_storage<control_block_capacity>::type control_block;
+  };
+
+  class Pool
+  {
+public:
+    explicit Pool(ResetFunction reset)
+    : reset_(reset), capacity_(0)
+    {
+      free_entries_.reserve(Size);
+      for (size_t i = 0; i < Size; ++i) {
+        free_entries_.push_back(new Entry());
+        ++capacity_;
+      }
+    }
+
+    ~Pool()
+    {
+      // Messages in use keep the pool alive, so all of them are free now.
+      for (auto entry : free_entries_) {
+        delete entry;
+      }
+    }
+
+    Entry * acquire()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_entries_.empty()) {
+          Entry * entry = free_entries_.back();
+          if (!entry->constructed) {
+            // Throws with the entry left in the pool.
+            entry->construct();
+          }
+          free_entries_.pop_back();
+          return entry;
+        }
+        // Reserve room now, so that release never allocates.
+        free_entries_.reserve(capacity_ + 1);
+        ++capacity_;
+      }
+      try {
+        return new Entry();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --capacity_;
+        throw;
+      }
+    }
+
+    /// Prepare a message for reuse, this is called when the last reference to it is gone.
+    /**
+     * This must not throw, since it is called by the deleter of the shared_ptr.
+     */
+    void reset(Entry * entry)
+    {
+      if (!reset_) {
+        return;
+      }
+      try {
+        reset_(entry->message());
+      } catch (...) {
+        // The message is in an unknown state, start over with a new one. The entry is marked
+        // empty first, so it is not destroyed twice if constructing the new message throws.
+        entry->message().~MessageT();
+        entry->constructed = false;
+        try {
+          entry->construct();
+        } catch (...) {
+          // Constructed again when the entry is acquired.
+        }
+      }
+    }
+
+    /// Push an entry back, this is called once its control block is gone.
+    void release(Entry * entry)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_entries_.push_back(entry);
+    }
+
+    size_t get_capacity() const
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return capacity_;
+    }
+
+private:
+    RCLCPP_DISABLE_COPY(Pool);
+
+    ResetFunction reset_;
+    mutable std::mutex mutex_;
+    std::vector<Entry *> free_entries_;
+    size_t capacity_;
+  };
+
+  /// Deleter of borrowed messages, which keeps the message itself alive for its next use.
+  struct Resetter
+  {
+    Resetter(Pool * pool, Entry * entry)
+    : pool_(pool), entry_(entry)
+    {}
+
+    void operator()(MessageT *) const
+    {
+      pool_->reset(entry_);
+    }
+
+    // The allocator of the same control block keeps the pool alive.
+    Pool * pool_;
+    Entry * entry_;
+  };
+
+  /// Allocator placing the control block of a borrowed message into the message's entry.
+  /* Releasing the entry in deallocate, rather than in the deleter, guarantees that the entry is
+   * not handed out again while the control block is still being destroyed.
+   * It keeps the pool alive as long as messages are in use.
+   */
+  template<typename T>
+  struct EntryAllocator
+  {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+      using other = EntryAllocator<U>;
+    };
+
+    EntryAllocator(std::shared_ptr<Pool> pool, Entry * entry)
+    : pool_(pool), entry_(entry)
+    {}
+
+    template<typename U>
+    EntryAllocator(const EntryAllocator<U> & other)  // NOLINT(runtime/explicit)
+    : pool_(other.pool_), entry_(other.entry_)
+    {}
+
+    T *
+    allocate(size_t n)
+    {
+      static_assert(alignof(T) <= alignof(decltype(Entry::control_block)),
+        "control block alignment is not supported");
+      if (n * sizeof(T) > control_block_capacity) {
+        throw std::bad_alloc();
+      }
+      return reinterpret_cast<T *>(&entry_->control_block);
+    }
+
+    void
+    deallocate(T *, size_t)
+    {
+      pool_->release(entry_);
+    }
+
+    template<typename U>
+    bool
+    operator==(const EntryAllocator<U> & other) const
+    {
+      return pool_ == other.pool_ && entry_ == other.entry_;
+    }
+
+    template<typename U>
+    bool
+    operator!=(const EntryAllocator<U> & other) const
+    {
+      return !(*this == other);
+    }
+
+    std::shared_ptr<Pool> pool_;
+    Entry * entry_;
+  };
+
+  std::shared_ptr<Pool> pool_;
+};
+
+template<typename MessageT, size_t Size>
+const size_t RetainingMessagePoolMemoryStrategy<MessageT, Size>::control_block_capacity;
+
+}  // namespace message_pool_memory_strategy
+}  // namespace strategies
+}  // namespace rclcpp
+
+#endif  // RCLCPP__STRATEGIES__RETAINING_MESSAGE_POOL_MEMORY_STRATEGY_HPP_
@@ -0,0 +1,80 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__STRATEGIES__SERVICE_POOL_MEMORY_STRATEGY_HPP_
+#define RCLCPP__STRATEGIES__SERVICE_POOL_MEMORY_STRATEGY_HPP_
+
+#include <memory>
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/service_memory_strategy.hpp"
+#include "rclcpp/strategies/retaining_message_pool_memory_strategy.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+#include "rmw/types.h"
+
+namespace rclcpp
+{
+namespace strategies
+{
+namespace service_pool_memory_strategy
+{
+
+/// Service memory strategy which recycles requests, responses and request headers.
+/**
+ * Each kind of object comes from its own RetainingMessagePoolMemoryStrategy,
+ * which starts with Size objects, grows to the largest number in use at once,
+ * and keeps the capacity of strings and sequences when an object is reused.
+ * Objects go back to their pool once the last reference to them is gone, so a
+ * response kept in the future of a client is not reused before it is released.
+ */
+template<typename ServiceT, size_t Size>
+class ServicePoolMemoryStrategy
+  : public service_memory_strategy::ServiceMemoryStrategy<ServiceT>
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(ServicePoolMemoryStrategy);
+
+  using Request = typename ServiceT::Request;
+  using Response = typename ServiceT::Response;
+
+  std::shared_ptr<Request> borrow_request()
+  {
+    return requests_.borrow_message();
+  }
+
+  std::shared_ptr<Response> borrow_response()
+  {
+    return responses_.borrow_message();
+  }
+
+  std::shared_ptr<rmw_request_id_t> borrow_request_header()
+  {
+    return request_headers_.borrow_message();
+  }
+
+private:
+  template<typename T>
+  using Pool = message_pool_memory_strategy::RetainingMessagePoolMemoryStrategy<T, Size>;
+
+  Pool<Request> requests_;
+  Pool<Response> responses_;
+  Pool<rmw_request_id_t> request_headers_;
+};
+
+}  // namespace service_pool_memory_strategy
+}  // namespace strategies
+}  // namespace rclcpp
+
+#endif  // RCLCPP__STRATEGIES__SERVICE_POOL_MEMORY_STRATEGY_HPP_
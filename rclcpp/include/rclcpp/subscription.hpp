@@ -18,13 +18,21 @@
 #include <rmw/error_handling.h>
 #include <rmw/rmw.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #include "rcl/error_handling.h"
+#include "rcl/guard_condition.h"
 #include "rcl/subscription.h"
 
 #include "rcl_interfaces/msg/intra_process_message.hpp"
@@ -32,6 +40,10 @@
 #include "rclcpp/macros.hpp"
 #include "rclcpp/message_memory_strategy.hpp"
 #include "rclcpp/any_subscription_callback.hpp"
+#include "rclcpp/callback_group_generation.hpp"
+#include "rclcpp/intra_process_batching.hpp"
+#include "rclcpp/message_throttle.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/type_support_decl.hpp"
 #include "rclcpp/visibility_control.hpp"
 
@@ -46,6 +58,26 @@ class Node;
 namespace subscription
 {
 
+/// What happens when a message is delivered to a full intra process queue.
+enum class IntraProcessQueuePolicy
+{
+  /// Drop the oldest queued message to make room for the new one.
+  KeepLast,
+  /// Block the publisher until the subscription has taken a message, for a bounded time.
+  BlockPublisher
+};
+
+/// Counters of the intra process messages of a subscription.
+struct IntraProcessStatistics
+{
+  /// Messages which were taken and passed to the callback.
+  uint64_t taken;
+  /// Messages dropped from the subscription's queue because it was full.
+  uint64_t dropped;
+  /// Messages displaced from the publisher's buffer before the subscription took them.
+  uint64_t overwritten;
+};
+
 /// Virtual base class for subscriptions. This pattern allows us to iterate over different template
 /// specializations of Subscription, among other things.
 class SubscriptionBase
@@ -82,6 +114,154 @@ public:
   virtual const rcl_subscription_t *
   get_intra_process_subscription_handle() const;
 
+  /// Set the maximum number of messages taken per wakeup of this subscription.
+  /**
+   * When the subscription is ready, the executor keeps taking and dispatching messages until
+   * either no more messages are available or this many have been handled, before returning to
+   * wait. The default of 1 takes a single message per wakeup.
+   * \param[in] take_batch_size Maximum number of messages per wakeup, must be at least 1.
+   * \throws std::invalid_argument if take_batch_size is 0.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_take_batch_size(size_t take_batch_size);
+
+  /// Get the maximum number of messages taken per wakeup of this subscription.
+  RCLCPP_PUBLIC
+  size_t
+  get_take_batch_size() const;
+
+  /// Get the guard condition signaling queued intra process messages, if directly delivered.
+  /**
+   * When intra process messages are delivered directly (see
+   * IntraProcessManager::set_direct_delivery), there is no intra process rcl subscription.
+   * Instead the intra process manager queues notifications in this subscription and triggers
+   * this guard condition, which executors wait on in place of the intra process subscription.
+   * \return The guard condition, or nullptr if intra process messages arrive through a topic.
+   */
+  RCLCPP_PUBLIC
+  const rcl_guard_condition_t *
+  get_intra_process_guard_condition() const;
+
+  /// Queue the notification of a new intra process message and wake up the executor.
+  /**
+   * If the queue is full, the oldest notification is dropped.
+   * This is called by the intra process manager when delivering directly.
+   * \param[in] publisher_id The intra process id of the publisher of the message.
+   * \param[in] message_sequence The sequence number of the message.
+   */
+  RCLCPP_PUBLIC
+  void
+  deliver_intra_process_message(uint64_t publisher_id, uint64_t message_sequence);
+
+  /// Take the oldest queued intra process message notification.
+  /**
+   * \param[out] ipm The publisher id and message sequence of the message.
+   * \return true if a notification was taken, false if the queue was empty.
+   */
+  RCLCPP_PUBLIC
+  bool
+  take_intra_process_notification(rcl_interfaces::msg::IntraProcessMessage & ipm);
+
+  /// Trigger the intra process guard condition again if notifications are still queued.
+  RCLCPP_PUBLIC
+  void
+  renotify_if_intra_process_pending();
+
+  /// Set the depth of the intra process queue and what happens when it is full.
+  /**
+   * The queue only exists when intra process messages are delivered directly (see
+   * IntraProcessManager::set_direct_delivery), its depth defaults to the depth of the qos
+   * profile of the subscription.
+   *
+   * With IntraProcessQueuePolicy::BlockPublisher, publishing to this subscription waits for room
+   * in the queue, but for at most max_block_time from the start of the publish, so a publish to
+   * several blocking subscriptions waits for the longest of their times, not their sum.
+   * After that the oldest message is dropped, as with IntraProcessQueuePolicy::KeepLast, so a
+   * publisher which is executed by the same thread as this subscription is slowed down but
+   * cannot deadlock.
+   *
+   * A queued message is still stored in the publisher's ring buffer, so a depth which is larger
+   * than the buffer size of a publisher (by default its queue size) does not keep more of its
+   * messages, they are overwritten there instead.
+   * \param[in] policy What to do when the queue is full.
+   * \param[in] depth Maximum number of queued messages, 0 for no limit.
+   * \param[in] max_block_time How long a publisher waits for room with BlockPublisher.
+   * \throws std::runtime_error if intra process messages are not delivered directly.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_intra_process_queue_policy(
+    IntraProcessQueuePolicy policy, size_t depth,
+    std::chrono::nanoseconds max_block_time = std::chrono::milliseconds(100));
+
+  RCLCPP_PUBLIC
+  IntraProcessQueuePolicy
+  get_intra_process_queue_policy() const;
+
+  RCLCPP_PUBLIC
+  size_t
+  get_intra_process_queue_depth() const;
+
+  /// Get the counters of taken, dropped and overwritten intra process messages.
+  RCLCPP_PUBLIC
+  IntraProcessStatistics
+  get_intra_process_statistics() const;
+
+  /// Get the number of inter process messages which were passed to the callback.
+  RCLCPP_PUBLIC
+  uint64_t
+  get_inter_process_taken_count() const;
+
+  /// Get the number of messages which were taken but rejected by the message filter.
+  RCLCPP_PUBLIC
+  uint64_t
+  get_filtered_count() const;
+
+  /// Limit the rate at which messages are passed to the callback.
+  /**
+   * Only one of every keep_every received messages is kept, and of those only the ones received
+   * at least min_period after the previous kept one; the others are dropped and counted, see
+   * get_throttled_count.
+   * The decision does not look at the message, so it is made before the message filter and
+   * before an intra process message is looked up or copied. Inter process messages still have
+   * to be taken, since the middleware cannot discard a message without deserializing it, but
+   * dropped ones are not filtered or dispatched.
+   * Setting the limits starts over, e.g. the next message is kept.
+   * \param[in] min_period Minimum time between two kept messages, 0 for no limit.
+   * \param[in] keep_every Keep one of every keep_every messages, 1 to keep all.
+   * \throws std::invalid_argument if min_period is negative or keep_every is 0.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_throttle(std::chrono::nanoseconds min_period, size_t keep_every = 1);
+
+  /// Get the number of messages which were dropped by the throttle.
+  RCLCPP_PUBLIC
+  uint64_t
+  get_throttled_count() const;
+
+  /// Wait until there is room in the intra process queue, if it blocks publishers.
+  /**
+   * This is called by the intra process manager before a message is stored, while no lock of the
+   * manager is held.
+   * \param[in] publish_start When the publish started, the wait ends max_block_time after it.
+   */
+  RCLCPP_PUBLIC
+  void
+  wait_for_intra_process_capacity(std::chrono::steady_clock::time_point publish_start);
+
+  /// Count a message which was displaced from a publisher's buffer before it was taken.
+  // This is called by the intra process manager.
+  RCLCPP_PUBLIC
+  void
+  on_intra_process_message_overwritten();
+
+  /// Get the membership in the callback group, which the group joins when this is added to it.
+  RCLCPP_PUBLIC
+  callback_group::GroupMembership &
+  get_group_membership();
+
   /// Borrow a new message.
   // \return Shared pointer to the fresh message.
   virtual std::shared_ptr<void>
@@ -104,6 +284,45 @@ public:
     const rmw_message_info_t & message_info) = 0;
 
 protected:
+  /// Set up the in process notification queue used for direct intra process delivery.
+  // \param[in] depth Maximum number of queued notifications, 0 for no limit.
+  RCLCPP_PUBLIC
+  void
+  setup_intra_process_queue(size_t depth);
+
+  /// Count an intra process message which was passed to the callback.
+  RCLCPP_PUBLIC
+  void
+  on_intra_process_message_taken();
+
+  /// Count an inter process message which was passed to the callback.
+  RCLCPP_PUBLIC
+  void
+  on_inter_process_message_taken();
+
+  /// Count a message which was rejected by the message filter.
+  RCLCPP_PUBLIC
+  void
+  on_message_filtered();
+
+  /// Decide whether the next received message is kept, or count it as throttled.
+  RCLCPP_PUBLIC
+  bool
+  throttle_accepts();
+
+  /// Return the first sequence number announced by an intra process notification.
+  /**
+   * Publishers may announce a batch of messages with a single notification, see
+   * PublisherBase::set_intra_process_notification_batching and
+   * intra_process_batching::SequenceTracker.
+   * \param[in] publisher_id The intra process id of the publisher.
+   * \param[in] last_sequence The notified sequence number, the last one announced.
+   * \param[in] max_messages Maximum number of messages announced, 0 for no limit.
+   */
+  RCLCPP_PUBLIC
+  uint64_t
+  begin_intra_process_batch(uint64_t publisher_id, uint64_t last_sequence, size_t max_messages);
+
   rcl_subscription_t intra_process_subscription_handle_ = rcl_get_zero_initialized_subscription();
   rcl_subscription_t subscription_handle_ = rcl_get_zero_initialized_subscription();
   std::shared_ptr<rcl_node_t> node_handle_;
@@ -112,6 +331,33 @@ private:
   RCLCPP_DISABLE_COPY(SubscriptionBase);
   std::string topic_name_;
   bool ignore_local_publications_;
+  std::atomic<size_t> take_batch_size_;
+
+  bool uses_intra_process_queue_;
+  rcl_guard_condition_t intra_process_guard_condition_ =
+    rcl_get_zero_initialized_guard_condition();
+  IntraProcessQueuePolicy intra_process_queue_policy_;
+  size_t intra_process_queue_depth_;
+  std::chrono::nanoseconds intra_process_max_block_time_;
+  std::deque<std::pair<uint64_t, uint64_t>> intra_process_queue_;
+  mutable std::mutex intra_process_queue_mutex_;
+  std::condition_variable intra_process_queue_condition_;
+
+  std::atomic<uint64_t> intra_process_taken_;
+  std::atomic<uint64_t> intra_process_dropped_;
+  std::atomic<uint64_t> intra_process_overwritten_;
+  std::atomic<uint64_t> inter_process_taken_;
+  std::atomic<uint64_t> filtered_;
+
+  std::atomic<bool> throttle_enabled_;
+  std::mutex throttle_mutex_;
+  message_throttle::MessageThrottle throttle_;
+  std::atomic<uint64_t> throttled_;
+
+  std::mutex intra_process_sequence_tracker_mutex_;
+  intra_process_batching::SequenceTracker intra_process_sequence_tracker_;
+
+  callback_group::GroupMembership group_membership_;
 };
 
 using any_subscription_callback::AnySubscriptionCallback;
@@ -127,6 +373,7 @@ public:
   using MessageAlloc = typename MessageAllocTraits::allocator_type;
   using MessageDeleter = allocator::Deleter<MessageAlloc, MessageT>;
   using MessageUniquePtr = std::unique_ptr<MessageT, MessageDeleter>;
+  using MessageFilter = std::function<bool(const MessageT &)>;
 
   RCLCPP_SMART_PTR_DEFINITIONS(Subscription);
 
@@ -153,7 +400,12 @@ public:
     any_callback_(callback),
     message_memory_strategy_(memory_strategy),
     get_intra_process_message_callback_(nullptr),
-    matches_any_intra_process_publishers_(nullptr)
+    get_intra_process_shared_message_callback_(nullptr),
+    matches_any_intra_process_publishers_(nullptr),
+    intra_process_depth_(0),
+    take_publisher_id_(0),
+    take_next_sequence_(1),
+    take_last_sequence_(0)
   {
     using rosidl_generator_cpp::get_message_type_support_handle;
 
@@ -178,11 +430,81 @@ public:
   {
     message_memory_strategy_ = message_memory_strategy;
   }
+
+  /// Set a predicate which messages have to satisfy to be passed to the callback.
+  /**
+   * The filter is applied to every message before the callback is called, messages for which it
+   * returns false are dropped and counted, see get_filtered_count.
+   * Inter process messages are still taken and deserialized before they can be filtered, but
+   * intra process messages are filtered where they are stored, so a dropped message is never
+   * copied for this subscription.
+   * For intra process messages the filter is called while the publisher's buffer is locked, so
+   * it should be quick and must not publish on the same topic.
+   * Behavior may be undefined if called while the subscription could be executing.
+   * \param[in] filter The predicate, or nullptr to pass all messages to the callback.
+   */
+  void set_message_filter(MessageFilter filter)
+  {
+    if (!filter) {
+      message_filter_ = nullptr;
+      return;
+    }
+    message_filter_ = [this, filter](const MessageT & message) -> bool {
+        if (filter(message)) {
+          return true;
+        }
+        on_message_filtered();
+        return false;
+      };
+  }
+
+  /// Take the next message without calling the callback, e.g. after a WaitSet reported it.
+  /**
+   * Inter process messages are taken first, then intra process messages. The throttle and the
+   * message filter apply, rejected messages are skipped.
+   * Taking messages this way should not be mixed with adding the subscription to an executor.
+   * \param[out] message The taken message. Inter process messages are deserialized into it, so
+   *   its memory is reused across takes.
+   * \param[out] message_info Information about the taken message.
+   * \return true if a message was taken, false if none was available.
+   * \throws std::runtime_error if taking a message failed.
+   */
+  bool take(MessageT & message, rmw_message_info_t & message_info)
+  {
+    while (true) {
+      rcl_ret_t ret = rcl_take(&subscription_handle_, &message, &message_info);
+      if (ret == RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
+        break;
+      }
+      if (ret != RCL_RET_OK) {
+        throw std::runtime_error(
+                std::string("could not take message: ") + rcl_get_error_string_safe());
+      }
+      message_info.from_intra_process = false;
+      if (matches_any_intra_process_publishers_ &&
+        matches_any_intra_process_publishers_(&message_info.publisher_gid))
+      {
+        // This message is delivered via intra process as well.
+        continue;
+      }
+      if (!throttle_accepts()) {
+        continue;
+      }
+      if (message_filter_ && !message_filter_(message)) {
+        continue;
+      }
+      on_inter_process_message_taken();
+      return true;
+    }
+    return take_intra_process(message, message_info);
+  }
   std::shared_ptr<void> create_message()
   {
     /* The default message memory strategy provides a dynamically allocated message on each call to
      * create_message, though alternative memory strategies that re-use a preallocated message may be
-     * used (see rclcpp/strategies/message_pool_memory_strategy.hpp).
+     * used (see rclcpp/strategies/message_pool_memory_strategy.hpp, and
+     * rclcpp/strategies/retaining_message_pool_memory_strategy.hpp for messages which are not of
+     * fixed size).
      */
     return message_memory_strategy_->borrow_message();
   }
@@ -196,7 +518,15 @@ public:
         return;
       }
     }
+    if (!throttle_accepts()) {
+      return;
+    }
     auto typed_message = std::static_pointer_cast<MessageT>(message);
+    if (message_filter_ && !message_filter_(*typed_message)) {
+      return;
+    }
+    on_inter_process_message_taken();
+    RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_subscription_handle()));
     any_callback_.dispatch(typed_message, message_info);
   }
 
@@ -217,35 +547,142 @@ public:
       // However, this can only really happen if this node has it disabled, but the other doesn't.
       return;
     }
+    uint64_t message_sequence = ipm.message_sequence;
+    if (!get_intra_process_guard_condition()) {
+      // A notification on the intra process topic announces all messages of the publisher
+      // since its previous one, while directly delivered notifications are queued one by one.
+      message_sequence = begin_intra_process_batch(
+        ipm.publisher_id, ipm.message_sequence, intra_process_depth_);
+    }
+    for (; message_sequence <= ipm.message_sequence; ++message_sequence) {
+      take_and_dispatch_intra_process_message(ipm.publisher_id, message_sequence, message_info);
+    }
+  }
+
+private:
+  bool take_intra_process(MessageT & message, rmw_message_info_t & message_info)
+  {
+    if (!get_intra_process_message_callback_) {
+      return false;
+    }
+    while (true) {
+      if (take_next_sequence_ > take_last_sequence_) {
+        // The messages of the previous notification are used up, take the next one.
+        rcl_interfaces::msg::IntraProcessMessage ipm;
+        if (get_intra_process_guard_condition()) {
+          if (!take_intra_process_notification(ipm)) {
+            return false;
+          }
+          take_next_sequence_ = ipm.message_sequence;
+        } else {
+          rmw_message_info_t ipm_info;
+          rcl_ret_t ret = rcl_take(&intra_process_subscription_handle_, &ipm, &ipm_info);
+          if (ret == RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
+            return false;
+          }
+          if (ret != RCL_RET_OK) {
+            throw std::runtime_error(
+                    std::string("could not take intra process message: ") +
+                    rcl_get_error_string_safe());
+          }
+          take_next_sequence_ = begin_intra_process_batch(
+            ipm.publisher_id, ipm.message_sequence, intra_process_depth_);
+        }
+        take_publisher_id_ = ipm.publisher_id;
+        take_last_sequence_ = ipm.message_sequence;
+      }
+      while (take_next_sequence_ <= take_last_sequence_) {
+        uint64_t message_sequence = take_next_sequence_++;
+        if (!throttle_accepts()) {
+          skip_intra_process_message_callback_(
+            take_publisher_id_, message_sequence, intra_process_subscription_id_);
+          continue;
+        }
+        MessageUniquePtr msg;
+        get_intra_process_message_callback_(
+          take_publisher_id_,
+          message_sequence,
+          intra_process_subscription_id_,
+          msg,
+          message_filter_);
+        if (msg) {
+          message = std::move(*msg);
+          message_info = rmw_message_info_t();
+          message_info.from_intra_process = true;
+          on_intra_process_message_taken();
+          return true;
+        }
+      }
+    }
+  }
+
+  void take_and_dispatch_intra_process_message(
+    uint64_t publisher_id, uint64_t message_sequence, const rmw_message_info_t & message_info)
+  {
+    if (!throttle_accepts()) {
+      // Release the message without looking it up, it is not copied for this subscription.
+      skip_intra_process_message_callback_(
+        publisher_id, message_sequence, intra_process_subscription_id_);
+      return;
+    }
+    if (any_callback_.use_take_shared_method() && get_intra_process_shared_message_callback_) {
+      // Read-only callbacks share the stored instance instead of getting a copy.
+      std::shared_ptr<const MessageT> shared_msg;
+      get_intra_process_shared_message_callback_(
+        publisher_id,
+        message_sequence,
+        intra_process_subscription_id_,
+        shared_msg);
+      if (shared_msg && (!message_filter_ || message_filter_(*shared_msg))) {
+        on_intra_process_message_taken();
+        RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_subscription_handle()));
+        any_callback_.dispatch_intra_process(shared_msg, message_info);
+      }
+      return;
+    }
     MessageUniquePtr msg;
     get_intra_process_message_callback_(
-      ipm.publisher_id,
-      ipm.message_sequence,
+      publisher_id,
+      message_sequence,
       intra_process_subscription_id_,
-      msg);
+      msg,
+      message_filter_);
     if (!msg) {
-      // This either occurred because the publisher no longer exists or the
-      // message requested is no longer being stored.
-      // TODO(wjwwood): should we notify someone of this? log error, log warning?
+      // This either occurred because the publisher no longer exists, the
+      // message requested is no longer being stored, which the intra process
+      // manager counted as overwritten when it displaced the message, or the
+      // message was rejected by the filter, which the filter counted.
       return;
     }
+    on_intra_process_message_taken();
+    RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(get_subscription_handle()));
     any_callback_.dispatch_intra_process(msg, message_info);
   }
 
-private:
   typedef
     std::function<
-      void (uint64_t, uint64_t, uint64_t, MessageUniquePtr &)
+      void (uint64_t, uint64_t, uint64_t, MessageUniquePtr &, const MessageFilter &)
     > GetMessageCallbackType;
+  typedef
+    std::function<
+      void (uint64_t, uint64_t, uint64_t, std::shared_ptr<const MessageT> &)
+    > GetSharedMessageCallbackType;
+  typedef std::function<void (uint64_t, uint64_t, uint64_t)> SkipMessageCallbackType;
   typedef std::function<bool (const rmw_gid_t *)> MatchesAnyPublishersCallbackType;
 
   void setup_intra_process(
     uint64_t intra_process_subscription_id,
     GetMessageCallbackType get_message_callback,
+    GetSharedMessageCallbackType get_shared_message_callback,
+    SkipMessageCallbackType skip_message_callback,
     MatchesAnyPublishersCallbackType matches_any_publisher_callback,
-    const rcl_subscription_options_t & intra_process_options)
+    const rcl_subscription_options_t & intra_process_options,
+    bool direct_delivery = false)
   {
-    if (rcl_subscription_init(
+    if (direct_delivery) {
+      // Notifications are queued in process, so there is no intra process topic to subscribe to.
+      setup_intra_process_queue(intra_process_options.qos.depth);
+    } else if (rcl_subscription_init(
         &intra_process_subscription_handle_, node_handle_.get(),
         rclcpp::type_support::get_intra_process_message_msg_type_support(),
         (get_topic_name() + "__intra").c_str(),
@@ -258,14 +695,19 @@ private:
     }
 
     intra_process_subscription_id_ = intra_process_subscription_id;
+    intra_process_depth_ = intra_process_options.qos.depth;
+    RCLCPP_TRACEPOINT(intra_process_subscription_init,
+      static_cast<const void *>(get_subscription_handle()), intra_process_subscription_id);
     get_intra_process_message_callback_ = get_message_callback;
+    get_intra_process_shared_message_callback_ = get_shared_message_callback;
+    skip_intra_process_message_callback_ = skip_message_callback;
     matches_any_intra_process_publishers_ = matches_any_publisher_callback;
   }
 
   const rcl_subscription_t *
   get_intra_process_subscription_handle() const
   {
-    if (!get_intra_process_message_callback_) {
+    if (!get_intra_process_message_callback_ || get_intra_process_guard_condition()) {
       return nullptr;
     }
     return &intra_process_subscription_handle_;
@@ -276,10 +718,19 @@ private:
   AnySubscriptionCallback<MessageT, Alloc> any_callback_;
   typename message_memory_strategy::MessageMemoryStrategy<MessageT, Alloc>::SharedPtr
   message_memory_strategy_;
+  MessageFilter message_filter_;
 
   GetMessageCallbackType get_intra_process_message_callback_;
+  GetSharedMessageCallbackType get_intra_process_shared_message_callback_;
+  SkipMessageCallbackType skip_intra_process_message_callback_;
   MatchesAnyPublishersCallbackType matches_any_intra_process_publishers_;
   uint64_t intra_process_subscription_id_;
+  /// Maximum number of messages taken for one intra process notification, 0 for no limit.
+  size_t intra_process_depth_;
+  /// The intra process messages of the last notification which take() did not return yet.
+  uint64_t take_publisher_id_;
+  uint64_t take_next_sequence_;
+  uint64_t take_last_sequence_;
 };
 
 }  // namespace subscription
@@ -15,6 +15,7 @@
 #ifndef RCLCPP__TIMER_HPP_
 #define RCLCPP__TIMER_HPP_
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <memory>
@@ -22,9 +23,12 @@
 #include <thread>
 #include <type_traits>
 
+#include "rclcpp/callback_group_generation.hpp"
 #include "rclcpp/function_traits.hpp"
 #include "rclcpp/macros.hpp"
 #include "rclcpp/rate.hpp"
+#include "rclcpp/scope_exit.hpp"
+#include "rclcpp/tracing.hpp"
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/visibility_control.hpp"
 
@@ -39,6 +43,38 @@ namespace rclcpp
 namespace timer
 {
 
+/// When the calls of a timer were due and how they went.
+/**
+ * A timer is due one period after its previous call, so the lateness of each call also delays
+ * all later ones; total_lateness is this accumulated drift.
+ */
+struct TimerStatistics
+{
+  using Clock = std::chrono::steady_clock;
+
+  TimerStatistics()
+  : calls(0), missed_periods(0), last_missed_periods(0),
+    last_lateness(0), max_lateness(0), total_lateness(0),
+    last_callback_duration(0), max_callback_duration(0)
+  {}
+
+  /// Number of calls of the callback.
+  uint64_t calls;
+  /// Number of whole periods which passed without a call, because calls were late.
+  uint64_t missed_periods;
+  uint64_t last_missed_periods;
+  /// When the last call was due and when it happened.
+  Clock::time_point last_scheduled_time;
+  Clock::time_point last_call_time;
+  /// How late the calls happened after they were due.
+  std::chrono::nanoseconds last_lateness;
+  std::chrono::nanoseconds max_lateness;
+  std::chrono::nanoseconds total_lateness;
+  /// How long the callback took, for the calls which have returned.
+  std::chrono::nanoseconds last_callback_duration;
+  std::chrono::nanoseconds max_callback_duration;
+};
+
 class TimerBase
 {
 public:
@@ -54,6 +90,12 @@ public:
   void
   cancel();
 
+  /// Check if the timer has been canceled.
+  // \return True if the timer is canceled and will not trigger until it is reset.
+  RCLCPP_PUBLIC
+  bool
+  is_canceled();
+
   RCLCPP_PUBLIC
   virtual void
   execute_callback() = 0;
@@ -68,6 +110,31 @@ public:
   std::chrono::nanoseconds
   time_until_trigger();
 
+  /// Set how long after its expiry the timer may be triggered.
+  /**
+   * The executor wakes up once for all timers which expire within the slack of each other,
+   * which saves wakeups when there are many timers, at the cost of triggering them later.
+   * The slack is zero by default and takes effect from the next expiry of the timer.
+   */
+  RCLCPP_PUBLIC
+  void
+  set_slack(std::chrono::nanoseconds slack);
+
+  RCLCPP_PUBLIC
+  std::chrono::nanoseconds
+  get_slack() const;
+
+  /// Return when the calls of the timer were due, when they happened and how long they took.
+  /**
+   * During a call, the statistics of the call itself are up to date, except its duration,
+   * so a callback taking the TimerBase can use them to tell whether it runs late.
+   * The counters are read one by one, so while the timer is called concurrently the result
+   * may mix the values of two consecutive calls.
+   */
+  RCLCPP_PUBLIC
+  TimerStatistics
+  get_statistics() const;
+
   /// Is the clock steady (i.e. is the time between ticks constant?)
   // \return True if the clock used by this timer is steady.
   virtual bool is_steady() = 0;
@@ -81,8 +148,43 @@ public:
   RCLCPP_PUBLIC
   bool is_ready();
 
+  /// Get the membership in the callback group, which the group joins when this is added to it.
+  RCLCPP_PUBLIC
+  callback_group::GroupMembership &
+  get_group_membership();
+
 protected:
+  /// Record a call, which was due at now plus the given time until the trigger.
+  RCLCPP_PUBLIC
+  void
+  record_call(TimerStatistics::Clock::time_point now, std::chrono::nanoseconds time_until_trigger);
+
+  /// Record how long the callback of the last call took.
+  RCLCPP_PUBLIC
+  void
+  record_callback_duration(std::chrono::nanoseconds duration);
+
   rcl_timer_t timer_handle_ = rcl_get_zero_initialized_timer();
+  std::atomic<int64_t> slack_;
+
+private:
+  /// The period of the rcl timer handle, which does not change after it was initialized.
+  uint64_t period_;
+
+  // The statistics are only written by the call of the timer, so they are kept in atomics
+  // instead of taking a lock around each call.
+  std::atomic<uint64_t> calls_;
+  std::atomic<uint64_t> missed_periods_;
+  std::atomic<uint64_t> last_missed_periods_;
+  std::atomic<int64_t> last_scheduled_time_ns_;
+  std::atomic<int64_t> last_call_time_ns_;
+  std::atomic<int64_t> last_lateness_ns_;
+  std::atomic<int64_t> max_lateness_ns_;
+  std::atomic<int64_t> total_lateness_ns_;
+  std::atomic<int64_t> last_callback_duration_ns_;
+  std::atomic<int64_t> max_callback_duration_ns_;
+
+  callback_group::GroupMembership group_membership_;
 };
 
 
@@ -117,6 +219,8 @@ public:
   /// Default destructor.
   virtual ~GenericTimer()
   {
+    // Leave the group before the handle is finalized, the base class would do it too late.
+    get_group_membership().leave();
     // Stop the timer from running.
     cancel();
     if (rcl_timer_fini(&timer_handle_) != RCL_RET_OK) {
@@ -127,6 +231,9 @@ public:
   void
   execute_callback()
   {
+    // The time until the trigger is negative by how late the call is, until it is made.
+    auto now = TimerStatistics::Clock::now();
+    auto time_until = time_until_trigger();
     rcl_ret_t ret = rcl_timer_call(&timer_handle_);
     if (ret == RCL_RET_TIMER_CANCELED) {
       return;
@@ -134,6 +241,9 @@ public:
     if (ret != RCL_RET_OK) {
       throw std::runtime_error("Failed to notify timer that callback occurred");
     }
+    record_call(now, time_until);
+    RCLCPP_SCOPE_EXIT(record_callback_duration(TimerStatistics::Clock::now() - now));
+    RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(&timer_handle_));
     execute_callback_delegate<>();
   }
 
@@ -0,0 +1,181 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__TIMER_QUEUE_HPP_
+#define RCLCPP__TIMER_QUEUE_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "rcl/timer.h"
+
+#include "rclcpp/macros.hpp"
+#include "rclcpp/timer.hpp"
+
+namespace rclcpp
+{
+namespace timer
+{
+
+/// Min-heap of timers ordered by their next expiry.
+/**
+ * The expiry of a timer is sampled from TimerBase::time_until_trigger when it is pushed.
+ * A timer with a slack (see TimerBase::set_slack) may be triggered up to its slack after its
+ * expiry, which time_until_next uses to wake up once for all the timers expiring close to each
+ * other, rather than once per timer.
+ * Timers which are handed out as ready are kept aside and their expiry is sampled again by
+ * the next call to requeue(), which normally happens after they have been executed.
+ * Canceled timers stay aside until they are reset.
+ * Finding the ready timers is O(log n) per ready timer instead of a check of every timer.
+ *
+ * This class is not thread safe; it is expected to be used by one memory strategy.
+ * TimerT is TimerBase, other timer types with the same interface are used by the tests.
+ */
+template<typename Alloc = std::allocator<void>, typename TimerT = TimerBase>
+class TimerQueue
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(TimerQueue<Alloc, TimerT>);
+
+  using Clock = std::chrono::steady_clock;
+
+  /// Remove all timers from the queue.
+  void clear()
+  {
+    heap_.clear();
+    requeue_.clear();
+  }
+
+  /// Add a timer, sampling its time until the next trigger.
+  void push(const typename TimerT::SharedPtr & timer, Clock::time_point now = Clock::now())
+  {
+    if (timer->is_canceled()) {
+      requeue_.push_back(timer);
+      return;
+    }
+    auto expiry = now + timer->time_until_trigger();
+    auto slack = timer->get_slack();
+    auto latest = Clock::time_point::max();
+    if (slack < Clock::time_point::max() - expiry) {
+      latest = expiry + slack;
+    }
+    heap_.push_back(Entry{expiry, latest, timer->get_timer_handle(), timer});
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+  }
+
+  /// Put the timers handed out by pop_ready back into the heap with their new expiry.
+  void requeue(Clock::time_point now = Clock::now())
+  {
+    auto pending = requeue_.size();
+    for (size_t i = 0; i < pending; ++i) {
+      auto timer = requeue_[i].lock();
+      if (timer) {
+        push(timer, now);
+      }
+    }
+    requeue_.erase(requeue_.begin(), requeue_.begin() + pending);
+  }
+
+  /// Return the time until the next wakeup, zero if overdue, or negative if there is no timer.
+  /**
+   * The wakeup is the earliest time by which a timer must be triggered, i.e. its expiry plus
+   * its slack, so all timers expiring before it are triggered by the same wakeup.
+   * Without any slack, this is the earliest expiry.
+   */
+  std::chrono::nanoseconds time_until_next(Clock::time_point now = Clock::now()) const
+  {
+    if (heap_.empty()) {
+      return std::chrono::nanoseconds(-1);
+    }
+    Clock::time_point wakeup = Clock::time_point::max();
+    find_wakeup(0, wakeup);
+    return std::max(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(wakeup - now),
+      std::chrono::nanoseconds::zero());
+  }
+
+  /// Move the handles of all timers which expired by now into ready_handles.
+  /**
+   * Since the heap may be stale (e.g. if a timer was reset), every candidate is confirmed with
+   * TimerBase::is_ready, while timers which turn out not to be ready are requeued.
+   */
+  template<typename HandleVector>
+  void pop_ready(HandleVector & ready_handles, Clock::time_point now = Clock::now())
+  {
+    while (!heap_.empty() && heap_.front().expiry <= now) {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+      auto timer = heap_.back().timer.lock();
+      auto handle = heap_.back().handle;
+      heap_.pop_back();
+      if (!timer) {
+        continue;
+      }
+      requeue_.push_back(timer);
+      if (timer->is_ready()) {
+        ready_handles.push_back(handle);
+      }
+    }
+  }
+
+  size_t size() const
+  {
+    return heap_.size() + requeue_.size();
+  }
+
+private:
+  struct Entry
+  {
+    Clock::time_point expiry;
+    // The expiry plus the slack of the timer.
+    Clock::time_point latest;
+    const rcl_timer_t * handle;
+    typename TimerT::WeakPtr timer;
+
+    bool operator>(const Entry & other) const
+    {
+      return expiry > other.expiry;
+    }
+  };
+
+  template<typename T>
+  using VectorRebind =
+      std::vector<T, typename std::allocator_traits<Alloc>::template rebind_alloc<T>>;
+
+  /// Lower wakeup to the latest time of the timers from index down which expire before it.
+  /**
+   * Timers expiring after the wakeup cannot make it earlier, and neither can the timers below
+   * them in the heap, so only the timers triggered by the wakeup are visited.
+   */
+  void find_wakeup(size_t index, Clock::time_point & wakeup) const
+  {
+    if (index >= heap_.size() || heap_[index].expiry >= wakeup) {
+      return;
+    }
+    wakeup = std::min(wakeup, heap_[index].latest);
+    find_wakeup(2 * index + 1, wakeup);
+    find_wakeup(2 * index + 2, wakeup);
+  }
+
+  // A binary heap, kept with std::push_heap and std::pop_heap so that it can be searched.
+  VectorRebind<Entry> heap_;
+  VectorRebind<typename TimerT::WeakPtr> requeue_;
+};
+
+}  // namespace timer
+}  // namespace rclcpp
+
+#endif  // RCLCPP__TIMER_QUEUE_HPP_
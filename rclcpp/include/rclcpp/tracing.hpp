@@ -0,0 +1,67 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__TRACING_HPP_
+#define RCLCPP__TRACING_HPP_
+
+/* Tracepoints to reconstruct the flow of messages and the latency chains across nodes.
+ *
+ * The tracepoints are only compiled in if RCLCPP_ENABLE_TRACING is defined, which the
+ * RCLCPP_ENABLE_TRACING CMake option does for rclcpp and for the packages using it.
+ * Otherwise they expand to nothing.
+ * They are USDT probes of the provider rclcpp, which are a single nop while no tracer is
+ * attached, and can be used with e.g. bpftrace, perf or SystemTap:
+ *
+ *   bpftrace -e 'usdt:./talker:rclcpp:publish { printf("%p\n", arg1); }'
+ *
+ * Many tracepoints are in templates, so they end up in the programs using rclcpp.
+ *
+ * Entities are identified by the address of their rcl handle:
+ *
+ * - publish(publisher_handle, message)
+ * - intra_process_publisher_init(publisher_handle, intra_process_publisher_id)
+ * - intra_process_subscription_init(subscription_handle, intra_process_subscription_id)
+ * - intra_process_store(intra_process_publisher_id, message_sequence)
+ * - intra_process_take(intra_process_publisher_id, message_sequence,
+ *   intra_process_subscription_id, message)
+ * - take(subscription_handle, message)
+ * - wait_for_work_start(executor, timeout_ns), wait_for_work_end(executor, rcl_wait_status)
+ * - execute_subscription(subscription_handle), execute_intra_process_subscription(
+ *   subscription_handle), execute_timer(timer_handle), execute_service(service_handle),
+ *   execute_intra_process_service(service_handle), execute_client(client_handle),
+ *   execute_client_continuation(client_handle)
+ * - callback_start(handle), callback_end(handle) around the user callback of an entity
+ */
+
+#ifdef RCLCPP_ENABLE_TRACING
+
+#include <sys/sdt.h>
+
+#include "rclcpp/scope_exit.hpp"
+
+#define RCLCPP_TRACEPOINT(event, ...) STAP_PROBEV(rclcpp, event, __VA_ARGS__)
+
+/// Trace callback_start now and callback_end when the enclosing scope is left.
+#define RCLCPP_TRACE_CALLBACK_SCOPE(handle) \
+  RCLCPP_TRACEPOINT(callback_start, handle); \
+  RCLCPP_SCOPE_EXIT(RCLCPP_TRACEPOINT(callback_end, handle))
+
+#else
+
+#define RCLCPP_TRACEPOINT(event, ...)
+#define RCLCPP_TRACE_CALLBACK_SCOPE(handle)
+
+#endif
+
+#endif  // RCLCPP__TRACING_HPP_
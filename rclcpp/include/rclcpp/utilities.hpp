@@ -45,11 +45,20 @@ bool
 ok();
 
 /// Notify the signal handler and rmw that rclcpp is shutting down.
+/**
+ * This also shuts down all contexts, see context::Context::shutdown_all.
+ * On SIGINT the same is done by a thread which the signal handler wakes up, since the handler
+ * itself may only make async-signal-safe calls.
+ */
 RCLCPP_PUBLIC
 void
 shutdown();
 
 /// Get a handle to the rmw guard condition that manages the signal handler.
+/**
+ * It is triggered on SIGINT and shutdown. Executors and wait sets do not wait on it, since all
+ * contexts are shut down as well, which wakes them up.
+ */
 RCLCPP_PUBLIC
 rcl_guard_condition_t *
 get_global_sigint_guard_condition();
@@ -0,0 +1,201 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RCLCPP__WAIT_SET_HPP_
+#define RCLCPP__WAIT_SET_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "rcl/allocator.h"
+#include "rcl/guard_condition.h"
+#include "rcl/wait.h"
+
+#include "rclcpp/context.hpp"
+#include "rclcpp/contexts/default_context.hpp"
+#include "rclcpp/macros.hpp"
+#include "rclcpp/subscription.hpp"
+#include "rclcpp/timer.hpp"
+#include "rclcpp/visibility_control.hpp"
+
+namespace rclcpp
+{
+namespace wait_set
+{
+
+/// Why WaitSet::wait returned.
+enum class WaitResult
+{
+  /// At least one of the entities is ready.
+  Ready,
+  /// The timeout passed before any entity was ready.
+  Timeout,
+  /// The context was shut down or SIGINT was received.
+  Interrupted
+};
+
+/// Waits on a fixed set of subscriptions, timers and guard conditions, without an executor.
+/**
+ * This is for loops which take messages themselves, e.g. with Subscription::take, rather than
+ * having an executor dispatch them to callbacks:
+ *
+ *   rclcpp::wait_set::WaitSet wait_set;
+ *   wait_set.add_subscription(subscription);
+ *   while (wait_set.wait() != rclcpp::wait_set::WaitResult::Interrupted) {
+ *     while (subscription->take(message, message_info)) {
+ *       ...
+ *     }
+ *   }
+ *
+ * The rcl wait set is kept between waits, it is only resized when entities were added or
+ * removed, so waiting on an unchanged set does not allocate.
+ * A subscription is ready if it has inter or intra process messages, a timer is ready if it is
+ * due, in which case TimerBase::execute_callback has to be called to rearm it.
+ * The shutdown of the context and SIGINT interrupt a wait.
+ *
+ * The entities are kept alive by the wait set until they are removed. Guard conditions are
+ * only referenced, they have to outlive the wait set or be removed before they are destroyed.
+ * This class is not thread-safe.
+ */
+class WaitSet
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(WaitSet);
+
+  /// Constructor.
+  /**
+   * \param[in] context The context whose shutdown interrupts a wait.
+   * \param[in] allocator The allocator of the rcl wait set.
+   * \throws std::runtime_error if the rcl wait set could not be created.
+   */
+  RCLCPP_PUBLIC
+  explicit WaitSet(
+    rclcpp::context::Context::SharedPtr context =
+    rclcpp::contexts::default_context::get_global_default_context(),
+    rcl_allocator_t allocator = rcl_get_default_allocator());
+
+  RCLCPP_PUBLIC
+  virtual ~WaitSet();
+
+  /// Add a subscription, unless it was added already.
+  RCLCPP_PUBLIC
+  void
+  add_subscription(rclcpp::subscription::SubscriptionBase::SharedPtr subscription);
+
+  /// Remove a subscription.
+  /**
+   * \return true if the subscription was removed, false if it was not in the wait set.
+   */
+  RCLCPP_PUBLIC
+  bool
+  remove_subscription(const rclcpp::subscription::SubscriptionBase::SharedPtr & subscription);
+
+  /// Add a timer, unless it was added already.
+  RCLCPP_PUBLIC
+  void
+  add_timer(rclcpp::timer::TimerBase::SharedPtr timer);
+
+  /// Remove a timer.
+  /**
+   * \return true if the timer was removed, false if it was not in the wait set.
+   */
+  RCLCPP_PUBLIC
+  bool
+  remove_timer(const rclcpp::timer::TimerBase::SharedPtr & timer);
+
+  /// Add a guard condition, unless it was added already.
+  RCLCPP_PUBLIC
+  void
+  add_guard_condition(const rcl_guard_condition_t * guard_condition);
+
+  /// Remove a guard condition.
+  /**
+   * \return true if the guard condition was removed, false if it was not in the wait set.
+   */
+  RCLCPP_PUBLIC
+  bool
+  remove_guard_condition(const rcl_guard_condition_t * guard_condition);
+
+  /// Wait until an entity is ready, the timeout passed or the wait was interrupted.
+  /**
+   * The ready entities are reported by get_ready_subscriptions, get_ready_timers and
+   * get_ready_guard_conditions until the next wait.
+   * \param[in] timeout How long to wait at most, negative to wait without a timeout.
+   * \return Why the wait returned.
+   * \throws std::runtime_error if waiting failed.
+   */
+  RCLCPP_PUBLIC
+  WaitResult
+  wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
+
+  /// Get the subscriptions which were ready after the last wait.
+  RCLCPP_PUBLIC
+  const std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> &
+  get_ready_subscriptions() const;
+
+  /// Get the timers which were ready after the last wait.
+  RCLCPP_PUBLIC
+  const std::vector<rclcpp::timer::TimerBase::SharedPtr> &
+  get_ready_timers() const;
+
+  /// Get the guard conditions which were triggered before the last wait returned.
+  RCLCPP_PUBLIC
+  const std::vector<const rcl_guard_condition_t *> &
+  get_ready_guard_conditions() const;
+
+private:
+  RCLCPP_DISABLE_COPY(WaitSet);
+
+  /// Slots of the handles of a subscription in the rcl wait set.
+  struct SubscriptionSlots
+  {
+    size_t subscription;
+    size_t intra_process_subscription;
+    size_t intra_process_guard_condition;
+  };
+
+  static const size_t no_slot = static_cast<size_t>(-1);
+  /// The shutdown guard condition of the context, which SIGINT triggers too, comes first.
+  static const size_t number_of_interrupt_guard_conditions = 1;
+
+  /// Assign the slots of the entities and resize the rcl wait set for them.
+  void
+  resize();
+
+  /// Add all entities to the (cleared) rcl wait set.
+  void
+  fill();
+
+  void
+  clear();
+
+  rclcpp::context::Context::SharedPtr context_;
+  rcl_wait_set_t wait_set_ = rcl_get_zero_initialized_wait_set();
+  bool resize_needed_;
+
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> subscriptions_;
+  std::vector<SubscriptionSlots> subscription_slots_;
+  std::vector<rclcpp::timer::TimerBase::SharedPtr> timers_;
+  std::vector<const rcl_guard_condition_t *> guard_conditions_;
+
+  std::vector<rclcpp::subscription::SubscriptionBase::SharedPtr> ready_subscriptions_;
+  std::vector<rclcpp::timer::TimerBase::SharedPtr> ready_timers_;
+  std::vector<const rcl_guard_condition_t *> ready_guard_conditions_;
+};
+
+}  // namespace wait_set
+}  // namespace rclcpp
+
+#endif  // RCLCPP__WAIT_SET_HPP_
@@ -0,0 +1,206 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/allocator/arena_allocator.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using rclcpp::allocator::Arena;
+
+namespace
+{
+
+/// Every block starts with a header holding its size class, which keeps the payload aligned.
+const size_t header_size = alignof(std::max_align_t) < 16 ? 16 : alignof(std::max_align_t);
+const size_t min_size_class = 5;
+
+size_t
+get_size_class(size_t size)
+{
+  size_t size_class = min_size_class;
+  while (size_class < 63 && (static_cast<size_t>(1) << size_class) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+size_t
+get_page_size()
+{
+#ifndef _WIN32
+  long page_size = sysconf(_SC_PAGESIZE);  // NOLINT(runtime/int)
+  if (page_size > 0) {
+    return static_cast<size_t>(page_size);
+  }
+#endif
+  return 4096;
+}
+
+}  // namespace
+
+const size_t Arena::number_of_size_classes;
+
+Arena::Arena(const ArenaOptions & options)
+: buffer_(nullptr), size_(options.size), unused_offset_(0), free_list_bitmap_(0),
+  bytes_in_use_(0), peak_bytes_in_use_(0), memory_locked_(false)
+{
+  for (size_t i = 0; i < number_of_size_classes; ++i) {
+    free_lists_[i] = nullptr;
+  }
+  buffer_ = static_cast<unsigned char *>(std::malloc(size_));
+  if (!buffer_ && size_ > 0) {
+    throw std::bad_alloc();
+  }
+  if (options.lock_all_memory) {
+#ifndef _WIN32
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      std::free(buffer_);
+      throw std::runtime_error(
+        std::string("failed to lock the memory of the process: ") + std::strerror(errno));
+    }
+#else
+    std::free(buffer_);
+    throw std::runtime_error("locking the memory of the process is not supported on Windows");
+#endif
+  }
+  if (options.lock_memory && size_ > 0) {
+#ifndef _WIN32
+    if (mlock(buffer_, size_) != 0) {
+      std::free(buffer_);
+      throw std::runtime_error(
+        std::string("failed to lock the memory of the arena: ") + std::strerror(errno));
+    }
+    memory_locked_ = true;
+#else
+    std::free(buffer_);
+    throw std::runtime_error("locking the memory of the arena is not supported on Windows");
+#endif
+  }
+  if (options.prefault) {
+    // Write to each page, as reading may map them all to the same zero page.
+    size_t page_size = get_page_size();
+    volatile unsigned char * pages = buffer_;
+    for (size_t offset = 0; offset < size_; offset += page_size) {
+      pages[offset] = 0;
+    }
+  }
+}
+
+Arena::~Arena()
+{
+#ifndef _WIN32
+  if (memory_locked_) {
+    munlock(buffer_, size_);
+  }
+#endif
+  std::free(buffer_);
+}
+
+void *
+Arena::allocate(size_t size, size_t alignment)
+{
+  if (alignment > header_size || size > (static_cast<size_t>(1) << 62) - header_size) {
+    throw std::bad_alloc();
+  }
+  size_t size_class = get_size_class(size + header_size);
+  size_t block_size = static_cast<size_t>(1) << size_class;
+  unsigned char * block = nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_lists_[size_class]) {
+    block = reinterpret_cast<unsigned char *>(free_lists_[size_class]);
+    free_lists_[size_class] = free_lists_[size_class]->next;
+    if (!free_lists_[size_class]) {
+      free_list_bitmap_ &= ~(static_cast<uint64_t>(1) << size_class);
+    }
+  } else if (size_ - unused_offset_ >= block_size) {
+    block = buffer_ + unused_offset_;
+    unused_offset_ += block_size;
+  } else {
+    // Split the smallest larger free block, keeping the halves which are not needed.
+    uint64_t larger = free_list_bitmap_ & ~((static_cast<uint64_t>(2) << size_class) - 1);
+    if (!larger) {
+      throw std::bad_alloc();
+    }
+    size_t larger_class = size_class + 1;
+    while (!(larger & (static_cast<uint64_t>(1) << larger_class))) {
+      ++larger_class;
+    }
+    block = reinterpret_cast<unsigned char *>(free_lists_[larger_class]);
+    free_lists_[larger_class] = free_lists_[larger_class]->next;
+    if (!free_lists_[larger_class]) {
+      free_list_bitmap_ &= ~(static_cast<uint64_t>(1) << larger_class);
+    }
+    for (size_t split_class = larger_class; split_class > size_class; --split_class) {
+      push_free_block(block + (static_cast<size_t>(1) << (split_class - 1)), split_class - 1);
+    }
+  }
+  bytes_in_use_ += block_size;
+  if (bytes_in_use_ > peak_bytes_in_use_) {
+    peak_bytes_in_use_ = bytes_in_use_;
+  }
+  *reinterpret_cast<size_t *>(block) = size_class;
+  return block + header_size;
+}
+
+void
+Arena::deallocate(void * pointer) noexcept
+{
+  if (!pointer) {
+    return;
+  }
+  unsigned char * block = static_cast<unsigned char *>(pointer) - header_size;
+  size_t size_class = *reinterpret_cast<size_t *>(block);
+  std::lock_guard<std::mutex> lock(mutex_);
+  bytes_in_use_ -= static_cast<size_t>(1) << size_class;
+  push_free_block(block, size_class);
+}
+
+size_t
+Arena::get_size() const
+{
+  return size_;
+}
+
+size_t
+Arena::get_bytes_in_use() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_in_use_;
+}
+
+size_t
+Arena::get_peak_bytes_in_use() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_bytes_in_use_;
+}
+
+void
+Arena::push_free_block(unsigned char * block, size_t size_class)
+{
+  FreeBlock * free_block = reinterpret_cast<FreeBlock *>(block);
+  free_block->next = free_lists_[size_class];
+  free_lists_[size_class] = free_block;
+  free_list_bitmap_ |= static_cast<uint64_t>(1) << size_class;
+}
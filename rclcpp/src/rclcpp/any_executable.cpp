@@ -21,9 +21,12 @@ AnyExecutable::AnyExecutable()
   subscription_intra_process(nullptr),
   timer(nullptr),
   service(nullptr),
+  service_intra_process(nullptr),
   client(nullptr),
+  client_continuation(nullptr),
   callback_group(nullptr),
-  node(nullptr)
+  node(nullptr),
+  statistics(nullptr)
 {}
 
 AnyExecutable::~AnyExecutable()
@@ -35,3 +38,28 @@ AnyExecutable::~AnyExecutable()
     callback_group->can_be_taken_from().store(true);
   }
 }
+
+void
+AnyExecutable::clear()
+{
+  if (callback_group) {
+    callback_group->can_be_taken_from().store(true);
+  }
+  subscription.reset();
+  subscription_intra_process.reset();
+  timer.reset();
+  service.reset();
+  service_intra_process.reset();
+  client.reset();
+  client_continuation.reset();
+  callback_group.reset();
+  node.reset();
+  statistics.reset();
+}
+
+bool
+AnyExecutable::has_work() const
+{
+  return subscription || subscription_intra_process || timer || service ||
+         service_intra_process || client || client_continuation;
+}
@@ -14,14 +14,23 @@
 
 #include "rclcpp/callback_group.hpp"
 
+#include <memory>
 #include <vector>
 
 using rclcpp::callback_group::CallbackGroup;
 using rclcpp::callback_group::CallbackGroupType;
 
 CallbackGroup::CallbackGroup(CallbackGroupType group_type)
-: type_(group_type), can_be_taken_from_(true)
-{}
+: type_(group_type), generation_(std::make_shared<GroupGeneration>()), priority_(0),
+  deadline_ns_(0)
+{
+  can_be_taken_from_.value.store(true);
+}
+
+CallbackGroup::~CallbackGroup()
+{
+  generation_->increment();
+}
 
 const std::vector<rclcpp::subscription::SubscriptionBase::WeakPtr> &
 CallbackGroup::get_subscription_ptrs() const
@@ -47,10 +56,16 @@ CallbackGroup::get_client_ptrs() const
   return client_ptrs_;
 }
 
+const rclcpp::callback_group::GroupGeneration::SharedPtr &
+CallbackGroup::get_generation() const
+{
+  return generation_;
+}
+
 std::atomic_bool &
 CallbackGroup::can_be_taken_from()
 {
-  return can_be_taken_from_;
+  return can_be_taken_from_.value;
 }
 
 const CallbackGroupType &
@@ -59,27 +74,62 @@ CallbackGroup::type() const
   return type_;
 }
 
+void
+CallbackGroup::set_priority(int priority)
+{
+  priority_.store(priority);
+  // Make the memory strategy collect the entities again, so it notices the change.
+  generation_->increment();
+}
+
+int
+CallbackGroup::get_priority() const
+{
+  return priority_.load(std::memory_order_relaxed);
+}
+
+void
+CallbackGroup::set_deadline(std::chrono::nanoseconds deadline)
+{
+  deadline_ns_.store(deadline.count());
+  generation_->increment();
+}
+
+std::chrono::nanoseconds
+CallbackGroup::get_deadline() const
+{
+  return std::chrono::nanoseconds(deadline_ns_.load(std::memory_order_relaxed));
+}
+
 void
 CallbackGroup::add_subscription(
   const rclcpp::subscription::SubscriptionBase::SharedPtr subscription_ptr)
 {
   subscription_ptrs_.push_back(subscription_ptr);
+  subscription_ptr->get_group_membership().join(generation_);
+  generation_->increment();
 }
 
 void
 CallbackGroup::add_timer(const rclcpp::timer::TimerBase::SharedPtr timer_ptr)
 {
   timer_ptrs_.push_back(timer_ptr);
+  timer_ptr->get_group_membership().join(generation_);
+  generation_->increment();
 }
 
 void
 CallbackGroup::add_service(const rclcpp::service::ServiceBase::SharedPtr service_ptr)
 {
+  // Services are owned by the group, so they are not destroyed before it.
   service_ptrs_.push_back(service_ptr);
+  generation_->increment();
 }
 
 void
 CallbackGroup::add_client(const rclcpp::client::ClientBase::SharedPtr client_ptr)
 {
   client_ptrs_.push_back(client_ptr);
+  client_ptr->get_group_membership().join(generation_);
+  generation_->increment();
 }
@@ -14,21 +14,55 @@
 
 #include "rclcpp/client.hpp"
 
+#include <chrono>
 #include <cstdio>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
+#include "rcl/error_handling.h"
 #include "rmw/rmw.h"
 
+#include "rclcpp/graph_listener.hpp"
+
 using rclcpp::client::ClientBase;
 
 ClientBase::ClientBase(
   std::shared_ptr<rcl_node_t> node_handle,
   const std::string & service_name)
-: node_handle_(node_handle), service_name_(service_name)
-{}
+: node_handle_(node_handle), service_name_(service_name), intra_process_sequence_number_(0),
+  request_timeout_ns_(0), max_pending_requests_(0), expired_requests_(0), unmatched_responses_(0)
+{
+  rcl_guard_condition_options_t guard_condition_options = rcl_guard_condition_get_default_options();
+  if (rcl_guard_condition_init(
+      &response_guard_condition_, guard_condition_options) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Failed to create response guard condition for client: ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_guard_condition_init(
+      &continuation_guard_condition_, guard_condition_options) != RCL_RET_OK)
+  {
+    std::string error = rcl_get_error_string_safe();
+    rcl_guard_condition_fini(&response_guard_condition_);
+    throw std::runtime_error(
+            "Failed to create continuation guard condition for client: " + error);
+  }
+}
 
 ClientBase::~ClientBase()
 {
+  group_membership_.leave();
+  if (rcl_guard_condition_fini(&response_guard_condition_) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy guard condition: %s\n", rcl_get_error_string_safe());
+  }
+  if (rcl_guard_condition_fini(&continuation_guard_condition_) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy guard condition: %s\n", rcl_get_error_string_safe());
+  }
 }
 
 const std::string &
@@ -42,3 +76,180 @@ ClientBase::get_client_handle() const
 {
   return &client_handle_;
 }
+
+const rcl_guard_condition_t *
+ClientBase::get_response_guard_condition() const
+{
+  return &response_guard_condition_;
+}
+
+const rcl_guard_condition_t *
+ClientBase::get_continuation_guard_condition() const
+{
+  return &continuation_guard_condition_;
+}
+
+void
+ClientBase::post_continuation(std::function<void()> continuation)
+{
+  {
+    std::lock_guard<std::mutex> lock(continuations_mutex_);
+    continuations_.push_back(std::move(continuation));
+  }
+  if (rcl_trigger_guard_condition(&continuation_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger continuation guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+bool
+ClientBase::take_continuation(std::function<void()> & continuation)
+{
+  std::lock_guard<std::mutex> lock(continuations_mutex_);
+  if (continuations_.empty()) {
+    return false;
+  }
+  continuation = std::move(continuations_.front());
+  continuations_.pop_front();
+  return true;
+}
+
+void
+ClientBase::renotify_if_continuations_pending()
+{
+  bool pending = false;
+  {
+    std::lock_guard<std::mutex> lock(continuations_mutex_);
+    pending = !continuations_.empty();
+  }
+  // The guard condition does not count triggers, so wake up again for what is left over.
+  if (pending && rcl_trigger_guard_condition(&continuation_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger continuation guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+const std::shared_ptr<const rclcpp::continuable_future::ContinuationList::PostFunction> &
+ClientBase::get_continuation_post_function()
+{
+  // *INDENT-OFF*
+  std::call_once(continuation_post_function_once_, [this]() {
+    std::weak_ptr<ClientBase> weak_client = shared_from_this();
+    continuation_post_function_ =
+      std::make_shared<const rclcpp::continuable_future::ContinuationList::PostFunction>(
+        [weak_client](std::function<void()> continuation) {
+          // Continuations of a client which is gone are dropped, which breaks their promises.
+          auto client = weak_client.lock();
+          if (client) {
+            client->post_continuation(std::move(continuation));
+          }
+        });
+  });
+  // *INDENT-ON*
+  return continuation_post_function_;
+}
+
+void
+ClientBase::notify_response_handled()
+{
+  if (rcl_trigger_guard_condition(&response_guard_condition_) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to trigger response guard condition: %s\n",
+      rcl_get_error_string_safe());
+  }
+}
+
+void
+ClientBase::set_request_timeout(std::chrono::nanoseconds timeout)
+{
+  if (timeout < std::chrono::nanoseconds::zero()) {
+    throw std::invalid_argument("request timeout must not be negative");
+  }
+  request_timeout_ns_.store(timeout.count());
+}
+
+std::chrono::nanoseconds
+ClientBase::get_request_timeout() const
+{
+  return std::chrono::nanoseconds(request_timeout_ns_.load());
+}
+
+void
+ClientBase::set_max_pending_requests(size_t max_pending_requests)
+{
+  max_pending_requests_.store(max_pending_requests);
+}
+
+size_t
+ClientBase::get_max_pending_requests() const
+{
+  return max_pending_requests_.load();
+}
+
+rclcpp::client::ClientStatistics
+ClientBase::get_statistics() const
+{
+  ClientStatistics statistics;
+  statistics.in_flight = get_pending_request_count();
+  statistics.expired = expired_requests_.load();
+  statistics.unmatched_responses = unmatched_responses_.load();
+  return statistics;
+}
+
+rclcpp::callback_group::GroupMembership &
+ClientBase::get_group_membership()
+{
+  return group_membership_;
+}
+
+int64_t
+ClientBase::get_request_deadline() const
+{
+  int64_t timeout = request_timeout_ns_.load();
+  if (timeout == 0) {
+    return rclcpp::pending_request_table::PendingRequestTable<int>::no_deadline;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count() + timeout;
+}
+
+void
+ClientBase::setup_intra_process(IntraProcessServiceLookupT lookup)
+{
+  intra_process_service_lookup_ = lookup;
+}
+
+bool
+ClientBase::wait_for_service(std::chrono::nanoseconds timeout)
+{
+  if (!intra_process_service_lookup_) {
+    throw std::runtime_error(
+            "cannot wait for service '" + service_name_ +
+            "' without intra process communication");
+  }
+  auto context = context_.lock();
+  if (!context) {
+    throw std::runtime_error("cannot wait for service '" + service_name_ + "' without context");
+  }
+  auto graph_listener = context->get_sub_context<rclcpp::graph_listener::GraphListener>();
+  // *INDENT-OFF*
+  return graph_listener->wait_for(*context, [this]() {
+    return get_intra_process_service() != nullptr;
+  }, timeout);
+  // *INDENT-ON*
+}
+
+rclcpp::service::ServiceBase::SharedPtr
+ClientBase::get_intra_process_service() const
+{
+  if (!intra_process_service_lookup_) {
+    return nullptr;
+  }
+  auto service = intra_process_service_lookup_(service_name_);
+  if (!service || !service->get_intra_process_guard_condition()) {
+    return nullptr;
+  }
+  return service;
+}
@@ -14,6 +14,121 @@
 
 #include "rclcpp/context.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rcl/error_handling.h"
+
+#include "rclcpp/utilities.hpp"
+
 using rclcpp::context::Context;
 
-Context::Context() {}
+/// All existing contexts, so a global shutdown can wake up the waits on each of them.
+static std::mutex g_contexts_mutex;
+static std::vector<Context *> g_contexts;
+
+Context::Context()
+: shutdown_(false), interrupt_guard_condition_initialized_(false),
+  shutdown_callbacks_called_(false), next_shutdown_callback_id_(0)
+{
+  std::lock_guard<std::mutex> lock(g_contexts_mutex);
+  g_contexts.push_back(this);
+}
+
+Context::~Context()
+{
+  {
+    std::lock_guard<std::mutex> lock(g_contexts_mutex);
+    g_contexts.erase(std::remove(g_contexts.begin(), g_contexts.end(), this), g_contexts.end());
+  }
+  if (interrupt_guard_condition_initialized_ &&
+    rcl_guard_condition_fini(&interrupt_guard_condition_) != RCL_RET_OK)
+  {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy guard condition: %s\n", rcl_get_error_string_safe());
+  }
+}
+
+bool
+Context::ok() const
+{
+  return !shutdown_.load() && rclcpp::utilities::ok();
+}
+
+void
+Context::shutdown()
+{
+  shutdown_.store(true);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (interrupt_guard_condition_initialized_ &&
+      rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK)
+    {
+      fprintf(stderr,
+        "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+    }
+  }
+  // Called with the lock held, so a callback which is being removed does not run afterwards.
+  std::lock_guard<std::mutex> lock(shutdown_callbacks_mutex_);
+  if (shutdown_callbacks_called_) {
+    return;
+  }
+  shutdown_callbacks_called_ = true;
+  for (auto & callback : shutdown_callbacks_) {
+    callback.second();
+  }
+}
+
+uint64_t
+Context::add_shutdown_callback(ShutdownCallback callback)
+{
+  std::lock_guard<std::mutex> lock(shutdown_callbacks_mutex_);
+  uint64_t callback_id = next_shutdown_callback_id_++;
+  shutdown_callbacks_.emplace_back(callback_id, callback);
+  return callback_id;
+}
+
+bool
+Context::remove_shutdown_callback(uint64_t callback_id)
+{
+  std::lock_guard<std::mutex> lock(shutdown_callbacks_mutex_);
+  for (auto it = shutdown_callbacks_.begin(); it != shutdown_callbacks_.end(); ++it) {
+    if (it->first == callback_id) {
+      shutdown_callbacks_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+Context::shutdown_all()
+{
+  std::lock_guard<std::mutex> lock(g_contexts_mutex);
+  for (auto context : g_contexts) {
+    context->shutdown();
+  }
+}
+
+rcl_guard_condition_t *
+Context::get_interrupt_guard_condition()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!interrupt_guard_condition_initialized_) {
+    rcl_guard_condition_options_t options = rcl_guard_condition_get_default_options();
+    if (rcl_guard_condition_init(&interrupt_guard_condition_, options) != RCL_RET_OK) {
+      throw std::runtime_error(std::string(
+                "Couldn't initialize guard condition: ") + rcl_get_error_string_safe());
+    }
+    interrupt_guard_condition_initialized_ = true;
+    if (!ok()) {
+      // Shut down before anyone waited, wake up the first wait right away.
+      rcl_trigger_guard_condition(&interrupt_guard_condition_);
+    }
+  }
+  return &interrupt_guard_condition_;
+}
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <functional>
 #include <string>
 #include <type_traits>
 
@@ -21,6 +22,7 @@
 
 #include "rclcpp/executor.hpp"
 #include "rclcpp/scope_exit.hpp"
+#include "rclcpp/tracing.hpp"
 
 #include "rcl_interfaces/msg/intra_process_message.hpp"
 
@@ -31,7 +33,11 @@ using rclcpp::executor::FutureReturnCode;
 
 Executor::Executor(const ExecutorArgs & args)
 : spinning(false),
-  memory_strategy_(args.memory_strategy)
+  memory_strategy_(args.memory_strategy),
+  context_(args.context),
+  statistics_enabled_(false),
+  number_of_waiting_threads_(0),
+  number_of_avoided_wakeups_(0)
 {
   rcl_guard_condition_options_t guard_condition_options = rcl_guard_condition_get_default_options();
   if (rcl_guard_condition_init(
@@ -42,18 +48,18 @@ Executor::Executor(const ExecutorArgs & args)
             rcl_get_error_string_safe());
   }
 
-  // The number of guard conditions is always at least 2: 1 for the ctrl-c guard cond,
-  // and one for the executor's guard cond (interrupt_guard_condition_)
-
-  // Put the global ctrl-c guard condition in
-  memory_strategy_->add_guard_condition(rclcpp::utilities::get_global_sigint_guard_condition());
+  if (!context_) {
+    context_ = rclcpp::contexts::default_context::get_global_default_context();
+  }
 
-  // Put the executor's guard condition in
+  // The number of guard conditions is always at least 1, the executor's guard condition
+  // (interrupt_guard_condition_). It is also triggered when the context is shut down, by SIGINT
+  // as well, so neither a global nor the context's guard condition is part of the waitset.
   memory_strategy_->add_guard_condition(&interrupt_guard_condition_);
   rcl_allocator_t allocator = memory_strategy_->get_allocator();
 
   if (rcl_wait_set_init(
-      &waitset_, 0, 2, 0, 0, 0, allocator) != RCL_RET_OK)
+      &waitset_, 0, 1, 0, 0, 0, allocator) != RCL_RET_OK)
   {
     fprintf(stderr,
       "[rclcpp::error] failed to create waitset: %s\n", rcl_get_error_string_safe());
@@ -63,10 +69,22 @@ Executor::Executor(const ExecutorArgs & args)
     }
     throw std::runtime_error("Failed to create waitset in Executor constructor");
   }
+
+  // The shutdown of the context cancels spinning, so the spin loops only check spinning.
+  // *INDENT-OFF*
+  shutdown_callback_id_ = context_->add_shutdown_callback([this]() {
+    spinning.store(false);
+    if (rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK) {
+      fprintf(stderr,
+        "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+    }
+  });
+  // *INDENT-ON*
 }
 
 Executor::~Executor()
 {
+  context_->remove_shutdown_callback(shutdown_callback_id_);
   // Finalize the waitset.
   if (rcl_wait_set_fini(&waitset_) != RCL_RET_OK) {
     fprintf(stderr,
@@ -82,6 +100,9 @@ Executor::~Executor()
 void
 Executor::add_node(rclcpp::node::Node::SharedPtr node_ptr, bool notify)
 {
+  if (node_ptr->get_context() != context_) {
+    throw std::runtime_error("Node belongs to a different context than the executor.");
+  }
   // If the node already has an executor
   if (node_ptr->has_executor.exchange(true)) {
     throw std::runtime_error("Node has already been added to an executor.");
@@ -160,8 +181,8 @@ Executor::spin_some()
     throw std::runtime_error("spin_some() called while already spinning");
   }
   RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
-  AnyExecutable::SharedPtr any_exec;
-  while ((any_exec = get_next_executable(std::chrono::milliseconds::zero())) && spinning.load()) {
+  AnyExecutable any_exec;
+  while (get_next_executable(any_exec, std::chrono::milliseconds::zero()) && spinning.load()) {
     execute_any_executable(any_exec);
   }
 }
@@ -173,8 +194,8 @@ Executor::spin_once(std::chrono::nanoseconds timeout)
     throw std::runtime_error("spin_once() called while already spinning");
   }
   RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
-  auto any_exec = get_next_executable(timeout);
-  if (any_exec) {
+  AnyExecutable any_exec;
+  if (get_next_executable(any_exec, timeout)) {
     execute_any_executable(any_exec);
   }
 }
@@ -188,6 +209,81 @@ Executor::cancel()
   }
 }
 
+rclcpp::context::Context::SharedPtr
+Executor::get_context() const
+{
+  return context_;
+}
+
+void
+Executor::set_statistics_enabled(bool enabled)
+{
+  statistics_enabled_.store(enabled);
+}
+
+bool
+Executor::get_statistics_enabled() const
+{
+  return statistics_enabled_.load();
+}
+
+rclcpp::executor::ExecutorStatistics &
+Executor::get_statistics()
+{
+  return statistics_;
+}
+
+void
+Executor::record_execution(
+  const AnyExecutable & any_exec, ExecutorStatistics::Clock::time_point execution_start)
+{
+  auto entity_statistics = any_exec.statistics;
+  if (!entity_statistics) {
+    // The memory strategy did not resolve the statistics, so look them up.
+    const void * handle = nullptr;
+    std::shared_ptr<const void> owner;
+    if (any_exec.timer) {
+      handle = any_exec.timer->get_timer_handle();
+      owner = any_exec.timer;
+    } else if (any_exec.subscription) {
+      handle = any_exec.subscription->get_subscription_handle();
+      owner = any_exec.subscription;
+    } else if (any_exec.subscription_intra_process) {
+      handle = any_exec.subscription_intra_process->get_intra_process_subscription_handle();
+      owner = any_exec.subscription_intra_process;
+    } else if (any_exec.service) {
+      handle = any_exec.service->get_service_handle();
+      owner = any_exec.service;
+    } else if (any_exec.service_intra_process) {
+      handle = any_exec.service_intra_process->get_intra_process_guard_condition();
+      owner = any_exec.service_intra_process;
+    } else if (any_exec.client) {
+      handle = any_exec.client->get_client_handle();
+      owner = any_exec.client;
+    } else if (any_exec.client_continuation) {
+      handle = any_exec.client_continuation->get_continuation_guard_condition();
+      owner = any_exec.client_continuation;
+    }
+    if (!handle) {
+      return;
+    }
+    entity_statistics = statistics_.get_entity_statistics(handle, owner);
+  }
+  auto execution_end = ExecutorStatistics::Clock::now();
+  auto wait_end = statistics_.get_last_wait_end();
+  entity_statistics->execution_time.record(execution_end - execution_start);
+  if (wait_end.time_since_epoch().count() != 0 && wait_end <= execution_start) {
+    entity_statistics->queue_delay.record(execution_start - wait_end);
+    entity_statistics->latency.record(execution_end - wait_end);
+  }
+}
+
+uint64_t
+Executor::get_number_of_avoided_wakeups() const
+{
+  return number_of_avoided_wakeups_.load();
+}
+
 void
 Executor::set_memory_strategy(rclcpp::memory_strategy::MemoryStrategy::SharedPtr memory_strategy)
 {
@@ -200,30 +296,62 @@ Executor::set_memory_strategy(rclcpp::memory_strategy::MemoryStrategy::SharedPtr
 void
 Executor::execute_any_executable(AnyExecutable::SharedPtr any_exec)
 {
-  if (!any_exec || !spinning.load()) {
+  if (any_exec) {
+    execute_any_executable(*any_exec);
+  }
+}
+
+void
+Executor::execute_any_executable(AnyExecutable & any_exec)
+{
+  if (!spinning.load()) {
+    any_exec.clear();
     return;
   }
-  if (any_exec->timer) {
-    execute_timer(any_exec->timer);
+  bool record_statistics = statistics_enabled_.load(std::memory_order_relaxed);
+  ExecutorStatistics::Clock::time_point execution_start;
+  if (record_statistics) {
+    execution_start = ExecutorStatistics::Clock::now();
   }
-  if (any_exec->subscription) {
-    execute_subscription(any_exec->subscription);
+  if (any_exec.timer) {
+    execute_timer(any_exec.timer);
   }
-  if (any_exec->subscription_intra_process) {
-    execute_intra_process_subscription(any_exec->subscription_intra_process);
+  if (any_exec.subscription) {
+    execute_subscription(any_exec.subscription);
   }
-  if (any_exec->service) {
-    execute_service(any_exec->service);
+  if (any_exec.subscription_intra_process) {
+    execute_intra_process_subscription(any_exec.subscription_intra_process);
   }
-  if (any_exec->client) {
-    execute_client(any_exec->client);
+  if (any_exec.service) {
+    execute_service(any_exec.service);
+  }
+  if (any_exec.service_intra_process) {
+    execute_intra_process_service(any_exec.service_intra_process);
+  }
+  if (any_exec.client) {
+    execute_client(any_exec.client);
+  }
+  if (any_exec.client_continuation) {
+    execute_client_continuation(any_exec.client_continuation);
+  }
+  if (record_statistics) {
+    record_execution(any_exec, execution_start);
   }
   // Reset the callback_group, regardless of type
-  any_exec->callback_group->can_be_taken_from().store(true);
-  // Wake the wait, because it may need to be recalculated or work that
-  // was previously blocked is now available.
-  if (rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK) {
-    throw std::runtime_error(rcl_get_error_string_safe());
+  auto group = std::move(any_exec.callback_group);
+  any_exec.clear();
+  group->can_be_taken_from().store(true);
+  // Entities of a mutually exclusive group are left out of the waitset while the group is in
+  // use, so wake up any thread that is currently waiting without them. Reentrant groups are
+  // never excluded and a single threaded executor has nobody waiting while it executes.
+  if (group->type() == callback_group::CallbackGroupType::MutuallyExclusive &&
+    number_of_waiting_threads_.load() > 0)
+  {
+    if (rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK) {
+      throw std::runtime_error(rcl_get_error_string_safe());
+    }
+  } else {
+    ++number_of_avoided_wakeups_;
   }
 }
 
@@ -231,40 +359,74 @@ void
 Executor::execute_subscription(
   rclcpp::subscription::SubscriptionBase::SharedPtr subscription)
 {
-  std::shared_ptr<void> message = subscription->create_message();
-  rmw_message_info_t message_info;
-
-  auto ret = rcl_take(subscription->get_subscription_handle(),
-      message.get(), &message_info);
-  if (ret == RCL_RET_OK) {
-    message_info.from_intra_process = false;
-    subscription->handle_message(message, message_info);
-  } else if (ret != RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
-    fprintf(stderr,
-      "[rclcpp::error] take failed for subscription on topic '%s': %s\n",
-      subscription->get_topic_name().c_str(), rcl_get_error_string_safe());
+  RCLCPP_TRACEPOINT(execute_subscription,
+    static_cast<const void *>(subscription->get_subscription_handle()));
+  // Drain up to take_batch_size messages before going back to wait, so a backlog of messages
+  // does not cost one full wait cycle per message.
+  size_t take_batch_size = subscription->get_take_batch_size();
+  for (size_t taken = 0; taken < take_batch_size; ++taken) {
+    std::shared_ptr<void> message = subscription->create_message();
+    rmw_message_info_t message_info;
+
+    auto ret = rcl_take(subscription->get_subscription_handle(),
+        message.get(), &message_info);
+    if (ret == RCL_RET_OK) {
+      RCLCPP_TRACEPOINT(take, static_cast<const void *>(subscription->get_subscription_handle()),
+        static_cast<const void *>(message.get()));
+      message_info.from_intra_process = false;
+      subscription->handle_message(message, message_info);
+    } else if (ret != RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
+      fprintf(stderr,
+        "[rclcpp::error] take failed for subscription on topic '%s': %s\n",
+        subscription->get_topic_name().c_str(), rcl_get_error_string_safe());
+    }
+    subscription->return_message(message);
+    if (ret != RCL_RET_OK) {
+      break;
+    }
   }
-  subscription->return_message(message);
 }
 
 void
 Executor::execute_intra_process_subscription(
   rclcpp::subscription::SubscriptionBase::SharedPtr subscription)
 {
-  rcl_interfaces::msg::IntraProcessMessage ipm;
-  rmw_message_info_t message_info;
-  rcl_ret_t status = rcl_take(
-    subscription->get_intra_process_subscription_handle(),
-    &ipm,
-    &message_info);
-
-  if (status == RCL_RET_OK) {
+  RCLCPP_TRACEPOINT(execute_intra_process_subscription,
+    static_cast<const void *>(subscription->get_subscription_handle()));
+  size_t take_batch_size = subscription->get_take_batch_size();
+  if (subscription->get_intra_process_guard_condition()) {
+    // Directly delivered, the notifications are queued in the subscription itself.
+    rcl_interfaces::msg::IntraProcessMessage ipm;
+    rmw_message_info_t message_info = rmw_message_info_t();
     message_info.from_intra_process = true;
-    subscription->handle_intra_process_message(ipm, message_info);
-  } else if (status != RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
-    fprintf(stderr,
-      "[rclcpp::error] take failed for intra process subscription on topic '%s': %s\n",
-      subscription->get_topic_name().c_str(), rcl_get_error_string_safe());
+    for (size_t taken = 0; taken < take_batch_size; ++taken) {
+      if (!subscription->take_intra_process_notification(ipm)) {
+        return;
+      }
+      subscription->handle_intra_process_message(ipm, message_info);
+    }
+    subscription->renotify_if_intra_process_pending();
+    return;
+  }
+  for (size_t taken = 0; taken < take_batch_size; ++taken) {
+    rcl_interfaces::msg::IntraProcessMessage ipm;
+    rmw_message_info_t message_info;
+    rcl_ret_t status = rcl_take(
+      subscription->get_intra_process_subscription_handle(),
+      &ipm,
+      &message_info);
+
+    if (status == RCL_RET_OK) {
+      message_info.from_intra_process = true;
+      subscription->handle_intra_process_message(ipm, message_info);
+    } else {
+      if (status != RCL_RET_SUBSCRIPTION_TAKE_FAILED) {
+        fprintf(stderr,
+          "[rclcpp::error] take failed for intra process subscription on topic '%s': %s\n",
+          subscription->get_topic_name().c_str(), rcl_get_error_string_safe());
+      }
+      break;
+    }
   }
 }
 
@@ -272,6 +434,7 @@ void
 Executor::execute_timer(
   rclcpp::timer::TimerBase::SharedPtr timer)
 {
+  RCLCPP_TRACEPOINT(execute_timer, static_cast<const void *>(timer->get_timer_handle()));
   timer->execute_callback();
 }
 
@@ -279,6 +442,7 @@ void
 Executor::execute_service(
   rclcpp::service::ServiceBase::SharedPtr service)
 {
+  RCLCPP_TRACEPOINT(execute_service, static_cast<const void *>(service->get_service_handle()));
   auto request_header = service->create_request_header();
   std::shared_ptr<void> request = service->create_request();
   rcl_ret_t status = rcl_take_request(
@@ -294,12 +458,29 @@ Executor::execute_service(
       "[rclcpp::error] take request failed for server of service '%s': %s\n",
       service->get_service_name().c_str(), rcl_get_error_string_safe());
   }
+  service->return_request(request);
+  service->return_request_header(request_header);
+}
+
+void
+Executor::execute_intra_process_service(
+  rclcpp::service::ServiceBase::SharedPtr service)
+{
+  RCLCPP_TRACEPOINT(execute_intra_process_service,
+    static_cast<const void *>(service->get_service_handle()));
+  rclcpp::service::ServiceBase::IntraProcessRequest request;
+  if (!service->take_intra_process_request(request)) {
+    return;
+  }
+  service->handle_intra_process_request(request);
+  service->renotify_if_intra_process_pending();
 }
 
 void
 Executor::execute_client(
   rclcpp::client::ClientBase::SharedPtr client)
 {
+  RCLCPP_TRACEPOINT(execute_client, static_cast<const void *>(client->get_client_handle()));
   auto request_header = client->create_request_header();
   std::shared_ptr<void> response = client->create_response();
   rcl_ret_t status = rcl_take_response(
@@ -315,12 +496,45 @@ Executor::execute_client(
       "[rclcpp::error] take response failed for client of service '%s': %s\n",
       client->get_service_name().c_str(), rcl_get_error_string_safe());
   }
+  client->return_response(response);
+  client->return_request_header(request_header);
+}
+
+void
+Executor::execute_client_continuation(
+  rclcpp::client::ClientBase::SharedPtr client)
+{
+  RCLCPP_TRACEPOINT(execute_client_continuation,
+    static_cast<const void *>(client->get_client_handle()));
+  std::function<void()> continuation;
+  if (!client->take_continuation(continuation)) {
+    return;
+  }
+  {
+    RCLCPP_TRACE_CALLBACK_SCOPE(static_cast<const void *>(client->get_client_handle()));
+    continuation();
+  }
+  client->renotify_if_continuations_pending();
 }
 
 void
 Executor::wait_for_work(std::chrono::nanoseconds timeout)
 {
+  // Announce the wait before the entities are collected, so a callback group released after
+  // collection is guaranteed to see this thread and trigger the interrupt guard condition.
+  ++number_of_waiting_threads_;
+  RCLCPP_SCOPE_EXIT(--this->number_of_waiting_threads_; );
+  RCLCPP_TRACEPOINT(wait_for_work_start, static_cast<const void *>(this),
+    static_cast<int64_t>(timeout.count()));
+
+  bool record_statistics = statistics_enabled_.load(std::memory_order_relaxed);
+  ExecutorStatistics::Clock::time_point wait_start;
+  if (record_statistics) {
+    wait_start = ExecutorStatistics::Clock::now();
+  }
+
   // Collect the subscriptions and timers to be waited on
+  memory_strategy_->set_executor_statistics(record_statistics ? &statistics_ : nullptr);
   memory_strategy_->clear_handles();
   bool has_invalid_weak_nodes = memory_strategy_->collect_entities(weak_nodes_);
 
@@ -339,40 +553,47 @@ Executor::wait_for_work(std::chrono::nanoseconds timeout)
     );
   }
 
-  if (rcl_wait_set_resize_subscriptions(
-      &waitset_, memory_strategy_->number_of_ready_subscriptions()) != RCL_RET_OK)
+  // The waitset is cleared after every wait, so it only needs to be resized when the number of
+  // entities has changed.
+  size_t number_of_subscriptions = memory_strategy_->number_of_ready_subscriptions();
+  if (waitset_.size_of_subscriptions != number_of_subscriptions &&
+    rcl_wait_set_resize_subscriptions(&waitset_, number_of_subscriptions) != RCL_RET_OK)
   {
     throw std::runtime_error(
             std::string("Couldn't resize the number of subscriptions in waitset : ") +
             rcl_get_error_string_safe());
   }
 
-  if (rcl_wait_set_resize_services(
-      &waitset_, memory_strategy_->number_of_ready_services()) != RCL_RET_OK)
+  size_t number_of_services = memory_strategy_->number_of_ready_services();
+  if (waitset_.size_of_services != number_of_services &&
+    rcl_wait_set_resize_services(&waitset_, number_of_services) != RCL_RET_OK)
   {
     throw std::runtime_error(
             std::string("Couldn't resize the number of services in waitset : ") +
             rcl_get_error_string_safe());
   }
 
-  if (rcl_wait_set_resize_clients(
-      &waitset_, memory_strategy_->number_of_ready_clients()) != RCL_RET_OK)
+  size_t number_of_clients = memory_strategy_->number_of_ready_clients();
+  if (waitset_.size_of_clients != number_of_clients &&
+    rcl_wait_set_resize_clients(&waitset_, number_of_clients) != RCL_RET_OK)
   {
     throw std::runtime_error(
             std::string("Couldn't resize the number of clients in waitset : ") +
             rcl_get_error_string_safe());
   }
 
-  if (rcl_wait_set_resize_guard_conditions(
-      &waitset_, memory_strategy_->number_of_guard_conditions()) != RCL_RET_OK)
+  size_t number_of_guard_conditions = memory_strategy_->number_of_guard_conditions();
+  if (waitset_.size_of_guard_conditions != number_of_guard_conditions &&
+    rcl_wait_set_resize_guard_conditions(&waitset_, number_of_guard_conditions) != RCL_RET_OK)
   {
     throw std::runtime_error(
             std::string("Couldn't resize the number of guard_conditions in waitset : ") +
             rcl_get_error_string_safe());
   }
 
-  if (rcl_wait_set_resize_timers(
-      &waitset_, memory_strategy_->number_of_ready_timers()) != RCL_RET_OK)
+  size_t number_of_timers = memory_strategy_->number_of_ready_timers();
+  if (waitset_.size_of_timers != number_of_timers &&
+    rcl_wait_set_resize_timers(&waitset_, number_of_timers) != RCL_RET_OK)
   {
     throw std::runtime_error(
             std::string("Couldn't resize the number of timers in waitset : ") +
@@ -382,8 +603,21 @@ Executor::wait_for_work(std::chrono::nanoseconds timeout)
   if (!memory_strategy_->add_handles_to_waitset(&waitset_)) {
     throw std::runtime_error("Couldn't fill waitset");
   }
+  // Don't block past the expiry of the next timer.
+  auto time_until_next_timer = memory_strategy_->time_until_next_timer();
+  if (time_until_next_timer >= std::chrono::nanoseconds::zero() &&
+    (timeout < std::chrono::nanoseconds::zero() || time_until_next_timer < timeout))
+  {
+    timeout = time_until_next_timer;
+  }
   rcl_ret_t status =
     rcl_wait(&waitset_, std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count());
+  RCLCPP_TRACEPOINT(wait_for_work_end, static_cast<const void *>(this), status);
+  if (record_statistics) {
+    auto wait_end = ExecutorStatistics::Clock::now();
+    statistics_.wait_time.record(wait_end - wait_start);
+    statistics_.set_last_wait_end(wait_end);
+  }
   if (status == RCL_RET_WAIT_SET_EMPTY) {
     fprintf(stderr, "Warning: empty waitset received in rcl_wait(). This should never happen.\n");
   } else if (status != RCL_RET_OK && status != RCL_RET_TIMEOUT) {
@@ -456,92 +690,78 @@ Executor::get_group_by_timer(rclcpp::timer::TimerBase::SharedPtr timer)
 }
 
 void
-Executor::get_next_timer(AnyExecutable::SharedPtr any_exec)
+Executor::get_next_timer(AnyExecutable & any_exec)
 {
-  for (auto & weak_node : weak_nodes_) {
-    auto node = weak_node.lock();
-    if (!node) {
-      continue;
-    }
-    for (auto & weak_group : node->get_callback_groups()) {
-      auto group = weak_group.lock();
-      if (!group || !group->can_be_taken_from().load()) {
-        continue;
-      }
-      for (auto & timer_ref : group->get_timer_ptrs()) {
-        auto timer = timer_ref.lock();
-        if (timer && timer->is_ready()) {
-          any_exec->timer = timer;
-          any_exec->callback_group = group;
-          node = get_node_by_group(group);
-          return;
-        }
-      }
-    }
-  }
+  memory_strategy_->get_next_timer(any_exec, weak_nodes_);
 }
 
 AnyExecutable::SharedPtr
 Executor::get_next_ready_executable()
 {
   auto any_exec = memory_strategy_->instantiate_next_executable();
-  // Check the timers to see if there are any that are ready, if so return
-  get_next_timer(any_exec);
-  if (any_exec->timer) {
-    return any_exec;
-  }
-  // Check the subscriptions to see if there are any that are ready
-  memory_strategy_->get_next_subscription(any_exec, weak_nodes_);
-  if (any_exec->subscription || any_exec->subscription_intra_process) {
-    return any_exec;
-  }
-  // Check the services to see if there are any that are ready
-  memory_strategy_->get_next_service(any_exec, weak_nodes_);
-  if (any_exec->service) {
-    return any_exec;
-  }
-  // Check the clients to see if there are any that are ready
-  memory_strategy_->get_next_client(any_exec, weak_nodes_);
-  if (any_exec->client) {
+  if (get_next_ready_executable(*any_exec)) {
     return any_exec;
   }
   // If there is no ready executable, return a null ptr
   return nullptr;
 }
 
+bool
+Executor::get_next_ready_executable(AnyExecutable & any_exec)
+{
+  if (!statistics_enabled_.load(std::memory_order_relaxed)) {
+    memory_strategy_->get_next_ready_executable(any_exec, weak_nodes_);
+    return any_exec.has_work();
+  }
+  auto selection_start = ExecutorStatistics::Clock::now();
+  memory_strategy_->get_next_ready_executable(any_exec, weak_nodes_);
+  statistics_.selection_time.record(ExecutorStatistics::Clock::now() - selection_start);
+  return any_exec.has_work();
+}
+
 AnyExecutable::SharedPtr
 Executor::get_next_executable(std::chrono::nanoseconds timeout)
+{
+  auto any_exec = memory_strategy_->instantiate_next_executable();
+  if (get_next_executable(*any_exec, timeout)) {
+    return any_exec;
+  }
+  return nullptr;
+}
+
+bool
+Executor::get_next_executable(AnyExecutable & any_exec, std::chrono::nanoseconds timeout)
 {
   // Check to see if there are any subscriptions or timers needing service
   // TODO(wjwwood): improve run to run efficiency of this function
-  auto any_exec = get_next_ready_executable();
+  bool success = get_next_ready_executable(any_exec);
   // If there are none
-  if (!any_exec) {
+  if (!success) {
     // Wait for subscriptions or timers to work on
     wait_for_work(timeout);
     if (!spinning.load()) {
-      return nullptr;
+      return false;
     }
     // Try again
-    any_exec = get_next_ready_executable();
+    success = get_next_ready_executable(any_exec);
   }
   // At this point any_exec should be valid with either a valid subscription
-  // or a valid timer, or it should be a null shared_ptr
-  if (any_exec) {
+  // or a valid timer, or it should be empty
+  if (success) {
     // If it is valid, check to see if the group is mutually exclusive or
     // not, then mark it accordingly
-    if (any_exec->callback_group && any_exec->callback_group->type() == \
+    if (any_exec.callback_group && any_exec.callback_group->type() == \
       callback_group::CallbackGroupType::MutuallyExclusive)
     {
       // It should not have been taken otherwise
-      assert(any_exec->callback_group->can_be_taken_from().load());
+      assert(any_exec.callback_group->can_be_taken_from().load());
       // Set to false to indicate something is being run from this group
       // This is reset to true either when the any_exec is executed or when the
-      // any_exec is destructued
-      any_exec->callback_group->can_be_taken_from().store(false);
+      // any_exec is cleared or destructed
+      any_exec.callback_group->can_be_taken_from().store(false);
     }
   }
-  return any_exec;
+  return success;
 }
 
 std::ostream &
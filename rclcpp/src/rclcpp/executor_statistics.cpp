@@ -0,0 +1,311 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/executor_statistics.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+using rclcpp::executor::EntityStatistics;
+using rclcpp::executor::ExecutorStatistics;
+using rclcpp::executor::Histogram;
+using rclcpp::executor::HistogramSnapshot;
+
+const size_t Histogram::number_of_buckets;
+
+Histogram::Histogram()
+{
+  reset();
+}
+
+void
+Histogram::record(std::chrono::nanoseconds duration)
+{
+  int64_t value = duration.count();
+  size_t bucket = 0;
+  for (int64_t remaining = value; remaining > 0 && bucket < number_of_buckets - 1;
+    remaining >>= 1)
+  {
+    ++bucket;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  int64_t current = min_.load(std::memory_order_relaxed);
+  while (value < current &&
+    !min_.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+  current = max_.load(std::memory_order_relaxed);
+  while (value > current &&
+    !max_.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+void
+Histogram::reset()
+{
+  for (auto & bucket : buckets_) {
+    bucket.store(0);
+  }
+  count_.store(0);
+  sum_.store(0);
+  min_.store(std::numeric_limits<int64_t>::max());
+  max_.store(std::numeric_limits<int64_t>::min());
+}
+
+uint64_t
+Histogram::count() const
+{
+  return count_.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds
+Histogram::min() const
+{
+  if (count() == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::nanoseconds(min_.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds
+Histogram::max() const
+{
+  if (count() == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds
+Histogram::mean() const
+{
+  uint64_t samples = count();
+  if (samples == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::nanoseconds(sum_.load(std::memory_order_relaxed) /
+           static_cast<int64_t>(samples));
+}
+
+std::chrono::nanoseconds
+Histogram::percentile(double fraction) const
+{
+  uint64_t samples = 0;
+  uint64_t counts[number_of_buckets];
+  for (size_t i = 0; i < number_of_buckets; ++i) {
+    counts[i] = bucket_count(i);
+    samples += counts[i];
+  }
+  if (samples == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  auto target = static_cast<uint64_t>(fraction * static_cast<double>(samples));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < number_of_buckets; ++i) {
+    seen += counts[i];
+    if (seen > target || seen == samples) {
+      return std::min(bucket_upper_bound(i), max());
+    }
+  }
+  return max();
+}
+
+uint64_t
+Histogram::bucket_count(size_t bucket) const
+{
+  if (bucket >= number_of_buckets) {
+    return 0;
+  }
+  return buckets_[bucket].load(std::memory_order_relaxed);
+}
+
+HistogramSnapshot
+Histogram::snapshot() const
+{
+  HistogramSnapshot snapshot;
+  for (size_t i = 0; i < number_of_buckets; ++i) {
+    snapshot.buckets[i] = bucket_count(i);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+std::chrono::nanoseconds
+Histogram::bucket_upper_bound(size_t bucket)
+{
+  if (bucket >= number_of_buckets - 1) {
+    return std::chrono::nanoseconds::max();
+  }
+  return std::chrono::nanoseconds(int64_t(1) << bucket);
+}
+
+HistogramSnapshot::HistogramSnapshot()
+: count(0), sum(0)
+{
+  std::fill(std::begin(buckets), std::end(buckets), 0);
+}
+
+HistogramSnapshot &
+HistogramSnapshot::operator+=(const HistogramSnapshot & other)
+{
+  for (size_t i = 0; i < Histogram::number_of_buckets; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+  count += other.count;
+  sum += other.sum;
+  return *this;
+}
+
+HistogramSnapshot &
+HistogramSnapshot::operator-=(const HistogramSnapshot & other)
+{
+  for (size_t i = 0; i < Histogram::number_of_buckets; ++i) {
+    buckets[i] -= other.buckets[i];
+  }
+  count -= other.count;
+  sum -= other.sum;
+  return *this;
+}
+
+std::chrono::nanoseconds
+HistogramSnapshot::mean() const
+{
+  if (count == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::nanoseconds(sum / static_cast<int64_t>(count));
+}
+
+std::chrono::nanoseconds
+HistogramSnapshot::percentile(double fraction) const
+{
+  if (count == 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  auto target = static_cast<uint64_t>(fraction * static_cast<double>(count));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < Histogram::number_of_buckets; ++i) {
+    seen += buckets[i];
+    if (seen > target || seen == count) {
+      return Histogram::bucket_upper_bound(i);
+    }
+  }
+  return Histogram::bucket_upper_bound(Histogram::number_of_buckets - 1);
+}
+
+ExecutorStatistics::ExecutorStatistics()
+: check_size_(1), last_wait_end_(0)
+{}
+
+EntityStatistics::SharedPtr
+ExecutorStatistics::get_entity_statistics(const void * handle, std::shared_ptr<const void> owner)
+{
+  std::lock_guard<std::mutex> lock(entities_mutex_);
+  if (entities_.size() >= check_size_) {
+    remove_destroyed_entities_locked();
+    check_size_ = 2 * entities_.size() + 1;
+  }
+  auto & entity = entities_[handle];
+  if (!entity.statistics || entity.is_destroyed()) {
+    // The handle is new, or its address was reused by a new entity.
+    entity.statistics = std::make_shared<EntityStatistics>();
+    entity.has_owner = static_cast<bool>(owner);
+    entity.owner = owner;
+  }
+  return entity.statistics;
+}
+
+EntityStatistics::SharedPtr
+ExecutorStatistics::find_entity_statistics(const void * handle) const
+{
+  std::lock_guard<std::mutex> lock(entities_mutex_);
+  auto it = entities_.find(handle);
+  if (it == entities_.end() || it->second.is_destroyed()) {
+    return nullptr;
+  }
+  return it->second.statistics;
+}
+
+size_t
+ExecutorStatistics::remove_destroyed_entities()
+{
+  std::lock_guard<std::mutex> lock(entities_mutex_);
+  return remove_destroyed_entities_locked();
+}
+
+size_t
+ExecutorStatistics::remove_destroyed_entities_locked()
+{
+  size_t count = 0;
+  for (auto it = entities_.begin(); it != entities_.end(); ) {
+    if (it->second.is_destroyed()) {
+      it = entities_.erase(it);
+      ++count;
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+std::vector<const void *>
+ExecutorStatistics::get_entity_handles() const
+{
+  std::lock_guard<std::mutex> lock(entities_mutex_);
+  std::vector<const void *> handles;
+  handles.reserve(entities_.size());
+  for (auto & pair : entities_) {
+    if (!pair.second.is_destroyed()) {
+      handles.push_back(pair.first);
+    }
+  }
+  return handles;
+}
+
+void
+ExecutorStatistics::set_last_wait_end(Clock::time_point time)
+{
+  last_wait_end_.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+ExecutorStatistics::Clock::time_point
+ExecutorStatistics::get_last_wait_end() const
+{
+  return Clock::time_point(Clock::duration(last_wait_end_.load(std::memory_order_relaxed)));
+}
+
+void
+ExecutorStatistics::reset()
+{
+  wait_time.reset();
+  selection_time.reset();
+  std::lock_guard<std::mutex> lock(entities_mutex_);
+  for (auto it = entities_.begin(); it != entities_.end(); ) {
+    if (!it->second.has_owner || it->second.is_destroyed()) {
+      it = entities_.erase(it);
+    } else {
+      it->second.statistics->queue_delay.reset();
+      it->second.statistics->execution_time.reset();
+      it->second.statistics->latency.reset();
+      ++it;
+    }
+  }
+  check_size_ = 2 * entities_.size() + 1;
+}
@@ -0,0 +1,185 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/executors/background_executor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/executors/single_threaded_executor.hpp"
+
+using rclcpp::executors::background_executor::BackgroundExecutor;
+
+struct BackgroundExecutor::State
+{
+  rclcpp::executor::Executor::SharedPtr executor;
+  std::mutex mutex;
+  std::condition_variable changes_applied;
+  // Nodes to add (true) or remove (false), in the order the changes were requested.
+  std::vector<std::pair<rclcpp::node::Node::SharedPtr, bool>> pending_changes;
+  uint64_t requested_changes = 0;
+  uint64_t applied_changes = 0;
+  bool running = true;
+  // Only accessed by the spinning thread.
+  std::vector<rclcpp::node::Node::WeakPtr> added_nodes;
+};
+
+void
+BackgroundExecutor::apply_pending_changes(State & state)
+{
+  std::vector<std::pair<rclcpp::node::Node::SharedPtr, bool>> changes;
+  uint64_t requested_changes;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    changes.swap(state.pending_changes);
+    requested_changes = state.requested_changes;
+  }
+  for (auto & change : changes) {
+    auto & node = change.first;
+    auto it = std::find_if(state.added_nodes.begin(), state.added_nodes.end(),
+        [&node](const rclcpp::node::Node::WeakPtr & added) {return added.lock() == node;});
+    try {
+      if (change.second && it == state.added_nodes.end()) {
+        // Hand the claim of add_node over to the executor, which takes it again.
+        node->has_executor.store(false);
+        state.executor->add_node(node, false);
+        state.added_nodes.push_back(node);
+      } else if (!change.second && it != state.added_nodes.end()) {
+        // Only remove nodes added here, removing clears the executor flag of any node.
+        state.added_nodes.erase(it);
+        state.executor->remove_node(node, false);
+      }
+    } catch (const std::exception & e) {
+      fprintf(stderr,
+        "[rclcpp::error] failed to %s node in background executor: %s\n",
+        change.second ? "add" : "remove", e.what());
+    }
+  }
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.applied_changes = requested_changes;
+  state.changes_applied.notify_all();
+}
+
+void
+BackgroundExecutor::run(std::shared_ptr<State> state)
+{
+  while (true) {
+    apply_pending_changes(*state);
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->running) {
+        break;
+      }
+    }
+    if (!state->executor->get_context()->ok()) {
+      // Keep applying changes so remove_node does not block, but there is nothing to spin.
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    // cancel() wakes this up for a change, but may be called before spin_once starts waiting,
+    // so the timeout bounds how long such a change waits.
+    state->executor->spin_once(std::chrono::milliseconds(100));
+  }
+  for (auto & weak_node : state->added_nodes) {
+    auto node = weak_node.lock();
+    if (node) {
+      state->executor->remove_node(node, false);
+    }
+  }
+  state->added_nodes.clear();
+}
+
+BackgroundExecutor::BackgroundExecutor(rclcpp::executor::Executor::SharedPtr executor)
+: state_(std::make_shared<State>())
+{
+  state_->executor = executor;
+  if (!state_->executor) {
+    state_->executor =
+      std::make_shared<rclcpp::executors::single_threaded_executor::SingleThreadedExecutor>();
+  }
+  thread_ = std::thread(&BackgroundExecutor::run, state_);
+}
+
+BackgroundExecutor::~BackgroundExecutor()
+{
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->running = false;
+    state_->changes_applied.notify_all();
+  }
+  state_->executor->cancel();
+  if (thread_.get_id() == std::this_thread::get_id()) {
+    // The last reference was released by a callback of this executor, which then stops once
+    // the callback returns.
+    thread_.detach();
+  } else {
+    thread_.join();
+  }
+}
+
+BackgroundExecutor::SharedPtr
+BackgroundExecutor::get_shared()
+{
+  static std::mutex shared_mutex;
+  static std::weak_ptr<BackgroundExecutor> weak_shared;
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  auto shared = weak_shared.lock();
+  if (!shared) {
+    shared = std::make_shared<BackgroundExecutor>();
+    weak_shared = shared;
+  }
+  return shared;
+}
+
+void
+BackgroundExecutor::add_node(rclcpp::node::Node::SharedPtr node)
+{
+  // Claim the node right away, so it cannot be added to another executor in the meantime.
+  bool has_executor = false;
+  if (!node->has_executor.compare_exchange_strong(has_executor, true)) {
+    throw std::runtime_error("Node has already been added to an executor.");
+  }
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->pending_changes.emplace_back(node, true);
+    ++state_->requested_changes;
+  }
+  state_->executor->cancel();
+}
+
+void
+BackgroundExecutor::remove_node(rclcpp::node::Node::SharedPtr node)
+{
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->pending_changes.emplace_back(node, false);
+  uint64_t change = ++state_->requested_changes;
+  lock.unlock();
+  state_->executor->cancel();
+  if (thread_.get_id() == std::this_thread::get_id()) {
+    // The change is applied once the callback returns, waiting for it would never end.
+    return;
+  }
+  lock.lock();
+  auto state = state_.get();
+  state_->changes_applied.wait(lock, [state, change]() {
+    return state->applied_changes >= change || !state->running;
+  });
+}
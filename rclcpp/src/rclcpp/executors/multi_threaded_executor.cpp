@@ -15,24 +15,83 @@
 #include "rclcpp/executors/multi_threaded_executor.hpp"
 
 #include <chrono>
+#include <cstdio>
 #include <functional>
 #include <vector>
 
+#include "rcl/error_handling.h"
+
 #include "rclcpp/utilities.hpp"
 #include "rclcpp/scope_exit.hpp"
 
 using rclcpp::executors::multi_threaded_executor::MultiThreadedExecutor;
+using rclcpp::executors::multi_threaded_executor::MultiThreadedExecutorOptions;
+
+namespace
+{
 
-MultiThreadedExecutor::MultiThreadedExecutor(const rclcpp::executor::ExecutorArgs & args)
-: executor::Executor(args)
+MultiThreadedExecutorOptions
+make_options(bool use_work_queue)
 {
-  number_of_threads_ = std::thread::hardware_concurrency();
+  MultiThreadedExecutorOptions options;
+  options.use_work_queue = use_work_queue;
+  return options;
+}
+
+}  // namespace
+
+MultiThreadedExecutor::MultiThreadedExecutor(
+  const rclcpp::executor::ExecutorArgs & args,
+  bool use_work_queue)
+: MultiThreadedExecutor(args, make_options(use_work_queue))
+{}
+
+MultiThreadedExecutor::MultiThreadedExecutor(
+  const rclcpp::executor::ExecutorArgs & args,
+  const MultiThreadedExecutorOptions & options)
+: executor::Executor(args),
+  number_of_threads_(options.number_of_threads),
+  options_(options),
+  spin_generation_(0),
+  pool_threads_finished_(0),
+  pool_shutdown_(false),
+  use_work_queue_(options.use_work_queue),
+  dispatcher_done_(false)
+{
+  if (options_.worker_pool) {
+    worker_queue_ = options_.worker_pool->create_queue(options_.worker_queue_options);
+    use_work_queue_ = false;
+    if (number_of_threads_ == 0) {
+      number_of_threads_ = options_.worker_pool->get_number_of_threads();
+    }
+  }
+  if (number_of_threads_ == 0) {
+    number_of_threads_ = std::thread::hardware_concurrency();
+  }
   if (number_of_threads_ == 0) {
     number_of_threads_ = 1;
   }
+  if (use_work_queue_ || worker_queue_) {
+    // One executable per thread: the workers each hold one while executing and the dispatcher
+    // prepares the next, so the queue never needs more. With a worker pool, this bounds the
+    // executables submitted to the pool at once.
+    executable_pool_ = std::vector<executor::AnyExecutable>(number_of_threads_);
+    free_executables_.reserve(number_of_threads_);
+    work_queue_.reserve(number_of_threads_);
+  }
 }
 
-MultiThreadedExecutor::~MultiThreadedExecutor() {}
+MultiThreadedExecutor::~MultiThreadedExecutor()
+{
+  {
+    std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+    pool_shutdown_ = true;
+  }
+  pool_cv_.notify_all();
+  for (auto & thread : pool_threads_) {
+    thread.join();
+  }
+}
 
 void
 MultiThreadedExecutor::spin()
@@ -41,19 +100,45 @@ MultiThreadedExecutor::spin()
     throw std::runtime_error("spin() called while already spinning");
   }
   RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
-  std::vector<std::thread> threads;
-  size_t thread_id = 0;
+  // Once spinning, the shutdown of the context cancels it.
+  if (!context_->ok()) {
+    return;
+  }
+  bool work_queue = use_work_queue_ && number_of_threads_ > 1;
   {
-    std::lock_guard<std::mutex> wait_lock(wait_mutex_);
-    for (; thread_id < number_of_threads_ - 1; ++thread_id) {
-      auto func = std::bind(&MultiThreadedExecutor::run, this, thread_id);
-      threads.emplace_back(func);
+    std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+    // Start the pool threads once, they are parked between calls to spin(). A worker pool
+    // replaces them.
+    size_t number_of_pool_threads = worker_queue_ ? 0 : number_of_threads_ - 1;
+    for (size_t thread_id = pool_threads_.size(); thread_id < number_of_pool_threads; ++thread_id) {
+      auto func = std::bind(&MultiThreadedExecutor::pool_thread_main, this, thread_id);
+      pool_threads_.emplace_back(func);
     }
+    {
+      std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+      dispatcher_done_ = false;
+      // Every executable of the pool is free at the start of a spin.
+      work_queue_.clear();
+      free_executables_.clear();
+      for (auto & any_exec : executable_pool_) {
+        any_exec.clear();
+        free_executables_.push_back(&any_exec);
+      }
+    }
+    pool_threads_finished_ = 0;
+    ++spin_generation_;
   }
+  pool_cv_.notify_all();
+  // Make sure the pool threads are back in their parked state before returning, even if the
+  // calling thread leaves through an exception.
+  RCLCPP_SCOPE_EXIT(wait_for_pool_threads(); );
 
-  run(thread_id);
-  for (auto & thread : threads) {
-    thread.join();
+  if (worker_queue_) {
+    run_worker_pool_dispatcher();
+  } else if (work_queue) {
+    run_dispatcher();
+  } else {
+    run(number_of_threads_ - 1);
   }
 }
 
@@ -66,15 +151,213 @@ MultiThreadedExecutor::get_number_of_threads()
 void
 MultiThreadedExecutor::run(size_t)
 {
-  while (rclcpp::utilities::ok() && spinning.load()) {
-    executor::AnyExecutable::SharedPtr any_exec;
+  // Each thread reuses its own executable, which is cleared after every execution.
+  executor::AnyExecutable any_exec;
+  while (spinning.load()) {
     {
       std::lock_guard<std::mutex> wait_lock(wait_mutex_);
-      if (!rclcpp::utilities::ok() || !spinning.load()) {
+      if (!spinning.load()) {
         return;
       }
-      any_exec = get_next_executable();
+      if (!get_next_executable(any_exec)) {
+        continue;
+      }
     }
     execute_any_executable(any_exec);
   }
 }
+
+void
+MultiThreadedExecutor::run_dispatcher()
+{
+  // Only this thread ever waits, so the wait itself needs no lock.
+  size_t max_queued = number_of_threads_ - 1;
+  while (spinning.load()) {
+    executor::AnyExecutable * any_exec = nullptr;
+    {
+      // Do not wait again while the workers still have a full backlog; the entities behind
+      // queued executables have not been taken yet and would be reported as ready again.
+      std::unique_lock<std::mutex> queue_lock(work_queue_mutex_);
+      // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+      work_queue_cv_.wait(queue_lock, [this, max_queued]() {
+        return (work_queue_.size() < max_queued && !free_executables_.empty()) ||
+               !spinning.load();
+      });
+      // *INDENT-ON*
+      if (!spinning.load()) {
+        break;
+      }
+      any_exec = free_executables_.back();
+      free_executables_.pop_back();
+    }
+    bool has_work = get_next_executable(*any_exec);
+    {
+      std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+      if (has_work) {
+        work_queue_.push_back(any_exec);
+      } else {
+        free_executables_.push_back(any_exec);
+      }
+    }
+    if (has_work) {
+      work_queue_cv_.notify_one();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+    dispatcher_done_ = true;
+    discard_queued_executables();
+  }
+  work_queue_cv_.notify_all();
+}
+
+void
+MultiThreadedExecutor::run_worker(size_t)
+{
+  while (true) {
+    executor::AnyExecutable * any_exec = nullptr;
+    {
+      std::unique_lock<std::mutex> queue_lock(work_queue_mutex_);
+      // *INDENT-OFF*
+      work_queue_cv_.wait(queue_lock, [this]() {
+        return !work_queue_.empty() || dispatcher_done_;
+      });
+      // *INDENT-ON*
+      if (dispatcher_done_) {
+        return;
+      }
+      any_exec = work_queue_.front();
+      work_queue_.erase(work_queue_.begin());
+    }
+    execute_any_executable(*any_exec);
+    {
+      std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+      free_executables_.push_back(any_exec);
+    }
+    // Let the dispatcher know there is room in the queue again.
+    work_queue_cv_.notify_all();
+  }
+}
+
+void
+MultiThreadedExecutor::run_worker_pool_dispatcher()
+{
+  while (spinning.load()) {
+    executor::AnyExecutable * any_exec = nullptr;
+    {
+      // Do not wait again while all executables are in flight, as in run_dispatcher().
+      std::unique_lock<std::mutex> queue_lock(work_queue_mutex_);
+      // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+      work_queue_cv_.wait(queue_lock, [this]() {
+        return !free_executables_.empty() || !spinning.load();
+      });
+      // *INDENT-ON*
+      if (!spinning.load()) {
+        break;
+      }
+      any_exec = free_executables_.back();
+      free_executables_.pop_back();
+    }
+    bool submitted = false;
+    // Return the executable if it is not submitted, or wait_for_pool_threads() would never end.
+    RCLCPP_SCOPE_EXIT(
+      if (!submitted) {
+        std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+        any_exec->clear();
+        free_executables_.push_back(any_exec);
+      }
+    );
+    if (!get_next_executable(*any_exec)) {
+      continue;
+    }
+    // *INDENT-OFF*
+    options_.worker_pool->submit(worker_queue_, [this, any_exec]() {
+      // Clears the executable instead if spinning stopped while it was queued.
+      execute_any_executable(*any_exec);
+      // Notify with the lock held: once the last executable is back, spin() may return and
+      // the executor be destroyed.
+      std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+      free_executables_.push_back(any_exec);
+      work_queue_cv_.notify_all();
+    });
+    // *INDENT-ON*
+    submitted = true;
+  }
+}
+
+void
+MultiThreadedExecutor::pool_thread_main(size_t this_thread_number)
+{
+  worker_pool::apply_thread_options(
+    options_.cpu_sets, options_.scheduling_policy, options_.scheduling_priority,
+    this_thread_number);
+  size_t last_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> pool_lock(pool_mutex_);
+      // *INDENT-OFF*
+      pool_cv_.wait(pool_lock, [this, last_generation]() {
+        return pool_shutdown_ || spin_generation_ != last_generation;
+      });
+      // *INDENT-ON*
+      if (pool_shutdown_) {
+        return;
+      }
+      last_generation = spin_generation_;
+    }
+    if (use_work_queue_) {
+      run_worker(this_thread_number);
+    } else {
+      run(this_thread_number);
+    }
+    {
+      std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+      ++pool_threads_finished_;
+    }
+    pool_cv_.notify_all();
+  }
+}
+
+void
+MultiThreadedExecutor::wait_for_pool_threads()
+{
+  // Wake anything still blocked in a wait, in case spin() is left early.
+  spinning.store(false);
+  if (rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+  }
+  {
+    std::lock_guard<std::mutex> queue_lock(work_queue_mutex_);
+    dispatcher_done_ = true;
+    discard_queued_executables();
+  }
+  work_queue_cv_.notify_all();
+  if (worker_queue_) {
+    // Wait for the executables submitted to the worker pool; the ones still queued are cleared
+    // instead of executed, since spinning stopped.
+    std::unique_lock<std::mutex> queue_lock(work_queue_mutex_);
+    // *INDENT-OFF*
+    work_queue_cv_.wait(queue_lock, [this]() {
+      return free_executables_.size() == executable_pool_.size();
+    });
+    // *INDENT-ON*
+  }
+  std::unique_lock<std::mutex> pool_lock(pool_mutex_);
+  // *INDENT-OFF*
+  pool_cv_.wait(pool_lock, [this]() {
+    return pool_threads_finished_ == pool_threads_.size();
+  });
+  // *INDENT-ON*
+}
+
+void
+MultiThreadedExecutor::discard_queued_executables()
+{
+  // Clearing releases the callback groups of executables which were taken but not executed.
+  for (auto any_exec : work_queue_) {
+    any_exec->clear();
+    free_executables_.push_back(any_exec);
+  }
+  work_queue_.clear();
+}
@@ -29,8 +29,15 @@ SingleThreadedExecutor::spin()
     throw std::runtime_error("spin_some() called while already spinning");
   }
   RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
-  while (rclcpp::utilities::ok() && spinning.load()) {
-    auto any_exec = get_next_executable();
-    execute_any_executable(any_exec);
+  // Once spinning, the shutdown of the context cancels it.
+  if (!context_->ok()) {
+    return;
+  }
+  // A single executable is reused for every iteration.
+  executor::AnyExecutable any_exec;
+  while (spinning.load()) {
+    if (get_next_executable(any_exec)) {
+      execute_any_executable(any_exec);
+    }
   }
 }
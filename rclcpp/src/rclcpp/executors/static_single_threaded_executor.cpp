@@ -0,0 +1,271 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/executors/static_single_threaded_executor.hpp"
+
+#include <string>
+
+#include "rcl/error_handling.h"
+
+#include "rclcpp/scope_exit.hpp"
+
+using rclcpp::executors::static_single_threaded_executor::StaticSingleThreadedExecutor;
+
+StaticSingleThreadedExecutor::StaticSingleThreadedExecutor(
+  const rclcpp::executor::ExecutorArgs & args)
+: executor::Executor(args) {}
+
+StaticSingleThreadedExecutor::~StaticSingleThreadedExecutor() {}
+
+void
+StaticSingleThreadedExecutor::spin()
+{
+  if (spinning.exchange(true)) {
+    throw std::runtime_error("spin() called while already spinning");
+  }
+  RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
+  // Once spinning, the shutdown of the context cancels it.
+  if (!context_->ok()) {
+    return;
+  }
+  rebuild_entities();
+  while (spinning.load()) {
+    fill_waitset();
+    rcl_ret_t status = rcl_wait(&waitset_, -1);
+    if (status == RCL_RET_WAIT_SET_EMPTY) {
+      fprintf(stderr, "Warning: empty waitset received in rcl_wait(). This should never happen.\n");
+    } else if (status != RCL_RET_OK && status != RCL_RET_TIMEOUT) {
+      throw std::runtime_error(std::string("rcl_wait() failed: ") + rcl_get_error_string_safe());
+    }
+    bool rebuild = execute_ready_entities();
+    clear_waitset();
+    if (rebuild) {
+      rebuild_entities();
+    }
+  }
+}
+
+void
+StaticSingleThreadedExecutor::rebuild_entities()
+{
+  subscriptions_.clear();
+  subscription_is_intra_process_.clear();
+  timers_.clear();
+  services_.clear();
+  clients_.clear();
+  guard_conditions_.clear();
+  intra_process_subscriptions_.clear();
+  intra_process_services_.clear();
+
+  guard_conditions_.push_back(&interrupt_guard_condition_);
+  for (auto & weak_node : weak_nodes_) {
+    auto node = weak_node.lock();
+    if (!node) {
+      continue;
+    }
+    guard_conditions_.push_back(node->get_notify_guard_condition());
+    for (auto & weak_group : node->get_callback_groups()) {
+      auto group = weak_group.lock();
+      if (!group) {
+        continue;
+      }
+      for (auto & weak_subscription : group->get_subscription_ptrs()) {
+        auto subscription = weak_subscription.lock();
+        if (subscription) {
+          subscriptions_.push_back(subscription);
+          subscription_is_intra_process_.push_back(false);
+          if (subscription->get_intra_process_subscription_handle()) {
+            subscriptions_.push_back(subscription);
+            subscription_is_intra_process_.push_back(true);
+          }
+          if (subscription->get_intra_process_guard_condition()) {
+            intra_process_subscriptions_.push_back(subscription);
+          }
+        }
+      }
+      for (auto & weak_timer : group->get_timer_ptrs()) {
+        auto timer = weak_timer.lock();
+        if (timer) {
+          timers_.push_back(timer);
+        }
+      }
+      for (auto & service : group->get_service_ptrs()) {
+        if (service) {
+          services_.push_back(service);
+          if (service->get_intra_process_guard_condition()) {
+            intra_process_services_.push_back(service);
+          }
+        }
+      }
+      for (auto & weak_client : group->get_client_ptrs()) {
+        auto client = weak_client.lock();
+        if (client) {
+          clients_.push_back(client);
+        }
+      }
+    }
+  }
+
+  number_of_notify_guard_conditions_ = guard_conditions_.size();
+  for (auto & subscription : intra_process_subscriptions_) {
+    guard_conditions_.push_back(subscription->get_intra_process_guard_condition());
+  }
+  for (auto & service : intra_process_services_) {
+    guard_conditions_.push_back(service->get_intra_process_guard_condition());
+  }
+  for (auto & client : clients_) {
+    guard_conditions_.push_back(client->get_continuation_guard_condition());
+  }
+
+  if (rcl_wait_set_resize_subscriptions(&waitset_, subscriptions_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of subscriptions in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_services(&waitset_, services_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of services in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_clients(&waitset_, clients_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of clients in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_guard_conditions(&waitset_, guard_conditions_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of guard_conditions in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_timers(&waitset_, timers_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of timers in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+void
+StaticSingleThreadedExecutor::fill_waitset()
+{
+  for (size_t i = 0; i < subscriptions_.size(); ++i) {
+    auto handle = subscription_is_intra_process_[i] ?
+      subscriptions_[i]->get_intra_process_subscription_handle() :
+      subscriptions_[i]->get_subscription_handle();
+    if (rcl_wait_set_add_subscription(&waitset_, handle) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add subscription to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & timer : timers_) {
+    if (rcl_wait_set_add_timer(&waitset_, timer->get_timer_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add timer to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & service : services_) {
+    if (rcl_wait_set_add_service(&waitset_, service->get_service_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add service to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & client : clients_) {
+    if (rcl_wait_set_add_client(&waitset_, client->get_client_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add client to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto guard_condition : guard_conditions_) {
+    if (rcl_wait_set_add_guard_condition(&waitset_, guard_condition) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to waitset: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+}
+
+bool
+StaticSingleThreadedExecutor::execute_ready_entities()
+{
+  // The waitset arrays are in the same order as the entity vectors.
+  for (size_t i = 0; i < timers_.size() && spinning.load(); ++i) {
+    if (waitset_.timers[i]) {
+      execute_timer(timers_[i]);
+    }
+  }
+  for (size_t i = 0; i < subscriptions_.size() && spinning.load(); ++i) {
+    if (waitset_.subscriptions[i]) {
+      if (subscription_is_intra_process_[i]) {
+        execute_intra_process_subscription(subscriptions_[i]);
+      } else {
+        execute_subscription(subscriptions_[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < intra_process_subscriptions_.size() && spinning.load(); ++i) {
+    if (waitset_.guard_conditions[number_of_notify_guard_conditions_ + i]) {
+      execute_intra_process_subscription(intra_process_subscriptions_[i]);
+    }
+  }
+  for (size_t i = 0; i < services_.size() && spinning.load(); ++i) {
+    if (waitset_.services[i]) {
+      execute_service(services_[i]);
+    }
+  }
+  size_t intra_process_service_offset =
+    number_of_notify_guard_conditions_ + intra_process_subscriptions_.size();
+  for (size_t i = 0; i < intra_process_services_.size() && spinning.load(); ++i) {
+    if (waitset_.guard_conditions[intra_process_service_offset + i]) {
+      execute_intra_process_service(intra_process_services_[i]);
+    }
+  }
+  for (size_t i = 0; i < clients_.size() && spinning.load(); ++i) {
+    if (waitset_.clients[i]) {
+      execute_client(clients_[i]);
+    }
+  }
+  size_t client_continuation_offset =
+    intra_process_service_offset + intra_process_services_.size();
+  for (size_t i = 0; i < clients_.size() && spinning.load(); ++i) {
+    if (waitset_.guard_conditions[client_continuation_offset + i]) {
+      execute_client_continuation(clients_[i]);
+    }
+  }
+  // The executor's and the nodes' guard conditions signal a change of the entities.
+  for (size_t i = 0; i < number_of_notify_guard_conditions_; ++i) {
+    if (waitset_.guard_conditions[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+StaticSingleThreadedExecutor::clear_waitset()
+{
+  if (rcl_wait_set_clear_subscriptions(&waitset_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear subscriptions from waitset");
+  }
+  if (rcl_wait_set_clear_services(&waitset_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear servicess from waitset");
+  }
+  if (rcl_wait_set_clear_clients(&waitset_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear clients from waitset");
+  }
+  if (rcl_wait_set_clear_guard_conditions(&waitset_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear guard conditions from waitset");
+  }
+  if (rcl_wait_set_clear_timers(&waitset_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear timers from waitset");
+  }
+}
@@ -0,0 +1,485 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/executors/thread_per_group_executor.hpp"
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rcl/error_handling.h"
+
+#include "rclcpp/scope_exit.hpp"
+
+using rclcpp::executors::thread_per_group_executor::ThreadPerGroupExecutor;
+
+ThreadPerGroupExecutor::ThreadPerGroupExecutor(
+  const rclcpp::executor::ExecutorArgs & args)
+: executor::Executor(args) {}
+
+ThreadPerGroupExecutor::~ThreadPerGroupExecutor() {}
+
+void
+ThreadPerGroupExecutor::spin()
+{
+  if (spinning.exchange(true)) {
+    throw std::runtime_error("spin() called while already spinning");
+  }
+  worker_error_ = nullptr;
+  RCLCPP_SCOPE_EXIT({
+    this->spinning.store(false);
+    join_workers();
+  });
+  // Once spinning, the shutdown of the context cancels it.
+  if (!context_->ok()) {
+    return;
+  }
+  // The spinning thread only waits on guard conditions.
+  if (rcl_wait_set_resize_subscriptions(&waitset_, 0) != RCL_RET_OK ||
+    rcl_wait_set_resize_services(&waitset_, 0) != RCL_RET_OK ||
+    rcl_wait_set_resize_clients(&waitset_, 0) != RCL_RET_OK ||
+    rcl_wait_set_resize_timers(&waitset_, 0) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Couldn't resize the waitset: ") + rcl_get_error_string_safe());
+  }
+  while (spinning.load()) {
+    update_workers();
+    fill_guard_conditions();
+    rcl_ret_t status = rcl_wait(&waitset_, -1);
+    if (status == RCL_RET_WAIT_SET_EMPTY) {
+      fprintf(stderr, "Warning: empty waitset received in rcl_wait(). This should never happen.\n");
+    } else if (status != RCL_RET_OK && status != RCL_RET_TIMEOUT) {
+      throw std::runtime_error(std::string("rcl_wait() failed: ") + rcl_get_error_string_safe());
+    }
+    // The executor's and the nodes' guard conditions signal a change of the nodes.
+    bool changed = false;
+    for (size_t i = 0; i < guard_conditions_.size(); ++i) {
+      if (waitset_.guard_conditions[i]) {
+        changed = true;
+        break;
+      }
+    }
+    if (rcl_wait_set_clear_guard_conditions(&waitset_) != RCL_RET_OK) {
+      throw std::runtime_error("Couldn't clear guard conditions from waitset");
+    }
+    if (changed) {
+      wake_workers(true);
+    }
+  }
+  join_workers();
+  if (worker_error_) {
+    std::exception_ptr error = worker_error_;
+    worker_error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+size_t
+ThreadPerGroupExecutor::get_number_of_workers()
+{
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  return workers_.size();
+}
+
+static void
+finalize_worker_handles(
+  rcl_wait_set_t * waitset, rcl_guard_condition_t * wake_guard_condition)
+{
+  if (rcl_wait_set_fini(waitset) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy waitset: %s\n", rcl_get_error_string_safe());
+  }
+  if (rcl_guard_condition_fini(wake_guard_condition) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy guard condition: %s\n", rcl_get_error_string_safe());
+  }
+}
+
+void
+ThreadPerGroupExecutor::update_workers()
+{
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  // Join the workers whose group is gone.
+  for (auto it = workers_.begin(); it != workers_.end(); ) {
+    if ((*it)->finished.load()) {
+      join_worker(it->get());
+      it = workers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto & weak_node : weak_nodes_) {
+    auto node = weak_node.lock();
+    if (!node) {
+      continue;
+    }
+    for (auto & weak_group : node->get_callback_groups()) {
+      auto group = weak_group.lock();
+      if (!group) {
+        continue;
+      }
+      bool has_worker = false;
+      for (auto & worker : workers_) {
+        if (worker->group.lock() == group) {
+          has_worker = true;
+          break;
+        }
+      }
+      if (has_worker) {
+        continue;
+      }
+      std::unique_ptr<GroupWorker> worker(new GroupWorker());
+      worker->group = group;
+      worker->rebuild.store(true);
+      worker->finished.store(false);
+      if (rcl_guard_condition_init(
+          &worker->wake_guard_condition, rcl_guard_condition_get_default_options()) != RCL_RET_OK)
+      {
+        throw std::runtime_error(
+                std::string("Failed to create guard condition for callback group worker: ") +
+                rcl_get_error_string_safe());
+      }
+      if (rcl_wait_set_init(
+          &worker->waitset, 0, 1, 0, 0, 0, memory_strategy_->get_allocator()) != RCL_RET_OK)
+      {
+        std::string error = rcl_get_error_string_safe();
+        if (rcl_guard_condition_fini(&worker->wake_guard_condition) != RCL_RET_OK) {
+          fprintf(stderr,
+            "[rclcpp::error] failed to destroy guard condition: %s\n",
+            rcl_get_error_string_safe());
+        }
+        throw std::runtime_error("Failed to create waitset for callback group worker: " + error);
+      }
+      worker->thread = std::thread(&ThreadPerGroupExecutor::run_worker, this, worker.get());
+      workers_.push_back(std::move(worker));
+    }
+  }
+}
+
+void
+ThreadPerGroupExecutor::fill_guard_conditions()
+{
+  guard_conditions_.clear();
+  guard_conditions_.push_back(&interrupt_guard_condition_);
+  for (auto & weak_node : weak_nodes_) {
+    auto node = weak_node.lock();
+    if (node) {
+      guard_conditions_.push_back(node->get_notify_guard_condition());
+    }
+  }
+  if (waitset_.size_of_guard_conditions != guard_conditions_.size() &&
+    rcl_wait_set_resize_guard_conditions(&waitset_, guard_conditions_.size()) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of guard_conditions in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  for (auto guard_condition : guard_conditions_) {
+    if (rcl_wait_set_add_guard_condition(&waitset_, guard_condition) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to waitset: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+}
+
+void
+ThreadPerGroupExecutor::wake_workers(bool rebuild)
+{
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  for (auto & worker : workers_) {
+    if (rebuild) {
+      worker->rebuild.store(true);
+    }
+    if (rcl_trigger_guard_condition(&worker->wake_guard_condition) != RCL_RET_OK) {
+      fprintf(stderr,
+        "[rclcpp::error] failed to wake callback group worker: %s\n",
+        rcl_get_error_string_safe());
+    }
+  }
+}
+
+void
+ThreadPerGroupExecutor::join_workers()
+{
+  wake_workers(false);
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  for (auto & worker : workers_) {
+    join_worker(worker.get());
+  }
+  workers_.clear();
+}
+
+void
+ThreadPerGroupExecutor::join_worker(GroupWorker * worker)
+{
+  worker->thread.join();
+  if (worker->error && !worker_error_) {
+    worker_error_ = worker->error;
+  }
+  finalize_worker_handles(&worker->waitset, &worker->wake_guard_condition);
+}
+
+void
+ThreadPerGroupExecutor::run_worker(GroupWorker * worker)
+{
+  RCLCPP_SCOPE_EXIT(worker->finished.store(true); );
+  // An exception escaping a thread terminates the process, so hand it to spin() instead.
+  try {
+    while (spinning.load()) {
+      if (worker->rebuild.exchange(false) && !collect_group_entities(worker)) {
+        // The group is gone, so is the work of this thread.
+        return;
+      }
+      fill_worker_waitset(worker);
+      rcl_ret_t status = rcl_wait(&worker->waitset, -1);
+      if (status == RCL_RET_WAIT_SET_EMPTY) {
+        fprintf(stderr,
+          "Warning: empty waitset received in rcl_wait(). This should never happen.\n");
+      } else if (status != RCL_RET_OK && status != RCL_RET_TIMEOUT) {
+        throw std::runtime_error(std::string("rcl_wait() failed: ") + rcl_get_error_string_safe());
+      }
+      execute_worker_entities(worker);
+      clear_worker_waitset(worker);
+    }
+  } catch (...) {
+    worker->error = std::current_exception();
+    // Stop spinning and wake up the spinning thread, which joins the workers and rethrows.
+    spinning.store(false);
+    if (rcl_trigger_guard_condition(&interrupt_guard_condition_) != RCL_RET_OK) {
+      fprintf(stderr,
+        "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+    }
+  }
+}
+
+bool
+ThreadPerGroupExecutor::collect_group_entities(GroupWorker * worker)
+{
+  auto group = worker->group.lock();
+  if (!group) {
+    return false;
+  }
+  worker->subscriptions.clear();
+  worker->subscription_is_intra_process.clear();
+  worker->timers.clear();
+  worker->services.clear();
+  worker->clients.clear();
+  worker->intra_process_subscriptions.clear();
+  worker->intra_process_services.clear();
+  for (auto & weak_subscription : group->get_subscription_ptrs()) {
+    auto subscription = weak_subscription.lock();
+    if (subscription) {
+      worker->subscriptions.push_back(subscription);
+      worker->subscription_is_intra_process.push_back(false);
+      if (subscription->get_intra_process_subscription_handle()) {
+        worker->subscriptions.push_back(subscription);
+        worker->subscription_is_intra_process.push_back(true);
+      }
+      if (subscription->get_intra_process_guard_condition()) {
+        worker->intra_process_subscriptions.push_back(subscription);
+      }
+    }
+  }
+  for (auto & weak_timer : group->get_timer_ptrs()) {
+    auto timer = weak_timer.lock();
+    if (timer) {
+      worker->timers.push_back(timer);
+    }
+  }
+  for (auto & service : group->get_service_ptrs()) {
+    if (service) {
+      worker->services.push_back(service);
+      if (service->get_intra_process_guard_condition()) {
+        worker->intra_process_services.push_back(service);
+      }
+    }
+  }
+  for (auto & weak_client : group->get_client_ptrs()) {
+    auto client = weak_client.lock();
+    if (client) {
+      worker->clients.push_back(client);
+    }
+  }
+
+  rcl_wait_set_t * waitset = &worker->waitset;
+  if (rcl_wait_set_resize_subscriptions(waitset, worker->subscriptions.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of subscriptions in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_services(waitset, worker->services.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of services in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_clients(waitset, worker->clients.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of clients in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_timers(waitset, worker->timers.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of timers in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_guard_conditions(
+      waitset, 1 + worker->intra_process_subscriptions.size() +
+      worker->intra_process_services.size() + worker->clients.size()) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Couldn't resize the number of guard_conditions in waitset : ") +
+            rcl_get_error_string_safe());
+  }
+  return true;
+}
+
+void
+ThreadPerGroupExecutor::fill_worker_waitset(GroupWorker * worker)
+{
+  rcl_wait_set_t * waitset = &worker->waitset;
+  for (size_t i = 0; i < worker->subscriptions.size(); ++i) {
+    auto handle = worker->subscription_is_intra_process[i] ?
+      worker->subscriptions[i]->get_intra_process_subscription_handle() :
+      worker->subscriptions[i]->get_subscription_handle();
+    if (rcl_wait_set_add_subscription(waitset, handle) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add subscription to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & timer : worker->timers) {
+    if (rcl_wait_set_add_timer(waitset, timer->get_timer_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add timer to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & service : worker->services) {
+    if (rcl_wait_set_add_service(waitset, service->get_service_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add service to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  for (auto & client : worker->clients) {
+    if (rcl_wait_set_add_client(waitset, client->get_client_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add client to waitset: ") + rcl_get_error_string_safe());
+    }
+  }
+  if (rcl_wait_set_add_guard_condition(waitset, &worker->wake_guard_condition) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't add guard_condition to waitset: ") +
+            rcl_get_error_string_safe());
+  }
+  for (auto & subscription : worker->intra_process_subscriptions) {
+    if (rcl_wait_set_add_guard_condition(
+        waitset, subscription->get_intra_process_guard_condition()) != RCL_RET_OK)
+    {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to waitset: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+  for (auto & service : worker->intra_process_services) {
+    if (rcl_wait_set_add_guard_condition(
+        waitset, service->get_intra_process_guard_condition()) != RCL_RET_OK)
+    {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to waitset: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+  for (auto & client : worker->clients) {
+    if (rcl_wait_set_add_guard_condition(
+        waitset, client->get_continuation_guard_condition()) != RCL_RET_OK)
+    {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to waitset: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+}
+
+void
+ThreadPerGroupExecutor::execute_worker_entities(GroupWorker * worker)
+{
+  // The waitset arrays are in the same order as the entity vectors. Only this thread executes
+  // the group, so there is no need to claim it through can_be_taken_from().
+  rcl_wait_set_t * waitset = &worker->waitset;
+  for (size_t i = 0; i < worker->timers.size() && spinning.load(); ++i) {
+    if (waitset->timers[i]) {
+      execute_timer(worker->timers[i]);
+    }
+  }
+  for (size_t i = 0; i < worker->subscriptions.size() && spinning.load(); ++i) {
+    if (waitset->subscriptions[i]) {
+      if (worker->subscription_is_intra_process[i]) {
+        execute_intra_process_subscription(worker->subscriptions[i]);
+      } else {
+        execute_subscription(worker->subscriptions[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < worker->intra_process_subscriptions.size() && spinning.load(); ++i) {
+    // Index 0 is the wake guard condition.
+    if (waitset->guard_conditions[1 + i]) {
+      execute_intra_process_subscription(worker->intra_process_subscriptions[i]);
+    }
+  }
+  for (size_t i = 0; i < worker->services.size() && spinning.load(); ++i) {
+    if (waitset->services[i]) {
+      execute_service(worker->services[i]);
+    }
+  }
+  size_t intra_process_service_offset = 1 + worker->intra_process_subscriptions.size();
+  for (size_t i = 0; i < worker->intra_process_services.size() && spinning.load(); ++i) {
+    if (waitset->guard_conditions[intra_process_service_offset + i]) {
+      execute_intra_process_service(worker->intra_process_services[i]);
+    }
+  }
+  for (size_t i = 0; i < worker->clients.size() && spinning.load(); ++i) {
+    if (waitset->clients[i]) {
+      execute_client(worker->clients[i]);
+    }
+  }
+  size_t client_continuation_offset =
+    intra_process_service_offset + worker->intra_process_services.size();
+  for (size_t i = 0; i < worker->clients.size() && spinning.load(); ++i) {
+    if (waitset->guard_conditions[client_continuation_offset + i]) {
+      execute_client_continuation(worker->clients[i]);
+    }
+  }
+}
+
+void
+ThreadPerGroupExecutor::clear_worker_waitset(GroupWorker * worker)
+{
+  rcl_wait_set_t * waitset = &worker->waitset;
+  if (rcl_wait_set_clear_subscriptions(waitset) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear subscriptions from waitset");
+  }
+  if (rcl_wait_set_clear_services(waitset) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear servicess from waitset");
+  }
+  if (rcl_wait_set_clear_clients(waitset) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear clients from waitset");
+  }
+  if (rcl_wait_set_clear_guard_conditions(waitset) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear guard conditions from waitset");
+  }
+  if (rcl_wait_set_clear_timers(waitset) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear timers from waitset");
+  }
+}
@@ -0,0 +1,238 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/executors/worker_pool.hpp"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using rclcpp::executors::worker_pool::SchedulingPolicy;
+using rclcpp::executors::worker_pool::WorkerPool;
+using rclcpp::executors::worker_pool::WorkerQueueOptions;
+
+namespace
+{
+
+/// The pass of a queue advances by this divided by its share for every task taken from it.
+const uint64_t stride_base = WorkerQueueOptions::max_share;
+
+}  // namespace
+
+class WorkerPool::Queue
+{
+public:
+  Queue(const WorkerPool * pool, const WorkerQueueOptions & options, uint64_t pass)
+  : pool(pool), priority(options.priority), stride(stride_base / options.share), pass(pass)
+  {}
+
+  const WorkerPool * const pool;
+  const int priority;
+  const uint64_t stride;
+  // The members below are protected by the mutex of the pool.
+  uint64_t pass;
+  std::deque<std::function<void()>> tasks;
+};
+
+void
+rclcpp::executors::worker_pool::apply_thread_options(
+  const std::vector<std::vector<size_t>> & cpu_sets,
+  SchedulingPolicy scheduling_policy,
+  int scheduling_priority,
+  size_t this_thread_number)
+{
+#if defined(__linux__)
+  if (!cpu_sets.empty()) {
+    const auto & cpu_set = cpu_sets[this_thread_number % cpu_sets.size()];
+    if (!cpu_set.empty()) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      for (auto cpu : cpu_set) {
+        CPU_SET(cpu, &cpuset);
+      }
+      int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+      if (ret != 0) {
+        fprintf(stderr,
+          "[rclcpp::error] failed to set affinity of executor thread %zu: %s\n",
+          this_thread_number, strerror(ret));
+      }
+    }
+  }
+#else
+  if (!cpu_sets.empty()) {
+    fprintf(stderr,
+      "[rclcpp::error] cpu affinity for executor threads is not supported on this platform\n");
+  }
+#endif
+
+  if (scheduling_policy == SchedulingPolicy::Inherit) {
+    return;
+  }
+#ifndef _WIN32
+  sched_param param;
+  param.sched_priority = scheduling_priority;
+  int policy = scheduling_policy == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+  int ret = pthread_setschedparam(pthread_self(), policy, &param);
+  if (ret != 0) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to set scheduling policy of executor thread %zu: %s\n",
+      this_thread_number, strerror(ret));
+  }
+#else
+  (void)scheduling_priority;
+  fprintf(stderr,
+    "[rclcpp::error] scheduling policy for executor threads is not supported on this platform\n");
+#endif
+}
+
+WorkerPool::WorkerPool(const WorkerPoolOptions & options)
+: options_(options), current_pass_(0), shutdown_(false)
+{
+  if (options_.number_of_threads == 0) {
+    options_.number_of_threads = std::thread::hardware_concurrency();
+  }
+  if (options_.number_of_threads == 0) {
+    options_.number_of_threads = 1;
+  }
+  threads_.reserve(options_.number_of_threads);
+  for (size_t thread_id = 0; thread_id < options_.number_of_threads; ++thread_id) {
+    threads_.emplace_back(std::bind(&WorkerPool::run, this, thread_id));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  condition_.notify_all();
+  for (auto & thread : threads_) {
+    thread.join();
+  }
+}
+
+WorkerPool::QueueSharedPtr
+WorkerPool::create_queue(const WorkerQueueOptions & options)
+{
+  if (options.share == 0) {
+    throw std::invalid_argument("the share of a worker queue must be positive");
+  }
+  if (options.share > WorkerQueueOptions::max_share) {
+    throw std::invalid_argument(
+            "the share of a worker queue must not exceed " +
+            std::to_string(WorkerQueueOptions::max_share));
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto queue = std::make_shared<Queue>(this, options, current_pass_);
+  // Forget the queues which were released, so creating queues does not grow the list forever.
+  // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+  queues_.erase(std::remove_if(queues_.begin(), queues_.end(),
+    [](const std::weak_ptr<Queue> & weak_queue) {
+      return weak_queue.expired();
+    }), queues_.end());
+  // *INDENT-ON*
+  queues_.push_back(queue);
+  return queue;
+}
+
+void
+WorkerPool::submit(const QueueSharedPtr & queue, std::function<void()> task)
+{
+  if (!queue || queue->pool != this) {
+    throw std::invalid_argument("the worker queue does not belong to this pool");
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue->tasks.empty()) {
+      // A queue which was idle must not make up for the time it did not use.
+      queue->pass = std::max(queue->pass, current_pass_);
+    }
+    queue->tasks.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+size_t
+WorkerPool::get_number_of_threads() const
+{
+  return threads_.size();
+}
+
+void
+WorkerPool::run(size_t this_thread_number)
+{
+  apply_thread_options(
+    options_.cpu_sets, options_.scheduling_policy, options_.scheduling_priority,
+    this_thread_number);
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // *INDENT-OFF*
+      condition_.wait(lock, [this, &task]() {
+        return shutdown_ || take_next_task(task);
+      });
+      // *INDENT-ON*
+      if (shutdown_) {
+        return;
+      }
+    }
+    task();
+  }
+}
+
+bool
+WorkerPool::take_next_task(std::function<void()> & task)
+{
+  QueueSharedPtr next;
+  for (auto & weak_queue : queues_) {
+    auto queue = weak_queue.lock();
+    if (!queue || queue->tasks.empty()) {
+      continue;
+    }
+    if (!next || queue->priority > next->priority ||
+      (queue->priority == next->priority && queue->pass < next->pass))
+    {
+      next = queue;
+    }
+  }
+  if (!next) {
+    return false;
+  }
+  task = std::move(next->tasks.front());
+  next->tasks.pop_front();
+  current_pass_ = next->pass;
+  next->pass += next->stride;
+  return true;
+}
+
+WorkerPool::SharedPtr
+rclcpp::executors::worker_pool::get_global_worker_pool()
+{
+  static WorkerPool::SharedPtr global_worker_pool = WorkerPool::make_shared();
+  return global_worker_pool;
+}
@@ -0,0 +1,173 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/graph_listener.hpp"
+
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+using rclcpp::graph_listener::GraphListener;
+
+GraphListener::GraphListener()
+: poll_period_(std::chrono::milliseconds(100)), notified_(false), stopped_(false)
+{}
+
+GraphListener::~GraphListener()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  wake_listener_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool
+GraphListener::wait_for(
+  rclcpp::context::Context & context,
+  std::function<bool()> condition,
+  std::chrono::nanoseconds timeout)
+{
+  if (condition()) {
+    return true;
+  }
+  if (!context.ok() || timeout == std::chrono::nanoseconds::zero()) {
+    return false;
+  }
+  auto wait = std::make_shared<Wait>();
+  wait->context = &context;
+  wait->condition = std::move(condition);
+  wait->done = false;
+  wait->result = false;
+  wait->checking = false;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopped_) {
+    return false;
+  }
+  if (!thread_.joinable()) {
+    thread_ = std::thread(&GraphListener::run, this);
+  }
+  waits_.push_back(wait);
+  wake_listener_.notify_all();
+
+  auto is_done = [&wait]() {
+      return wait->done;
+    };
+  if (timeout < std::chrono::nanoseconds::zero()) {
+    wake_waiters_.wait(lock, is_done);
+  } else {
+    wake_waiters_.wait_for(lock, timeout, is_done);
+  }
+  if (!wait->done) {
+    waits_.remove(wait);
+    // The condition may refer to the caller's state, so let a running check finish first.
+    wake_waiters_.wait(lock, [&wait]() {
+        return !wait->checking;
+      });
+  }
+  return wait->done && wait->result;
+}
+
+void
+GraphListener::notify()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (waits_.empty()) {
+      return;
+    }
+    notified_ = true;
+  }
+  wake_listener_.notify_all();
+}
+
+void
+GraphListener::set_poll_period(std::chrono::nanoseconds poll_period)
+{
+  if (poll_period <= std::chrono::nanoseconds::zero()) {
+    throw std::invalid_argument("the poll period must be positive");
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    poll_period_ = poll_period;
+  }
+  // Apply a shorter period right away rather than after the current one.
+  notify();
+}
+
+std::chrono::nanoseconds
+GraphListener::get_poll_period() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return poll_period_;
+}
+
+void
+GraphListener::run()
+{
+  std::vector<std::shared_ptr<Wait>> waits;
+  std::vector<char> done;
+  std::vector<char> results;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopped_) {
+    if (waits_.empty()) {
+      wake_listener_.wait(lock, [this]() {
+          return stopped_ || !waits_.empty();
+        });
+      continue;
+    }
+    notified_ = false;
+    waits.assign(waits_.begin(), waits_.end());
+    for (auto & wait : waits) {
+      wait->checking = true;
+    }
+    lock.unlock();
+
+    // The conditions query the middleware, so check them without holding the lock.
+    done.assign(waits.size(), false);
+    results.assign(waits.size(), false);
+    for (size_t i = 0; i < waits.size(); ++i) {
+      if (!waits[i]->context->ok()) {
+        done[i] = true;
+        continue;
+      }
+      try {
+        results[i] = waits[i]->condition();
+      } catch (const std::exception & e) {
+        fprintf(stderr, "[rclcpp::error] failed to check the graph: %s\n", e.what());
+      }
+      done[i] = results[i];
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < waits.size(); ++i) {
+      waits[i]->checking = false;
+      if (done[i]) {
+        waits[i]->done = true;
+        waits[i]->result = results[i] != 0;
+        waits_.remove(waits[i]);
+      }
+    }
+    waits.clear();
+    wake_waiters_.notify_all();
+    wake_listener_.wait_for(lock, poll_period_, [this]() {
+        return stopped_ || notified_;
+      });
+  }
+}
@@ -23,9 +23,26 @@ static std::atomic<uint64_t> _next_unique_id {1};
 
 IntraProcessManager::IntraProcessManager(
   rclcpp::intra_process_manager::IntraProcessManagerImplBase::SharedPtr impl)
-: impl_(impl)
+: impl_(impl), direct_delivery_(false), has_entities_(false)
 {}
 
+void
+IntraProcessManager::set_direct_delivery(bool direct_delivery)
+{
+  if (has_entities_.load() && direct_delivery != direct_delivery_.load()) {
+    throw std::runtime_error(
+            "cannot change the intra process delivery after publishers or subscriptions "
+            "were added");
+  }
+  direct_delivery_.store(direct_delivery);
+}
+
+bool
+IntraProcessManager::get_direct_delivery() const
+{
+  return direct_delivery_.load();
+}
+
 IntraProcessManager::~IntraProcessManager()
 {}
 
@@ -33,6 +50,7 @@ uint64_t
 IntraProcessManager::add_subscription(
   rclcpp::subscription::SubscriptionBase::SharedPtr subscription)
 {
+  has_entities_.store(true);
   auto id = IntraProcessManager::get_next_unique_id();
   impl_->add_subscription(id, subscription);
   return id;
@@ -50,12 +68,49 @@ IntraProcessManager::remove_publisher(uint64_t intra_process_publisher_id)
   impl_->remove_publisher(intra_process_publisher_id);
 }
 
+void
+IntraProcessManager::set_lifespan(
+  uint64_t intra_process_publisher_id, std::chrono::nanoseconds lifespan)
+{
+  impl_->set_lifespan(intra_process_publisher_id, lifespan);
+}
+
+uint64_t
+IntraProcessManager::get_evicted_count(uint64_t intra_process_publisher_id) const
+{
+  return impl_->get_evicted_count(intra_process_publisher_id);
+}
+
+void
+IntraProcessManager::evict_expired_messages()
+{
+  impl_->evict_expired_messages();
+}
+
 bool
 IntraProcessManager::matches_any_publishers(const rmw_gid_t * id) const
 {
   return impl_->matches_any_publishers(id);
 }
 
+size_t
+IntraProcessManager::get_subscription_count(uint64_t intra_process_publisher_id) const
+{
+  return impl_->get_subscription_count(intra_process_publisher_id);
+}
+
+void
+IntraProcessManager::add_service(rclcpp::service::ServiceBase::SharedPtr service)
+{
+  impl_->add_service(service);
+}
+
+rclcpp::service::ServiceBase::SharedPtr
+IntraProcessManager::get_service(const std::string & service_name) const
+{
+  return impl_->get_service(service_name);
+}
+
 uint64_t
 IntraProcessManager::get_next_unique_id()
 {
@@ -16,6 +16,56 @@
 
 using rclcpp::memory_strategy::MemoryStrategy;
 
+void
+MemoryStrategy::set_executor_statistics(rclcpp::executor::ExecutorStatistics *)
+{}
+
+void
+MemoryStrategy::get_next_timer(
+  rclcpp::executor::AnyExecutable & any_exec, const WeakNodeVector & weak_nodes)
+{
+  for (auto & weak_node : weak_nodes) {
+    auto node = weak_node.lock();
+    if (!node) {
+      continue;
+    }
+    for (auto & weak_group : node->get_callback_groups()) {
+      auto group = weak_group.lock();
+      if (!group || !group->can_be_taken_from().load()) {
+        continue;
+      }
+      for (auto & timer_ref : group->get_timer_ptrs()) {
+        auto timer = timer_ref.lock();
+        if (timer && timer->is_ready()) {
+          any_exec.timer = timer;
+          any_exec.callback_group = group;
+          any_exec.node = node;
+          return;
+        }
+      }
+    }
+  }
+}
+
+void
+MemoryStrategy::get_next_ready_executable(
+  rclcpp::executor::AnyExecutable & any_exec, const WeakNodeVector & weak_nodes)
+{
+  get_next_timer(any_exec, weak_nodes);
+  if (any_exec.timer) {
+    return;
+  }
+  get_next_subscription(any_exec, weak_nodes);
+  if (any_exec.subscription || any_exec.subscription_intra_process) {
+    return;
+  }
+  get_next_service(any_exec, weak_nodes);
+  if (any_exec.service || any_exec.service_intra_process) {
+    return;
+  }
+  get_next_client(any_exec, weak_nodes);
+}
+
 rclcpp::subscription::SubscriptionBase::SharedPtr
 MemoryStrategy::get_subscription_by_handle(
   const rcl_subscription_t * subscriber_handle, const WeakNodeVector & weak_nodes)
@@ -13,16 +13,32 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <set>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "rclcpp/node.hpp"
 
+#include "rclcpp/graph_listener.hpp"
+
 using rclcpp::node::Node;
 
+static std::vector<std::string>
+names_of(const std::vector<rclcpp::parameter::ParameterVariant> & parameters)
+{
+  std::vector<std::string> names;
+  names.reserve(parameters.size());
+  for (auto & p : parameters) {
+    names.push_back(p.get_name());
+  }
+  return names;
+}
+
 Node::Node(const std::string & node_name, bool use_intra_process_comms)
 : Node(
     node_name,
@@ -33,10 +49,12 @@ Node::Node(const std::string & node_name, bool use_intra_process_comms)
 Node::Node(
   const std::string & node_name,
   rclcpp::context::Context::SharedPtr context,
-  bool use_intra_process_comms)
+  bool use_intra_process_comms,
+  bool lightweight)
 : name_(node_name), context_(context),
   number_of_subscriptions_(0), number_of_timers_(0), number_of_services_(0),
-  use_intra_process_comms_(use_intra_process_comms)
+  use_intra_process_comms_(use_intra_process_comms), lightweight_(lightweight),
+  parameter_event_window_(std::chrono::nanoseconds::zero())
 {
   rcl_guard_condition_options_t guard_condition_options = rcl_guard_condition_get_default_options();
   if (rcl_guard_condition_init(
@@ -102,12 +120,45 @@ Node::Node(
   using rclcpp::callback_group::CallbackGroupType;
   default_callback_group_ = create_callback_group(
     CallbackGroupType::MutuallyExclusive);
-  events_publisher_ = create_publisher<rcl_interfaces::msg::ParameterEvent>(
-    "parameter_events", rmw_qos_profile_parameter_events);
+  if (!lightweight_) {
+    events_publisher_ = create_publisher<rcl_interfaces::msg::ParameterEvent>(
+      "parameter_events", rmw_qos_profile_parameter_events);
+  }
+}
+
+Node::Node(
+  const std::string & node_name,
+  const std::vector<rclcpp::parameter::ParameterVariant> & initial_parameters,
+  bool use_intra_process_comms)
+: Node(node_name, use_intra_process_comms)
+{
+  load_initial_parameters(initial_parameters);
+}
+
+Node::Node(
+  const std::string & node_name,
+  rclcpp::context::Context::SharedPtr context,
+  const std::vector<rclcpp::parameter::ParameterVariant> & initial_parameters,
+  bool use_intra_process_comms,
+  bool lightweight)
+: Node(node_name, context, use_intra_process_comms, lightweight)
+{
+  load_initial_parameters(initial_parameters);
 }
 
 Node::~Node()
 {
+  // An executor may still hold the parameter event timer, whose callback uses this node, so
+  // cancel it: a canceled timer does not call its callback anymore.
+  if (parameter_event_timer_) {
+    try {
+      parameter_event_timer_->cancel();
+    } catch (const std::exception & e) {
+      fprintf(stderr,
+        "[rclcpp::error] failed to cancel parameter event timer: %s\n", e.what());
+    }
+    parameter_event_timer_.reset();
+  }
   // Finalize the interrupt guard condition.
   if (rcl_guard_condition_fini(&notify_guard_condition_) != RCL_RET_OK) {
     fprintf(stderr,
@@ -121,6 +172,12 @@ Node::get_name() const
   return name_;
 }
 
+rclcpp::context::Context::SharedPtr
+Node::get_context() const
+{
+  return context_;
+}
+
 rclcpp::callback_group::CallbackGroup::SharedPtr
 Node::create_callback_group(
   rclcpp::callback_group::CallbackGroupType group_type)
@@ -163,80 +220,251 @@ Node::set_parameters(
   const std::vector<rclcpp::parameter::ParameterVariant> & parameters)
 {
   std::vector<rcl_interfaces::msg::SetParametersResult> results;
-  for (auto p : parameters) {
-    auto result = set_parameters_atomically({{p}});
+  results.reserve(parameters.size());
+  auto parameter_event = std::make_shared<rcl_interfaces::msg::ParameterEvent>();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Each parameter is set on its own, but they share the lock and the event.
+  for (auto it = parameters.cbegin(); it != parameters.cend(); ++it) {
+    rcl_interfaces::msg::SetParametersResult result;
+    try {
+      apply_parameters(it, it + 1, *parameter_event);
+      result.successful = true;
+    } catch (const std::exception & e) {
+      result.successful = false;
+      result.reason = e.what();
+    }
     results.push_back(result);
   }
+
+  parameter_read_cache_.publish(parameters_, names_of(parameters));
+  publish_parameter_event(parameter_event);
+
   return results;
 }
 
 rcl_interfaces::msg::SetParametersResult
 Node::set_parameters_atomically(
   const std::vector<rclcpp::parameter::ParameterVariant> & parameters)
+{
+  auto parameter_event = std::make_shared<rcl_interfaces::msg::ParameterEvent>();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // TODO(jacquelinekay): handle parameter constraints
+  rcl_interfaces::msg::SetParametersResult result;
+  try {
+    apply_parameters(parameters.cbegin(), parameters.cend(), *parameter_event);
+    result.successful = true;
+  } catch (const std::exception & e) {
+    result.successful = false;
+    result.reason = e.what();
+    return result;
+  }
+
+  parameter_read_cache_.publish(parameters_, names_of(parameters));
+  publish_parameter_event(parameter_event);
+
+  return result;
+}
+
+void
+Node::set_parameter_event_window(std::chrono::nanoseconds window)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    parameter_event_window_ = window;
+  }
+  if (parameter_event_timer_) {
+    // An executor may still hold the replaced timer, which the destructor would not cancel.
+    parameter_event_timer_->cancel();
+    parameter_event_timer_.reset();
+  }
+  if (window > std::chrono::nanoseconds::zero() && window != std::chrono::nanoseconds::max()) {
+    parameter_event_timer_ = create_wall_timer(window, [this]() {flush_parameter_events();});
+  } else if (window <= std::chrono::nanoseconds::zero()) {
+    flush_parameter_events();
+  }
+}
+
+void
+Node::flush_parameter_events()
 {
   std::lock_guard<std::mutex> lock(mutex_);
-  std::map<std::string, rclcpp::parameter::ParameterVariant> tmp_map;
+  if (pending_parameter_event_.empty()) {
+    return;
+  }
   auto parameter_event = std::make_shared<rcl_interfaces::msg::ParameterEvent>();
+  pending_parameter_event_.take(*parameter_event);
+  publish_events(parameter_event);
+}
 
-  for (auto p : parameters) {
-    if (parameters_.find(p.get_name()) == parameters_.end()) {
-      if (p.get_type() != rclcpp::parameter::ParameterType::PARAMETER_NOT_SET) {
-        parameter_event->new_parameters.push_back(p.to_parameter());
-      }
-    } else if (p.get_type() != rclcpp::parameter::ParameterType::PARAMETER_NOT_SET) {
-      parameter_event->changed_parameters.push_back(p.to_parameter());
+void
+Node::publish_events(std::shared_ptr<rcl_interfaces::msg::ParameterEvent> parameter_event)
+{
+  if (events_publisher_) {
+    events_publisher_->publish(parameter_event);
+    return;
+  }
+  if (!shared_events_publisher_) {
+    shared_events_publisher_ = context_->get_sub_context<SharedParameterEventsPublisher>();
+  }
+  // Lightweight nodes are locked independently, so their publishing is serialized here.
+  std::lock_guard<std::mutex> lock(shared_events_publisher_->mutex);
+  if (!shared_events_publisher_->node) {
+    shared_events_publisher_->node = std::make_shared<Node>(
+      "parameter_events_publisher", std::make_shared<rclcpp::context::Context>());
+  }
+  shared_events_publisher_->node->events_publisher_->publish(parameter_event);
+}
+
+void
+Node::publish_parameter_event(
+  std::shared_ptr<rcl_interfaces::msg::ParameterEvent> parameter_event)
+{
+  if (parameter_event_window_ <= std::chrono::nanoseconds::zero()) {
+    publish_events(parameter_event);
+  } else {
+    pending_parameter_event_.add(*parameter_event);
+  }
+}
+
+void
+Node::load_initial_parameters(
+  const std::vector<rclcpp::parameter::ParameterVariant> & parameters)
+{
+  std::vector<std::string> names;
+  names.reserve(parameters.size());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  parameters_.reserve(parameters_.size() + parameters.size());
+  for (auto & p : parameters) {
+    if (p.get_type() == rclcpp::parameter::ParameterType::PARAMETER_NOT_SET) {
+      continue;
+    }
+    auto inserted = parameters_.emplace(p.get_name(), p);
+    if (inserted.second) {
+      names.push_back(p.get_name());
     } else {
-      parameter_event->deleted_parameters.push_back(p.to_parameter());
+      inserted.first->second = p;
     }
-    tmp_map[p.get_name()] = p;
   }
-  // std::map::insert will not overwrite elements, so we'll keep the new
-  // ones and add only those that already exist in the Node's internal map
-  tmp_map.insert(parameters_.begin(), parameters_.end());
-  std::swap(tmp_map, parameters_);
+  parameter_read_cache_.publish(parameters_, names_of(parameters));
+  if (names.empty()) {
+    return;
+  }
+  // Inserting the sorted names at the end of the index takes constant time for each of them.
+  std::sort(names.begin(), names.end());
+  auto parameter_event = std::make_shared<rcl_interfaces::msg::ParameterEvent>();
+  parameter_event->new_parameters.reserve(names.size());
+  for (auto & name : names) {
+    parameter_event->new_parameters.push_back(parameters_.find(name)->second.to_parameter());
+    parameter_names_.emplace_hint(parameter_names_.end(), std::move(name));
+  }
 
-  // TODO(jacquelinekay): handle parameter constraints
-  rcl_interfaces::msg::SetParametersResult result;
-  result.successful = true;
+  publish_parameter_event(parameter_event);
+}
 
-  events_publisher_->publish(parameter_event);
+void
+Node::apply_parameters(
+  std::vector<rclcpp::parameter::ParameterVariant>::const_iterator first,
+  std::vector<rclcpp::parameter::ParameterVariant>::const_iterator last,
+  rcl_interfaces::msg::ParameterEvent & parameter_event)
+{
+  using rclcpp::parameter::ParameterType;
+  using rclcpp::parameter::ParameterVariant;
 
-  return result;
+  // What to undo for each applied parameter, reserved up front so recording cannot throw.
+  // The entries of the hash map stay in place when it rehashes, unlike its iterators.
+  struct Change
+  {
+    const std::string * name;
+    ParameterVariant * value;
+    bool inserted;
+    ParameterVariant previous;
+  };
+  std::vector<Change> changes;
+  changes.reserve(static_cast<size_t>(std::distance(first, last)));
+  size_t new_count = parameter_event.new_parameters.size();
+  size_t changed_count = parameter_event.changed_parameters.size();
+  size_t deleted_count = parameter_event.deleted_parameters.size();
+
+  try {
+    for (; first != last; ++first) {
+      const ParameterVariant & p = *first;
+      auto it = parameters_.find(p.get_name());
+      if (it == parameters_.end()) {
+        if (p.get_type() != ParameterType::PARAMETER_NOT_SET) {
+          parameter_event.new_parameters.push_back(p.to_parameter());
+        }
+        it = parameters_.emplace(p.get_name(), p).first;
+        changes.push_back(Change {&it->first, &it->second, true, ParameterVariant()});
+        parameter_names_.insert(p.get_name());
+      } else {
+        if (p.get_type() != ParameterType::PARAMETER_NOT_SET) {
+          parameter_event.changed_parameters.push_back(p.to_parameter());
+        } else {
+          parameter_event.deleted_parameters.push_back(p.to_parameter());
+        }
+        changes.push_back(Change {&it->first, &it->second, false, std::move(it->second)});
+        it->second = p;
+      }
+    }
+  } catch (...) {
+    // Undo in reverse order, so a parameter given twice gets its original value back.
+    for (auto change = changes.rbegin(); change != changes.rend(); ++change) {
+      if (change->inserted) {
+        std::string name = *change->name;
+        parameter_names_.erase(name);
+        parameters_.erase(name);
+      } else {
+        *change->value = std::move(change->previous);
+      }
+    }
+    parameter_event.new_parameters.resize(new_count);
+    parameter_event.changed_parameters.resize(changed_count);
+    parameter_event.deleted_parameters.resize(deleted_count);
+    throw;
+  }
 }
 
 std::vector<rclcpp::parameter::ParameterVariant>
 Node::get_parameters(
   const std::vector<std::string> & names) const
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  // Read from a snapshot, so callbacks reading parameters do not wait for writers or each other.
+  auto snapshot = parameter_read_cache_.get_snapshot();
   std::vector<rclcpp::parameter::ParameterVariant> results;
+  results.reserve(names.size());
 
+  rclcpp::parameter::ParameterVariant parameter;
   for (auto & name : names) {
-    if (std::any_of(parameters_.cbegin(), parameters_.cend(),
-      [&name](const std::pair<std::string, rclcpp::parameter::ParameterVariant> & kv) {
-      return name == kv.first;
-    }))
-    {
-      results.push_back(parameters_.at(name));
+    if (snapshot.get_parameter(name, parameter)) {
+      results.push_back(parameter);
     }
   }
   return results;
 }
 
+rclcpp::parameter_snapshot::ParameterSnapshot
+Node::get_parameters_snapshot() const
+{
+  return parameter_read_cache_.get_snapshot();
+}
+
 std::vector<rcl_interfaces::msg::ParameterDescriptor>
 Node::describe_parameters(
   const std::vector<std::string> & names) const
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  auto snapshot = parameter_read_cache_.get_snapshot();
+  auto & parameters = snapshot.get_parameters();
   std::vector<rcl_interfaces::msg::ParameterDescriptor> results;
-  for (auto & kv : parameters_) {
-    if (std::any_of(names.cbegin(), names.cend(), [&kv](const std::string & name) {
-      return name == kv.first;
-    }))
-    {
+  results.reserve(names.size());
+  for (auto & name : names) {
+    auto it = parameters.find(name);
+    if (it != parameters.end()) {
       rcl_interfaces::msg::ParameterDescriptor parameter_descriptor;
-      parameter_descriptor.name = kv.first;
-      parameter_descriptor.type = kv.second.get_type();
+      parameter_descriptor.name = it->first;
+      parameter_descriptor.type = it->second.get_type();
       results.push_back(parameter_descriptor);
     }
   }
@@ -247,14 +475,15 @@ std::vector<uint8_t>
 Node::get_parameter_types(
   const std::vector<std::string> & names) const
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  auto snapshot = parameter_read_cache_.get_snapshot();
+  auto & parameters = snapshot.get_parameters();
   std::vector<uint8_t> results;
-  for (auto & kv : parameters_) {
-    if (std::any_of(names.cbegin(), names.cend(), [&kv](const std::string & name) {
-      return name == kv.first;
-    }))
-    {
-      results.push_back(kv.second.get_type());
+  results.reserve(names.size());
+  // One type per requested name, in the order of the names.
+  for (auto & name : names) {
+    auto it = parameters.find(name);
+    if (it != parameters.end()) {
+      results.push_back(it->second.get_type());
     } else {
       results.push_back(rcl_interfaces::msg::ParameterType::PARAMETER_NOT_SET);
     }
@@ -270,28 +499,50 @@ Node::list_parameters(
   rcl_interfaces::msg::ListParametersResult result;
 
   // TODO(esteve): define parameter separator, use "." for now
-  for (auto & kv : parameters_) {
-    if (std::any_of(prefixes.cbegin(), prefixes.cend(), [&kv, &depth](const std::string & prefix) {
-      if (kv.first == prefix) {
-        return true;
-      } else if (kv.first.find(prefix + ".") == 0) {
-        size_t length = prefix.length();
-        std::string substr = kv.first.substr(length);
-        // Cast as unsigned integer to avoid warning
-        return static_cast<uint64_t>(std::count(substr.begin(), substr.end(), '.')) < depth;
+  // The names are sorted, so the names below a prefix are a single range of them.
+  std::vector<const std::string *> names;
+  if (prefixes.empty()) {
+    // Without any prefix, list all parameters with fewer separators than the depth.
+    for (auto & name : parameter_names_) {
+      if (static_cast<uint64_t>(std::count(name.begin(), name.end(), '.')) < depth) {
+        names.push_back(&name);
       }
-      return false;
-    }))
+    }
+  }
+  for (auto & prefix : prefixes) {
+    auto exact = parameter_names_.find(prefix);
+    if (exact != parameter_names_.end()) {
+      names.push_back(&*exact);
+    }
+    std::string prefix_with_separator = prefix + ".";
+    for (auto it = parameter_names_.lower_bound(prefix_with_separator);
+      it != parameter_names_.end() && it->compare(
+        0, prefix_with_separator.length(), prefix_with_separator) == 0;
+      ++it)
     {
-      result.names.push_back(kv.first);
-      size_t last_separator = kv.first.find_last_of('.');
-      if (std::string::npos != last_separator) {
-        std::string prefix = kv.first.substr(0, last_separator);
-        if (std::find(result.prefixes.cbegin(), result.prefixes.cend(), prefix) ==
-          result.prefixes.cend())
-        {
-          result.prefixes.push_back(prefix);
-        }
+      // Cast as unsigned integer to avoid warning
+      auto separators = std::count(it->begin() + prefix.length(), it->end(), '.');
+      if (static_cast<uint64_t>(separators) < depth) {
+        names.push_back(&*it);
+      }
+    }
+  }
+  // *INDENT-OFF*
+  std::sort(names.begin(), names.end(), [](const std::string * a, const std::string * b) {
+    return *a < *b;
+  });
+  // *INDENT-ON*
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+
+  result.names.reserve(names.size());
+  std::set<std::string> listed_prefixes;
+  for (auto name : names) {
+    result.names.push_back(*name);
+    size_t last_separator = name->find_last_of('.');
+    if (std::string::npos != last_separator) {
+      std::string prefix = name->substr(0, last_separator);
+      if (listed_prefixes.insert(prefix).second) {
+        result.prefixes.push_back(prefix);
       }
     }
   }
@@ -361,6 +612,36 @@ Node::count_subscribers(const std::string & topic_name) const
   return count;
 }
 
+bool
+Node::wait_for_publishers(
+  const std::string & topic_name, size_t count, std::chrono::nanoseconds timeout) const
+{
+  auto graph_listener = context_->get_sub_context<rclcpp::graph_listener::GraphListener>();
+  // *INDENT-OFF*
+  return graph_listener->wait_for(*context_, [this, &topic_name, count]() {
+    return count_publishers(topic_name) >= count;
+  }, timeout);
+  // *INDENT-ON*
+}
+
+bool
+Node::wait_for_subscribers(
+  const std::string & topic_name, size_t count, std::chrono::nanoseconds timeout) const
+{
+  auto graph_listener = context_->get_sub_context<rclcpp::graph_listener::GraphListener>();
+  // *INDENT-OFF*
+  return graph_listener->wait_for(*context_, [this, &topic_name, count]() {
+    return count_subscribers(topic_name) >= count;
+  }, timeout);
+  // *INDENT-ON*
+}
+
+void
+Node::notify_graph_change()
+{
+  context_->get_sub_context<rclcpp::graph_listener::GraphListener>()->notify();
+}
+
 
 const Node::CallbackGroupWeakPtrList &
 Node::get_callback_groups() const
@@ -180,7 +180,7 @@ ParameterVariant::from_parameter(const rcl_interfaces::msg::Parameter & paramete
 }
 
 rcl_interfaces::msg::Parameter
-ParameterVariant::to_parameter()
+ParameterVariant::to_parameter() const
 {
   rcl_interfaces::msg::Parameter parameter;
   parameter.name = name_;
@@ -15,6 +15,9 @@
 #include "rclcpp/parameter_client.hpp"
 
 #include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -227,6 +230,159 @@ AsyncParametersClient::list_parameters(
   return future_result;
 }
 
+std::shared_future<void>
+AsyncParametersClient::enable_parameter_cache()
+{
+  if (parameter_cache_) {
+    return parameter_cache_->seeded_future;
+  }
+  auto cache = std::make_shared<ParameterCache>();
+  cache->seeded_future = cache->seeded.get_future().share();
+
+  // Subscribe before seeding, so no change made after the seed was read is missed.
+  // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+  parameter_cache_subscription_ = on_parameter_event(
+    [cache](const rcl_interfaces::msg::ParameterEvent::SharedPtr event)
+    {
+      std::lock_guard<std::mutex> lock(cache->mutex);
+      for (auto parameters : {&event->new_parameters, &event->changed_parameters}) {
+        for (auto & parameter : *parameters) {
+          cache->parameters[parameter.name] =
+            rclcpp::parameter::ParameterVariant::from_parameter(parameter);
+          if (!cache->ready) {
+            cache->updated_while_seeding.insert(parameter.name);
+          }
+        }
+      }
+      for (auto & parameter : event->deleted_parameters) {
+        cache->parameters.erase(parameter.name);
+        if (!cache->ready) {
+          cache->updated_while_seeding.insert(parameter.name);
+        }
+      }
+    });
+  // *INDENT-ON*
+  parameter_cache_ = cache;
+  seed_parameter_cache(cache, list_parameters_client_, get_parameters_client_);
+  return cache->seeded_future;
+}
+
+void
+AsyncParametersClient::seed_parameter_cache(
+  std::shared_ptr<ParameterCache> cache,
+  rclcpp::client::Client<rcl_interfaces::srv::ListParameters>::SharedPtr list_client,
+  rclcpp::client::Client<rcl_interfaces::srv::GetParameters>::SharedPtr get_client)
+{
+  auto list_request = std::make_shared<rcl_interfaces::srv::ListParameters::Request>();
+  list_request->depth = std::numeric_limits<uint64_t>::max();
+
+  // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+  list_client->async_send_request(
+    list_request,
+    [cache, list_client, get_client](
+      rclcpp::client::Client<rcl_interfaces::srv::ListParameters>::SharedFuture list_f)
+    {
+      auto get_request = std::make_shared<rcl_interfaces::srv::GetParameters::Request>();
+      try {
+        get_request->names = list_f.get()->result.names;
+      } catch (...) {
+        // E.g. the request timed out, the seed fails and so does the future of the cache.
+        cache->seeded.set_exception(std::current_exception());
+        return;
+      }
+      get_client->async_send_request(
+        get_request,
+        [cache, list_client, get_client, get_request](
+          rclcpp::client::Client<rcl_interfaces::srv::GetParameters>::SharedFuture get_f)
+        {
+          std::shared_ptr<rcl_interfaces::srv::GetParameters::Response> response;
+          try {
+            response = get_f.get();
+          } catch (...) {
+            cache->seeded.set_exception(std::current_exception());
+            return;
+          }
+          auto & values = response->values;
+          if (values.size() != get_request->names.size()) {
+            // Only set parameters have a value in the response, so one was deleted after it
+            // was listed and the values cannot be matched with the names; read them again.
+            seed_parameter_cache(cache, list_client, get_client);
+            return;
+          }
+          {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            for (size_t i = 0; i < values.size(); ++i) {
+              const std::string & name = get_request->names[i];
+              if (cache->updated_while_seeding.count(name) != 0) {
+                continue;
+              }
+              rcl_interfaces::msg::Parameter parameter;
+              parameter.name = name;
+              parameter.value = values[i];
+              cache->parameters[name] =
+                rclcpp::parameter::ParameterVariant::from_parameter(parameter);
+            }
+            cache->updated_while_seeding.clear();
+            cache->ready = true;
+          }
+          cache->seeded.set_value();
+        });
+    });
+  // *INDENT-ON*
+}
+
+void
+AsyncParametersClient::disable_parameter_cache()
+{
+  // A seed still in flight completes on the dropped cache.
+  parameter_cache_subscription_.reset();
+  parameter_cache_.reset();
+}
+
+bool
+AsyncParametersClient::is_parameter_cache_ready() const
+{
+  if (!parameter_cache_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(parameter_cache_->mutex);
+  return parameter_cache_->ready;
+}
+
+std::vector<rclcpp::parameter::ParameterVariant>
+AsyncParametersClient::get_cached_parameters(const std::vector<std::string> & names) const
+{
+  if (!parameter_cache_) {
+    throw std::runtime_error("parameter cache is not enabled");
+  }
+  std::vector<rclcpp::parameter::ParameterVariant> results;
+  results.reserve(names.size());
+  std::lock_guard<std::mutex> lock(parameter_cache_->mutex);
+  for (auto & name : names) {
+    auto it = parameter_cache_->parameters.find(name);
+    if (it != parameter_cache_->parameters.end()) {
+      results.push_back(it->second);
+    }
+  }
+  return results;
+}
+
+bool
+AsyncParametersClient::get_cached_parameter(
+  const std::string & name, rclcpp::parameter::ParameterVariant & parameter) const
+{
+  if (!parameter_cache_) {
+    throw std::runtime_error("parameter cache is not enabled");
+  }
+  std::lock_guard<std::mutex> lock(parameter_cache_->mutex);
+  auto it = parameter_cache_->parameters.find(name);
+  if (it == parameter_cache_->parameters.end()) {
+    return false;
+  }
+  parameter = it->second;
+  return true;
+}
+
 SyncParametersClient::SyncParametersClient(
   rclcpp::node::Node::SharedPtr node)
 : node_(node)
@@ -243,13 +399,29 @@ SyncParametersClient::SyncParametersClient(
   async_parameters_client_ = std::make_shared<AsyncParametersClient>(node);
 }
 
+SyncParametersClient::SyncParametersClient(
+  rclcpp::executors::BackgroundExecutor::SharedPtr background_executor,
+  rclcpp::node::Node::SharedPtr node)
+: background_executor_(background_executor), node_(node)
+{
+  // Only waits for the responses which the background thread delivers.
+  executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  async_parameters_client_ = std::make_shared<AsyncParametersClient>(node);
+  background_executor_->add_node(node_);
+}
+
+SyncParametersClient::~SyncParametersClient()
+{
+  if (background_executor_) {
+    background_executor_->remove_node(node_);
+  }
+}
+
 std::vector<rclcpp::parameter::ParameterVariant>
 SyncParametersClient::get_parameters(const std::vector<std::string> & parameter_names)
 {
   auto f = async_parameters_client_->get_parameters(parameter_names);
-  if (rclcpp::executors::spin_node_until_future_complete(*executor_, node_, f) ==
-    rclcpp::executor::FutureReturnCode::SUCCESS)
-  {
+  if (wait_for_future(async_parameters_client_->get_parameters_client_, f)) {
     return f.get();
   }
   // Return an empty vector if unsuccessful
@@ -261,9 +433,7 @@ SyncParametersClient::get_parameter_types(const std::vector<std::string> & param
 {
   auto f = async_parameters_client_->get_parameter_types(parameter_names);
 
-  if (rclcpp::executors::spin_node_until_future_complete(*executor_, node_, f) ==
-    rclcpp::executor::FutureReturnCode::SUCCESS)
-  {
+  if (wait_for_future(async_parameters_client_->get_parameter_types_client_, f)) {
     return f.get();
   }
   return std::vector<rclcpp::parameter::ParameterType>();
@@ -275,9 +445,7 @@ SyncParametersClient::set_parameters(
 {
   auto f = async_parameters_client_->set_parameters(parameters);
 
-  if (rclcpp::executors::spin_node_until_future_complete(*executor_, node_, f) ==
-    rclcpp::executor::FutureReturnCode::SUCCESS)
-  {
+  if (wait_for_future(async_parameters_client_->set_parameters_client_, f)) {
     return f.get();
   }
   return std::vector<rcl_interfaces::msg::SetParametersResult>();
@@ -289,9 +457,7 @@ SyncParametersClient::set_parameters_atomically(
 {
   auto f = async_parameters_client_->set_parameters_atomically(parameters);
 
-  if (rclcpp::executors::spin_node_until_future_complete(*executor_, node_, f) ==
-    rclcpp::executor::FutureReturnCode::SUCCESS)
-  {
+  if (wait_for_future(async_parameters_client_->set_parameters_atomically_client_, f)) {
     return f.get();
   }
 
@@ -305,9 +471,7 @@ SyncParametersClient::list_parameters(
 {
   auto f = async_parameters_client_->list_parameters(parameter_prefixes, depth);
 
-  if (rclcpp::executors::spin_node_until_future_complete(*executor_, node_, f) ==
-    rclcpp::executor::FutureReturnCode::SUCCESS)
-  {
+  if (wait_for_future(async_parameters_client_->list_parameters_client_, f)) {
     return f.get();
   }
 
@@ -17,10 +17,12 @@
 #include <rmw/error_handling.h>
 #include <rmw/rmw.h>
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 
 #include "rcl_interfaces/msg/intra_process_message.hpp"
@@ -38,7 +40,14 @@ PublisherBase::PublisherBase(
   size_t queue_size)
 : node_handle_(node_handle),
   topic_(topic), queue_size_(queue_size),
-  intra_process_publisher_id_(0), store_intra_process_message_(nullptr)
+  intra_process_publisher_id_(0), store_intra_process_message_(nullptr),
+  intra_process_direct_delivery_(false),
+  skip_inter_process_publish_(false),
+  inter_process_check_period_ns_(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(100)).count()),
+  last_inter_process_check_ns_(0),
+  has_inter_process_subscriptions_(true),
+  batch_intra_process_notifications_(false)
 {
 }
 
@@ -85,7 +94,7 @@ PublisherBase::operator==(const rmw_gid_t * gid) const
     throw std::runtime_error(
             std::string("failed to compare gids: ") + rmw_get_error_string_safe());
   }
-  if (!result) {
+  if (!result && store_intra_process_message_ && !intra_process_direct_delivery_) {
     ret = rmw_compare_gids_equal(gid, &this->get_intra_process_gid(), &result);
     if (ret != RMW_RET_OK) {
       throw std::runtime_error(
@@ -95,12 +104,70 @@ PublisherBase::operator==(const rmw_gid_t * gid) const
   return result;
 }
 
+void
+PublisherBase::set_skip_inter_process_publish(
+  bool enabled,
+  std::chrono::nanoseconds check_period)
+{
+  skip_inter_process_publish_.store(enabled);
+  inter_process_check_period_ns_.store(check_period.count());
+  // Force a new check with the new settings.
+  last_inter_process_check_ns_.store(0);
+}
+
+bool
+PublisherBase::needs_inter_process_publish()
+{
+  if (!count_intra_process_subscriptions_ || !skip_inter_process_publish_.load()) {
+    return true;
+  }
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  int64_t last_check = last_inter_process_check_ns_.load();
+  if (last_check != 0 && now - last_check < inter_process_check_period_ns_.load()) {
+    return has_inter_process_subscriptions_.load();
+  }
+  // Only one of the concurrent publishers refreshes, the others use the previous result.
+  if (!last_inter_process_check_ns_.compare_exchange_strong(last_check, now)) {
+    return has_inter_process_subscriptions_.load();
+  }
+  size_t subscription_count = 0;
+  auto ret = rmw_count_subscribers(
+    rcl_node_get_rmw_handle(node_handle_.get()), topic_.c_str(), &subscription_count);
+  bool result = true;
+  if (ret == RMW_RET_OK) {
+    // The middleware counts the intra process subscriptions as well, since they also
+    // subscribe to the topic.
+    result = subscription_count > count_intra_process_subscriptions_(intra_process_publisher_id_);
+  }
+  has_inter_process_subscriptions_.store(result);
+  return result;
+}
+
 void
 PublisherBase::setup_intra_process(
   uint64_t intra_process_publisher_id,
   StoreMessageCallbackT callback,
-  const rcl_publisher_options_t & intra_process_options)
+  StoreSharedMessageCallbackT shared_callback,
+  CountSubscriptionsCallbackT count_callback,
+  const rcl_publisher_options_t & intra_process_options,
+  bool direct_delivery,
+  SetLifespanCallbackT lifespan_callback,
+  CountEvictedCallbackT evicted_callback)
 {
+  intra_process_publisher_id_ = intra_process_publisher_id;
+  store_intra_process_message_ = callback;
+  store_shared_intra_process_message_ = shared_callback;
+  count_intra_process_subscriptions_ = count_callback;
+  set_intra_process_lifespan_ = lifespan_callback;
+  count_intra_process_evicted_ = evicted_callback;
+  intra_process_direct_delivery_ = direct_delivery;
+  RCLCPP_TRACEPOINT(intra_process_publisher_init, static_cast<const void *>(&publisher_handle_),
+    intra_process_publisher_id);
+  if (direct_delivery) {
+    // Without an intra process topic there is no intra process gid either.
+    return;
+  }
   if (rcl_publisher_init(
       &intra_process_publisher_handle_, node_handle_.get(),
       rclcpp::type_support::get_intra_process_message_msg_type_support(),
@@ -111,8 +178,6 @@ PublisherBase::setup_intra_process(
             rcl_get_error_string_safe());
   }
 
-  intra_process_publisher_id_ = intra_process_publisher_id;
-  store_intra_process_message_ = callback;
   // Life time of this object is tied to the publisher handle.
   rmw_publisher_t * publisher_rmw_handle = rcl_publisher_get_rmw_handle(
     &intra_process_publisher_handle_);
@@ -130,3 +195,91 @@ PublisherBase::setup_intra_process(
     // *INDENT-ON*
   }
 }
+
+void
+PublisherBase::set_intra_process_notification_batching(
+  size_t max_messages,
+  std::chrono::nanoseconds max_delay)
+{
+  if (queue_size_ > 0 && max_messages > queue_size_) {
+    throw std::invalid_argument("batches cannot hold more messages than the queue size");
+  }
+  std::lock_guard<std::mutex> lock(notification_batcher_mutex_);
+  notification_batcher_.set_limits(max_messages, max_delay);
+  batch_intra_process_notifications_.store(max_messages > 1);
+  uint64_t message_seq = 0;
+  if (notification_batcher_.flush(message_seq)) {
+    do_publish_intra_process_notification(message_seq);
+  }
+}
+
+size_t
+PublisherBase::get_intra_process_notification_batch_size() const
+{
+  std::lock_guard<std::mutex> lock(notification_batcher_mutex_);
+  return notification_batcher_.get_max_messages();
+}
+
+void
+PublisherBase::flush_intra_process_notifications()
+{
+  std::lock_guard<std::mutex> lock(notification_batcher_mutex_);
+  uint64_t message_seq = 0;
+  if (notification_batcher_.flush(message_seq)) {
+    do_publish_intra_process_notification(message_seq);
+  }
+}
+
+void
+PublisherBase::set_intra_process_lifespan(std::chrono::nanoseconds lifespan)
+{
+  if (!set_intra_process_lifespan_) {
+    throw std::runtime_error("publisher does not use intra process communication");
+  }
+  set_intra_process_lifespan_(intra_process_publisher_id_, lifespan);
+}
+
+uint64_t
+PublisherBase::get_intra_process_evicted_count() const
+{
+  if (!count_intra_process_evicted_) {
+    return 0;
+  }
+  return count_intra_process_evicted_(intra_process_publisher_id_);
+}
+
+void
+PublisherBase::publish_intra_process_notification(uint64_t message_seq)
+{
+  if (intra_process_direct_delivery_) {
+    // The intra process manager has already notified the subscriptions.
+    return;
+  }
+  if (batch_intra_process_notifications_.load()) {
+    // Notify under the lock, so that the notifications of concurrent publishes stay in order.
+    std::lock_guard<std::mutex> lock(notification_batcher_mutex_);
+    if (notification_batcher_.add(message_seq, std::chrono::steady_clock::now(), message_seq)) {
+      do_publish_intra_process_notification(message_seq);
+    }
+    return;
+  }
+  do_publish_intra_process_notification(message_seq);
+}
+
+void
+PublisherBase::do_publish_intra_process_notification(uint64_t message_seq)
+{
+  if (!store_intra_process_message_ || intra_process_direct_delivery_) {
+    return;
+  }
+  rcl_interfaces::msg::IntraProcessMessage ipm;
+  ipm.publisher_id = intra_process_publisher_id_;
+  ipm.message_sequence = message_seq;
+  auto status = rcl_publish(&intra_process_publisher_handle_, &ipm);
+  if (status != RCL_RET_OK) {
+    // *INDENT-OFF* (prevent uncrustify from making unecessary indents here)
+    throw std::runtime_error(
+      std::string("failed to publish intra process message: ") + rcl_get_error_string_safe());
+    // *INDENT-ON*
+  }
+}
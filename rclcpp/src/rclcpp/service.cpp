@@ -14,11 +14,14 @@
 
 #include "rclcpp/service.hpp"
 
+#include <cstdio>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
 #include "rclcpp/any_service_callback.hpp"
 #include "rclcpp/macros.hpp"
@@ -30,11 +33,18 @@ using rclcpp::service::ServiceBase;
 ServiceBase::ServiceBase(
   std::shared_ptr<rcl_node_t> node_handle,
   const std::string service_name)
-: node_handle_(node_handle), service_name_(service_name)
+: node_handle_(node_handle), service_name_(service_name), uses_intra_process_(false)
 {}
 
 ServiceBase::~ServiceBase()
-{}
+{
+  if (uses_intra_process_ &&
+    rcl_guard_condition_fini(&intra_process_guard_condition_) != RCL_RET_OK)
+  {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy guard condition: %s\n", rcl_get_error_string_safe());
+  }
+}
 
 std::string
 ServiceBase::get_service_name()
@@ -47,3 +57,74 @@ ServiceBase::get_service_handle()
 {
   return &service_handle_;
 }
+
+const rcl_guard_condition_t *
+ServiceBase::get_intra_process_guard_condition() const
+{
+  if (!uses_intra_process_) {
+    return nullptr;
+  }
+  return &intra_process_guard_condition_;
+}
+
+void
+ServiceBase::add_intra_process_request(IntraProcessRequest request)
+{
+  if (!uses_intra_process_) {
+    throw std::runtime_error(
+            "intra process requests are not enabled for service '" + service_name_ + "'");
+  }
+  {
+    std::lock_guard<std::mutex> lock(intra_process_requests_mutex_);
+    intra_process_requests_.push_back(std::move(request));
+  }
+  if (rcl_trigger_guard_condition(&intra_process_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+bool
+ServiceBase::take_intra_process_request(IntraProcessRequest & request)
+{
+  std::lock_guard<std::mutex> lock(intra_process_requests_mutex_);
+  if (intra_process_requests_.empty()) {
+    return false;
+  }
+  request = std::move(intra_process_requests_.front());
+  intra_process_requests_.pop_front();
+  return true;
+}
+
+void
+ServiceBase::renotify_if_intra_process_pending()
+{
+  bool pending = false;
+  {
+    std::lock_guard<std::mutex> lock(intra_process_requests_mutex_);
+    pending = !intra_process_requests_.empty();
+  }
+  // The guard condition does not count triggers, so wake up again for what is left over.
+  if (pending && rcl_trigger_guard_condition(&intra_process_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+void
+ServiceBase::setup_intra_process()
+{
+  if (uses_intra_process_) {
+    return;
+  }
+  if (rcl_guard_condition_init(
+      &intra_process_guard_condition_, rcl_guard_condition_get_default_options()) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("could not create intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+  uses_intra_process_ = true;
+}
@@ -0,0 +1,194 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/statistics_publisher.hpp"
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "rclcpp/parameter.hpp"
+
+using rclcpp::executor::HistogramSnapshot;
+using rclcpp::parameter::ParameterVariant;
+using rclcpp::statistics_publisher::StatisticsPublisher;
+
+namespace
+{
+
+// The counters only grow, unless the entities they belong to went away or were reset, in which
+// case the current values are the best guess for the period.
+uint64_t
+difference(uint64_t current, uint64_t previous)
+{
+  return current >= previous ? current - previous : current;
+}
+
+HistogramSnapshot
+difference(HistogramSnapshot current, const HistogramSnapshot & previous)
+{
+  for (size_t i = 0; i < rclcpp::executor::Histogram::number_of_buckets; ++i) {
+    if (current.buckets[i] < previous.buckets[i]) {
+      return current;
+    }
+  }
+  current -= previous;
+  return current;
+}
+
+}  // namespace
+
+StatisticsPublisher::StatisticsPublisher(
+  rclcpp::node::Node::SharedPtr node,
+  rclcpp::executor::Executor::SharedPtr executor,
+  std::chrono::nanoseconds period)
+: node_(node), executor_(executor)
+{
+  if (!node || !executor) {
+    throw std::invalid_argument("the statistics publisher needs a node and an executor");
+  }
+  if (period <= std::chrono::nanoseconds::zero()) {
+    throw std::invalid_argument("the statistics period must be positive");
+  }
+  node_name_ = node->get_name();
+  executor->set_statistics_enabled(true);
+  // The first collection only takes the snapshots which the first period is measured from.
+  previous_time_ = std::chrono::steady_clock::now();
+  collect();
+
+  callback_group_ = node->create_callback_group(
+    rclcpp::callback_group::CallbackGroupType::MutuallyExclusive);
+  publisher_ = node->create_publisher<rcl_interfaces::msg::ParameterEvent>(
+    node_name_ + "__statistics", rmw_qos_profile_default);
+  timer_target_ = std::make_shared<TimerTarget>();
+  timer_target_->statistics_publisher = this;
+  // The executor may still run the timer while this is destroyed, so it must not capture this.
+  auto timer_target = timer_target_;
+  // *INDENT-OFF*
+  timer_ = node->create_wall_timer(period, [timer_target]() {
+    std::lock_guard<std::mutex> lock(timer_target->mutex);
+    auto statistics_publisher = timer_target->statistics_publisher;
+    if (statistics_publisher) {
+      statistics_publisher->publisher_->publish(statistics_publisher->collect());
+    }
+  }, callback_group_, period / 10);
+  // *INDENT-ON*
+}
+
+StatisticsPublisher::~StatisticsPublisher()
+{
+  if (timer_target_) {
+    // Once this returns, a running timer callback has finished and later ones do nothing.
+    std::lock_guard<std::mutex> lock(timer_target_->mutex);
+    timer_target_->statistics_publisher = nullptr;
+  }
+  if (timer_) {
+    timer_->cancel();
+  }
+}
+
+std::shared_ptr<rcl_interfaces::msg::ParameterEvent>
+StatisticsPublisher::collect()
+{
+  auto message = std::make_shared<rcl_interfaces::msg::ParameterEvent>();
+  auto node = node_.lock();
+  auto executor = executor_.lock();
+  if (!node || !executor) {
+    return message;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = std::chrono::steady_clock::now();
+  auto & executor_statistics = executor->get_statistics();
+  auto wait_time = executor_statistics.wait_time.snapshot();
+  auto topics = take_topic_snapshots(*node, executor_statistics);
+  auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(now - previous_time_);
+  double seconds = std::chrono::duration<double>(period).count();
+
+  auto & values = message->new_parameters;
+  values.push_back(ParameterVariant("node", node_name_).to_parameter());
+  values.push_back(ParameterVariant("period_ns", static_cast<int64_t>(period.count()))
+    .to_parameter());
+  double wait_seconds = difference(wait_time, previous_wait_time_).sum / 1e9;
+  values.push_back(ParameterVariant("executor.idle_ratio",
+    seconds > 0 ? wait_seconds / seconds : 0.0).to_parameter());
+  for (auto & topic : topics) {
+    TopicSnapshot previous;
+    auto it = previous_topics_.find(topic.first);
+    if (it != previous_topics_.end()) {
+      previous = it->second;
+    }
+    std::string prefix = "topic." + topic.first + ".";
+    uint64_t taken = difference(topic.second.taken, previous.taken);
+    values.push_back(ParameterVariant(prefix + "messages_per_second",
+      seconds > 0 ? taken / seconds : 0.0).to_parameter());
+    values.push_back(ParameterVariant(prefix + "intra_process_dropped",
+      static_cast<int64_t>(difference(topic.second.dropped, previous.dropped))).to_parameter());
+    auto queue_delay = difference(topic.second.queue_delay, previous.queue_delay);
+    values.push_back(ParameterVariant(prefix + "take_latency_p50_ns",
+      static_cast<int64_t>(queue_delay.percentile(0.5).count())).to_parameter());
+    values.push_back(ParameterVariant(prefix + "take_latency_p99_ns",
+      static_cast<int64_t>(queue_delay.percentile(0.99).count())).to_parameter());
+    auto execution_time = difference(topic.second.execution_time, previous.execution_time);
+    values.push_back(ParameterVariant(prefix + "callback_duration_p50_ns",
+      static_cast<int64_t>(execution_time.percentile(0.5).count())).to_parameter());
+    values.push_back(ParameterVariant(prefix + "callback_duration_p99_ns",
+      static_cast<int64_t>(execution_time.percentile(0.99).count())).to_parameter());
+    values.push_back(ParameterVariant(prefix + "callback_duration_p999_ns",
+      static_cast<int64_t>(execution_time.percentile(0.999).count())).to_parameter());
+  }
+
+  previous_time_ = now;
+  previous_wait_time_ = wait_time;
+  previous_topics_ = std::move(topics);
+  return message;
+}
+
+std::map<std::string, StatisticsPublisher::TopicSnapshot>
+StatisticsPublisher::take_topic_snapshots(
+  rclcpp::node::Node & node, rclcpp::executor::ExecutorStatistics & executor_statistics)
+{
+  std::map<std::string, TopicSnapshot> topics;
+  for (auto & weak_group : node.get_callback_groups()) {
+    auto group = weak_group.lock();
+    if (!group) {
+      continue;
+    }
+    for (auto & weak_subscription : group->get_subscription_ptrs()) {
+      auto subscription = weak_subscription.lock();
+      if (!subscription) {
+        continue;
+      }
+      auto & snapshot = topics[subscription->get_topic_name()];
+      auto intra_process_statistics = subscription->get_intra_process_statistics();
+      snapshot.taken +=
+        subscription->get_inter_process_taken_count() + intra_process_statistics.taken;
+      snapshot.dropped += intra_process_statistics.dropped + intra_process_statistics.overwritten;
+      // The executor keeps the statistics of inter and intra process executions apart.
+      const void * handles[] = {
+        subscription->get_subscription_handle(),
+        subscription->get_intra_process_subscription_handle()
+      };
+      for (auto handle : handles) {
+        auto entity_statistics = executor_statistics.find_entity_statistics(handle);
+        if (entity_statistics) {
+          snapshot.queue_delay += entity_statistics->queue_delay.snapshot();
+          snapshot.execution_time += entity_statistics->execution_time.snapshot();
+        }
+      }
+    }
+  }
+  return topics;
+}
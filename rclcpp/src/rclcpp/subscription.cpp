@@ -14,7 +14,10 @@
 
 #include "rclcpp/subscription.hpp"
 
+#include <chrono>
 #include <cstdio>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 
 #include "rmw/error_handling.h"
@@ -29,7 +32,19 @@ SubscriptionBase::SubscriptionBase(
   bool ignore_local_publications)
 :   node_handle_(node_handle),
   topic_name_(topic_name),
-  ignore_local_publications_(ignore_local_publications)
+  ignore_local_publications_(ignore_local_publications),
+  take_batch_size_(1),
+  uses_intra_process_queue_(false),
+  intra_process_queue_policy_(IntraProcessQueuePolicy::KeepLast),
+  intra_process_queue_depth_(0),
+  intra_process_max_block_time_(0),
+  intra_process_taken_(0),
+  intra_process_dropped_(0),
+  intra_process_overwritten_(0),
+  inter_process_taken_(0),
+  filtered_(0),
+  throttle_enabled_(false),
+  throttled_(0)
 {
   // To avoid unused private member warnings.
   (void)ignore_local_publications_;
@@ -37,6 +52,7 @@ SubscriptionBase::SubscriptionBase(
 
 SubscriptionBase::~SubscriptionBase()
 {
+  group_membership_.leave();
   if (rcl_subscription_fini(&subscription_handle_, node_handle_.get()) != RCL_RET_OK) {
     std::stringstream ss;
     ss << "Error in destruction of rcl subscription handle: " <<
@@ -51,6 +67,14 @@ SubscriptionBase::~SubscriptionBase()
       rcl_get_error_string_safe() << '\n';
     (std::cerr << ss.str()).flush();
   }
+  if (uses_intra_process_queue_ &&
+    rcl_guard_condition_fini(&intra_process_guard_condition_) != RCL_RET_OK)
+  {
+    std::stringstream ss;
+    ss << "Error in destruction of intra process guard condition: " <<
+      rcl_get_error_string_safe() << '\n';
+    (std::cerr << ss.str()).flush();
+  }
 }
 
 const std::string &
@@ -70,3 +94,246 @@ SubscriptionBase::get_intra_process_subscription_handle() const
 {
   return &intra_process_subscription_handle_;
 }
+
+void
+SubscriptionBase::set_take_batch_size(size_t take_batch_size)
+{
+  if (take_batch_size == 0) {
+    throw std::invalid_argument("take batch size must be at least 1");
+  }
+  take_batch_size_.store(take_batch_size);
+}
+
+size_t
+SubscriptionBase::get_take_batch_size() const
+{
+  return take_batch_size_.load();
+}
+
+const rcl_guard_condition_t *
+SubscriptionBase::get_intra_process_guard_condition() const
+{
+  if (!uses_intra_process_queue_) {
+    return nullptr;
+  }
+  return &intra_process_guard_condition_;
+}
+
+void
+SubscriptionBase::deliver_intra_process_message(uint64_t publisher_id, uint64_t message_sequence)
+{
+  if (!uses_intra_process_queue_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+    if (intra_process_queue_depth_ > 0 &&
+      intra_process_queue_.size() >= intra_process_queue_depth_)
+    {
+      intra_process_queue_.pop_front();
+      ++intra_process_dropped_;
+    }
+    intra_process_queue_.emplace_back(publisher_id, message_sequence);
+  }
+  if (rcl_trigger_guard_condition(&intra_process_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+bool
+SubscriptionBase::take_intra_process_notification(rcl_interfaces::msg::IntraProcessMessage & ipm)
+{
+  bool notify_publishers = false;
+  {
+    std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+    if (intra_process_queue_.empty()) {
+      return false;
+    }
+    ipm.publisher_id = intra_process_queue_.front().first;
+    ipm.message_sequence = intra_process_queue_.front().second;
+    intra_process_queue_.pop_front();
+    notify_publishers = intra_process_queue_policy_ == IntraProcessQueuePolicy::BlockPublisher;
+  }
+  if (notify_publishers) {
+    intra_process_queue_condition_.notify_all();
+  }
+  return true;
+}
+
+void
+SubscriptionBase::renotify_if_intra_process_pending()
+{
+  bool pending = false;
+  {
+    std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+    pending = !intra_process_queue_.empty();
+  }
+  // The guard condition does not count triggers, so wake up again for what is left over.
+  if (pending && rcl_trigger_guard_condition(&intra_process_guard_condition_) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("failed to trigger intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+}
+
+void
+SubscriptionBase::setup_intra_process_queue(size_t depth)
+{
+  if (rcl_guard_condition_init(
+      &intra_process_guard_condition_, rcl_guard_condition_get_default_options()) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("could not create intra process guard condition: ") +
+            rcl_get_error_string_safe());
+  }
+  intra_process_queue_depth_ = depth;
+  uses_intra_process_queue_ = true;
+}
+
+void
+SubscriptionBase::set_intra_process_queue_policy(
+  IntraProcessQueuePolicy policy, size_t depth, std::chrono::nanoseconds max_block_time)
+{
+  if (!uses_intra_process_queue_) {
+    throw std::runtime_error(
+            "the intra process queue policy can only be set with direct intra process delivery");
+  }
+  {
+    std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+    intra_process_queue_policy_ = policy;
+    intra_process_queue_depth_ = depth;
+    intra_process_max_block_time_ = max_block_time;
+    while (depth > 0 && intra_process_queue_.size() > depth) {
+      intra_process_queue_.pop_front();
+      ++intra_process_dropped_;
+    }
+  }
+  // Blocked publishers reevaluate with the new depth.
+  intra_process_queue_condition_.notify_all();
+}
+
+rclcpp::subscription::IntraProcessQueuePolicy
+SubscriptionBase::get_intra_process_queue_policy() const
+{
+  std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+  return intra_process_queue_policy_;
+}
+
+size_t
+SubscriptionBase::get_intra_process_queue_depth() const
+{
+  std::lock_guard<std::mutex> lock(intra_process_queue_mutex_);
+  return intra_process_queue_depth_;
+}
+
+rclcpp::subscription::IntraProcessStatistics
+SubscriptionBase::get_intra_process_statistics() const
+{
+  IntraProcessStatistics statistics;
+  statistics.taken = intra_process_taken_.load();
+  statistics.dropped = intra_process_dropped_.load();
+  statistics.overwritten = intra_process_overwritten_.load();
+  return statistics;
+}
+
+uint64_t
+SubscriptionBase::get_inter_process_taken_count() const
+{
+  return inter_process_taken_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+SubscriptionBase::get_filtered_count() const
+{
+  return filtered_.load(std::memory_order_relaxed);
+}
+
+void
+SubscriptionBase::set_throttle(std::chrono::nanoseconds min_period, size_t keep_every)
+{
+  std::lock_guard<std::mutex> lock(throttle_mutex_);
+  throttle_.set_limits(min_period, keep_every);
+  throttle_enabled_.store(throttle_.is_enabled());
+}
+
+uint64_t
+SubscriptionBase::get_throttled_count() const
+{
+  return throttled_.load(std::memory_order_relaxed);
+}
+
+void
+SubscriptionBase::wait_for_intra_process_capacity(
+  std::chrono::steady_clock::time_point publish_start)
+{
+  if (!uses_intra_process_queue_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(intra_process_queue_mutex_);
+  if (intra_process_queue_policy_ != IntraProcessQueuePolicy::BlockPublisher) {
+    return;
+  }
+  // If this times out, the delivery drops the oldest message as with KeepLast.
+  // *INDENT-OFF*
+  auto deadline = publish_start + intra_process_max_block_time_;
+  intra_process_queue_condition_.wait_until(lock, deadline, [this]() {
+    return intra_process_queue_policy_ != IntraProcessQueuePolicy::BlockPublisher ||
+      intra_process_queue_depth_ == 0 ||
+      intra_process_queue_.size() < intra_process_queue_depth_;
+  });
+  // *INDENT-ON*
+}
+
+void
+SubscriptionBase::on_intra_process_message_overwritten()
+{
+  ++intra_process_overwritten_;
+}
+
+rclcpp::callback_group::GroupMembership &
+SubscriptionBase::get_group_membership()
+{
+  return group_membership_;
+}
+
+void
+SubscriptionBase::on_intra_process_message_taken()
+{
+  ++intra_process_taken_;
+}
+
+void
+SubscriptionBase::on_inter_process_message_taken()
+{
+  inter_process_taken_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+SubscriptionBase::on_message_filtered()
+{
+  filtered_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool
+SubscriptionBase::throttle_accepts()
+{
+  if (!throttle_enabled_.load()) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(throttle_mutex_);
+  if (throttle_.accept(std::chrono::steady_clock::now())) {
+    return true;
+  }
+  throttled_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+uint64_t
+SubscriptionBase::begin_intra_process_batch(
+  uint64_t publisher_id, uint64_t last_sequence, size_t max_messages)
+{
+  std::lock_guard<std::mutex> lock(intra_process_sequence_tracker_mutex_);
+  return intra_process_sequence_tracker_.begin(publisher_id, last_sequence, max_messages);
+}
@@ -14,12 +14,34 @@
 
 #include "rclcpp/timer.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
 #include <string>
 
 using rclcpp::timer::TimerBase;
 
+namespace
+{
+
+void
+update_max(std::atomic<int64_t> & maximum, int64_t value)
+{
+  int64_t current = maximum.load(std::memory_order_relaxed);
+  while (value > current &&
+    !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+}  // namespace
+
 TimerBase::TimerBase(std::chrono::nanoseconds period)
+: slack_(0), period_(period.count()),
+  calls_(0), missed_periods_(0), last_missed_periods_(0),
+  last_scheduled_time_ns_(0), last_call_time_ns_(0),
+  last_lateness_ns_(0), max_lateness_ns_(0), total_lateness_ns_(0),
+  last_callback_duration_ns_(0), max_callback_duration_ns_(0)
 {
   if (rcl_timer_init(
       &timer_handle_, period.count(), nullptr,
@@ -30,7 +52,9 @@ TimerBase::TimerBase(std::chrono::nanoseconds period)
 }
 
 TimerBase::~TimerBase()
-{}
+{
+  group_membership_.leave();
+}
 
 void
 TimerBase::cancel()
@@ -40,6 +64,17 @@ TimerBase::cancel()
   }
 }
 
+bool
+TimerBase::is_canceled()
+{
+  bool canceled = false;
+  if (rcl_timer_is_canceled(&timer_handle_, &canceled) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't get timer cancelled state: ") + rcl_get_error_string_safe());
+  }
+  return canceled;
+}
+
 bool
 TimerBase::is_ready()
 {
@@ -50,6 +85,12 @@ TimerBase::is_ready()
   return ready;
 }
 
+rclcpp::callback_group::GroupMembership &
+TimerBase::get_group_membership()
+{
+  return group_membership_;
+}
+
 std::chrono::nanoseconds
 TimerBase::time_until_trigger()
 {
@@ -67,3 +108,66 @@ TimerBase::get_timer_handle()
 {
   return &timer_handle_;
 }
+
+void
+TimerBase::set_slack(std::chrono::nanoseconds slack)
+{
+  if (slack < std::chrono::nanoseconds::zero()) {
+    throw std::invalid_argument("timer slack must not be negative");
+  }
+  slack_.store(slack.count());
+}
+
+std::chrono::nanoseconds
+TimerBase::get_slack() const
+{
+  return std::chrono::nanoseconds(slack_.load());
+}
+
+rclcpp::timer::TimerStatistics
+TimerBase::get_statistics() const
+{
+  using std::chrono::nanoseconds;
+  TimerStatistics statistics;
+  statistics.calls = calls_.load(std::memory_order_relaxed);
+  statistics.missed_periods = missed_periods_.load(std::memory_order_relaxed);
+  statistics.last_missed_periods = last_missed_periods_.load(std::memory_order_relaxed);
+  statistics.last_scheduled_time = TimerStatistics::Clock::time_point(
+    nanoseconds(last_scheduled_time_ns_.load(std::memory_order_relaxed)));
+  statistics.last_call_time = TimerStatistics::Clock::time_point(
+    nanoseconds(last_call_time_ns_.load(std::memory_order_relaxed)));
+  statistics.last_lateness = nanoseconds(last_lateness_ns_.load(std::memory_order_relaxed));
+  statistics.max_lateness = nanoseconds(max_lateness_ns_.load(std::memory_order_relaxed));
+  statistics.total_lateness = nanoseconds(total_lateness_ns_.load(std::memory_order_relaxed));
+  statistics.last_callback_duration =
+    nanoseconds(last_callback_duration_ns_.load(std::memory_order_relaxed));
+  statistics.max_callback_duration =
+    nanoseconds(max_callback_duration_ns_.load(std::memory_order_relaxed));
+  return statistics;
+}
+
+void
+TimerBase::record_call(
+  TimerStatistics::Clock::time_point now, std::chrono::nanoseconds time_until_trigger)
+{
+  int64_t lateness = std::max(-time_until_trigger.count(), static_cast<int64_t>(0));
+  uint64_t missed_periods = period_ ? static_cast<uint64_t>(lateness) / period_ : 0;
+  auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    now.time_since_epoch()).count();
+
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  missed_periods_.fetch_add(missed_periods, std::memory_order_relaxed);
+  last_missed_periods_.store(missed_periods, std::memory_order_relaxed);
+  last_scheduled_time_ns_.store(now_ns + time_until_trigger.count(), std::memory_order_relaxed);
+  last_call_time_ns_.store(now_ns, std::memory_order_relaxed);
+  last_lateness_ns_.store(lateness, std::memory_order_relaxed);
+  update_max(max_lateness_ns_, lateness);
+  total_lateness_ns_.fetch_add(lateness, std::memory_order_relaxed);
+}
+
+void
+TimerBase::record_callback_duration(std::chrono::nanoseconds duration)
+{
+  last_callback_duration_ns_.store(duration.count(), std::memory_order_relaxed);
+  update_max(max_callback_duration_ns_, duration.count());
+}
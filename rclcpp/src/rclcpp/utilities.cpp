@@ -15,16 +15,24 @@
 #include "rclcpp/utilities.hpp"
 
 #include <atomic>
+#include <cerrno>
 #include <condition_variable>
 #include <csignal>
 #include <cstdio>
 #include <cstring>
 #include <mutex>
 #include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "rcl/error_handling.h"
 #include "rcl/rcl.h"
 
+#include "rclcpp/context.hpp"
+
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 
@@ -44,6 +52,50 @@ static std::atomic<bool> g_is_interrupted(false);
 /// Mutex for protecting the global condition variable.
 static std::mutex g_interrupt_mutex;
 
+#ifndef _WIN32
+/// Pipe through which the signal handler wakes up the signal watcher thread.
+static volatile sig_atomic_t g_signal_pipe_write = -1;
+
+/// Thread which does the work of a signal that is not async-signal-safe, see signal_handler.
+/**
+ * It is stopped and joined at exit, before the other globals of this file are destroyed.
+ */
+static struct SignalWatcher
+{
+  ~SignalWatcher()
+  {
+    if (!thread.joinable()) {
+      return;
+    }
+    int write_fd = g_signal_pipe_write;
+    g_signal_pipe_write = -1;
+    const char stop = 0;
+    if (write(write_fd, &stop, 1) == 1) {
+      thread.join();
+    } else {
+      thread.detach();
+    }
+    close(write_fd);
+  }
+
+  std::thread thread;
+} g_signal_watcher;
+#endif
+
+/// Wake up everything which waits for the shutdown: executors, wait sets and sleep_for.
+static void
+notify_shutdown()
+{
+  rcl_ret_t status = rcl_trigger_guard_condition(&g_sigint_guard_cond_handle);
+  if (status != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+  }
+  rclcpp::context::Context::shutdown_all();
+  g_is_interrupted.store(true);
+  g_interrupt_condition_variable.notify_all();
+}
+
 #ifdef HAS_SIGACTION
 static struct sigaction old_action;
 #else
@@ -57,8 +109,6 @@ signal_handler(int signal_value, siginfo_t * siginfo, void * context)
 signal_handler(int signal_value)
 #endif
 {
-  // TODO(wjwwood): remove? move to console logging at some point?
-  printf("signal_handler(%d)\n", signal_value);
 #ifdef HAS_SIGACTION
   if (old_action.sa_flags & SA_SIGINFO) {
     if (old_action.sa_sigaction != NULL) {
@@ -81,14 +131,40 @@ signal_handler(int signal_value)
   }
 #endif
   g_signal_status = signal_value;
-  rcl_ret_t status = rcl_trigger_guard_condition(&g_sigint_guard_cond_handle);
-  if (status != RCL_RET_OK) {
-    fprintf(stderr,
-      "[rclcpp::error] failed to trigger guard condition: %s\n", rcl_get_error_string_safe());
+#ifdef _WIN32
+  // The handler runs in a thread of its own, so it may lock and trigger guard conditions.
+  notify_shutdown();
+#else
+  // Only async-signal-safe calls here, the signal watcher thread does the rest.
+  int saved_errno = errno;
+  int write_fd = g_signal_pipe_write;
+  if (write_fd != -1) {
+    const char signaled = 1;
+    ssize_t ret = write(write_fd, &signaled, 1);
+    (void)ret;
   }
-  g_is_interrupted.store(true);
-  g_interrupt_condition_variable.notify_all();
+  errno = saved_errno;
+#endif
+}
+
+#ifndef _WIN32
+static void
+run_signal_watcher(int read_fd)
+{
+  while (true) {
+    char byte = 0;
+    ssize_t ret = read(read_fd, &byte, 1);
+    if (ret == -1 && errno == EINTR) {
+      continue;
+    }
+    if (ret != 1 || byte == 0) {
+      break;
+    }
+    notify_shutdown();
+  }
+  close(read_fd);
 }
+#endif
 
 void
 rclcpp::utilities::init(int argc, char * argv[])
@@ -100,6 +176,18 @@ rclcpp::utilities::init(int argc, char * argv[])
       std::string("failed to initialize rmw implementation: ") + rcl_get_error_string_safe());
     // *INDENT-ON*
   }
+#ifndef _WIN32
+  // Start the signal watcher before the handler is installed, so no signal is missed.
+  if (!g_signal_watcher.thread.joinable()) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+      throw std::runtime_error(
+              "Failed to create the signal pipe: (" + std::to_string(errno) + ")");
+    }
+    g_signal_pipe_write = pipe_fds[1];
+    g_signal_watcher.thread = std::thread(run_signal_watcher, pipe_fds[0]);
+  }
+#endif
 #ifdef HAS_SIGACTION
   struct sigaction action;
   memset(&action, 0, sizeof(action));
@@ -156,12 +244,7 @@ void
 rclcpp::utilities::shutdown()
 {
   g_signal_status = SIGINT;
-  if (rcl_trigger_guard_condition(&g_sigint_guard_cond_handle) != RCL_RET_OK) {
-    fprintf(stderr,
-      "[rclcpp::error] failed to trigger guard condition: %s\n", rmw_get_error_string_safe());
-  }
-  g_is_interrupted.store(true);
-  g_interrupt_condition_variable.notify_all();
+  notify_shutdown();
 }
 
 rcl_guard_condition_t *
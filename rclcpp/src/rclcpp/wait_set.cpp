@@ -0,0 +1,331 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rclcpp/wait_set.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "rcl/error_handling.h"
+
+using rclcpp::subscription::SubscriptionBase;
+using rclcpp::timer::TimerBase;
+using rclcpp::wait_set::WaitResult;
+using rclcpp::wait_set::WaitSet;
+
+const size_t WaitSet::no_slot;
+const size_t WaitSet::number_of_interrupt_guard_conditions;
+
+namespace
+{
+
+template<typename T>
+bool
+erase_first(std::vector<T> & entities, const T & entity)
+{
+  auto it = std::find(entities.begin(), entities.end(), entity);
+  if (it == entities.end()) {
+    return false;
+  }
+  entities.erase(it);
+  return true;
+}
+
+}  // namespace
+
+WaitSet::WaitSet(rclcpp::context::Context::SharedPtr context, rcl_allocator_t allocator)
+: context_(context), resize_needed_(false)
+{
+  if (!context_) {
+    throw std::invalid_argument("a wait set needs a context");
+  }
+  if (rcl_wait_set_init(
+      &wait_set_, 0, number_of_interrupt_guard_conditions, 0, 0, 0, allocator) != RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("could not create wait set: ") + rcl_get_error_string_safe());
+  }
+}
+
+WaitSet::~WaitSet()
+{
+  if (rcl_wait_set_fini(&wait_set_) != RCL_RET_OK) {
+    fprintf(stderr,
+      "[rclcpp::error] failed to destroy wait set: %s\n", rcl_get_error_string_safe());
+  }
+}
+
+void
+WaitSet::add_subscription(SubscriptionBase::SharedPtr subscription)
+{
+  if (!subscription) {
+    throw std::invalid_argument("cannot add a null subscription to a wait set");
+  }
+  if (std::find(subscriptions_.begin(), subscriptions_.end(), subscription) !=
+    subscriptions_.end())
+  {
+    return;
+  }
+  subscriptions_.push_back(subscription);
+  resize_needed_ = true;
+}
+
+bool
+WaitSet::remove_subscription(const SubscriptionBase::SharedPtr & subscription)
+{
+  if (!erase_first(subscriptions_, subscription)) {
+    return false;
+  }
+  resize_needed_ = true;
+  return true;
+}
+
+void
+WaitSet::add_timer(TimerBase::SharedPtr timer)
+{
+  if (!timer) {
+    throw std::invalid_argument("cannot add a null timer to a wait set");
+  }
+  if (std::find(timers_.begin(), timers_.end(), timer) != timers_.end()) {
+    return;
+  }
+  timers_.push_back(timer);
+  resize_needed_ = true;
+}
+
+bool
+WaitSet::remove_timer(const TimerBase::SharedPtr & timer)
+{
+  if (!erase_first(timers_, timer)) {
+    return false;
+  }
+  resize_needed_ = true;
+  return true;
+}
+
+void
+WaitSet::add_guard_condition(const rcl_guard_condition_t * guard_condition)
+{
+  if (!guard_condition) {
+    throw std::invalid_argument("cannot add a null guard condition to a wait set");
+  }
+  if (std::find(guard_conditions_.begin(), guard_conditions_.end(), guard_condition) !=
+    guard_conditions_.end())
+  {
+    return;
+  }
+  guard_conditions_.push_back(guard_condition);
+  resize_needed_ = true;
+}
+
+bool
+WaitSet::remove_guard_condition(const rcl_guard_condition_t * guard_condition)
+{
+  if (!erase_first(guard_conditions_, guard_condition)) {
+    return false;
+  }
+  resize_needed_ = true;
+  return true;
+}
+
+WaitResult
+WaitSet::wait(std::chrono::nanoseconds timeout)
+{
+  ready_subscriptions_.clear();
+  ready_timers_.clear();
+  ready_guard_conditions_.clear();
+  if (!context_->ok()) {
+    return WaitResult::Interrupted;
+  }
+  if (resize_needed_) {
+    resize();
+  }
+  fill();
+  rcl_ret_t status = rcl_wait(&wait_set_, timeout < std::chrono::nanoseconds::zero() ?
+    -1 : timeout.count());
+  if (status != RCL_RET_OK && status != RCL_RET_TIMEOUT) {
+    std::string error = rcl_get_error_string_safe();
+    clear();
+    throw std::runtime_error("rcl_wait() failed: " + error);
+  }
+
+  // The rcl wait set arrays are in the order of the slots which were assigned in resize().
+  bool interrupted = false;
+  for (size_t i = 0; i < number_of_interrupt_guard_conditions; ++i) {
+    interrupted = interrupted || wait_set_.guard_conditions[i];
+  }
+  for (size_t i = 0; i < subscriptions_.size(); ++i) {
+    auto & slots = subscription_slots_[i];
+    if (wait_set_.subscriptions[slots.subscription] ||
+      (slots.intra_process_subscription != no_slot &&
+      wait_set_.subscriptions[slots.intra_process_subscription]) ||
+      (slots.intra_process_guard_condition != no_slot &&
+      wait_set_.guard_conditions[slots.intra_process_guard_condition]))
+    {
+      ready_subscriptions_.push_back(subscriptions_[i]);
+    }
+  }
+  for (size_t i = 0; i < timers_.size(); ++i) {
+    if (wait_set_.timers[i]) {
+      ready_timers_.push_back(timers_[i]);
+    }
+  }
+  for (size_t i = 0; i < guard_conditions_.size(); ++i) {
+    if (wait_set_.guard_conditions[number_of_interrupt_guard_conditions + i]) {
+      ready_guard_conditions_.push_back(guard_conditions_[i]);
+    }
+  }
+  clear();
+
+  if (interrupted || !context_->ok()) {
+    return WaitResult::Interrupted;
+  }
+  if (ready_subscriptions_.empty() && ready_timers_.empty() && ready_guard_conditions_.empty()) {
+    return WaitResult::Timeout;
+  }
+  return WaitResult::Ready;
+}
+
+const std::vector<SubscriptionBase::SharedPtr> &
+WaitSet::get_ready_subscriptions() const
+{
+  return ready_subscriptions_;
+}
+
+const std::vector<TimerBase::SharedPtr> &
+WaitSet::get_ready_timers() const
+{
+  return ready_timers_;
+}
+
+const std::vector<const rcl_guard_condition_t *> &
+WaitSet::get_ready_guard_conditions() const
+{
+  return ready_guard_conditions_;
+}
+
+void
+WaitSet::resize()
+{
+  // Directly delivered intra process messages are signaled by a guard condition of the
+  // subscription, those come after the interrupt and the added guard conditions.
+  size_t number_of_subscriptions = 0;
+  size_t number_of_guard_conditions =
+    number_of_interrupt_guard_conditions + guard_conditions_.size();
+  subscription_slots_.clear();
+  for (auto & subscription : subscriptions_) {
+    SubscriptionSlots slots = {number_of_subscriptions++, no_slot, no_slot};
+    if (subscription->get_intra_process_subscription_handle()) {
+      slots.intra_process_subscription = number_of_subscriptions++;
+    } else if (subscription->get_intra_process_guard_condition()) {
+      slots.intra_process_guard_condition = number_of_guard_conditions++;
+    }
+    subscription_slots_.push_back(slots);
+  }
+
+  if (rcl_wait_set_resize_subscriptions(&wait_set_, number_of_subscriptions) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize subscriptions of wait set: ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_guard_conditions(&wait_set_, number_of_guard_conditions) !=
+    RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Couldn't resize guard conditions of wait set: ") +
+            rcl_get_error_string_safe());
+  }
+  if (rcl_wait_set_resize_timers(&wait_set_, timers_.size()) != RCL_RET_OK) {
+    throw std::runtime_error(
+            std::string("Couldn't resize timers of wait set: ") + rcl_get_error_string_safe());
+  }
+  // The ready lists never hold more than all entities, so reporting them does not allocate.
+  ready_subscriptions_.reserve(subscriptions_.size());
+  ready_timers_.reserve(timers_.size());
+  ready_guard_conditions_.reserve(guard_conditions_.size());
+  resize_needed_ = false;
+}
+
+void
+WaitSet::fill()
+{
+  // rcl assigns the slots in the order the entities are added, which is the order of resize().
+  // SIGINT shuts down the context as well, so its guard condition is the only interrupt one.
+  if (rcl_wait_set_add_guard_condition(&wait_set_, context_->get_interrupt_guard_condition()) !=
+    RCL_RET_OK)
+  {
+    throw std::runtime_error(
+            std::string("Couldn't add guard_condition to wait set: ") +
+            rcl_get_error_string_safe());
+  }
+  for (auto guard_condition : guard_conditions_) {
+    if (rcl_wait_set_add_guard_condition(&wait_set_, guard_condition) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add guard_condition to wait set: ") +
+              rcl_get_error_string_safe());
+    }
+  }
+  for (auto & subscription : subscriptions_) {
+    if (rcl_wait_set_add_subscription(&wait_set_, subscription->get_subscription_handle()) !=
+      RCL_RET_OK)
+    {
+      throw std::runtime_error(
+              std::string("Couldn't add subscription to wait set: ") +
+              rcl_get_error_string_safe());
+    }
+    auto intra_process_handle = subscription->get_intra_process_subscription_handle();
+    if (intra_process_handle) {
+      if (rcl_wait_set_add_subscription(&wait_set_, intra_process_handle) != RCL_RET_OK) {
+        throw std::runtime_error(
+                std::string("Couldn't add intra process subscription to wait set: ") +
+                rcl_get_error_string_safe());
+      }
+      continue;
+    }
+    auto intra_process_guard_condition = subscription->get_intra_process_guard_condition();
+    if (intra_process_guard_condition) {
+      // Messages which were not taken after the last wait have to make this one return.
+      subscription->renotify_if_intra_process_pending();
+      if (rcl_wait_set_add_guard_condition(&wait_set_, intra_process_guard_condition) !=
+        RCL_RET_OK)
+      {
+        throw std::runtime_error(
+                std::string("Couldn't add guard_condition to wait set: ") +
+                rcl_get_error_string_safe());
+      }
+    }
+  }
+  for (auto & timer : timers_) {
+    if (rcl_wait_set_add_timer(&wait_set_, timer->get_timer_handle()) != RCL_RET_OK) {
+      throw std::runtime_error(
+              std::string("Couldn't add timer to wait set: ") + rcl_get_error_string_safe());
+    }
+  }
+}
+
+void
+WaitSet::clear()
+{
+  if (rcl_wait_set_clear_subscriptions(&wait_set_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear subscriptions from wait set");
+  }
+  if (rcl_wait_set_clear_guard_conditions(&wait_set_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear guard conditions from wait set");
+  }
+  if (rcl_wait_set_clear_timers(&wait_set_) != RCL_RET_OK) {
+    throw std::runtime_error("Couldn't clear timers from wait set");
+  }
+}
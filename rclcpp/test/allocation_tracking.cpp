@@ -0,0 +1,376 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "allocation_tracking.hpp"
+
+#if defined(__GLIBC__)
+#include <cxxabi.h>
+#include <execinfo.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#if defined(__GLIBC__)
+// The allocation functions of glibc, which the replacements below forward to.
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * pointer, size_t size);
+extern "C" void __libc_free(void * pointer);
+#endif
+
+namespace
+{
+
+const size_t max_regions = 64;
+const size_t max_records = 64;
+const int max_frames = 24;
+
+struct Region
+{
+  std::atomic<const char *> name;
+  std::atomic<size_t> allocations;
+  std::atomic<size_t> bytes;
+};
+
+struct Record
+{
+  const char * region;
+  size_t size;
+  int frame_count;
+  void * frames[max_frames];
+};
+
+// All of this is statically allocated, so counting does not allocate.
+Region g_regions[max_regions];
+std::atomic<size_t> g_region_count(0);
+Record g_records[max_records];
+std::atomic<size_t> g_record_count(0);
+std::atomic<bool> g_tracking(false);
+
+thread_local const char * t_region = nullptr;
+thread_local bool t_in_hook = false;
+
+Region *
+find_or_add_region(const char * name)
+{
+  size_t count = g_region_count.load();
+  for (size_t i = 0; i < count && i < max_regions; ++i) {
+    const char * region_name = g_regions[i].name.load();
+    if (region_name && std::strcmp(region_name, name) == 0) {
+      return &g_regions[i];
+    }
+  }
+  size_t index = g_region_count.fetch_add(1);
+  if (index >= max_regions) {
+    return nullptr;
+  }
+  g_regions[index].name.store(name);
+  return &g_regions[index];
+}
+
+void
+record_allocation(size_t size)
+{
+  if (!g_tracking.load(std::memory_order_relaxed)) {
+    return;
+  }
+  const char * name = t_region;
+  if (!name || t_in_hook) {
+    return;
+  }
+  t_in_hook = true;
+  Region * region = find_or_add_region(name);
+  if (region) {
+    ++region->allocations;
+    region->bytes += size;
+  }
+  size_t index = g_record_count.fetch_add(1);
+  if (index < max_records) {
+    Record & record = g_records[index];
+    record.region = name;
+    record.size = size;
+#if defined(__GLIBC__)
+    record.frame_count = backtrace(record.frames, max_frames);
+#else
+    record.frame_count = 0;
+#endif
+  }
+  t_in_hook = false;
+}
+
+void *
+raw_malloc(size_t size)
+{
+#if defined(__GLIBC__)
+  return __libc_malloc(size);
+#else
+  return std::malloc(size);
+#endif
+}
+
+void
+raw_free(void * pointer)
+{
+#if defined(__GLIBC__)
+  __libc_free(pointer);
+#else
+  std::free(pointer);
+#endif
+}
+
+void *
+tracked_new(size_t size)
+{
+  record_allocation(size);
+  void * pointer = raw_malloc(size ? size : 1);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+#if defined(__GLIBC__)
+std::string
+describe_frame(char * symbol)
+{
+  // Symbols look like "binary(mangled_name+0x2a) [0x4005d2]".
+  std::string description(symbol);
+  char * begin = std::strchr(symbol, '(');
+  char * end = begin ? std::strchr(begin, '+') : nullptr;
+  if (!begin || !end || end == begin + 1) {
+    return description;
+  }
+  std::string mangled(begin + 1, end);
+  int status = 0;
+  char * demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+  if (status == 0 && demangled) {
+    description = demangled;
+  }
+  std::free(demangled);
+  return description;
+}
+#endif
+
+}  // namespace
+
+void *
+operator new(size_t size)
+{
+  return tracked_new(size);
+}
+
+void *
+operator new[](size_t size)
+{
+  return tracked_new(size);
+}
+
+void *
+operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return tracked_new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *
+operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return tracked_new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void
+operator delete(void * pointer) noexcept
+{
+  raw_free(pointer);
+}
+
+void
+operator delete[](void * pointer) noexcept
+{
+  raw_free(pointer);
+}
+
+void
+operator delete(void * pointer, const std::nothrow_t &) noexcept
+{
+  raw_free(pointer);
+}
+
+void
+operator delete[](void * pointer, const std::nothrow_t &) noexcept
+{
+  raw_free(pointer);
+}
+
+#if defined(__GLIBC__)
+// Also count allocations of C code, e.g. the default rcl allocator.
+extern "C" void *
+malloc(size_t size) noexcept
+{
+  record_allocation(size);
+  return __libc_malloc(size);
+}
+
+extern "C" void *
+calloc(size_t count, size_t size) noexcept
+{
+  record_allocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *
+realloc(void * pointer, size_t size) noexcept
+{
+  record_allocation(size);
+  return __libc_realloc(pointer, size);
+}
+#endif
+
+namespace allocation_tracking
+{
+
+void
+start()
+{
+#if defined(__GLIBC__)
+  // The first backtrace loads the unwinder, which allocates.
+  void * frames[1];
+  backtrace(frames, 1);
+#endif
+  g_tracking.store(false);
+  for (size_t i = 0; i < max_regions; ++i) {
+    g_regions[i].name.store(nullptr);
+    g_regions[i].allocations.store(0);
+    g_regions[i].bytes.store(0);
+  }
+  g_region_count.store(0);
+  g_record_count.store(0);
+  g_tracking.store(true);
+}
+
+void
+stop()
+{
+  g_tracking.store(false);
+}
+
+bool
+is_tracking()
+{
+  return g_tracking.load();
+}
+
+ScopedRegion::ScopedRegion(const char * name)
+: previous_region_(t_region)
+{
+  t_region = name;
+}
+
+ScopedRegion::~ScopedRegion()
+{
+  t_region = previous_region_;
+}
+
+size_t
+get_allocation_count(const char * region)
+{
+  size_t allocations = 0;
+  size_t count = g_region_count.load();
+  for (size_t i = 0; i < count && i < max_regions; ++i) {
+    const char * name = g_regions[i].name.load();
+    if (name && std::strcmp(name, region) == 0) {
+      allocations += g_regions[i].allocations.load();
+    }
+  }
+  return allocations;
+}
+
+size_t
+get_allocated_bytes(const char * region)
+{
+  size_t bytes = 0;
+  size_t count = g_region_count.load();
+  for (size_t i = 0; i < count && i < max_regions; ++i) {
+    const char * name = g_regions[i].name.load();
+    if (name && std::strcmp(name, region) == 0) {
+      bytes += g_regions[i].bytes.load();
+    }
+  }
+  return bytes;
+}
+
+size_t
+get_total_allocation_count()
+{
+  size_t allocations = 0;
+  size_t count = g_region_count.load();
+  for (size_t i = 0; i < count && i < max_regions; ++i) {
+    allocations += g_regions[i].allocations.load();
+  }
+  return allocations;
+}
+
+std::string
+get_report()
+{
+  // Do not count the allocations of the report itself.
+  bool was_in_hook = t_in_hook;
+  t_in_hook = true;
+  std::ostringstream report;
+  size_t count = g_region_count.load();
+  for (size_t i = 0; i < count && i < max_regions; ++i) {
+    const char * name = g_regions[i].name.load();
+    if (name) {
+      report << "region '" << name << "': " << g_regions[i].allocations.load() <<
+        " allocations, " << g_regions[i].bytes.load() << " bytes\n";
+    }
+  }
+  if (count > max_regions) {
+    report << (count - max_regions) << " more regions were not counted\n";
+  }
+  size_t record_count = g_record_count.load();
+  for (size_t i = 0; i < record_count && i < max_records; ++i) {
+    const Record & record = g_records[i];
+    report << "allocation of " << record.size << " bytes in region '" << record.region << "':\n";
+#if defined(__GLIBC__)
+    char ** symbols = backtrace_symbols(record.frames, record.frame_count);
+    // Skip the frames of the tracking itself.
+    for (int frame = 2; symbols && frame < record.frame_count; ++frame) {
+      report << "  " << describe_frame(symbols[frame]) << "\n";
+    }
+    std::free(symbols);
+#else
+    report << "  (no call stack on this platform)\n";
+#endif
+  }
+  if (record_count > max_records) {
+    report << "call stacks of " << (record_count - max_records) <<
+      " more allocations were not kept\n";
+  }
+  t_in_hook = was_in_hook;
+  return report.str();
+}
+
+}  // namespace allocation_tracking
@@ -0,0 +1,170 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ALLOCATION_TRACKING_HPP_
+#define ALLOCATION_TRACKING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+
+/* Allocation tracking for tests which check that code does not allocate.
+ *
+ * Linking allocation_tracking.cpp into a test replaces operator new and, with
+ * glibc, malloc, calloc and realloc, so that every allocation made while
+ * tracking is started is counted against the region of the allocating thread:
+ *
+ *   allocation_tracking::start();
+ *   {
+ *     allocation_tracking::ScopedRegion region("publish");
+ *     publisher->publish(message);
+ *   }
+ *   allocation_tracking::stop();
+ *   EXPECT_EQ(0u, allocation_tracking::get_allocation_count("publish")) <<
+ *     allocation_tracking::get_report();
+ *
+ * Allocations outside of any region are not counted.
+ * Where available, the call stack of the first allocations is kept, and
+ * get_report prints it, so a failing test shows where the allocation came from.
+ * Counting itself never allocates.
+ */
+namespace allocation_tracking
+{
+
+/// Forget earlier counts and start counting allocations made inside regions.
+void
+start();
+
+/// Stop counting allocations; the counts are kept until the next start.
+void
+stop();
+
+/// Return true between start and stop.
+bool
+is_tracking();
+
+/// Count the allocations of this thread against a region while the scope is alive.
+/**
+ * Regions nest; the innermost one is counted.
+ * The name must outlive the tracking, e.g. be a string literal.
+ */
+class ScopedRegion
+{
+public:
+  explicit ScopedRegion(const char * name);
+  ~ScopedRegion();
+
+private:
+  ScopedRegion(const ScopedRegion &) = delete;
+  ScopedRegion & operator=(const ScopedRegion &) = delete;
+
+  const char * previous_region_;
+};
+
+/// Return the number of allocations counted against the region.
+size_t
+get_allocation_count(const char * region);
+
+/// Return the number of bytes allocated in the region.
+size_t
+get_allocated_bytes(const char * region);
+
+/// Return the number of allocations counted against any region.
+size_t
+get_total_allocation_count();
+
+/// Return the counts of all regions and where their first allocations came from.
+/**
+ * This allocates, so it should be called after stop.
+ */
+std::string
+get_report();
+
+/// Allocation counters shared by copies of a TrackingAllocator.
+struct AllocatorCounters
+{
+  AllocatorCounters()
+  : allocations(0), deallocations(0)
+  {}
+
+  std::atomic<size_t> allocations;
+  std::atomic<size_t> deallocations;
+};
+
+/// std::allocator_traits compatible allocator which counts what it allocates.
+/**
+ * Pass this as the Alloc of a publisher, subscription or memory strategy to
+ * check which allocations go through it.
+ * Copies and rebound copies share their counters.
+ */
+template<typename T>
+class TrackingAllocator
+{
+public:
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = TrackingAllocator<U>;
+  };
+
+  TrackingAllocator()
+  : counters_(std::make_shared<AllocatorCounters>())
+  {}
+
+  template<typename U>
+  TrackingAllocator(const TrackingAllocator<U> & other) noexcept
+  : counters_(other.get_counters())
+  {}
+
+  T * allocate(size_t n)
+  {
+    ++counters_->allocations;
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T * pointer, size_t n) noexcept
+  {
+    (void)n;
+    ++counters_->deallocations;
+    ::operator delete(pointer);
+  }
+
+  std::shared_ptr<AllocatorCounters> get_counters() const noexcept
+  {
+    return counters_;
+  }
+
+private:
+  std::shared_ptr<AllocatorCounters> counters_;
+};
+
+template<typename T, typename U>
+bool operator==(const TrackingAllocator<T> & a, const TrackingAllocator<U> & b) noexcept
+{
+  return a.get_counters() == b.get_counters();
+}
+
+template<typename T, typename U>
+bool operator!=(const TrackingAllocator<T> & a, const TrackingAllocator<U> & b) noexcept
+{
+  return !(a == b);
+}
+
+}  // namespace allocation_tracking
+
+#endif  // ALLOCATION_TRACKING_HPP_
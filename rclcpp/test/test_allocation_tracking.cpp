@@ -0,0 +1,113 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "allocation_tracking.hpp"
+
+/*
+   Tests that allocations are counted against the innermost region of the allocating thread and
+   that allocations outside of regions, or while not tracking, are not counted.
+ */
+TEST(TestAllocationTracking, regions) {
+  std::unique_ptr<int> outside;
+  std::unique_ptr<int> inner;
+  std::unique_ptr<std::vector<int>> vector;
+  allocation_tracking::start();
+  outside.reset(new int(1));
+  {
+    allocation_tracking::ScopedRegion region("outer");
+    vector.reset(new std::vector<int>(10));
+    {
+      allocation_tracking::ScopedRegion inner_region("inner");
+      inner.reset(new int(2));
+    }
+  }
+  allocation_tracking::stop();
+  {
+    allocation_tracking::ScopedRegion region("outer");
+    outside.reset(new int(3));
+  }
+  EXPECT_EQ(2u, allocation_tracking::get_allocation_count("outer"));
+  EXPECT_EQ(sizeof(std::vector<int>) + 10 * sizeof(int),
+    allocation_tracking::get_allocated_bytes("outer"));
+  EXPECT_EQ(1u, allocation_tracking::get_allocation_count("inner"));
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("unknown"));
+  EXPECT_EQ(3u, allocation_tracking::get_total_allocation_count());
+}
+
+/*
+   Tests that malloc is counted and that regions belong to threads.
+ */
+TEST(TestAllocationTracking, malloc_and_threads) {
+  allocation_tracking::start();
+  std::thread thread([]() {
+      allocation_tracking::ScopedRegion region("thread");
+      void * pointer = std::malloc(16);
+      std::free(pointer);
+    });
+  {
+    allocation_tracking::ScopedRegion region("main");
+    thread.join();
+  }
+  allocation_tracking::stop();
+#if defined(__GLIBC__)
+  EXPECT_EQ(1u, allocation_tracking::get_allocation_count("thread"));
+#endif
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("main"));
+}
+
+static void allocating_function(std::unique_ptr<int> & pointer)
+{
+  pointer.reset(new int(4));
+}
+
+/*
+   Tests that the report names the regions and where the allocations came from.
+ */
+TEST(TestAllocationTracking, report) {
+  std::unique_ptr<int> pointer;
+  allocation_tracking::start();
+  {
+    allocation_tracking::ScopedRegion region("reported");
+    allocating_function(pointer);
+  }
+  allocation_tracking::stop();
+  std::string report = allocation_tracking::get_report();
+  EXPECT_NE(std::string::npos, report.find("region 'reported': 1 allocations")) << report;
+  EXPECT_NE(std::string::npos, report.find("allocation of 4 bytes")) << report;
+  EXPECT_EQ(1u, allocation_tracking::get_allocation_count("reported"));
+}
+
+/*
+   Tests that the tracking allocator counts through rebound copies.
+ */
+TEST(TestAllocationTracking, tracking_allocator) {
+  allocation_tracking::TrackingAllocator<void> allocator;
+  {
+    std::vector<int, allocation_tracking::TrackingAllocator<int>> vector(allocator);
+    vector.reserve(10);
+    auto shared = std::allocate_shared<int>(allocator, 5);
+    EXPECT_EQ(2u, allocator.get_counters()->allocations.load());
+  }
+  EXPECT_EQ(2u, allocator.get_counters()->deallocations.load());
+  EXPECT_TRUE(allocator == allocation_tracking::TrackingAllocator<int>(allocator));
+  EXPECT_TRUE(allocator != allocation_tracking::TrackingAllocator<void>());
+}
@@ -0,0 +1,121 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+
+#define RCLCPP_BUILDING_LIBRARY 1  // Prevent including unavailable symbols
+#include <rclcpp/any_subscription_callback.hpp>
+
+struct Message
+{
+  int data = 0;
+};
+
+using AnySubscriptionCallback =
+  rclcpp::any_subscription_callback::AnySubscriptionCallback<Message, std::allocator<void>>;
+using MessageUniquePtr = std::unique_ptr<Message,
+    rclcpp::allocator::Deleter<std::allocator<Message>, Message>>;
+
+class TestAnySubscriptionCallback : public ::testing::Test
+{
+protected:
+  TestAnySubscriptionCallback()
+  : callback(std::make_shared<std::allocator<void>>()), message(std::make_shared<Message>())
+  {
+    message->data = 42;
+    message_info.from_intra_process = false;
+  }
+
+  MessageUniquePtr make_unique_message()
+  {
+    return MessageUniquePtr(new Message(*message));
+  }
+
+  AnySubscriptionCallback callback;
+  std::shared_ptr<Message> message;
+  rmw_message_info_t message_info;
+};
+
+/*
+   Tests that a callback taking a shared_ptr receives the taken message itself.
+ */
+TEST_F(TestAnySubscriptionCallback, shared_ptr) {
+  const Message * received = nullptr;
+  callback.set([&received](const std::shared_ptr<Message> msg) {received = msg.get();});
+  EXPECT_FALSE(callback.use_take_shared_method());
+
+  callback.dispatch(message, message_info);
+  EXPECT_EQ(message.get(), received);
+
+  auto unique_message = make_unique_message();
+  const Message * expected = unique_message.get();
+  callback.dispatch_intra_process(unique_message, message_info);
+  EXPECT_EQ(expected, received);
+  EXPECT_FALSE(unique_message);
+}
+
+/*
+   Tests that a const callback with info shares intra process messages without a copy.
+ */
+TEST_F(TestAnySubscriptionCallback, const_shared_ptr_with_info) {
+  const Message * received = nullptr;
+  bool from_intra_process = false;
+  callback.set(
+    [&](const std::shared_ptr<const Message> msg, const rmw_message_info_t & info) {
+    received = msg.get();
+    from_intra_process = info.from_intra_process;
+  });
+  EXPECT_TRUE(callback.use_take_shared_method());
+
+  message_info.from_intra_process = true;
+  std::shared_ptr<const Message> const_message = message;
+  callback.dispatch_intra_process(const_message, message_info);
+  EXPECT_EQ(message.get(), received);
+  EXPECT_TRUE(from_intra_process);
+}
+
+/*
+   Tests that a unique_ptr callback gets its own copy of shared messages.
+ */
+TEST_F(TestAnySubscriptionCallback, unique_ptr) {
+  MessageUniquePtr received;
+  callback.set([&received](MessageUniquePtr msg) {received = std::move(msg);});
+  EXPECT_FALSE(callback.use_take_shared_method());
+
+  callback.dispatch(message, message_info);
+  ASSERT_TRUE(received);
+  EXPECT_NE(message.get(), received.get());
+  EXPECT_EQ(42, received->data);
+
+  std::shared_ptr<const Message> const_message = message;
+  callback.dispatch_intra_process(const_message, message_info);
+  ASSERT_TRUE(received);
+  EXPECT_NE(message.get(), received.get());
+
+  auto unique_message = make_unique_message();
+  const Message * expected = unique_message.get();
+  callback.dispatch_intra_process(unique_message, message_info);
+  EXPECT_EQ(expected, received.get());
+}
+
+/*
+   Tests that dispatching without a callback set throws.
+ */
+TEST_F(TestAnySubscriptionCallback, no_callback) {
+  EXPECT_FALSE(callback.use_take_shared_method());
+  EXPECT_THROW(callback.dispatch(message, message_info), std::runtime_error);
+}
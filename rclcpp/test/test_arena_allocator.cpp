@@ -0,0 +1,125 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "rclcpp/allocator/arena_allocator.hpp"
+
+using rclcpp::allocator::Arena;
+using rclcpp::allocator::ArenaAllocator;
+using rclcpp::allocator::ArenaOptions;
+
+static ArenaOptions
+make_options(size_t size)
+{
+  ArenaOptions options;
+  options.size = size;
+  return options;
+}
+
+/*
+   Tests that freed blocks are reused and that allocations are aligned.
+ */
+TEST(TestArenaAllocator, reuse) {
+  Arena arena(make_options(4096));
+  void * first = arena.allocate(100);
+  void * second = arena.allocate(100);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % alignof(std::max_align_t));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(second) % alignof(std::max_align_t));
+  EXPECT_EQ(256u, arena.get_bytes_in_use());
+
+  arena.deallocate(first);
+  EXPECT_EQ(128u, arena.get_bytes_in_use());
+  EXPECT_EQ(first, arena.allocate(90));
+  EXPECT_EQ(256u, arena.get_peak_bytes_in_use());
+  arena.deallocate(nullptr);
+}
+
+/*
+   Tests that an exhausted arena throws, and that larger free blocks are split.
+ */
+TEST(TestArenaAllocator, exhausted) {
+  Arena arena(make_options(1024));
+  void * large = arena.allocate(1000);
+  EXPECT_THROW(arena.allocate(1), std::bad_alloc);
+  arena.deallocate(large);
+
+  // The free block of 1024 bytes is split into blocks of 32, 32, 64, ..., 512 bytes.
+  std::vector<void *> small;
+  for (size_t i = 0; i < 32; ++i) {
+    small.push_back(arena.allocate(16));
+  }
+  EXPECT_THROW(arena.allocate(16), std::bad_alloc);
+  EXPECT_EQ(1024u, arena.get_bytes_in_use());
+  for (auto block : small) {
+    arena.deallocate(block);
+  }
+  EXPECT_EQ(0u, arena.get_bytes_in_use());
+  EXPECT_THROW(arena.allocate(16, 2 * alignof(std::max_align_t)), std::bad_alloc);
+}
+
+/*
+   Tests the allocator with standard containers and std::allocate_shared.
+ */
+TEST(TestArenaAllocator, containers) {
+  auto arena = Arena::make_shared(make_options(64 * 1024));
+  ArenaAllocator<void> allocator(arena);
+  {
+    std::vector<int, ArenaAllocator<int>> vector(allocator);
+    vector.resize(1000);
+    std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int>>> map(allocator);
+    for (int i = 0; i < 100; ++i) {
+      map[i] = i;
+    }
+    auto shared = std::allocate_shared<int>(ArenaAllocator<int>(arena), 42);
+    EXPECT_EQ(42, *shared);
+    EXPECT_LT(4000u, arena->get_bytes_in_use());
+  }
+  EXPECT_EQ(0u, arena->get_bytes_in_use());
+
+  EXPECT_TRUE(ArenaAllocator<int>(arena) == ArenaAllocator<double>(arena));
+  EXPECT_TRUE(ArenaAllocator<int>(arena) != ArenaAllocator<int>());
+  EXPECT_THROW(ArenaAllocator<int>().allocate(1), std::bad_alloc);
+}
+
+/*
+   Tests that the arena can be used from several threads at once.
+ */
+TEST(TestArenaAllocator, concurrent) {
+  auto arena = Arena::make_shared(make_options(1024 * 1024));
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([arena, t]() {
+        for (size_t i = 0; i < 1000; ++i) {
+          std::vector<size_t, ArenaAllocator<size_t>> vector(
+            t + i % 100, t, ArenaAllocator<size_t>(arena));
+          for (auto value : vector) {
+            ASSERT_EQ(t, value);
+          }
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0u, arena->get_bytes_in_use());
+}
@@ -0,0 +1,71 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "rclcpp/callback_group_generation.hpp"
+
+using rclcpp::callback_group::GroupGeneration;
+using rclcpp::callback_group::GroupMembership;
+
+/// Stands in for an entity, which leaves its group when it is destroyed.
+struct Entity
+{
+  GroupMembership membership;
+};
+
+/*
+   Tests that destroying a member changes the generation, and that leaving only counts once.
+ */
+TEST(TestCallbackGroupGeneration, membership) {
+  auto generation = std::make_shared<GroupGeneration>();
+  EXPECT_EQ(0u, generation->get());
+  {
+    Entity entity;
+    entity.membership.join(generation);
+    EXPECT_EQ(0u, generation->get());
+  }
+  EXPECT_EQ(1u, generation->get());
+
+  Entity entity;
+  entity.membership.join(generation);
+  entity.membership.leave();
+  EXPECT_EQ(2u, generation->get());
+  entity.membership.leave();
+  EXPECT_EQ(2u, generation->get());
+
+  // Entities which never joined a group do not change anything.
+  {
+    Entity other;
+  }
+  EXPECT_EQ(2u, generation->get());
+}
+
+/*
+   Tests that the generation outlives the group, so members destroyed later are still safe.
+ */
+TEST(TestCallbackGroupGeneration, outlives_group) {
+  std::unique_ptr<Entity> entity(new Entity());
+  std::weak_ptr<GroupGeneration> weak_generation;
+  {
+    auto generation = std::make_shared<GroupGeneration>();
+    weak_generation = generation;
+    entity->membership.join(generation);
+  }
+  EXPECT_FALSE(weak_generation.expired());
+  entity.reset();
+  EXPECT_TRUE(weak_generation.expired());
+}
@@ -0,0 +1,171 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "rclcpp/continuable_future.hpp"
+
+using rclcpp::continuable_future::ContinuableFuture;
+using rclcpp::continuable_future::ContinuationList;
+
+/// Stands in for the executor, which runs the posted continuations one at a time.
+class PostedContinuations
+{
+public:
+  std::shared_ptr<ContinuationList> make_list()
+  {
+    return std::make_shared<ContinuationList>(
+      [this](ContinuationList::Continuation continuation) {
+        queue.push_back(continuation);
+      });
+  }
+
+  size_t run_all()
+  {
+    size_t count = 0;
+    while (!queue.empty()) {
+      auto continuation = queue.front();
+      queue.pop_front();
+      continuation();
+      ++count;
+    }
+    return count;
+  }
+
+  std::deque<ContinuationList::Continuation> queue;
+};
+
+/// A request which is completed by hand, like a client does when the response arrives.
+template<typename T>
+struct Source
+{
+  explicit Source(PostedContinuations & posted)
+  : continuations(posted.make_list()),
+    future(promise.get_future().share(), continuations)
+  {}
+
+  void complete(T value)
+  {
+    promise.set_value(value);
+    continuations->complete();
+  }
+
+  std::promise<T> promise;
+  std::shared_ptr<ContinuationList> continuations;
+  ContinuableFuture<T> future;
+};
+
+static bool
+is_ready(const std::shared_future<int> & future)
+{
+  return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/*
+   Tests that continuations are posted once the future is completed, not called directly.
+ */
+TEST(TestContinuableFuture, posted_on_completion) {
+  PostedContinuations posted;
+  Source<int> source(posted);
+  int seen = 0;
+  auto result = source.future.then([&seen](std::shared_future<int> future) {
+      seen = future.get();
+      return future.get() * 2;
+    });
+  EXPECT_TRUE(posted.queue.empty());
+  EXPECT_FALSE(is_ready(result));
+
+  source.complete(21);
+  EXPECT_EQ(0, seen);
+  EXPECT_EQ(1u, posted.run_all());
+  EXPECT_EQ(21, seen);
+  ASSERT_TRUE(is_ready(result));
+  EXPECT_EQ(42, result.get());
+
+  // Continuations attached to a completed future are posted at once.
+  bool called = false;
+  source.future.then([&called](std::shared_future<int>) {called = true;});
+  EXPECT_EQ(1u, posted.queue.size());
+  posted.run_all();
+  EXPECT_TRUE(called);
+}
+
+/*
+   Tests chaining continuations, including void results and exceptions.
+ */
+TEST(TestContinuableFuture, chain) {
+  PostedContinuations posted;
+  Source<int> source(posted);
+  auto text = source.future
+    .then([](std::shared_future<int> future) {return future.get() + 1;})
+    .then([](std::shared_future<int> future) {return std::to_string(future.get());});
+  bool done = false;
+  auto end = text.then([&done](std::shared_future<std::string>) {done = true;});
+  auto failed = source.future
+    .then([](std::shared_future<int>) -> int {throw std::runtime_error("failed");})
+    .then([](std::shared_future<int> future) {return future.get();});
+
+  source.complete(1);
+  posted.run_all();
+  EXPECT_EQ("2", text.get());
+  EXPECT_TRUE(done);
+  end.get();
+  EXPECT_THROW(failed.get(), std::runtime_error);
+
+  EXPECT_THROW(ContinuableFuture<int>().then([](std::shared_future<int>) {}), std::runtime_error);
+}
+
+/*
+   Tests that a continuation returning a future, like the next request, is waited for.
+ */
+TEST(TestContinuableFuture, unwrap) {
+  PostedContinuations posted;
+  Source<int> first(posted);
+  Source<int> second(posted);
+  auto result = first.future
+    .then([&second](std::shared_future<int> future) {
+      EXPECT_EQ(1, future.get());
+      return second.future;
+    })
+    .then([](std::shared_future<int> future) {return future.get() * 10;});
+
+  first.complete(1);
+  posted.run_all();
+  EXPECT_FALSE(is_ready(result));
+  second.complete(2);
+  posted.run_all();
+  ASSERT_TRUE(is_ready(result));
+  EXPECT_EQ(20, result.get());
+}
+
+/*
+   Tests that a continuation which is never posted does not keep its future alive.
+ */
+TEST(TestContinuableFuture, no_cycle) {
+  PostedContinuations posted;
+  std::weak_ptr<ContinuationList> weak_continuations;
+  {
+    Source<int> source(posted);
+    weak_continuations = source.continuations;
+    source.future.then([](std::shared_future<int> future) {return future.get();});
+  }
+  EXPECT_TRUE(weak_continuations.expired());
+}
@@ -0,0 +1,110 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "rclcpp/deferred_request_table.hpp"
+
+using rclcpp::deferred_request_table::DeferredRequestTable;
+
+struct Header
+{
+  int id;
+};
+
+using RespondT = std::function<int()>;
+using Table = DeferredRequestTable<Header, RespondT>;
+
+std::shared_ptr<Header>
+make_header(int id)
+{
+  auto header = std::make_shared<Header>();
+  header->id = id;
+  return header;
+}
+
+/*
+   Tests that a request is answered by the function it was inserted with, once.
+ */
+TEST(TestDeferredRequestTable, insert_take) {
+  Table table;
+  auto first = make_header(1);
+  auto second = make_header(2);
+  table.insert(first, []() {return 1;}, nullptr);
+  table.insert(second, []() {return 2;}, nullptr);
+  EXPECT_EQ(2u, table.size());
+
+  RespondT respond;
+  Header unknown;
+  EXPECT_FALSE(table.take(&unknown, respond));
+  ASSERT_TRUE(table.take(second.get(), respond));
+  EXPECT_EQ(2, respond());
+  EXPECT_FALSE(table.take(second.get(), respond));
+  ASSERT_TRUE(table.take(first.get(), respond));
+  EXPECT_EQ(1, respond());
+  EXPECT_EQ(0u, table.size());
+}
+
+/*
+   Tests that requests whose client stopped waiting are dropped, and the others are kept.
+ */
+TEST(TestDeferredRequestTable, remove_abandoned) {
+  Table table;
+  std::set<int> pending;
+  std::vector<std::shared_ptr<Header>> headers;
+  for (int i = 0; i < 4; ++i) {
+    headers.push_back(make_header(i));
+    pending.insert(i);
+    table.insert(headers.back(), [i]() {return i;},
+      [&pending, i]() {return pending.count(i) != 0;});
+  }
+  auto kept = make_header(4);
+  table.insert(kept, []() {return 4;}, nullptr);
+
+  pending.erase(1);
+  pending.erase(3);
+  EXPECT_EQ(2u, table.remove_abandoned());
+  EXPECT_EQ(3u, table.size());
+
+  RespondT respond;
+  EXPECT_FALSE(table.take(headers[1].get(), respond));
+  EXPECT_TRUE(table.take(headers[2].get(), respond));
+  EXPECT_TRUE(table.take(kept.get(), respond));
+  EXPECT_EQ(0u, table.remove_abandoned());
+}
+
+/*
+   Tests that requests which are never answered do not accumulate.
+ */
+TEST(TestDeferredRequestTable, abandoned_requests_do_not_accumulate) {
+  Table table;
+  std::vector<std::shared_ptr<Header>> headers;
+  for (int i = 0; i < 10000; ++i) {
+    headers.push_back(make_header(i));
+    // Only the last request is still waiting for its response.
+    int last = i;
+    table.insert(headers.back(), []() {return 0;},
+      [&headers, last]() {return static_cast<int>(headers.size()) == last + 1;});
+    ASSERT_GE(4u, table.size());
+  }
+
+  RespondT respond;
+  EXPECT_TRUE(table.take(headers.back().get(), respond));
+  EXPECT_FALSE(table.take(headers.front().get(), respond));
+}
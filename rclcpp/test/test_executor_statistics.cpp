@@ -0,0 +1,163 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+
+#include "rclcpp/executor_statistics.hpp"
+
+using rclcpp::executor::ExecutorStatistics;
+using rclcpp::executor::Histogram;
+using rclcpp::executor::HistogramSnapshot;
+
+/*
+   Tests recording into a histogram and the derived values.
+ */
+TEST(TestExecutorStatistics, histogram_basics) {
+  Histogram histogram;
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.mean());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.percentile(0.5));
+
+  histogram.record(std::chrono::nanoseconds(0));
+  histogram.record(std::chrono::nanoseconds(1));
+  histogram.record(std::chrono::nanoseconds(3));
+  histogram.record(std::chrono::nanoseconds(1000));
+  EXPECT_EQ(4u, histogram.count());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.min());
+  EXPECT_EQ(std::chrono::nanoseconds(1000), histogram.max());
+  EXPECT_EQ(std::chrono::nanoseconds(251), histogram.mean());
+
+  // 0 -> bucket 0, 1 -> bucket 1 ([1, 2)), 3 -> bucket 2 ([2, 4)), 1000 -> bucket 10.
+  EXPECT_EQ(1u, histogram.bucket_count(0));
+  EXPECT_EQ(1u, histogram.bucket_count(1));
+  EXPECT_EQ(1u, histogram.bucket_count(2));
+  EXPECT_EQ(1u, histogram.bucket_count(10));
+
+  EXPECT_EQ(std::chrono::nanoseconds(4), histogram.percentile(0.5));
+  EXPECT_EQ(std::chrono::nanoseconds(1000), histogram.percentile(0.99));
+
+  histogram.reset();
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(0u, histogram.bucket_count(10));
+}
+
+/*
+   Tests that very long durations end up in the last bucket.
+ */
+TEST(TestExecutorStatistics, histogram_overflow) {
+  Histogram histogram;
+  histogram.record(std::chrono::hours(24 * 365));
+  EXPECT_EQ(1u, histogram.bucket_count(Histogram::number_of_buckets - 1));
+  EXPECT_EQ(std::chrono::nanoseconds::max(),
+    Histogram::bucket_upper_bound(Histogram::number_of_buckets - 1));
+}
+
+/*
+   Tests the statistics of an interval derived from snapshots, and merging snapshots.
+ */
+TEST(TestExecutorStatistics, histogram_snapshots) {
+  Histogram first;
+  Histogram second;
+  first.record(std::chrono::nanoseconds(1000));
+  auto before = first.snapshot();
+  EXPECT_EQ(1u, before.count);
+
+  first.record(std::chrono::nanoseconds(3));
+  first.record(std::chrono::nanoseconds(3));
+  first.record(std::chrono::nanoseconds(5));
+  auto interval = first.snapshot();
+  interval -= before;
+  EXPECT_EQ(3u, interval.count);
+  EXPECT_EQ(0u, interval.buckets[10]);
+  EXPECT_EQ(std::chrono::nanoseconds(3), interval.mean());
+  EXPECT_EQ(std::chrono::nanoseconds(4), interval.percentile(0.5));
+  EXPECT_EQ(std::chrono::nanoseconds(8), interval.percentile(0.99));
+
+  second.record(std::chrono::nanoseconds(1000));
+  interval += second.snapshot();
+  EXPECT_EQ(4u, interval.count);
+  EXPECT_EQ(std::chrono::nanoseconds(1024), interval.percentile(0.99));
+
+  EXPECT_EQ(std::chrono::nanoseconds(0), HistogramSnapshot().percentile(0.5));
+}
+
+/*
+   Tests the per entity bookkeeping.
+ */
+TEST(TestExecutorStatistics, entity_statistics) {
+  ExecutorStatistics statistics;
+  int first = 0;
+  int second = 0;
+  EXPECT_EQ(nullptr, statistics.find_entity_statistics(&first));
+
+  auto entity = statistics.get_entity_statistics(&first);
+  entity->execution_time.record(std::chrono::microseconds(5));
+  EXPECT_EQ(entity, statistics.get_entity_statistics(&first));
+  statistics.get_entity_statistics(&second);
+  EXPECT_EQ(2u, statistics.get_entity_handles().size());
+
+  auto found = statistics.find_entity_statistics(&first);
+  ASSERT_NE(nullptr, found);
+  EXPECT_EQ(1u, found->execution_time.count());
+
+  statistics.reset();
+  EXPECT_EQ(nullptr, statistics.find_entity_statistics(&first));
+  EXPECT_TRUE(statistics.get_entity_handles().empty());
+}
+
+/*
+   Tests that the statistics of destroyed entities are dropped and not handed to new entities.
+ */
+TEST(TestExecutorStatistics, destroyed_entities) {
+  ExecutorStatistics statistics;
+  int handle = 0;
+  auto owner = std::make_shared<int>(0);
+
+  auto entity = statistics.get_entity_statistics(&handle, owner);
+  entity->execution_time.record(std::chrono::microseconds(5));
+  EXPECT_EQ(entity, statistics.get_entity_statistics(&handle, owner));
+
+  // Entities which are alive keep their statistics across a reset.
+  statistics.reset();
+  EXPECT_EQ(entity, statistics.find_entity_statistics(&handle));
+  EXPECT_EQ(0u, entity->execution_time.count());
+
+  owner.reset();
+  EXPECT_EQ(nullptr, statistics.find_entity_statistics(&handle));
+  EXPECT_TRUE(statistics.get_entity_handles().empty());
+
+  // A new entity reusing the address of the handle gets new statistics.
+  auto new_owner = std::make_shared<int>(0);
+  auto new_entity = statistics.get_entity_statistics(&handle, new_owner);
+  EXPECT_NE(entity, new_entity);
+  new_owner.reset();
+  EXPECT_EQ(1u, statistics.remove_destroyed_entities());
+  EXPECT_EQ(0u, statistics.remove_destroyed_entities());
+}
+
+/*
+   Tests that entities which come and go do not accumulate.
+ */
+TEST(TestExecutorStatistics, destroyed_entities_do_not_accumulate) {
+  ExecutorStatistics statistics;
+  int handles[64];
+  for (int & handle : handles) {
+    auto owner = std::make_shared<int>(0);
+    statistics.get_entity_statistics(&handle, owner);
+  }
+  EXPECT_GE(2u, statistics.remove_destroyed_entities());
+}
@@ -0,0 +1,85 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "rclcpp/context.hpp"
+#include "rclcpp/graph_listener.hpp"
+
+using rclcpp::graph_listener::GraphListener;
+
+/*
+   Tests that a notify wakes up a waiting thread without waiting for the poll period.
+ */
+TEST(TestGraphListener, notify_wakes_waiter) {
+  rclcpp::context::Context context;
+  GraphListener listener;
+  listener.set_poll_period(std::chrono::hours(1));
+  std::atomic<bool> ready(false);
+
+  std::thread notifier([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      ready.store(true);
+      listener.notify();
+    });
+  auto start = std::chrono::steady_clock::now();
+  bool result = listener.wait_for(context, [&ready]() {
+        return ready.load();
+      }, std::chrono::seconds(10));
+  auto waited = std::chrono::steady_clock::now() - start;
+  notifier.join();
+  EXPECT_TRUE(result);
+  EXPECT_LT(waited, std::chrono::seconds(5));
+}
+
+/*
+   Tests that a condition which never holds times out, and that conditions are polled.
+ */
+TEST(TestGraphListener, timeout_and_poll) {
+  rclcpp::context::Context context;
+  GraphListener listener;
+  listener.set_poll_period(std::chrono::milliseconds(1));
+
+  EXPECT_FALSE(listener.wait_for(context, []() {
+      return false;
+    }, std::chrono::milliseconds(20)));
+
+  std::atomic<int> checks(0);
+  EXPECT_TRUE(listener.wait_for(context, [&checks]() {
+      return ++checks >= 3;
+    }, std::chrono::seconds(10)));
+  EXPECT_GE(checks.load(), 3);
+}
+
+/*
+   Tests that shutting down the context interrupts a wait without a timeout.
+ */
+TEST(TestGraphListener, shutdown_interrupts_wait) {
+  rclcpp::context::Context context;
+  GraphListener listener;
+  listener.set_poll_period(std::chrono::milliseconds(1));
+
+  std::thread stopper([&context]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      context.shutdown();
+    });
+  EXPECT_FALSE(listener.wait_for(context, []() {
+      return false;
+    }, std::chrono::nanoseconds(-1)));
+  stopper.join();
+}
@@ -0,0 +1,83 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "rclcpp/inline_function.hpp"
+
+using rclcpp::inline_function::InlineFunction;
+
+/*
+   Tests that small callables are stored inline and survive being moved.
+ */
+TEST(TestInlineFunction, inline_callable) {
+  auto counter = std::make_shared<int>(0);
+  InlineFunction<int(int)> function([counter](int increment) {
+      return *counter += increment;
+    });
+  ASSERT_TRUE(static_cast<bool>(function));
+  EXPECT_TRUE(function.is_inline());
+  EXPECT_EQ(2, function(2));
+
+  InlineFunction<int(int)> moved(std::move(function));
+  EXPECT_FALSE(static_cast<bool>(function));
+  EXPECT_TRUE(moved.is_inline());
+  EXPECT_EQ(5, moved(3));
+  EXPECT_EQ(2, counter.use_count());
+
+  moved = nullptr;
+  EXPECT_FALSE(static_cast<bool>(moved));
+  EXPECT_EQ(1, counter.use_count());
+  EXPECT_THROW(moved(1), std::bad_function_call);
+}
+
+/*
+   Tests that large callables are stored on the heap and released once.
+ */
+TEST(TestInlineFunction, heap_callable) {
+  auto counter = std::make_shared<int>(0);
+  std::array<char, 128> padding{};
+  InlineFunction<void()> function([counter, padding]() {
+      (void)padding;
+      ++*counter;
+    });
+  EXPECT_FALSE(function.is_inline());
+  function();
+
+  InlineFunction<void()> other;
+  other = std::move(function);
+  EXPECT_FALSE(static_cast<bool>(function));
+  other();
+  EXPECT_EQ(2, *counter);
+  EXPECT_EQ(2, counter.use_count());
+  other = nullptr;
+  EXPECT_EQ(1, counter.use_count());
+}
+
+/*
+   Tests that move only arguments are forwarded.
+ */
+TEST(TestInlineFunction, move_only_argument) {
+  int value = 0;
+  InlineFunction<void(std::unique_ptr<int>)> function([&value](std::unique_ptr<int> ptr) {
+      value = *ptr;
+    });
+  function(std::unique_ptr<int>(new int(42)));
+  EXPECT_EQ(42, value);
+}
@@ -0,0 +1,86 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "rclcpp/intra_process_batching.hpp"
+
+using rclcpp::intra_process_batching::NotificationBatcher;
+using rclcpp::intra_process_batching::SequenceTracker;
+using Clock = std::chrono::steady_clock;
+
+/*
+   Tests that without limits every message is notified.
+ */
+TEST(TestIntraProcessBatching, unbatched) {
+  NotificationBatcher batcher;
+  auto now = Clock::now();
+  uint64_t notify_sequence = 0;
+  for (uint64_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(batcher.add(i, now, notify_sequence));
+    EXPECT_EQ(i, notify_sequence);
+  }
+  EXPECT_FALSE(batcher.flush(notify_sequence));
+  EXPECT_THROW(batcher.set_limits(0, std::chrono::seconds(1)), std::invalid_argument);
+}
+
+/*
+   Tests that a batch is complete after max_messages messages or max_delay.
+ */
+TEST(TestIntraProcessBatching, batch_limits) {
+  NotificationBatcher batcher;
+  batcher.set_limits(3, std::chrono::milliseconds(10));
+  EXPECT_EQ(3u, batcher.get_max_messages());
+  auto now = Clock::now();
+  uint64_t notify_sequence = 0;
+  EXPECT_FALSE(batcher.add(0, now, notify_sequence));
+  EXPECT_FALSE(batcher.add(1, now, notify_sequence));
+  EXPECT_TRUE(batcher.add(2, now, notify_sequence));
+  EXPECT_EQ(2u, notify_sequence);
+
+  EXPECT_FALSE(batcher.add(3, now, notify_sequence));
+  EXPECT_TRUE(batcher.add(4, now + std::chrono::milliseconds(10), notify_sequence));
+  EXPECT_EQ(4u, notify_sequence);
+
+  // Sequence numbers added out of order are notified with the last one.
+  EXPECT_FALSE(batcher.add(6, now, notify_sequence));
+  EXPECT_FALSE(batcher.add(5, now, notify_sequence));
+  EXPECT_TRUE(batcher.flush(notify_sequence));
+  EXPECT_EQ(6u, notify_sequence);
+  EXPECT_FALSE(batcher.flush(notify_sequence));
+}
+
+/*
+   Tests the ranges of sequence numbers announced by notifications.
+ */
+TEST(TestIntraProcessBatching, sequence_tracker) {
+  SequenceTracker tracker;
+  // The first notification of a publisher only announces the notified message.
+  EXPECT_EQ(4u, tracker.begin(1, 4, 0));
+  EXPECT_EQ(5u, tracker.begin(1, 5, 0));
+  EXPECT_EQ(6u, tracker.begin(1, 9, 0));
+  // Publishers are tracked separately.
+  EXPECT_EQ(2u, tracker.begin(2, 2, 0));
+  EXPECT_EQ(3u, tracker.begin(2, 3, 0));
+  // Older notifications only announce the notified message.
+  EXPECT_EQ(7u, tracker.begin(1, 7, 0));
+  EXPECT_EQ(10u, tracker.begin(1, 10, 0));
+  // Announcements are limited to max_messages.
+  EXPECT_EQ(16u, tracker.begin(1, 20, 5));
+  tracker.erase(1);
+  EXPECT_EQ(30u, tracker.begin(1, 30, 5));
+}
@@ -12,15 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "allocation_tracking.hpp"
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/macros.hpp"
 #include "rmw/types.h"
 
-// Mock up publisher and subscription base to avoid needing an rmw impl.
+// Mock up publisher, subscription and service base to avoid needing an rmw impl.
 namespace rclcpp
 {
 namespace publisher
@@ -96,7 +103,7 @@ public:
   RCLCPP_SMART_PTR_DEFINITIONS(SubscriptionBase);
 
   SubscriptionBase()
-  : mock_topic_name(""), mock_queue_size(0) {}
+  : mock_topic_name(""), mock_queue_size(0), mock_capacity_waits(0), mock_overwritten(0) {}
 
   const std::string & get_topic_name() const
   {
@@ -107,24 +114,73 @@ public:
     return mock_queue_size;
   }
 
+  void deliver_intra_process_message(uint64_t publisher_id, uint64_t message_sequence)
+  {
+    mock_delivered.emplace_back(publisher_id, message_sequence);
+  }
+
+  void wait_for_intra_process_capacity(std::chrono::steady_clock::time_point)
+  {
+    ++mock_capacity_waits;
+  }
+
+  void on_intra_process_message_overwritten()
+  {
+    ++mock_overwritten;
+  }
+
   std::string mock_topic_name;
   size_t mock_queue_size;
+  std::vector<std::pair<uint64_t, uint64_t>> mock_delivered;
+  size_t mock_capacity_waits;
+  size_t mock_overwritten;
 };
 
 }  // namespace mock
 }  // namespace subscription
 }  // namespace rclcpp
 
-// Prevent rclcpp/publisher.hpp and rclcpp/subscription.hpp from being imported.
+namespace rclcpp
+{
+namespace service
+{
+namespace mock
+{
+
+class ServiceBase
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(ServiceBase);
+
+  ServiceBase()
+  : mock_service_name("") {}
+
+  std::string get_service_name()
+  {
+    return mock_service_name;
+  }
+
+  std::string mock_service_name;
+};
+
+}  // namespace mock
+}  // namespace service
+}  // namespace rclcpp
+
+// Prevent rclcpp/publisher.hpp, rclcpp/subscription.hpp and rclcpp/service.hpp from being
+// imported.
 #define RCLCPP__PUBLISHER_HPP_
 #define RCLCPP__SUBSCRIPTION_HPP_
+#define RCLCPP__SERVICE_HPP_
 #define RCLCPP_BUILDING_LIBRARY 1
 // Force ipm to use our mock publisher class.
 #define Publisher mock::Publisher
 #define PublisherBase mock::PublisherBase
 #define SubscriptionBase mock::SubscriptionBase
+#define ServiceBase mock::ServiceBase
 #include "../src/rclcpp/intra_process_manager.cpp"
 #include "../src/rclcpp/intra_process_manager_impl.cpp"
+#undef ServiceBase
 #undef SubscriptionBase
 #undef Publisher
 #undef PublisherBase
@@ -682,7 +738,7 @@ TEST(TestIntraProcessManager, multiple_publishers_multiple_subscription) {
    - Publish a message on the publisher.
    - Publish another message.
    - Take the second message.
-   - Publish a message.
+   - Publish a message, the first message should be counted as overwritten.
    - Try to take the first message, should fail.
  */
 TEST(TestIntraProcessManager, ring_buffer_displacement) {
@@ -743,6 +799,8 @@ TEST(TestIntraProcessManager, ring_buffer_displacement) {
     EXPECT_EQ(original_message_pointer1, unique_msg.get());
   }
   unique_msg.reset();
+  // The subscription had not taken the displaced message, the one it took does not count.
+  EXPECT_EQ(1u, s1->mock_overwritten);
 
   // Since it just got displaced it should no longer be there to take.
   ipm.take_intra_process_message(p1_id, p1_m1_id, s1_id, unique_msg);
@@ -866,3 +924,410 @@ TEST(TestIntraProcessManager, publisher_out_of_scope_store) {
   EXPECT_THROW(ipm.store_intra_process_message(p1_id, unique_msg), std::runtime_error);
   ASSERT_EQ(nullptr, unique_msg);
 }
+
+/*
+   Tests direct delivery:
+   - Enables direct delivery before anything is added.
+   - Creates a publisher and a matching and a non-matching subscription.
+   - Publishes a message, only the matching subscription should be notified.
+   - Takes the message with the notified id's, should work.
+   - Only the matching subscription is asked to make room for the message.
+   - Changing the delivery after entities were added should throw.
+ */
+TEST(TestIntraProcessManager, direct_delivery) {
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+  ipm.set_direct_delivery(true);
+  EXPECT_TRUE(ipm.get_direct_delivery());
+
+  auto p1 = std::make_shared<
+    rclcpp::publisher::mock::Publisher<rcl_interfaces::msg::IntraProcessMessage>
+    >();
+  p1->mock_topic_name = "nominal1";
+  p1->mock_queue_size = 2;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "nominal1";
+  s1->mock_queue_size = 10;
+
+  auto s2 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s2->mock_topic_name = "nominal2";
+  s2->mock_queue_size = 10;
+
+  auto p1_id =
+    ipm.add_publisher<rcl_interfaces::msg::IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+  ipm.add_subscription(s2);
+
+  EXPECT_THROW(ipm.set_direct_delivery(false), std::runtime_error);
+
+  rcl_interfaces::msg::IntraProcessMessage::UniquePtr unique_msg(
+    new rcl_interfaces::msg::IntraProcessMessage());
+  unique_msg->message_sequence = 42;
+  auto p1_m1_id = ipm.store_intra_process_message(p1_id, unique_msg);
+  ASSERT_EQ(nullptr, unique_msg);
+
+  // Only the subscriptions on the topic are asked for room before the message is stored.
+  EXPECT_EQ(1u, s1->mock_capacity_waits);
+  EXPECT_EQ(0u, s2->mock_capacity_waits);
+  ASSERT_EQ(1u, s1->mock_delivered.size());
+  EXPECT_EQ(p1_id, s1->mock_delivered[0].first);
+  EXPECT_EQ(p1_m1_id, s1->mock_delivered[0].second);
+  EXPECT_TRUE(s2->mock_delivered.empty());
+
+  ipm.take_intra_process_message(
+    s1->mock_delivered[0].first, s1->mock_delivered[0].second, s1_id, unique_msg);
+  ASSERT_NE(nullptr, unique_msg);
+  EXPECT_EQ(42ul, unique_msg->message_sequence);
+}
+
+/*
+   Tests the service registry:
+   - Looking up a service which was never added gives nullptr.
+   - An added service can be looked up by its name, others are not affected.
+   - A later service with the same name replaces the earlier one.
+   - A destroyed service is not returned anymore.
+ */
+TEST(TestIntraProcessManager, services) {
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  EXPECT_EQ(nullptr, ipm.get_service("service1"));
+
+  auto sv1 = std::make_shared<rclcpp::service::mock::ServiceBase>();
+  sv1->mock_service_name = "service1";
+  auto sv2 = std::make_shared<rclcpp::service::mock::ServiceBase>();
+  sv2->mock_service_name = "service2";
+
+  ipm.add_service(sv1);
+  ipm.add_service(sv2);
+  EXPECT_EQ(sv1, ipm.get_service("service1"));
+  EXPECT_EQ(sv2, ipm.get_service("service2"));
+
+  auto sv3 = std::make_shared<rclcpp::service::mock::ServiceBase>();
+  sv3->mock_service_name = "service1";
+  ipm.add_service(sv3);
+  EXPECT_EQ(sv3, ipm.get_service("service1"));
+
+  sv3.reset();
+  EXPECT_EQ(nullptr, ipm.get_service("service1"));
+  EXPECT_EQ(sv2, ipm.get_service("service2"));
+}
+
+/*
+   Tests taking messages with a filter:
+   - Creates a publisher and two subscriptions on the same topic.
+   - A message rejected by the first subscription's filter is handed to the second without a copy.
+   - A message rejected by the last subscription's filter is released.
+ */
+TEST(TestIntraProcessManager, filtered_take) {
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  auto p1 = std::make_shared<
+    rclcpp::publisher::mock::Publisher<rcl_interfaces::msg::IntraProcessMessage>
+    >();
+  p1->mock_topic_name = "nominal1";
+  p1->mock_queue_size = 10;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "nominal1";
+  s1->mock_queue_size = 10;
+
+  auto s2 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s2->mock_topic_name = "nominal1";
+  s2->mock_queue_size = 10;
+
+  auto p1_id =
+    ipm.add_publisher<rcl_interfaces::msg::IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+  auto s2_id = ipm.add_subscription(s2);
+
+  size_t filter_calls = 0;
+  std::function<bool(const rcl_interfaces::msg::IntraProcessMessage &)> accept_even =
+    [&filter_calls](const rcl_interfaces::msg::IntraProcessMessage & msg) {
+      ++filter_calls;
+      return msg.message_sequence % 2 == 0;
+    };
+
+  rcl_interfaces::msg::IntraProcessMessage::UniquePtr unique_msg(
+    new rcl_interfaces::msg::IntraProcessMessage());
+  unique_msg->message_sequence = 43;
+  auto original_address = unique_msg.get();
+  auto m1_id = ipm.store_intra_process_message(p1_id, unique_msg);
+
+  ipm.take_intra_process_message(p1_id, m1_id, s1_id, unique_msg, accept_even);
+  EXPECT_EQ(nullptr, unique_msg);
+  EXPECT_EQ(1u, filter_calls);
+  ipm.take_intra_process_message(p1_id, m1_id, s2_id, unique_msg);
+  ASSERT_NE(nullptr, unique_msg);
+  EXPECT_EQ(original_address, unique_msg.get());
+
+  unique_msg->message_sequence = 45;
+  auto m2_id = ipm.store_intra_process_message(p1_id, unique_msg);
+  ipm.take_intra_process_message(p1_id, m2_id, s1_id, unique_msg);
+  ASSERT_NE(nullptr, unique_msg);
+  EXPECT_NE(original_address, unique_msg.get());
+  unique_msg.reset();
+  ipm.take_intra_process_message(p1_id, m2_id, s2_id, unique_msg, accept_even);
+  EXPECT_EQ(nullptr, unique_msg);
+  EXPECT_EQ(2u, filter_calls);
+  // Taking again fails, so the message is gone.
+  ipm.take_intra_process_message(p1_id, m2_id, s2_id, unique_msg);
+  EXPECT_EQ(nullptr, unique_msg);
+}
+
+/*
+   Tests skipping messages without taking them:
+   - Skipping by one of two subscriptions leaves the message to the other one, uncopied.
+   - Skipping by the last subscription releases the message.
+ */
+TEST(TestIntraProcessManager, skip) {
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  auto p1 = std::make_shared<
+    rclcpp::publisher::mock::Publisher<rcl_interfaces::msg::IntraProcessMessage>
+    >();
+  p1->mock_topic_name = "nominal1";
+  p1->mock_queue_size = 10;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "nominal1";
+  s1->mock_queue_size = 10;
+
+  auto s2 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s2->mock_topic_name = "nominal1";
+  s2->mock_queue_size = 10;
+
+  auto p1_id =
+    ipm.add_publisher<rcl_interfaces::msg::IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+  auto s2_id = ipm.add_subscription(s2);
+
+  rcl_interfaces::msg::IntraProcessMessage::UniquePtr unique_msg(
+    new rcl_interfaces::msg::IntraProcessMessage());
+  unique_msg->message_sequence = 43;
+  auto original_address = unique_msg.get();
+  auto m1_id = ipm.store_intra_process_message(p1_id, unique_msg);
+
+  ipm.skip_intra_process_message<rcl_interfaces::msg::IntraProcessMessage>(p1_id, m1_id, s1_id);
+  // The message was taken by s1, so it cannot be taken by it again.
+  ipm.take_intra_process_message(p1_id, m1_id, s1_id, unique_msg);
+  EXPECT_EQ(nullptr, unique_msg);
+  ipm.take_intra_process_message(p1_id, m1_id, s2_id, unique_msg);
+  ASSERT_NE(nullptr, unique_msg);
+  EXPECT_EQ(original_address, unique_msg.get());
+
+  auto m2_id = ipm.store_intra_process_message(p1_id, unique_msg);
+  std::shared_ptr<const rcl_interfaces::msg::IntraProcessMessage> shared_msg;
+  ipm.take_intra_process_message(p1_id, m2_id, s1_id, shared_msg);
+  ASSERT_NE(nullptr, shared_msg);
+  EXPECT_LT(1, shared_msg.use_count());
+  ipm.skip_intra_process_message<rcl_interfaces::msg::IntraProcessMessage>(p1_id, m2_id, s2_id);
+  // The last subscription skipped it, so the manager released the message.
+  EXPECT_EQ(1, shared_msg.use_count());
+}
+
+/*
+   Tests the lifespan of a publisher's messages:
+   - Stores messages, one of which is taken before it expires.
+   - Asserts that a later store releases the expired message which was not taken.
+   - Asserts that evict_expired_messages releases expired messages without a store.
+   - Asserts that expired messages cannot be taken, and that evictions are counted.
+ */
+TEST(TestIntraProcessManager, lifespan) {
+  using IntraProcessMessage = rcl_interfaces::msg::IntraProcessMessage;
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  auto p1 = std::make_shared<rclcpp::publisher::mock::Publisher<IntraProcessMessage>>();
+  p1->mock_topic_name = "nominal1";
+  p1->mock_queue_size = 10;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "nominal1";
+  s1->mock_queue_size = 10;
+
+  auto p1_id = ipm.add_publisher<IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+  EXPECT_THROW(ipm.set_lifespan(p1_id, std::chrono::milliseconds(-1)), std::invalid_argument);
+  EXPECT_THROW(ipm.set_lifespan(p1_id + 1000, std::chrono::milliseconds(1)), std::runtime_error);
+  ipm.set_lifespan(p1_id, std::chrono::milliseconds(20));
+
+  auto taken = std::make_shared<const IntraProcessMessage>();
+  auto m1_id = ipm.store_intra_process_message<IntraProcessMessage>(p1_id, taken);
+  auto stale = std::make_shared<const IntraProcessMessage>();
+  auto m2_id = ipm.store_intra_process_message<IntraProcessMessage>(p1_id, stale);
+  std::shared_ptr<const IntraProcessMessage> shared_msg;
+  ipm.take_intra_process_message(p1_id, m1_id, s1_id, shared_msg);
+  EXPECT_EQ(taken, shared_msg);
+  EXPECT_EQ(2, stale.use_count());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  auto fresh = std::make_shared<const IntraProcessMessage>();
+  auto m3_id = ipm.store_intra_process_message<IntraProcessMessage>(p1_id, fresh);
+  // The stale message was released by the store, not when it would have been displaced.
+  EXPECT_EQ(1, stale.use_count());
+  EXPECT_EQ(1u, ipm.get_evicted_count(p1_id));
+  ipm.take_intra_process_message(p1_id, m2_id, s1_id, shared_msg);
+  EXPECT_EQ(nullptr, shared_msg);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  EXPECT_EQ(2, fresh.use_count());
+  ipm.evict_expired_messages();
+  EXPECT_EQ(1, fresh.use_count());
+  EXPECT_EQ(2u, ipm.get_evicted_count(p1_id));
+  ipm.take_intra_process_message(p1_id, m3_id, s1_id, shared_msg);
+  EXPECT_EQ(nullptr, shared_msg);
+
+  // Without a lifespan, messages are kept until they are taken.
+  ipm.set_lifespan(p1_id, std::chrono::nanoseconds::zero());
+  auto m4_id = ipm.store_intra_process_message<IntraProcessMessage>(p1_id, fresh);
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  ipm.evict_expired_messages();
+  ipm.take_intra_process_message(p1_id, m4_id, s1_id, shared_msg);
+  EXPECT_EQ(fresh, shared_msg);
+  EXPECT_EQ(2u, ipm.get_evicted_count(p1_id));
+}
+
+/*
+   Tests that removing the last subscription which was to take a message releases it.
+ */
+TEST(TestIntraProcessManager, removed_subscription_releases_message) {
+  using IntraProcessMessage = rcl_interfaces::msg::IntraProcessMessage;
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  auto p1 = std::make_shared<rclcpp::publisher::mock::Publisher<IntraProcessMessage>>();
+  p1->mock_topic_name = "nominal1";
+  p1->mock_queue_size = 10;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "nominal1";
+  s1->mock_queue_size = 10;
+
+  auto s2 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s2->mock_topic_name = "nominal1";
+  s2->mock_queue_size = 10;
+
+  auto p1_id = ipm.add_publisher<IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+  auto s2_id = ipm.add_subscription(s2);
+
+  auto message = std::make_shared<const IntraProcessMessage>();
+  auto m1_id = ipm.store_intra_process_message<IntraProcessMessage>(p1_id, message);
+  std::shared_ptr<const IntraProcessMessage> shared_msg;
+  ipm.take_intra_process_message(p1_id, m1_id, s1_id, shared_msg);
+  EXPECT_EQ(message, shared_msg);
+  shared_msg.reset();
+  EXPECT_EQ(2, message.use_count());
+
+  ipm.remove_subscription(s2_id);
+  EXPECT_EQ(1, message.use_count());
+  EXPECT_EQ(1u, ipm.get_evicted_count(p1_id));
+}
+
+/*
+   Tests that a steady state of storing and taking messages does not allocate:
+   - Creates a publisher and two subscriptions, one taking unique messages and one shared ones.
+   - Warms the manager up, then stores and takes messages which are reused.
+   - Asserts that neither store_intra_process_message nor take_intra_process_message allocated.
+ */
+TEST(TestIntraProcessManager, steady_state_does_not_allocate) {
+  using rcl_interfaces::msg::IntraProcessMessage;
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+
+  auto p1 = std::make_shared<rclcpp::publisher::mock::Publisher<IntraProcessMessage>>();
+  p1->mock_topic_name = "steady";
+  p1->mock_queue_size = 4;
+
+  auto s1 = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+  s1->mock_topic_name = "steady";
+  s1->mock_queue_size = 4;
+
+  auto p1_id = ipm.add_publisher<IntraProcessMessage, std::allocator<void>>(p1);
+  auto s1_id = ipm.add_subscription(s1);
+
+  IntraProcessMessage::UniquePtr unique_msg(new IntraProcessMessage());
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      allocation_tracking::start();
+    }
+    for (uint64_t i = 0; i < 100; ++i) {
+      unique_msg->message_sequence = i;
+      uint64_t message_id;
+      {
+        allocation_tracking::ScopedRegion region("store_intra_process_message");
+        message_id = ipm.store_intra_process_message(p1_id, unique_msg);
+      }
+      ASSERT_EQ(nullptr, unique_msg);
+      {
+        allocation_tracking::ScopedRegion region("take_intra_process_message");
+        ipm.take_intra_process_message(p1_id, message_id, s1_id, unique_msg);
+      }
+      ASSERT_NE(nullptr, unique_msg);
+      EXPECT_EQ(i, unique_msg->message_sequence);
+    }
+  }
+  allocation_tracking::stop();
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("store_intra_process_message")) <<
+    allocation_tracking::get_report();
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("take_intra_process_message")) <<
+    allocation_tracking::get_report();
+}
+
+/*
+   Tests that a steady state of storing and taking shared messages does not allocate, including
+   with direct delivery, where each subscription is notified of each message.
+ */
+TEST(TestIntraProcessManager, steady_state_shared_does_not_allocate) {
+  using rcl_interfaces::msg::IntraProcessMessage;
+  rclcpp::intra_process_manager::IntraProcessManager ipm;
+  ipm.set_direct_delivery(true);
+
+  auto p1 = std::make_shared<rclcpp::publisher::mock::Publisher<IntraProcessMessage>>();
+  p1->mock_topic_name = "steady";
+  p1->mock_queue_size = 4;
+
+  std::vector<rclcpp::subscription::mock::SubscriptionBase::SharedPtr> subscriptions;
+  std::vector<uint64_t> subscription_ids;
+  for (size_t i = 0; i < 2; ++i) {
+    auto subscription = std::make_shared<rclcpp::subscription::mock::SubscriptionBase>();
+    subscription->mock_topic_name = "steady";
+    subscription->mock_queue_size = 4;
+    // The mock records deliveries in a vector, which must not grow while tracking.
+    subscription->mock_delivered.reserve(1);
+    subscription_ids.push_back(ipm.add_subscription(subscription));
+    subscriptions.push_back(subscription);
+  }
+  auto p1_id = ipm.add_publisher<IntraProcessMessage, std::allocator<void>>(p1);
+
+  std::vector<std::shared_ptr<const IntraProcessMessage>> messages;
+  for (size_t i = 0; i < 8; ++i) {
+    messages.push_back(std::make_shared<IntraProcessMessage>());
+  }
+  std::shared_ptr<const IntraProcessMessage> taken;
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      allocation_tracking::start();
+    }
+    for (uint64_t i = 0; i < 100; ++i) {
+      const auto & message = messages[i % messages.size()];
+      {
+        allocation_tracking::ScopedRegion region("store_intra_process_message");
+        ipm.store_intra_process_message<IntraProcessMessage>(p1_id, message);
+      }
+      for (size_t j = 0; j < subscriptions.size(); ++j) {
+        ASSERT_EQ(1u, subscriptions[j]->mock_delivered.size());
+        uint64_t message_id = subscriptions[j]->mock_delivered[0].second;
+        subscriptions[j]->mock_delivered.clear();
+        {
+          allocation_tracking::ScopedRegion region("take_intra_process_message");
+          ipm.take_intra_process_message(p1_id, message_id, subscription_ids[j], taken);
+        }
+        EXPECT_EQ(message, taken);
+        taken.reset();
+      }
+    }
+  }
+  allocation_tracking::stop();
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("store_intra_process_message")) <<
+    allocation_tracking::get_report();
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("take_intra_process_message")) <<
+    allocation_tracking::get_report();
+}
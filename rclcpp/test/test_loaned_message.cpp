@@ -0,0 +1,72 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#define RCLCPP_BUILDING_LIBRARY 1  // Prevent including unavailable symbols
+#include <rclcpp/loaned_message.hpp>
+
+using rclcpp::loaned_message::LoanedMessage;
+using rclcpp::loaned_message::LoanedMessagePool;
+
+/*
+   Tests that messages are recycled once all references to them are gone.
+ */
+TEST(TestLoanedMessage, recycle) {
+  EXPECT_THROW(LoanedMessagePool<std::vector<int>> pool(0), std::invalid_argument);
+  LoanedMessagePool<std::vector<int>> pool(2);
+
+  auto first = pool.borrow_message();
+  ASSERT_TRUE(static_cast<bool>(first));
+  first->push_back(42);
+  std::vector<int> * first_ptr = first.get();
+
+  auto second = pool.borrow_message();
+  EXPECT_NE(first_ptr, second.get());
+
+  // Releasing the loan keeps the message in use while it is referenced, e.g. by subscriptions.
+  std::shared_ptr<const std::vector<int>> shared = first.release();
+  EXPECT_FALSE(static_cast<bool>(first));
+  EXPECT_EQ(first_ptr, shared.get());
+
+  // All messages are in use, so the pool grows.
+  auto third = pool.borrow_message();
+  EXPECT_EQ(3u, pool.size());
+  EXPECT_NE(first_ptr, third.get());
+
+  // Once the last reference is gone the message is handed out again, with its contents.
+  shared.reset();
+  auto recycled = pool.borrow_message();
+  EXPECT_EQ(first_ptr, recycled.get());
+  ASSERT_EQ(1u, recycled->size());
+  EXPECT_EQ(42, (*recycled)[0]);
+  EXPECT_EQ(3u, pool.size());
+}
+
+/*
+   Tests that a loan can be moved.
+ */
+TEST(TestLoanedMessage, move) {
+  LoanedMessagePool<int> pool(1);
+  auto loaned = pool.borrow_message();
+  int * ptr = loaned.get();
+  LoanedMessage<int> moved(std::move(loaned));
+  EXPECT_FALSE(static_cast<bool>(loaned));
+  EXPECT_EQ(ptr, moved.get());
+  *moved = 3;
+  EXPECT_EQ(3, *moved);
+}
@@ -0,0 +1,134 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "rcl_interfaces/msg/intra_process_message.hpp"
+#include "rclcpp/strategies/lock_free_message_pool_memory_strategy.hpp"
+
+using rclcpp::strategies::message_pool_memory_strategy::LockFreeMessagePoolMemoryStrategy;
+using rclcpp::strategies::message_pool_memory_strategy::PoolExhaustedPolicy;
+using Message = rcl_interfaces::msg::IntraProcessMessage;
+
+/*
+   Tests that returned messages are reused, and are fresh when borrowed again.
+ */
+TEST(TestLockFreeMessagePoolMemoryStrategy, recycle) {
+  LockFreeMessagePoolMemoryStrategy<Message, 1> strategy;
+  auto message = strategy.borrow_message();
+  Message * address = message.get();
+  message->message_sequence = 42;
+  strategy.return_message(message);
+  EXPECT_EQ(nullptr, message);
+
+  message = strategy.borrow_message();
+  EXPECT_EQ(address, message.get());
+  EXPECT_EQ(0u, message->message_sequence);
+  EXPECT_EQ(1u, strategy.get_capacity());
+}
+
+/*
+   Tests that a message which is still referenced elsewhere is not reused, and that the pool
+   grows instead.
+ */
+TEST(TestLockFreeMessagePoolMemoryStrategy, grow) {
+  LockFreeMessagePoolMemoryStrategy<Message, 2> strategy(PoolExhaustedPolicy::Grow);
+  auto message1 = strategy.borrow_message();
+  auto kept = message1;
+  strategy.return_message(message1);
+  auto message2 = strategy.borrow_message();
+  auto message3 = strategy.borrow_message();
+  EXPECT_NE(kept.get(), message2.get());
+  EXPECT_NE(kept.get(), message3.get());
+  EXPECT_NE(message2.get(), message3.get());
+  // 2 + 4 messages.
+  EXPECT_EQ(6u, strategy.get_capacity());
+
+  Message * address = kept.get();
+  kept.reset();
+  std::vector<std::shared_ptr<Message>> messages;
+  bool reused = false;
+  for (size_t i = 0; i < 4; ++i) {
+    messages.push_back(strategy.borrow_message());
+    reused = reused || messages.back().get() == address;
+  }
+  EXPECT_TRUE(reused);
+  EXPECT_EQ(6u, strategy.get_capacity());
+}
+
+/*
+   Tests that borrowing from an exhausted blocking pool waits for a message to be released.
+ */
+TEST(TestLockFreeMessagePoolMemoryStrategy, block) {
+  LockFreeMessagePoolMemoryStrategy<Message, 1> strategy(PoolExhaustedPolicy::Block);
+  auto message = strategy.borrow_message();
+  Message * address = message.get();
+  std::atomic<bool> borrowed(false);
+  std::thread borrower([&strategy, &borrowed, address]() {
+      auto other = strategy.borrow_message();
+      EXPECT_EQ(address, other.get());
+      borrowed.store(true);
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(borrowed.load());
+  strategy.return_message(message);
+  borrower.join();
+  EXPECT_TRUE(borrowed.load());
+  EXPECT_EQ(1u, strategy.get_capacity());
+}
+
+/*
+   Tests that messages outlive the strategy they were borrowed from.
+ */
+TEST(TestLockFreeMessagePoolMemoryStrategy, outlive_strategy) {
+  std::shared_ptr<Message> message;
+  {
+    LockFreeMessagePoolMemoryStrategy<Message, 1> strategy;
+    message = strategy.borrow_message();
+  }
+  message->message_sequence = 1;
+  message.reset();
+}
+
+/*
+   Tests that threads can borrow and return concurrently without sharing a message.
+ */
+TEST(TestLockFreeMessagePoolMemoryStrategy, concurrent) {
+  LockFreeMessagePoolMemoryStrategy<Message, 4> strategy(PoolExhaustedPolicy::Block);
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < 8; ++t) {
+    threads.emplace_back([&strategy, t]() {
+        for (uint64_t i = 0; i < 10000; ++i) {
+          auto message = strategy.borrow_message();
+          EXPECT_EQ(0u, message->publisher_id);
+          message->publisher_id = t + 1;
+          message->message_sequence = i;
+          std::this_thread::yield();
+          EXPECT_EQ(t + 1, message->publisher_id);
+          EXPECT_EQ(i, message->message_sequence);
+          strategy.return_message(message);
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(4u, strategy.get_capacity());
+}
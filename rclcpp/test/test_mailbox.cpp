@@ -0,0 +1,78 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "rclcpp/mailbox.hpp"
+
+using rclcpp::mailbox::Mailbox;
+
+struct State
+{
+  uint64_t stamp;
+  uint64_t stamp_copy;
+};
+
+/*
+   Tests that only the latest message is kept, and that readers keep the messages they got.
+ */
+TEST(TestMailbox, latest) {
+  auto mailbox = Mailbox<State>::make_shared();
+  EXPECT_EQ(nullptr, mailbox->get());
+  EXPECT_EQ(0u, mailbox->get_count());
+
+  mailbox->put(std::make_shared<State>(State {1, 1}));
+  auto first = mailbox->get();
+  mailbox->put(std::make_shared<State>(State {2, 2}));
+  mailbox->put(std::make_shared<State>(State {3, 3}));
+
+  EXPECT_EQ(3u, mailbox->get_count());
+  EXPECT_EQ(3u, mailbox->get()->stamp);
+  ASSERT_NE(nullptr, first);
+  EXPECT_EQ(1u, first->stamp);
+}
+
+/*
+   Tests that a reader racing with a writer only sees whole messages, never going back in time.
+ */
+TEST(TestMailbox, concurrent) {
+  Mailbox<State> mailbox;
+  const uint64_t messages = 10000;
+  std::thread writer([&mailbox, messages]() {
+      for (uint64_t i = 1; i <= messages; ++i) {
+        mailbox.put(std::make_shared<State>(State {i, i}));
+      }
+    });
+  uint64_t last = 0;
+  while (last < messages) {
+    auto state = mailbox.get();
+    if (!state) {
+      continue;
+    }
+    // Not ASSERT, which would return while the writer thread is still joinable.
+    EXPECT_EQ(state->stamp, state->stamp_copy);
+    EXPECT_GE(state->stamp, last);
+    if (state->stamp != state->stamp_copy || state->stamp < last) {
+      break;
+    }
+    last = state->stamp;
+  }
+  writer.join();
+  EXPECT_EQ(messages, mailbox.get_count());
+}
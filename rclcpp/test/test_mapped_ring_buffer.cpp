@@ -14,6 +14,8 @@
 
 #include <gtest/gtest.h>
 
+#include <memory>
+
 #define RCLCPP_BUILDING_LIBRARY 1  // Prevent including unavailable symbols
 #include <rclcpp/mapped_ring_buffer.hpp>
 
@@ -171,3 +173,200 @@ TEST(TestMappedRingBuffer, non_unique_keys) {
     EXPECT_EQ('b', *actual);
   }
 }
+
+/*
+   Tests sharing a stored value:
+   - Shared readers get the original instance, without a copy.
+   - A reader needing ownership gets a copy of the shared value.
+   - Popping a shared value removes it from the buffer.
+ */
+TEST(TestMappedRingBuffer, shared_values) {
+  rclcpp::mapped_ring_buffer::MappedRingBuffer<char> mrb(2);
+  std::unique_ptr<char> expected(new char('a'));
+  char * expected_orig = expected.get();
+  EXPECT_FALSE(mrb.push_and_replace(1, expected));
+
+  std::shared_ptr<const char> shared;
+  mrb.get_shared_at_key(1, shared);
+  ASSERT_NE(nullptr, shared);
+  EXPECT_EQ(expected_orig, shared.get());
+
+  std::shared_ptr<const char> shared_again;
+  mrb.get_shared_at_key(1, shared_again);
+  EXPECT_EQ(shared.get(), shared_again.get());
+
+  std::unique_ptr<char> actual;
+  mrb.pop_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ('a', *actual);
+  EXPECT_NE(expected_orig, actual.get());
+  EXPECT_FALSE(mrb.has_key(1));
+
+  // A value pushed as shared is handed out as is.
+  std::shared_ptr<const char> pushed(new char('b'));
+  EXPECT_FALSE(mrb.push_and_replace(2, pushed));
+  mrb.pop_shared_at_key(2, shared);
+  EXPECT_EQ(pushed.get(), shared.get());
+  mrb.get_shared_at_key(2, shared);
+  EXPECT_EQ(nullptr, shared);
+}
+
+/*
+   Tests applying a predicate to stored values without taking them.
+ */
+TEST(TestMappedRingBuffer, test_at_key) {
+  rclcpp::mapped_ring_buffer::MappedRingBuffer<char> mrb(2);
+  auto is_a = [](const char & value) {return value == 'a';};
+  EXPECT_FALSE(mrb.test_at_key(1, is_a));
+
+  std::unique_ptr<char> unique(new char('a'));
+  char * unique_orig = unique.get();
+  mrb.push_and_replace(1, unique);
+  std::shared_ptr<const char> pushed(new char('b'));
+  mrb.push_and_replace(2, pushed);
+  EXPECT_TRUE(mrb.test_at_key(1, is_a));
+  EXPECT_FALSE(mrb.test_at_key(2, is_a));
+  EXPECT_TRUE(mrb.test_at_key(2, [](const char & value) {return value == 'b';}));
+
+  // Testing neither copied nor took the value.
+  std::unique_ptr<char> actual;
+  mrb.pop_at_key(1, actual);
+  EXPECT_EQ(unique_orig, actual.get());
+  EXPECT_FALSE(mrb.test_at_key(1, is_a));
+}
+
+/*
+   Tests releasing stored values without returning them.
+ */
+TEST(TestMappedRingBuffer, remove_at_key) {
+  rclcpp::mapped_ring_buffer::MappedRingBuffer<char> mrb(2);
+  EXPECT_FALSE(mrb.remove_at_key(1));
+
+  std::unique_ptr<char> unique(new char('a'));
+  mrb.push_and_replace(1, unique);
+  std::shared_ptr<const char> pushed(new char('b'));
+  mrb.push_and_replace(2, pushed);
+  std::shared_ptr<const char> shared;
+  mrb.get_shared_at_key(2, shared);
+
+  EXPECT_TRUE(mrb.remove_at_key(1));
+  EXPECT_FALSE(mrb.has_key(1));
+  EXPECT_FALSE(mrb.remove_at_key(1));
+  EXPECT_TRUE(mrb.remove_at_key(2));
+  EXPECT_FALSE(mrb.has_key(2));
+  // Shared references handed out before stay valid, the buffer only dropped its own.
+  EXPECT_EQ('b', *shared);
+  pushed.reset();
+  EXPECT_EQ(1, shared.use_count());
+}
+
+/*
+   Tests the sequential key mode, where a key is stored in slot key % size.
+ */
+TEST(TestMappedRingBuffer, sequential_keys) {
+  using rclcpp::mapped_ring_buffer::MappedRingBufferKeyMode;
+  rclcpp::mapped_ring_buffer::MappedRingBuffer<char> mrb(
+    3, nullptr, MappedRingBufferKeyMode::Sequential);
+  for (uint64_t key = 0; key < 5; ++key) {
+    std::unique_ptr<char> value(new char('a' + key));
+    EXPECT_EQ(key >= 3, mrb.push_and_replace(key, value));
+  }
+  // Only the three most recent keys are left.
+  EXPECT_FALSE(mrb.has_key(0));
+  EXPECT_FALSE(mrb.has_key(1));
+  std::unique_ptr<char> actual;
+  for (uint64_t key = 2; key < 5; ++key) {
+    mrb.pop_at_key(key, actual);
+    ASSERT_NE(nullptr, actual);
+    EXPECT_EQ('a' + key, *actual);
+    EXPECT_FALSE(mrb.has_key(key));
+  }
+  // A key sharing a slot with a stored one is not matched.
+  mrb.push_and_replace(6, std::unique_ptr<char>(new char('g')));
+  EXPECT_FALSE(mrb.has_key(3));
+  mrb.get_copy_at_key(3, actual);
+  EXPECT_EQ(nullptr, actual);
+  EXPECT_TRUE(mrb.has_key(6));
+}
+
+/// Numbers of allocations and deallocations made through a TrackingAllocator and its copies.
+struct AllocationCounts
+{
+  size_t allocations = 0;
+  size_t deallocations = 0;
+};
+
+template<typename T>
+struct TrackingAllocator : public std::allocator<T>
+{
+  template<typename U>
+  struct rebind
+  {
+    typedef TrackingAllocator<U> other;
+  };
+
+  // A default constructed allocator does not count.
+  TrackingAllocator() = default;
+
+  explicit TrackingAllocator(std::shared_ptr<AllocationCounts> counts)
+  : counts(counts)
+  {}
+
+  template<typename U>
+  TrackingAllocator(const TrackingAllocator<U> & other)  // NOLINT(runtime/explicit)
+  : counts(other.counts)
+  {}
+
+  T * allocate(size_t n)
+  {
+    if (counts) {
+      ++counts->allocations;
+    }
+    return std::allocator<T>::allocate(n);
+  }
+
+  void deallocate(T * ptr, size_t n)
+  {
+    if (counts) {
+      ++counts->deallocations;
+    }
+    std::allocator<T>::deallocate(ptr, n);
+  }
+
+  std::shared_ptr<AllocationCounts> counts;
+};
+
+/*
+   Tests that the deleter of a value is kept, and that copies get one for the buffer's allocator.
+ */
+TEST(TestMappedRingBuffer, deleters) {
+  using MRB = rclcpp::mapped_ring_buffer::MappedRingBuffer<char, TrackingAllocator<void>>;
+  auto buffer_counts = std::make_shared<AllocationCounts>();
+  auto allocator = std::make_shared<TrackingAllocator<void>>(buffer_counts);
+  MRB mrb(2, allocator);
+
+  auto value_counts = std::make_shared<AllocationCounts>();
+  TrackingAllocator<char> value_allocator(value_counts);
+  MRB::ElemDeleter deleter(&value_allocator);
+  char * ptr = value_allocator.allocate(1);
+  *ptr = 'a';
+  MRB::ElemUniquePtr value(ptr, deleter);
+  mrb.push_and_replace(1, value);
+
+  // The copy comes from the buffer's allocator and goes back to it.
+  MRB::ElemUniquePtr actual;
+  mrb.get_copy_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ(1u, buffer_counts->allocations);
+  actual.reset();
+  EXPECT_EQ(1u, buffer_counts->deallocations);
+
+  // The stored value goes back to the allocator it came from.
+  mrb.pop_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ(&value_allocator, actual.get_deleter().get_allocator());
+  actual.reset();
+  EXPECT_EQ(1u, value_counts->allocations);
+  EXPECT_EQ(1u, value_counts->deallocations);
+  EXPECT_EQ(1u, buffer_counts->allocations);
+}
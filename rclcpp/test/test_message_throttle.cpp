@@ -0,0 +1,78 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "rclcpp/message_throttle.hpp"
+
+using rclcpp::message_throttle::MessageThrottle;
+using std::chrono::milliseconds;
+
+/*
+   Tests that all messages are kept by default, and that invalid limits are rejected.
+ */
+TEST(TestMessageThrottle, defaults) {
+  MessageThrottle throttle;
+  EXPECT_FALSE(throttle.is_enabled());
+  auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(throttle.accept(now));
+  }
+  EXPECT_THROW(throttle.set_limits(milliseconds(-1), 1), std::invalid_argument);
+  EXPECT_THROW(throttle.set_limits(milliseconds(0), 0), std::invalid_argument);
+  EXPECT_FALSE(throttle.is_enabled());
+}
+
+/*
+   Tests keeping every nth message, starting with the first one.
+ */
+TEST(TestMessageThrottle, keep_every) {
+  MessageThrottle throttle;
+  throttle.set_limits(milliseconds(0), 3);
+  EXPECT_TRUE(throttle.is_enabled());
+  auto now = std::chrono::steady_clock::now();
+  size_t kept = 0;
+  for (int i = 0; i < 9; ++i) {
+    bool accepted = throttle.accept(now);
+    EXPECT_EQ(i % 3 == 0, accepted);
+    kept += accepted ? 1 : 0;
+  }
+  EXPECT_EQ(3u, kept);
+}
+
+/*
+   Tests the minimum period, alone and combined with keeping every nth message.
+ */
+TEST(TestMessageThrottle, min_period) {
+  MessageThrottle throttle;
+  throttle.set_limits(milliseconds(200), 1);
+  auto start = std::chrono::steady_clock::now();
+  // A 1 kHz stream limited to 5 Hz.
+  size_t kept = 0;
+  for (int i = 0; i < 1000; ++i) {
+    kept += throttle.accept(start + milliseconds(i)) ? 1 : 0;
+  }
+  EXPECT_EQ(5u, kept);
+
+  // Setting the limits starts over.
+  throttle.set_limits(milliseconds(10), 2);
+  EXPECT_TRUE(throttle.accept(start));
+  EXPECT_FALSE(throttle.accept(start + milliseconds(20)));
+  EXPECT_TRUE(throttle.accept(start + milliseconds(20)));
+  EXPECT_FALSE(throttle.accept(start + milliseconds(40)));
+  EXPECT_FALSE(throttle.accept(start + milliseconds(25)));
+}
@@ -0,0 +1,89 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "rcl_interfaces/srv/list_parameters.hpp"
+#include "rclcpp/client.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/parameter_client.hpp"
+#include "rclcpp/utilities.hpp"
+
+using rclcpp::parameter_client::AsyncParametersClient;
+
+class TestParameterClient : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase()
+  {
+    rclcpp::utilities::init(0, nullptr);
+  }
+
+  void SetUp()
+  {
+    node = rclcpp::node::Node::make_shared("test_parameter_client");
+  }
+
+  /// Find the list_parameters client the parameter client created on the node.
+  rclcpp::client::Client<rcl_interfaces::srv::ListParameters>::SharedPtr
+  find_list_parameters_client()
+  {
+    for (auto & weak_group : node->get_callback_groups()) {
+      auto group = weak_group.lock();
+      if (!group) {
+        continue;
+      }
+      for (auto & weak_client : group->get_client_ptrs()) {
+        auto client = std::dynamic_pointer_cast<
+          rclcpp::client::Client<rcl_interfaces::srv::ListParameters>>(weak_client.lock());
+        if (client) {
+          return client;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  rclcpp::node::Node::SharedPtr node;
+};
+
+/*
+   Tests that a failed seed request fails the future of the cache instead of leaving it pending.
+ */
+TEST_F(TestParameterClient, failed_seed_fails_cache_future) {
+  // Nothing offers the parameter services of this remote node, so the seed request times out.
+  auto parameters_client = std::make_shared<AsyncParametersClient>(node, "missing_node");
+  auto list_client = find_list_parameters_client();
+  ASSERT_NE(nullptr, list_client);
+  list_client->set_request_timeout(std::chrono::milliseconds(1));
+
+  auto seeded = parameters_client->enable_parameter_cache();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(1u, list_client->remove_expired_requests());
+
+  ASSERT_EQ(std::future_status::ready, seeded.wait_for(std::chrono::seconds(0)));
+  EXPECT_THROW(seeded.get(), std::runtime_error);
+  EXPECT_FALSE(parameters_client->is_parameter_cache_ready());
+
+  // The cache can be enabled again after a failure.
+  parameters_client->disable_parameter_cache();
+  auto reseeded = parameters_client->enable_parameter_cache();
+  EXPECT_EQ(std::future_status::timeout, reseeded.wait_for(std::chrono::seconds(0)));
+}
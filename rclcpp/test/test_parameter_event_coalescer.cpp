@@ -0,0 +1,89 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "rclcpp/parameter_event_coalescer.hpp"
+
+using rclcpp::parameter_event_coalescer::ParameterEventCoalescer;
+
+static rcl_interfaces::msg::Parameter
+make_parameter(const std::string & name)
+{
+  rcl_interfaces::msg::Parameter parameter;
+  parameter.name = name;
+  return parameter;
+}
+
+/*
+   Tests that each parameter is reported once, by the difference of its first and last event.
+ */
+TEST(TestParameterEventCoalescer, final_state) {
+  ParameterEventCoalescer coalescer;
+  EXPECT_TRUE(coalescer.empty());
+
+  rcl_interfaces::msg::ParameterEvent first;
+  first.new_parameters.push_back(make_parameter("new_changed"));
+  first.new_parameters.push_back(make_parameter("new_deleted"));
+  first.changed_parameters.push_back(make_parameter("changed_deleted"));
+  first.changed_parameters.push_back(make_parameter("changed_changed"));
+  first.deleted_parameters.push_back(make_parameter("deleted_changed"));
+  coalescer.add(first);
+
+  rcl_interfaces::msg::ParameterEvent second;
+  second.changed_parameters.push_back(make_parameter("new_changed"));
+  second.changed_parameters.push_back(make_parameter("changed_changed"));
+  second.changed_parameters.push_back(make_parameter("deleted_changed"));
+  second.deleted_parameters.push_back(make_parameter("new_deleted"));
+  second.deleted_parameters.push_back(make_parameter("changed_deleted"));
+  coalescer.add(second);
+  EXPECT_FALSE(coalescer.empty());
+
+  rcl_interfaces::msg::ParameterEvent merged;
+  coalescer.take(merged);
+  EXPECT_TRUE(coalescer.empty());
+
+  ASSERT_EQ(1u, merged.new_parameters.size());
+  EXPECT_EQ("new_changed", merged.new_parameters[0].name);
+  ASSERT_EQ(2u, merged.changed_parameters.size());
+  EXPECT_EQ("changed_changed", merged.changed_parameters[0].name);
+  EXPECT_EQ("deleted_changed", merged.changed_parameters[1].name);
+  ASSERT_EQ(1u, merged.deleted_parameters.size());
+  EXPECT_EQ("changed_deleted", merged.deleted_parameters[0].name);
+}
+
+/*
+   Tests that nothing is left pending once the merged event was taken.
+ */
+TEST(TestParameterEventCoalescer, take_resets) {
+  ParameterEventCoalescer coalescer;
+  rcl_interfaces::msg::ParameterEvent event;
+  event.new_parameters.push_back(make_parameter("a"));
+  coalescer.add(event);
+
+  rcl_interfaces::msg::ParameterEvent merged;
+  coalescer.take(merged);
+  EXPECT_EQ(1u, merged.new_parameters.size());
+
+  // The parameter exists now, so changing it again is reported as a change.
+  rcl_interfaces::msg::ParameterEvent change;
+  change.changed_parameters.push_back(make_parameter("a"));
+  coalescer.add(change);
+  rcl_interfaces::msg::ParameterEvent merged_again;
+  coalescer.take(merged_again);
+  EXPECT_EQ(0u, merged_again.new_parameters.size());
+  EXPECT_EQ(1u, merged_again.changed_parameters.size());
+}
@@ -0,0 +1,99 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "rclcpp/parameter_snapshot.hpp"
+
+using rclcpp::parameter::ParameterVariant;
+using rclcpp::parameter_snapshot::ParameterHandle;
+using rclcpp::parameter_snapshot::ParameterMap;
+using rclcpp::parameter_snapshot::ParameterReadCache;
+
+static void
+set(ParameterMap & parameters, const ParameterVariant & parameter)
+{
+  parameters[parameter.get_name()] = parameter;
+}
+
+/*
+   Tests that snapshots do not change when parameters are published afterwards.
+ */
+TEST(TestParameterSnapshot, snapshot) {
+  ParameterReadCache cache;
+  auto empty = cache.get_snapshot();
+  EXPECT_TRUE(empty.get_parameters().empty());
+
+  ParameterMap parameters;
+  set(parameters, ParameterVariant("gain", 1.5));
+  set(parameters, ParameterVariant("name", "robot"));
+  cache.publish(parameters, {"gain", "name"});
+  auto first = cache.get_snapshot();
+
+  set(parameters, ParameterVariant("gain", 2.5));
+  cache.publish(parameters, {"gain"});
+  auto second = cache.get_snapshot();
+
+  ParameterVariant parameter;
+  ASSERT_TRUE(first.get_parameter("gain", parameter));
+  EXPECT_EQ(1.5, parameter.as_double());
+  ASSERT_TRUE(second.get_parameter("gain", parameter));
+  EXPECT_EQ(2.5, parameter.as_double());
+  EXPECT_TRUE(second.has_parameter("name"));
+  EXPECT_FALSE(second.get_parameter("missing", parameter));
+  EXPECT_TRUE(empty.get_parameters().empty());
+}
+
+/*
+   Tests that handles follow the published changes of their parameter and type.
+ */
+TEST(TestParameterSnapshot, handles) {
+  ParameterReadCache cache;
+  ParameterMap parameters;
+  set(parameters, ParameterVariant("rate", static_cast<int64_t>(100)));
+
+  auto rate = cache.get_handle<int64_t>("rate", parameters);
+  auto rate_as_double = cache.get_handle<double>("rate", parameters);
+  auto enabled = cache.get_handle<bool>("enabled", parameters);
+  int64_t value = 0;
+  ASSERT_TRUE(rate.get(value));
+  EXPECT_EQ(100, value);
+  double double_value = 0.0;
+  EXPECT_FALSE(rate_as_double.get(double_value));
+  EXPECT_TRUE(enabled.get_or(true));
+  EXPECT_EQ(0, ParameterHandle<int64_t>().get_or(0));
+
+  // Handles to the same parameter and type share their value.
+  auto same_rate = cache.get_handle<int64_t>("rate", parameters);
+
+  set(parameters, ParameterVariant("rate", 2.0));
+  set(parameters, ParameterVariant("enabled", false));
+  cache.publish(parameters, {"rate", "enabled"});
+  EXPECT_FALSE(rate.get(value));
+  EXPECT_FALSE(same_rate.get(value));
+  EXPECT_EQ(2.0, rate_as_double.get_or(0.0));
+  EXPECT_FALSE(enabled.get_or(true));
+
+  // Parameters which were not named as changed are left alone.
+  set(parameters, ParameterVariant("enabled", true));
+  cache.publish(parameters, {"rate"});
+  EXPECT_FALSE(enabled.get_or(true));
+
+  parameters.erase("enabled");
+  cache.publish(parameters, {"enabled"});
+  EXPECT_TRUE(enabled.get_or(true));
+}
@@ -0,0 +1,150 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "rclcpp/pending_request_table.hpp"
+
+using rclcpp::pending_request_table::PendingRequestTable;
+
+/*
+   Tests that entries are taken by their sequence number, once.
+ */
+TEST(TestPendingRequestTable, insert_take) {
+  PendingRequestTable<std::unique_ptr<int>> table(4);
+  for (int64_t i = 1; i <= 3; ++i) {
+    table.insert(i, PendingRequestTable<std::unique_ptr<int>>::no_deadline,
+      std::unique_ptr<int>(new int(static_cast<int>(i * 10))));
+  }
+  EXPECT_EQ(3u, table.size());
+
+  std::unique_ptr<int> value;
+  EXPECT_FALSE(table.take(5, value));
+  EXPECT_TRUE(table.contains(2));
+  EXPECT_TRUE(table.take(2, value));
+  EXPECT_FALSE(table.contains(2));
+  ASSERT_TRUE(value);
+  EXPECT_EQ(20, *value);
+  EXPECT_FALSE(table.take(2, value));
+  EXPECT_EQ(2u, table.size());
+  EXPECT_THROW(
+    table.insert(1, 0, std::unique_ptr<int>(new int(0))), std::invalid_argument);
+}
+
+/*
+   Tests that the table grows when more sequence numbers are in flight than it has slots.
+ */
+TEST(TestPendingRequestTable, grow) {
+  PendingRequestTable<int> table(4);
+  EXPECT_EQ(4u, table.capacity());
+  for (int64_t i = 0; i < 100; ++i) {
+    table.insert(i, PendingRequestTable<int>::no_deadline, static_cast<int>(i));
+  }
+  EXPECT_EQ(100u, table.size());
+  EXPECT_LE(100u, table.capacity());
+  for (int64_t i = 99; i >= 0; --i) {
+    int value = -1;
+    ASSERT_TRUE(table.take(i, value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_EQ(0u, table.size());
+
+  // Keeping one old request pending while the sequence numbers advance.
+  PendingRequestTable<int> sparse_table(4);
+  sparse_table.insert(0, PendingRequestTable<int>::no_deadline, 0);
+  for (int64_t i = 1; i < 1000; ++i) {
+    sparse_table.insert(i, PendingRequestTable<int>::no_deadline, static_cast<int>(i));
+    int value = -1;
+    ASSERT_TRUE(sparse_table.take(i, value));
+  }
+  int value = -1;
+  EXPECT_TRUE(sparse_table.take(0, value));
+  EXPECT_EQ(0, value);
+}
+
+/*
+   Tests that a request whose response is lost does not make the table grow as the sequence
+   numbers advance, and can still be taken or expire.
+ */
+TEST(TestPendingRequestTable, lost_response) {
+  PendingRequestTable<int> table(4);
+  table.insert(0, PendingRequestTable<int>::no_deadline, 0);
+  table.insert(1, 1000, 1);
+  for (int64_t i = 2; i < 100000; ++i) {
+    table.insert(i, PendingRequestTable<int>::no_deadline, static_cast<int>(i));
+    int value = -1;
+    ASSERT_TRUE(table.take(i, value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_EQ(2u, table.size());
+  // Three entries at most were held at once.
+  EXPECT_GE(8u, table.capacity());
+  EXPECT_THROW(table.insert(0, 0, 0), std::invalid_argument);
+  EXPECT_TRUE(table.contains(0));
+
+  std::vector<int> expired;
+  EXPECT_EQ(1u, table.remove_expired(2000, expired));
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(1, expired[0]);
+  int value = -1;
+  EXPECT_TRUE(table.take(0, value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(0u, table.size());
+}
+
+/*
+   Tests that reserving keeps the entries and fits as many consecutive sequence numbers.
+ */
+TEST(TestPendingRequestTable, reserve) {
+  PendingRequestTable<int> table(4);
+  table.insert(1, PendingRequestTable<int>::no_deadline, 1);
+  table.reserve(100);
+  EXPECT_EQ(128u, table.capacity());
+  for (int64_t i = 2; i <= 128; ++i) {
+    table.insert(i, PendingRequestTable<int>::no_deadline, static_cast<int>(i));
+  }
+  EXPECT_EQ(128u, table.capacity());
+  int value = -1;
+  EXPECT_TRUE(table.take(1, value));
+  EXPECT_EQ(1, value);
+  table.reserve(10);
+  EXPECT_EQ(128u, table.capacity());
+}
+
+/*
+   Tests that only the entries whose deadline passed are removed.
+ */
+TEST(TestPendingRequestTable, remove_expired) {
+  PendingRequestTable<int> table;
+  table.insert(1, 100, 1);
+  table.insert(2, 200, 2);
+  table.insert(3, PendingRequestTable<int>::no_deadline, 3);
+
+  std::vector<int> expired;
+  EXPECT_EQ(0u, table.remove_expired(50, expired));
+  EXPECT_EQ(1u, table.remove_expired(150, expired));
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(1, expired[0]);
+  EXPECT_EQ(1u, table.remove_expired(1000, expired));
+  EXPECT_EQ(2u, expired.size());
+  EXPECT_EQ(1u, table.size());
+
+  int value = -1;
+  EXPECT_FALSE(table.take(2, value));
+  EXPECT_TRUE(table.take(3, value));
+}
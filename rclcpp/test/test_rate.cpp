@@ -98,3 +98,39 @@ TEST(TestRate, wall_rate_basics) {
   delta = five - four;
   ASSERT_TRUE(epsilon > delta);
 }
+
+/*
+   Tests that the statistics of a rate with a precision margin count the slept and the missed
+   cycles. How far a sleep overshoots depends on the scheduling of the machine running the test,
+   so it is not checked against the margin.
+ */
+TEST(TestRate, precision_margin_statistics) {
+  auto period = std::chrono::milliseconds(10);
+  auto margin = std::chrono::milliseconds(2);
+
+  rclcpp::rate::WallRate r(period);
+  r.set_precision_margin(margin);
+  ASSERT_EQ(margin, r.get_precision_margin());
+  uint64_t missed_cycles = 0;
+  for (int i = 0; i < 5; ++i) {
+    if (!r.sleep()) {
+      ++missed_cycles;
+    }
+  }
+  auto statistics = r.get_statistics();
+  EXPECT_EQ(5u, statistics.cycles);
+  EXPECT_EQ(missed_cycles, statistics.missed_cycles);
+  if (statistics.missed_cycles < statistics.cycles) {
+    EXPECT_LE(statistics.min_overshoot, statistics.mean_overshoot());
+    EXPECT_LE(statistics.mean_overshoot(), statistics.max_overshoot);
+  }
+
+  rclcpp::utilities::sleep_for(2 * period);
+  ASSERT_FALSE(r.sleep());
+  statistics = r.get_statistics();
+  EXPECT_EQ(6u, statistics.cycles);
+  EXPECT_EQ(missed_cycles + 1, statistics.missed_cycles);
+
+  r.reset_statistics();
+  EXPECT_EQ(0u, r.get_statistics().cycles);
+}
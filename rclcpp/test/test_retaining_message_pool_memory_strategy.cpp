@@ -0,0 +1,177 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "rclcpp/strategies/retaining_message_pool_memory_strategy.hpp"
+
+using rclcpp::strategies::message_pool_memory_strategy::RetainingMessagePoolMemoryStrategy;
+
+struct PointCloud
+{
+  std::string frame_id;
+  std::vector<float> points;
+};
+
+/*
+   Tests that reused messages keep the capacity of their strings and sequences.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, retain_capacity) {
+  RetainingMessagePoolMemoryStrategy<PointCloud, 1> strategy;
+  auto message = strategy.borrow_message();
+  PointCloud * address = message.get();
+  message->frame_id = "a frame id which is too long for the small string buffer";
+  message->points.resize(1000);
+  const float * data = message->points.data();
+  strategy.return_message(message);
+  EXPECT_EQ(nullptr, message);
+
+  message = strategy.borrow_message();
+  EXPECT_EQ(address, message.get());
+  EXPECT_LE(1000u, message->points.capacity());
+  message->points.resize(500);
+  EXPECT_EQ(data, message->points.data());
+}
+
+/*
+   Tests that the reset function is called before a message is reused.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, reset) {
+  RetainingMessagePoolMemoryStrategy<PointCloud, 1> strategy(
+    [](PointCloud & message) {
+      message.frame_id.clear();
+      message.points.clear();
+    });
+  auto message = strategy.borrow_message();
+  message->frame_id = "map";
+  message->points.resize(1000);
+  strategy.return_message(message);
+
+  message = strategy.borrow_message();
+  EXPECT_TRUE(message->frame_id.empty());
+  EXPECT_TRUE(message->points.empty());
+  EXPECT_LE(1000u, message->points.capacity());
+}
+
+/// Message whose construction can be made to fail.
+struct FragileMessage
+{
+  static int constructed;
+  static bool fail_construction;
+
+  FragileMessage()
+  {
+    if (fail_construction) {
+      throw std::runtime_error("construction failed");
+    }
+    ++constructed;
+  }
+
+  ~FragileMessage()
+  {
+    --constructed;
+  }
+};
+
+int FragileMessage::constructed = 0;
+bool FragileMessage::fail_construction = false;
+
+/*
+   Tests that a message whose reset and replacement failed is neither destroyed twice nor reused.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, failed_reset) {
+  {
+    RetainingMessagePoolMemoryStrategy<FragileMessage, 1> strategy(
+      [](FragileMessage &) {
+        throw std::runtime_error("reset failed");
+      });
+    EXPECT_EQ(1, FragileMessage::constructed);
+    auto message = strategy.borrow_message();
+    FragileMessage::fail_construction = true;
+    strategy.return_message(message);
+    EXPECT_EQ(0, FragileMessage::constructed);
+
+    // The message is constructed again once the entry is borrowed.
+    EXPECT_THROW(strategy.borrow_message(), std::runtime_error);
+    FragileMessage::fail_construction = false;
+    message = strategy.borrow_message();
+    EXPECT_EQ(1, FragileMessage::constructed);
+    EXPECT_EQ(1u, strategy.get_capacity());
+  }
+  EXPECT_EQ(0, FragileMessage::constructed);
+}
+
+/*
+   Tests that the pool grows when messages are kept, and keeps the new messages.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, grow) {
+  RetainingMessagePoolMemoryStrategy<PointCloud, 1> strategy;
+  auto message1 = strategy.borrow_message();
+  auto kept = message1;
+  strategy.return_message(message1);
+  auto message2 = strategy.borrow_message();
+  EXPECT_NE(kept.get(), message2.get());
+  EXPECT_EQ(2u, strategy.get_capacity());
+
+  PointCloud * address = message2.get();
+  strategy.return_message(message2);
+  kept.reset();
+  auto message3 = strategy.borrow_message();
+  auto message4 = strategy.borrow_message();
+  EXPECT_TRUE(message3.get() == address || message4.get() == address);
+  EXPECT_EQ(2u, strategy.get_capacity());
+}
+
+/*
+   Tests that messages outlive the strategy they were borrowed from.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, outlive_strategy) {
+  std::shared_ptr<PointCloud> message;
+  {
+    RetainingMessagePoolMemoryStrategy<PointCloud, 2> strategy;
+    message = strategy.borrow_message();
+  }
+  message->points.resize(10);
+  message.reset();
+}
+
+/*
+   Tests that threads can borrow and return concurrently without sharing a message.
+ */
+TEST(TestRetainingMessagePoolMemoryStrategy, concurrent) {
+  RetainingMessagePoolMemoryStrategy<PointCloud, 2> strategy;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&strategy, t]() {
+        for (size_t i = 0; i < 10000; ++i) {
+          auto message = strategy.borrow_message();
+          message->points.assign(t + 1, static_cast<float>(i));
+          std::this_thread::yield();
+          ASSERT_EQ(t + 1, message->points.size());
+          EXPECT_EQ(static_cast<float>(i), message->points.back());
+          strategy.return_message(message);
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  EXPECT_GE(4u, strategy.get_capacity());
+}
@@ -0,0 +1,105 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "allocation_tracking.hpp"
+#include "rclcpp/service_memory_strategy.hpp"
+#include "rclcpp/strategies/service_pool_memory_strategy.hpp"
+
+struct MockService
+{
+  struct Request
+  {
+    std::string name;
+  };
+  struct Response
+  {
+    std::vector<double> values;
+  };
+};
+
+using rclcpp::service_memory_strategy::AllocatorServiceMemoryStrategy;
+using rclcpp::service_memory_strategy::ServiceMemoryStrategy;
+using rclcpp::strategies::service_pool_memory_strategy::ServicePoolMemoryStrategy;
+
+/*
+   Tests that the default strategy hands out new objects.
+ */
+TEST(TestServiceMemoryStrategy, default_strategy) {
+  auto strategy = ServiceMemoryStrategy<MockService>::create_default();
+  auto request = strategy->borrow_request();
+  auto response = strategy->borrow_response();
+  auto request_header = strategy->borrow_request_header();
+  ASSERT_NE(nullptr, request);
+  ASSERT_NE(nullptr, response);
+  ASSERT_NE(nullptr, request_header);
+  strategy->return_request(request);
+  strategy->return_response(response);
+  strategy->return_request_header(request_header);
+  EXPECT_EQ(nullptr, request);
+  EXPECT_EQ(nullptr, response);
+  EXPECT_EQ(nullptr, request_header);
+}
+
+/*
+   Tests that the allocator strategy allocates with the given allocator.
+ */
+TEST(TestServiceMemoryStrategy, allocator_strategy) {
+  using Alloc = allocation_tracking::TrackingAllocator<void>;
+  auto allocator = std::make_shared<Alloc>();
+  ServiceMemoryStrategy<MockService>::SharedPtr strategy =
+    std::make_shared<AllocatorServiceMemoryStrategy<MockService, Alloc>>(allocator);
+  auto request = strategy->borrow_request();
+  auto response = strategy->borrow_response();
+  auto request_header = strategy->borrow_request_header();
+  EXPECT_EQ(3u, allocator->get_counters()->allocations.load());
+  strategy->return_request(request);
+  strategy->return_response(response);
+  strategy->return_request_header(request_header);
+  EXPECT_EQ(3u, allocator->get_counters()->deallocations.load());
+}
+
+/*
+   Tests that the pool strategy recycles objects, keeping their capacity, and does not allocate
+   once warmed up.
+ */
+TEST(TestServiceMemoryStrategy, pool_strategy) {
+  ServiceMemoryStrategy<MockService>::SharedPtr strategy =
+    std::make_shared<ServicePoolMemoryStrategy<MockService, 1>>();
+  auto response = strategy->borrow_response();
+  MockService::Response * address = response.get();
+  response->values.resize(100);
+  strategy->return_response(response);
+
+  allocation_tracking::start();
+  for (size_t i = 0; i < 10; ++i) {
+    allocation_tracking::ScopedRegion region("service");
+    auto request = strategy->borrow_request();
+    auto request_header = strategy->borrow_request_header();
+    response = strategy->borrow_response();
+    EXPECT_EQ(address, response.get());
+    EXPECT_LE(100u, response->values.capacity());
+    strategy->return_request(request);
+    strategy->return_request_header(request_header);
+    strategy->return_response(response);
+  }
+  allocation_tracking::stop();
+  EXPECT_EQ(0u, allocation_tracking::get_allocation_count("service")) <<
+    allocation_tracking::get_report();
+}
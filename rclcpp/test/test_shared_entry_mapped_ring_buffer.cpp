@@ -0,0 +1,204 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define RCLCPP_BUILDING_LIBRARY 1  // Prevent including unavailable symbols
+#include <rclcpp/shared_entry_mapped_ring_buffer.hpp>
+
+using rclcpp::mapped_ring_buffer::SharedEntryMappedRingBuffer;
+
+/*
+   Tests get_copy and pop on an empty buffer.
+ */
+TEST(TestSharedEntryMappedRingBuffer, empty) {
+  EXPECT_THROW(SharedEntryMappedRingBuffer<char> mrb(0), std::invalid_argument);
+  SharedEntryMappedRingBuffer<char> mrb(1);
+
+  std::unique_ptr<char> actual;
+  mrb.get_copy_at_key(1, actual);
+  EXPECT_EQ(nullptr, actual);
+
+  mrb.pop_at_key(1, actual);
+  EXPECT_EQ(nullptr, actual);
+  EXPECT_FALSE(mrb.has_key(1));
+}
+
+/*
+   Tests normal usage of the buffer, in particular that popping the last
+   reference moves the original value out instead of copying it.
+ */
+TEST(TestSharedEntryMappedRingBuffer, nominal) {
+  SharedEntryMappedRingBuffer<char> mrb(2);
+  std::unique_ptr<char> expected(new char('a'));
+  char * expected_orig = expected.get();
+
+  EXPECT_FALSE(mrb.push_and_replace(1, expected));
+  EXPECT_EQ(nullptr, expected);
+  EXPECT_TRUE(mrb.has_key(1));
+
+  std::unique_ptr<char> actual;
+  mrb.get_copy_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ('a', *actual);
+  EXPECT_NE(expected_orig, actual.get());
+
+  // Ownership cannot be handed out while the value is still stored, so it is a copy.
+  mrb.get_ownership_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_NE(expected_orig, actual.get());
+
+  mrb.pop_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ(expected_orig, actual.get());
+  EXPECT_FALSE(mrb.has_key(1));
+
+  // Displaced values are returned.
+  EXPECT_FALSE(mrb.push_and_replace(2, std::unique_ptr<char>(new char('b'))));
+  EXPECT_FALSE(mrb.push_and_replace(3, std::unique_ptr<char>(new char('c'))));
+  expected.reset(new char('d'));
+  EXPECT_TRUE(mrb.push_and_replace(4, expected));
+  ASSERT_NE(nullptr, expected);
+  EXPECT_EQ('b', *expected);
+  EXPECT_FALSE(mrb.has_key(2));
+  EXPECT_TRUE(mrb.has_key(3));
+  EXPECT_TRUE(mrb.has_key(4));
+}
+
+/*
+   Tests that a value which is still shared is copied when popped.
+ */
+TEST(TestSharedEntryMappedRingBuffer, shared_values) {
+  SharedEntryMappedRingBuffer<char> mrb(2);
+  std::unique_ptr<char> expected(new char('a'));
+  char * expected_orig = expected.get();
+  mrb.push_and_replace(1, expected);
+
+  std::shared_ptr<const char> shared;
+  mrb.get_shared_at_key(1, shared);
+  ASSERT_NE(nullptr, shared);
+  EXPECT_EQ(expected_orig, shared.get());
+
+  std::unique_ptr<char> actual;
+  mrb.pop_at_key(1, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ('a', *actual);
+  EXPECT_NE(expected_orig, actual.get());
+  // The shared reference stays valid after the value was removed.
+  EXPECT_EQ('a', *shared);
+
+  std::shared_ptr<const char> pushed(new char('b'));
+  mrb.push_and_replace(2, pushed);
+  mrb.pop_shared_at_key(2, shared);
+  EXPECT_EQ(pushed.get(), shared.get());
+  EXPECT_FALSE(mrb.has_key(2));
+}
+
+TEST(TestSharedEntryMappedRingBuffer, test_at_key) {
+  SharedEntryMappedRingBuffer<char> mrb(2);
+  auto is_a = [](const char & value) {return value == 'a';};
+  EXPECT_FALSE(mrb.test_at_key(1, is_a));
+
+  std::unique_ptr<char> unique(new char('a'));
+  char * unique_orig = unique.get();
+  mrb.push_and_replace(1, unique);
+  std::shared_ptr<const char> pushed(new char('b'));
+  mrb.push_and_replace(2, pushed);
+  EXPECT_TRUE(mrb.test_at_key(1, is_a));
+  EXPECT_FALSE(mrb.test_at_key(2, is_a));
+
+  // Testing did not keep a reference, so the value can still be moved out.
+  std::unique_ptr<char> actual;
+  mrb.pop_at_key(1, actual);
+  EXPECT_EQ(unique_orig, actual.get());
+  EXPECT_FALSE(mrb.test_at_key(1, is_a));
+}
+
+/*
+   Tests releasing stored values without returning them.
+ */
+TEST(TestSharedEntryMappedRingBuffer, remove_at_key) {
+  SharedEntryMappedRingBuffer<char> mrb(2);
+  EXPECT_FALSE(mrb.remove_at_key(1));
+
+  std::unique_ptr<char> unique(new char('a'));
+  mrb.push_and_replace(1, unique);
+  std::shared_ptr<const char> shared;
+  mrb.get_shared_at_key(1, shared);
+
+  EXPECT_TRUE(mrb.remove_at_key(1));
+  EXPECT_FALSE(mrb.has_key(1));
+  EXPECT_FALSE(mrb.remove_at_key(1));
+  // The reader which got the value before keeps it.
+  EXPECT_EQ('a', *shared);
+}
+
+/*
+   Tests a writer and readers using the buffer concurrently.
+   Every value read must be a complete value written for that key.
+ */
+TEST(TestSharedEntryMappedRingBuffer, concurrent_readers) {
+  const uint64_t count = 10000;
+  SharedEntryMappedRingBuffer<std::vector<uint64_t>> mrb(4);
+  std::atomic<uint64_t> last_key(0);
+  std::atomic_bool failed(false);
+
+  auto reader = [&]() {
+      uint64_t key = 0;
+      while (key < count) {
+        key = last_key.load();
+        std::unique_ptr<std::vector<uint64_t>> value;
+        mrb.get_copy_at_key(key, value);
+        if (value && (value->size() != 16 || (*value)[0] != key || (*value)[15] != key)) {
+          failed.store(true);
+        }
+      }
+    };
+  std::thread reader1(reader);
+  std::thread reader2(reader);
+
+  for (uint64_t key = 1; key <= count; ++key) {
+    std::unique_ptr<std::vector<uint64_t>> value(new std::vector<uint64_t>(16, key));
+    mrb.push_and_replace(key, value);
+    last_key.store(key);
+  }
+  reader1.join();
+  reader2.join();
+  EXPECT_FALSE(failed.load());
+}
+
+/*
+   Tests the sequential key mode.
+ */
+TEST(TestSharedEntryMappedRingBuffer, sequential_keys) {
+  using rclcpp::mapped_ring_buffer::MappedRingBufferKeyMode;
+  SharedEntryMappedRingBuffer<char> mrb(3, nullptr, MappedRingBufferKeyMode::Sequential);
+  for (uint64_t key = 0; key < 5; ++key) {
+    std::unique_ptr<char> value(new char('a' + key));
+    EXPECT_EQ(key >= 3, mrb.push_and_replace(key, value));
+  }
+  EXPECT_FALSE(mrb.has_key(1));
+  std::unique_ptr<char> actual;
+  mrb.pop_at_key(4, actual);
+  ASSERT_NE(nullptr, actual);
+  EXPECT_EQ('e', *actual);
+  mrb.get_copy_at_key(7, actual);
+  EXPECT_EQ(nullptr, actual);
+  EXPECT_TRUE(mrb.has_key(2));
+}
@@ -0,0 +1,119 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rclcpp/executors/single_threaded_executor.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/parameter.hpp"
+#include "rclcpp/statistics_publisher.hpp"
+#include "rclcpp/utilities.hpp"
+
+using rcl_interfaces::msg::ParameterEvent;
+using rclcpp::executors::single_threaded_executor::SingleThreadedExecutor;
+using rclcpp::parameter::ParameterVariant;
+using rclcpp::statistics_publisher::StatisticsPublisher;
+
+class TestStatisticsPublisher : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase()
+  {
+    rclcpp::utilities::init(0, nullptr);
+  }
+
+  void SetUp()
+  {
+    node = rclcpp::node::Node::make_shared("test_statistics_publisher");
+    executor = std::make_shared<SingleThreadedExecutor>();
+    executor->add_node(node);
+  }
+
+  void TearDown()
+  {
+    executor->remove_node(node);
+  }
+
+  rclcpp::node::Node::SharedPtr node;
+  rclcpp::executor::Executor::SharedPtr executor;
+};
+
+std::map<std::string, ParameterVariant>
+values_of(const ParameterEvent & message)
+{
+  std::map<std::string, ParameterVariant> values;
+  for (auto & parameter : message.new_parameters) {
+    auto value = ParameterVariant::from_parameter(parameter);
+    values.emplace(value.get_name(), value);
+  }
+  return values;
+}
+
+/*
+   Tests that the arguments are checked and that the executor statistics are enabled.
+ */
+TEST_F(TestStatisticsPublisher, construction) {
+  EXPECT_THROW(StatisticsPublisher(nullptr, executor), std::invalid_argument);
+  EXPECT_THROW(StatisticsPublisher(node, nullptr), std::invalid_argument);
+  EXPECT_THROW(
+    StatisticsPublisher(node, executor, std::chrono::nanoseconds(0)), std::invalid_argument);
+
+  EXPECT_FALSE(executor->get_statistics_enabled());
+  StatisticsPublisher statistics_publisher(node, executor);
+  EXPECT_TRUE(executor->get_statistics_enabled());
+}
+
+/*
+   Tests that the collected statistics name the node and report the topics of its subscriptions.
+ */
+TEST_F(TestStatisticsPublisher, collect) {
+  auto subscription = node->create_subscription<ParameterEvent>(
+    "statistics_test_topic", [](ParameterEvent::SharedPtr) {});
+  StatisticsPublisher statistics_publisher(node, executor, std::chrono::hours(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  auto values = values_of(*statistics_publisher.collect());
+  ASSERT_EQ(1u, values.count("node"));
+  EXPECT_EQ("test_statistics_publisher", values.at("node").as_string());
+  ASSERT_EQ(1u, values.count("period_ns"));
+  EXPECT_LT(0, values.at("period_ns").as_int());
+  EXPECT_EQ(1u, values.count("executor.idle_ratio"));
+  const std::string prefix = "topic.statistics_test_topic.";
+  ASSERT_EQ(1u, values.count(prefix + "messages_per_second"));
+  EXPECT_EQ(0.0, values.at(prefix + "messages_per_second").as_double());
+  ASSERT_EQ(1u, values.count(prefix + "intra_process_dropped"));
+  EXPECT_EQ(0, values.at(prefix + "intra_process_dropped").as_int());
+  EXPECT_EQ(1u, values.count(prefix + "callback_duration_p999_ns"));
+}
+
+/*
+   Tests that statistics publishers can be destroyed while the executor runs their timers.
+ */
+TEST_F(TestStatisticsPublisher, destroyed_while_spinning) {
+  std::thread spinner([this]() {executor->spin();});
+  for (size_t i = 0; i < 50; ++i) {
+    StatisticsPublisher statistics_publisher(node, executor, std::chrono::microseconds(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  executor->cancel();
+  spinner.join();
+}
@@ -0,0 +1,174 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "rclcpp/timer_queue.hpp"
+
+using std::chrono::milliseconds;
+
+/// Timer with a fixed time until its trigger, which needs no rcl timer.
+class FakeTimer
+{
+public:
+  RCLCPP_SMART_PTR_DEFINITIONS(FakeTimer);
+
+  explicit FakeTimer(
+    std::chrono::nanoseconds time_until_trigger,
+    std::chrono::nanoseconds slack = std::chrono::nanoseconds::zero())
+  : time_until_trigger_(time_until_trigger), slack_(slack), canceled_(false), ready_(true),
+    handle_()
+  {}
+
+  std::chrono::nanoseconds time_until_trigger() {return time_until_trigger_;}
+  std::chrono::nanoseconds get_slack() const {return slack_;}
+  bool is_canceled() {return canceled_;}
+  bool is_ready() {return ready_;}
+  const rcl_timer_t * get_timer_handle() {return &handle_;}
+
+  std::chrono::nanoseconds time_until_trigger_;
+  std::chrono::nanoseconds slack_;
+  bool canceled_;
+  bool ready_;
+
+private:
+  rcl_timer_t handle_;
+};
+
+using TimerQueue = rclcpp::timer::TimerQueue<std::allocator<void>, FakeTimer>;
+using Clock = TimerQueue::Clock;
+using Handles = std::vector<const rcl_timer_t *>;
+
+/*
+   Tests that timers are handed out in the order of their expiry.
+ */
+TEST(TestTimerQueue, ordering) {
+  auto now = Clock::now();
+  auto late = FakeTimer::make_shared(milliseconds(30));
+  auto early = FakeTimer::make_shared(milliseconds(10));
+  auto middle = FakeTimer::make_shared(milliseconds(20));
+  TimerQueue queue;
+  EXPECT_GT(std::chrono::nanoseconds::zero(), queue.time_until_next(now));
+  queue.push(late, now);
+  queue.push(early, now);
+  queue.push(middle, now);
+  EXPECT_EQ(3u, queue.size());
+  EXPECT_EQ(milliseconds(10), queue.time_until_next(now));
+
+  Handles ready;
+  queue.pop_ready(ready, now + milliseconds(5));
+  EXPECT_TRUE(ready.empty());
+  queue.pop_ready(ready, now + milliseconds(25));
+  ASSERT_EQ(2u, ready.size());
+  EXPECT_EQ(early->get_timer_handle(), ready[0]);
+  EXPECT_EQ(middle->get_timer_handle(), ready[1]);
+  EXPECT_EQ(milliseconds(5), queue.time_until_next(now + milliseconds(25)));
+  // Handed out timers are kept aside until they are requeued.
+  EXPECT_EQ(3u, queue.size());
+
+  queue.requeue(now + milliseconds(25));
+  EXPECT_EQ(3u, queue.size());
+  EXPECT_EQ(milliseconds(5), queue.time_until_next(now + milliseconds(25)));
+  EXPECT_EQ(std::chrono::nanoseconds::zero(), queue.time_until_next(now + milliseconds(40)));
+}
+
+/*
+   Tests that timers which turn out not to be ready, or which are gone, are not handed out.
+ */
+TEST(TestTimerQueue, stale_timers) {
+  auto now = Clock::now();
+  auto not_ready = FakeTimer::make_shared(milliseconds(10));
+  not_ready->ready_ = false;
+  auto gone = FakeTimer::make_shared(milliseconds(10));
+  TimerQueue queue;
+  queue.push(not_ready, now);
+  queue.push(gone, now);
+  gone.reset();
+
+  Handles ready;
+  queue.pop_ready(ready, now + milliseconds(10));
+  EXPECT_TRUE(ready.empty());
+  // The timer which is not ready is requeued, the one which is gone is dropped.
+  queue.requeue(now + milliseconds(10));
+  EXPECT_EQ(1u, queue.size());
+  EXPECT_EQ(milliseconds(10), queue.time_until_next(now + milliseconds(10)));
+}
+
+/*
+   Tests that canceled timers are neither handed out nor woken up for, until they are reset.
+ */
+TEST(TestTimerQueue, canceled_timers) {
+  auto now = Clock::now();
+  auto canceled = FakeTimer::make_shared(milliseconds(10));
+  canceled->canceled_ = true;
+  TimerQueue queue;
+  queue.push(canceled, now);
+  EXPECT_EQ(1u, queue.size());
+  EXPECT_GT(std::chrono::nanoseconds::zero(), queue.time_until_next(now));
+
+  // Every wait requeues the canceled timer, which puts it aside again.
+  Handles ready;
+  for (int i = 0; i < 3; ++i) {
+    queue.requeue(now);
+    queue.pop_ready(ready, now + milliseconds(20));
+    EXPECT_TRUE(ready.empty());
+    EXPECT_EQ(1u, queue.size());
+    EXPECT_GT(std::chrono::nanoseconds::zero(), queue.time_until_next(now));
+  }
+
+  canceled->canceled_ = false;
+  queue.requeue(now);
+  EXPECT_EQ(1u, queue.size());
+  EXPECT_EQ(milliseconds(10), queue.time_until_next(now));
+  queue.pop_ready(ready, now + milliseconds(10));
+  ASSERT_EQ(1u, ready.size());
+  EXPECT_EQ(canceled->get_timer_handle(), ready[0]);
+}
+
+/*
+   Tests that the slack of timers lets one wakeup trigger timers expiring close to each other.
+ */
+TEST(TestTimerQueue, slack_coalescing) {
+  auto now = Clock::now();
+  TimerQueue queue;
+  auto first = FakeTimer::make_shared(milliseconds(10), milliseconds(10));
+  auto second = FakeTimer::make_shared(milliseconds(15));
+  auto third = FakeTimer::make_shared(milliseconds(40));
+  queue.push(first, now);
+  queue.push(second, now);
+  queue.push(third, now);
+  // Waking up for the second timer is within the slack of the first one.
+  EXPECT_EQ(milliseconds(15), queue.time_until_next(now));
+  Handles ready;
+  queue.pop_ready(ready, now + milliseconds(15));
+  EXPECT_EQ(2u, ready.size());
+
+  // A timer expiring after the end of the slack gets its own wakeup.
+  TimerQueue separate;
+  auto slack = FakeTimer::make_shared(milliseconds(10), milliseconds(5));
+  auto later = FakeTimer::make_shared(milliseconds(30));
+  separate.push(slack, now);
+  separate.push(later, now);
+  EXPECT_EQ(milliseconds(15), separate.time_until_next(now));
+
+  // Without slack, the wakeup is the earliest expiry.
+  TimerQueue exact;
+  exact.push(FakeTimer::make_shared(milliseconds(20)), now);
+  exact.push(FakeTimer::make_shared(milliseconds(10)), now);
+  EXPECT_EQ(milliseconds(10), exact.time_until_next(now));
+}
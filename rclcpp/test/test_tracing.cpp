@@ -0,0 +1,44 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "rclcpp/tracing.hpp"
+
+int evaluations = 0;
+
+int64_t
+evaluate()
+{
+  return ++evaluations;
+}
+
+/*
+   Tests that the tracepoints are usable as statements and that their arguments are only
+   evaluated if tracing is compiled in.
+ */
+TEST(TestTracing, arguments) {
+  evaluations = 0;
+  {
+    RCLCPP_TRACE_CALLBACK_SCOPE(evaluate());
+    RCLCPP_TRACEPOINT(take, evaluate(), evaluate());
+  }
+#ifdef RCLCPP_ENABLE_TRACING
+  EXPECT_EQ(4, evaluations);
+#else
+  EXPECT_EQ(0, evaluations);
+#endif
+}
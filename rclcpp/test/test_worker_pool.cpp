@@ -0,0 +1,234 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rclcpp/executors/worker_pool.hpp"
+
+using rclcpp::executors::worker_pool::WorkerPool;
+using rclcpp::executors::worker_pool::WorkerPoolOptions;
+using rclcpp::executors::worker_pool::WorkerQueueOptions;
+
+/// Blocks the single thread of a pool, so tasks can be queued before any of them runs.
+class Gate
+{
+public:
+  Gate()
+  : open_(false)
+  {}
+
+  void
+  wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() {return open_;});
+  }
+
+  void
+  open()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      open_ = true;
+    }
+    condition_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool open_;
+};
+
+/// Records the order in which tasks ran, and waits for a number of them.
+class Recorder
+{
+public:
+  std::function<void()>
+  task(const std::string & name)
+  {
+    return [this, name]() {
+             std::lock_guard<std::mutex> lock(mutex_);
+             order_ += name;
+             condition_.notify_all();
+           };
+  }
+
+  std::string
+  wait_for(size_t count)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this, count]() {return order_.size() >= count;});
+    return order_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::string order_;
+};
+
+WorkerPool::SharedPtr
+make_single_threaded_pool()
+{
+  WorkerPoolOptions options;
+  options.number_of_threads = 1;
+  return WorkerPool::make_shared(options);
+}
+
+/*
+   Tests that tasks of several queues all run, on the given number of threads.
+ */
+TEST(TestWorkerPool, runs_tasks) {
+  WorkerPoolOptions options;
+  options.number_of_threads = 3;
+  WorkerPool pool(options);
+  EXPECT_EQ(3u, pool.get_number_of_threads());
+
+  std::atomic<size_t> count(0);
+  std::mutex mutex;
+  std::condition_variable condition;
+  auto first = pool.create_queue();
+  auto second = pool.create_queue();
+  for (size_t i = 0; i < 100; ++i) {
+    pool.submit(i % 2 ? first : second, [&]() {
+        if (++count == 100) {
+          std::lock_guard<std::mutex> lock(mutex);
+          condition.notify_all();
+        }
+      });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, [&count]() {return count.load() == 100;});
+
+  WorkerPool other(options);
+  EXPECT_THROW(other.submit(first, []() {}), std::invalid_argument);
+  WorkerQueueOptions no_share;
+  no_share.share = 0;
+  EXPECT_THROW(pool.create_queue(no_share), std::invalid_argument);
+}
+
+/*
+   Tests that the share of a queue is limited to the range in which its stride is not zero.
+ */
+TEST(TestWorkerPool, share_range) {
+  WorkerPoolOptions options;
+  options.number_of_threads = 1;
+  WorkerPool pool(options);
+
+  WorkerQueueOptions largest_share;
+  largest_share.share = WorkerQueueOptions::max_share;
+  auto queue = pool.create_queue(largest_share);
+  EXPECT_TRUE(queue != nullptr);
+  WorkerQueueOptions too_large_share;
+  too_large_share.share = WorkerQueueOptions::max_share + 1;
+  EXPECT_THROW(pool.create_queue(too_large_share), std::invalid_argument);
+
+  // The tasks of a queue with the largest share run along with those of other queues.
+  std::atomic<size_t> count(0);
+  std::mutex mutex;
+  std::condition_variable condition;
+  auto other = pool.create_queue();
+  for (size_t i = 0; i < 10; ++i) {
+    pool.submit(i % 2 ? queue : other, [&]() {
+        if (++count == 10) {
+          std::lock_guard<std::mutex> lock(mutex);
+          condition.notify_all();
+        }
+      });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, [&count]() {return count.load() == 10;});
+}
+
+/*
+   Tests that queues of a higher priority are served first, in the order of their tasks.
+ */
+TEST(TestWorkerPool, priority) {
+  auto pool = make_single_threaded_pool();
+  WorkerQueueOptions high_options;
+  high_options.priority = 1;
+  auto low = pool->create_queue();
+  auto high = pool->create_queue(high_options);
+
+  Gate gate;
+  Recorder recorder;
+  pool->submit(low, [&gate]() {gate.wait();});
+  pool->submit(low, recorder.task("a"));
+  pool->submit(low, recorder.task("b"));
+  pool->submit(high, recorder.task("X"));
+  pool->submit(high, recorder.task("Y"));
+  gate.open();
+  EXPECT_EQ("XYab", recorder.wait_for(4));
+}
+
+/*
+   Tests that busy queues of the same priority are served in proportion to their shares.
+ */
+TEST(TestWorkerPool, shares) {
+  auto pool = make_single_threaded_pool();
+  WorkerQueueOptions triple_options;
+  triple_options.share = 3;
+  WorkerQueueOptions gate_options;
+  gate_options.priority = 1;
+  auto single = pool->create_queue();
+  auto triple = pool->create_queue(triple_options);
+  auto gate_queue = pool->create_queue(gate_options);
+
+  Gate gate;
+  Recorder recorder;
+  pool->submit(gate_queue, [&gate]() {gate.wait();});
+  for (size_t i = 0; i < 4; ++i) {
+    pool->submit(single, recorder.task("s"));
+  }
+  for (size_t i = 0; i < 12; ++i) {
+    pool->submit(triple, recorder.task("t"));
+  }
+  gate.open();
+  std::string order = recorder.wait_for(16);
+  // At any point, about one in four tasks run was of the single share queue.
+  for (size_t i = 1; i <= order.size(); ++i) {
+    auto singles = std::count(order.begin(), order.begin() + i, 's');
+    EXPECT_LE(static_cast<size_t>(singles), i / 4 + 1) << order;
+    EXPECT_GE(static_cast<size_t>(singles) + 1, i / 4) << order;
+  }
+}
+
+/*
+   Tests that the tasks of a released queue are dropped.
+ */
+TEST(TestWorkerPool, released_queue) {
+  auto pool = make_single_threaded_pool();
+  auto released = pool->create_queue();
+  auto kept = pool->create_queue();
+
+  Gate gate;
+  Recorder recorder;
+  pool->submit(kept, [&gate]() {gate.wait();});
+  pool->submit(released, recorder.task("r"));
+  pool->submit(kept, recorder.task("k"));
+  released.reset();
+  gate.open();
+  EXPECT_EQ("k", recorder.wait_for(1));
+}